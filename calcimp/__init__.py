@@ -6,11 +6,33 @@ using transmission line theory. It supports both ZMENSUR (.men) and XMENSUR (.xm
 
 Main function:
     calcimp(filename, ...) - Calculate input impedance from a mensur file
+    calcimp_many(paths, ...) - The same for many files at once on native threads
+    simplify_men(filename, ...) - Merge redundant cells of a mensur
+    calcimp_terminations(filename, ...) - Input impedance for several end conditions
+    chain_matrix(filename, ...) / terminate(chain, ...) - The same in two steps
+    Instrument(filename).calcimp(states, ...) - Switch valves and toneholes without reparsing
+    Instrument(filename).fingerings(states_list, ...) - A whole fingering chart in one sweep
+    Instrument(filename).resonances(states, ...) - Peaks of one state
+    loads(text, format) - An Instrument from mensur text in memory
+    Mensur(filename) - A parsed and compiled bore evaluated many times
+    IncrementalBore(filename, ...) - Sweep again after editing a few cells
+    impedance_at(filename, frequencies, ...) - Impedance at arbitrary frequencies
+    pressure_field(filename, frequencies, ...) - Pressure and volume velocity along the bore
+    calcimp_adaptive(filename, ...) - A frequency grid refined around the peaks
+    find_resonances(filename, ...) - Peak frequencies, magnitudes and Q factors
+    sensitivities(filename, frequencies, ...) - Derivatives of Z by every cell
+    resonance_sensitivities(filename, ...) - Derivatives of the peak frequencies by every cell
+    optimize(filename, variables, targets, ...) - Fit XMENSUR variables to target resonances
+    xmen_variables(filename) - Variables defined in an XMENSUR file
+    fit_rational(freq, z, ...) - Pole-residue model of a sweep, evaluated anywhere
+    reflectance(filename, ...) - Reflectance, reflection function and impulse response
+    set_cache_size(n) / clear_cache() / cache_info() - Parsed files kept between calls
 
 Constants:
     NONE   - No radiation impedance calculation
     PIPE   - Pipe radiation impedance (default)
     BUFFLE - Infinite baffle radiation impedance
+    CLOSED - Closed end (terminations only)
 
 Example:
     >>> import calcimp
@@ -23,23 +45,58 @@ Example:
 from . import _calcimp_c
 
 # Import the Python wrapper
-from .calcimp_wrapper import calcimp
+from .calcimp_wrapper import (calcimp, calcimp_many, simplify_men, chain_matrix,
+                              terminate, calcimp_terminations, Instrument, loads,
+                              IncrementalBore, impedance_at, pressure_field, calcimp_adaptive,
+                              find_resonances, sensitivities, resonance_sensitivities,
+                              optimize, xmen_variables, reflectance, CLOSED)
+from .rational import fit_rational, RationalModel
 
 # Re-export constants
 NONE = _calcimp_c.NONE
 PIPE = _calcimp_c.PIPE
 BUFFLE = _calcimp_c.BUFFLE
 
-# Re-export print_men
+# Re-export C types and functions
+Mensur = _calcimp_c.Mensur
 print_men = _calcimp_c.print_men
+radiation_impedance = _calcimp_c.radiation_impedance
+set_cache_size = _calcimp_c.set_cache_size
+clear_cache = _calcimp_c.clear_cache
+cache_info = _calcimp_c.cache_info
 
 # Define public API
 __all__ = [
     'calcimp',
+    'calcimp_many',
     'print_men',
+    'simplify_men',
+    'chain_matrix',
+    'terminate',
+    'calcimp_terminations',
+    'Instrument',
+    'loads',
+    'Mensur',
+    'IncrementalBore',
+    'impedance_at',
+    'pressure_field',
+    'calcimp_adaptive',
+    'find_resonances',
+    'sensitivities',
+    'resonance_sensitivities',
+    'optimize',
+    'xmen_variables',
+    'fit_rational',
+    'RationalModel',
+    'reflectance',
+    'radiation_impedance',
+    'set_cache_size',
+    'clear_cache',
+    'cache_info',
     'NONE',
     'PIPE',
     'BUFFLE',
+    'CLOSED',
 ]
 
 __version__ = '0.8.3'
@@ -5,11 +5,32 @@ This module provides a high-level interface to the calcimp C extension
 that automatically handles both ZMENSUR (.men) and XMENSUR (.xmen) file formats.
 """
 
+import numpy as np
+
 from . import _calcimp_c
+from .rational import fit_rational
+
+# Termination of terminate() / calcimp_terminations() closing the open end
+CLOSED = 'closed'
+
+
+def _rad_calc_arg(rad_calc):
+    """rad_calc for the C extension, None meaning PIPE."""
+    return _calcimp_c.PIPE if rad_calc is None else rad_calc
+
+
+def _simplify_arg(simplify):
+    """simplify for the C extension: None or False disables, True merges exactly."""
+    if simplify is None or simplify is False:
+        return -1.0
+    if simplify is True:
+        return 0.0
+    return simplify
 
 
 def calcimp(filename, max_freq=2000.0, step_freq=2.5, num_freq=0, temperature=24.0,
-            rad_calc=None, dump_calc=True, sec_var_calc=False):
+            rad_calc=None, dump_calc=True, sec_var_calc=False, threads=1,
+            scalar=False, fast_math=False, simplify=None, rational=None):
     """Calculate input impedance of a tube.
 
     This function supports both ZMENSUR (.men) and XMENSUR (.xmen) file formats.
@@ -25,28 +46,846 @@ def calcimp(filename, max_freq=2000.0, step_freq=2.5, num_freq=0, temperature=24
                                   or calcimp.NONE (default: calcimp.PIPE)
         dump_calc (bool, optional): Enable wall damping calculation (default: True)
         sec_var_calc (bool, optional): Enable section variation calculation (default: False)
+        threads (int, optional): Number of native threads for the frequency sweep.
+                                 0 uses all processors. The GIL is released during
+                                 the sweep and the result does not depend on threads
+                                 (default: 1)
+        scalar (bool, optional): Evaluate one frequency at a time with the reference
+                                 kernel instead of SIMD blocks of frequencies. Both
+                                 agree within rounding (default: False)
+        fast_math (bool, optional): Use fused sincos/expm1 for the complex sin and cos,
+                                 accurate to a few ULP, instead of the GSL-exact
+                                 functions (default: False)
+        simplify (float, optional): Merge redundant cells before the sweep (see
+                                 simplify_men). 0 merges only cylinders of equal
+                                 diameter and leaves the impedance unchanged. A
+                                 positive value is the allowed diameter error in
+                                 mm; cones are merged too, which changes the wall
+                                 losses (about 1e-2 relative with dump_calc).
+                                 None disables (default: None)
+        rational (int or bool, optional): Also fit a pole-residue model of that
+                                 many poles to the sweep (see fit_rational), True
+                                 chooses the number (default: None)
 
     Returns:
         tuple: (frequencies, real_part, imaginary_part, magnitude_db)
-               All return values are NumPy arrays.
+               All return values are NumPy arrays. With rational, a fifth item
+               is the RationalModel, callable on any frequencies.
 
     Examples:
         >>> import calcimp
         >>> freq, real, imag, mag_db = calcimp.calcimp("sample.men")
         >>> freq, real, imag, mag_db = calcimp.calcimp("sample.xmen")  # XMENSUR format
+        >>> freq, real, imag, mag_db, model = calcimp.calcimp("sample.men", rational=True)
     """
-    # Default rad_calc to PIPE if not specified
-    if rad_calc is None:
-        rad_calc = _calcimp_c.PIPE
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
 
     # Pass directly to C extension - it handles both .men and .xmen formats
-    return _calcimp_c.calcimp(
+    result = _calcimp_c.calcimp(
         filename, max_freq, step_freq, num_freq, temperature,
-        rad_calc, dump_calc, sec_var_calc
+        rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math, simplify
+    )
+    if rational is None or rational is False:
+        return result
+
+    freq, real, imag, _ = result
+    n_poles = None if rational is True else int(rational)
+    return result + (fit_rational(freq, real + 1j * imag, n_poles),)
+
+
+def calcimp_many(paths, max_freq=2000.0, step_freq=2.5, num_freq=0, temperature=24.0,
+                 rad_calc=None, dump_calc=True, sec_var_calc=False, threads=0,
+                 scalar=False, fast_math=False, simplify=None):
+    """Calculate the input impedance of many tubes at once.
+
+    The files are read, compiled and swept on a pool of native threads with
+    the GIL released, one file per thread, so the parsing of some files
+    overlaps the sweeps of others. A file that cannot be read does not stop
+    the others. The files are read directly, without the cache of parsed files.
+
+    Parameters:
+        paths (sequence): Paths of the mensur files (.men or .xmen), str or
+                          os.PathLike
+        threads (int, optional): Number of files evaluated at once. 0 uses all
+                                 processors (default: 0)
+        The other parameters are those of calcimp().
+
+    Returns:
+        list: One entry per path in the same order, the tuple
+              (frequencies, real_part, imaginary_part, magnitude_db) of calcimp()
+              or, for a file that failed, a RuntimeError naming the file.
+
+    Examples:
+        >>> import calcimp, glob
+        >>> files = sorted(glob.glob("designs/*.xmen"))
+        >>> for fn, res in zip(files, calcimp.calcimp_many(files)):
+        ...     if isinstance(res, Exception):
+        ...         print(res)
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    return _calcimp_c.calcimp_many(
+        paths, max_freq, step_freq, num_freq, temperature,
+        rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math, simplify
     )
 
 
+def simplify_men(filename, tolerance=0.0):
+    """Read a mensur file and merge redundant cells.
+
+    Adjacent cells are merged when they form one straight taper. Cells with a
+    branch at their outlet and the terminal cell of each branch are kept.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        tolerance (float, optional): Allowed diameter error in mm. 0 merges only
+                                     cylinders of equal diameter, which leaves the
+                                     impedance unchanged. A positive value also
+                                     merges cones into one taper; the wall losses
+                                     use one mean diameter per cell, so even
+                                     collinear cones change the impedance with
+                                     dump_calc, by about 1e-2 relative (default: 0.0)
+
+    Returns:
+        tuple: (cells_removed, cells)
+               cells_removed counts the removed cells of all branches,
+               cells is the simplified main bore like print_men()
+
+    Examples:
+        >>> import calcimp
+        >>> removed, cells = calcimp.simplify_men("sample.men")
+        >>> removed, cells = calcimp.simplify_men("ct_bore.men", tolerance=0.05)
+    """
+    return _calcimp_c.simplify_men(filename, tolerance)
+
+
 # Re-export constants from C extension
 NONE = _calcimp_c.NONE
 PIPE = _calcimp_c.PIPE
 BUFFLE = _calcimp_c.BUFFLE
+
+
+def chain_matrix(filename, max_freq=2000.0, step_freq=2.5, num_freq=0, temperature=24.0,
+                 rad_calc=None, dump_calc=True, sec_var_calc=False, threads=1,
+                 fast_math=False, simplify=None):
+    """Calculate the chain matrix of the main bore once for any termination.
+
+    The matrix covers everything but the open end of the main bore, so the
+    input impedance for an end impedance Z_L is
+
+        Z = (t11 * Z_L + t12) / (t21 * Z_L + t22)
+
+    at O(1) cost per frequency (see terminate). Side branches are part of
+    the matrix, so their own open ends keep the radiation mode rad_calc.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        rad_calc (int, optional): Radiation mode of side branch ends
+                                  (default: calcimp.PIPE)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (frequencies, chain, bell_diameter, closed)
+               chain is a complex array of shape (n, 2, 2), scaled so that Z
+               matches calcimp(); bell_diameter is the diameter of the open end
+               in mm; closed is True if the bore itself is closed
+
+    Examples:
+        >>> import calcimp
+        >>> chain = calcimp.chain_matrix("sample.men")
+        >>> freq, real, imag, mag_db = calcimp.terminate(chain, calcimp.BUFFLE)
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    return _calcimp_c.chain_matrix(
+        filename, max_freq, step_freq, num_freq, temperature,
+        rad_calc, dump_calc, sec_var_calc, threads, fast_math, simplify
+    )
+
+
+def terminate(chain, termination, temperature=24.0):
+    """Input impedance from a chain matrix and a termination of the open end.
+
+    Parameters:
+        chain (tuple): Result of chain_matrix()
+        termination: One of
+                     - calcimp.PIPE, calcimp.BUFFLE or calcimp.NONE: radiation
+                       impedance of the bell
+                     - (mode, e_ratio): radiation of the bell diameter scaled by
+                       e_ratio; e_ratio 0 closes the end
+                     - calcimp.CLOSED: closed end
+                     - a complex scalar or array of end impedances Z_L in Pa s/m^3,
+                       one per frequency
+                     A closed bore stays closed whatever the termination.
+        temperature (float, optional): Temperature in Celsius for the radiation
+                                       impedance, use that of chain_matrix()
+                                       (default: 24.0)
+
+    Returns:
+        tuple: (frequencies, real_part, imaginary_part, magnitude_db) as calcimp()
+    """
+    freq, t, bell, closed = chain
+    t11, t12, t21, t22 = t[:, 0, 0], t[:, 0, 1], t[:, 1, 0], t[:, 1, 1]
+
+    if isinstance(termination, str):
+        if termination != CLOSED:
+            raise ValueError(f"unknown termination {termination!r}")
+        closed = True
+        z_l = None
+    elif isinstance(termination, tuple):
+        mode, e_ratio = termination
+        if e_ratio == 0:
+            closed = True
+            z_l = None
+        elif not closed:
+            z_l = _calcimp_c.radiation_impedance(freq, bell * e_ratio, mode, temperature)
+    elif isinstance(termination, (int, np.integer)):
+        if not closed:
+            z_l = _calcimp_c.radiation_impedance(freq, bell, termination, temperature)
+    else:
+        z_l = np.broadcast_to(np.asarray(termination, dtype=complex), freq.shape)
+
+    with np.errstate(divide='ignore', invalid='ignore'):
+        if closed:
+            z = t11 / t21
+        else:
+            z = (t11 * z_l + t12) / (t21 * z_l + t22)
+    z = np.where(freq > 0, z, 0)  # DC is not evaluated
+
+    mag = z.real ** 2 + z.imag ** 2
+    with np.errstate(divide='ignore'):
+        mag_db = np.where(mag > 0, 10 * np.log10(mag), mag)
+
+    return freq, z.real.copy(), z.imag.copy(), mag_db
+
+
+def calcimp_terminations(filename, terminations=(_calcimp_c.PIPE, _calcimp_c.BUFFLE,
+                                                 _calcimp_c.NONE, CLOSED),
+                         max_freq=2000.0, step_freq=2.5, num_freq=0, temperature=24.0,
+                         **kwargs):
+    """Calculate input impedance for several terminations from one sweep.
+
+    Equivalent to calling calcimp() once per termination, except that side
+    branch ends keep the radiation mode rad_calc (default calcimp.PIPE)
+    whatever the termination of the main bore.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        terminations (sequence, optional): Terminations as accepted by terminate()
+                                           (default: PIPE, BUFFLE, NONE, CLOSED)
+        Other keyword arguments are passed to chain_matrix().
+
+    Returns:
+        list: One (frequencies, real_part, imaginary_part, magnitude_db) tuple per
+              termination
+
+    Examples:
+        >>> import calcimp
+        >>> pipe, baffle, none, closed = calcimp.calcimp_terminations("sample.men")
+    """
+    chain = chain_matrix(filename, max_freq=max_freq, step_freq=step_freq,
+                         num_freq=num_freq, temperature=temperature, **kwargs)
+    return [terminate(chain, term, temperature) for term in terminations]
+
+
+class Instrument:
+    """A mensur file read once, with switchable valves and toneholes.
+
+    Every branch point (tonehole, ADDON or SPLIT/JOIN valve) is addressed by
+    its side branch name. A state maps names to ratios in [0, 1]: 0 closes a
+    tonehole or bypasses a valve loop, 1 opens it fully. Names not given keep
+    the ratio of the file. A name shared by several branch points, such as
+    the split and join of one valve, sets all of them.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+
+    Examples:
+        >>> import calcimp
+        >>> tp = calcimp.Instrument("trumpet_valve.xmen")
+        >>> tp.branches
+        {'VALVE1': 1.0}
+        >>> freq, real, imag, mag_db = tp.calcimp({'VALVE1': 0})
+    """
+
+    def __init__(self, filename):
+        self.filename = filename
+        self._handle = _calcimp_c.load_instrument(filename)
+
+    @classmethod
+    def _from_handle(cls, handle):
+        inst = cls.__new__(cls)
+        inst.filename = None
+        inst._handle = handle
+        return inst
+
+    @property
+    def branches(self):
+        """dict: Branch name -> ratio given in the file, in bore order."""
+        return {name: ratio
+                for name, s_type, ratio in _calcimp_c.instrument_branches(self._handle)}
+
+    def calcimp(self, states=None, max_freq=2000.0, step_freq=2.5, num_freq=0,
+                temperature=24.0, rad_calc=None, dump_calc=True, sec_var_calc=False,
+                threads=1, scalar=False, fast_math=False, simplify=None):
+        """Calculate input impedance for a state of the branch points.
+
+        Parameters:
+            states (dict, optional): Branch name -> ratio in [0, 1]. Unknown names
+                                     raise KeyError (default: ratios of the file)
+            The other parameters are those of calcimp().
+
+        Returns:
+            tuple: (frequencies, real_part, imaginary_part, magnitude_db)
+        """
+        rad_calc = _rad_calc_arg(rad_calc)
+        simplify = _simplify_arg(simplify)
+
+        return _calcimp_c.instrument_calcimp(
+            self._handle, states, max_freq, step_freq, num_freq, temperature,
+            rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math, simplify
+        )
+
+    def fingerings(self, fingerings, max_freq=2000.0, step_freq=2.5, num_freq=0,
+                   temperature=24.0, rad_calc=None, dump_calc=True, sec_var_calc=False,
+                   threads=1, fast_math=False, simplify=None):
+        """Calculate input impedance for a list of states in one sweep.
+
+        Transmission matrices are computed once per frequency for all states.
+        Each state then only walks the bore up to the first branch point where
+        it differs from an earlier state, so a fingering chart costs about one
+        sweep. States whose valves take different paths are grouped, and each
+        group shares its own sweep. The result of every state equals
+        calcimp(state, scalar=True).
+
+        Parameters:
+            fingerings (sequence): States as accepted by calcimp(), e.g. dicts
+                                   of hole name -> ratio
+            The other parameters are those of calcimp().
+
+        Returns:
+            tuple: (frequencies, real_part, imaginary_part, magnitude_db)
+                   frequencies has shape (n,), the others (len(fingerings), n)
+
+        Examples:
+            >>> chart = [{'h1': 0, 'h2': 0}, {'h1': 0, 'h2': 1}, {'h1': 1, 'h2': 1}]
+            >>> freq, real, imag, mag_db = inst.fingerings(chart)
+        """
+        rad_calc = _rad_calc_arg(rad_calc)
+        simplify = _simplify_arg(simplify)
+
+        return _calcimp_c.instrument_fingerings(
+            self._handle, fingerings, max_freq, step_freq, num_freq, temperature,
+            rad_calc, dump_calc, sec_var_calc, threads, fast_math, simplify
+        )
+
+    def resonances(self, states=None, max_freq=2000.0, step_freq=10.0, tol=1e-3,
+                   temperature=24.0, rad_calc=None, dump_calc=True, sec_var_calc=False,
+                   threads=1, scalar=False, fast_math=False, simplify=None):
+        """Find the impedance maxima for a state of the branch points.
+
+        Parameters:
+            states (dict, optional): as for calcimp()
+            The other parameters are those of find_resonances().
+
+        Returns:
+            tuple: (frequencies, magnitude, q, bandwidth) as find_resonances()
+        """
+        rad_calc = _rad_calc_arg(rad_calc)
+        simplify = _simplify_arg(simplify)
+
+        return _calcimp_c.instrument_resonances(
+            self._handle, states, max_freq, step_freq, tol, temperature,
+            rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math, simplify
+        )
+
+
+def loads(text, format="xmen"):
+    """Parse a mensur held in memory instead of a file.
+
+    The text is parsed exactly as the file readers parse the contents of a
+    file, so generated designs need no temporary files.
+
+    Parameters:
+        text (str or bytes): Contents of a mensur file
+        format (str, optional): 'xmen' for XMENSUR or 'men' for ZMENSUR
+                                (default: 'xmen')
+
+    Returns:
+        Instrument: with filename None
+
+    Examples:
+        >>> import calcimp
+        >>> text = "[\\n10, 10, 1000\\nOPEN_END\\n]\\n"  # generated XMENSUR
+        >>> inst = calcimp.loads(text)
+        >>> freq, real, imag, mag_db = inst.calcimp()
+    """
+    return Instrument._from_handle(_calcimp_c.load_instrument_text(text, format))
+
+
+class IncrementalBore:
+    """A bore swept again and again at fixed frequencies while its cells change.
+
+    The chain matrix of the main bore is kept per frequency as a tree of
+    products over blocks of cells. After set_cell(), calcimp() recomputes
+    only the edited blocks and their path to the root, so an optimizer
+    that moves a few diameters per iteration pays a small fraction of a
+    full sweep. Results equal calcimp() on the edited bore within rounding.
+    The tree takes 128 bytes per block and frequency. One bore may be
+    shared by Python threads; set_cell() waits for a sweep in progress.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        block (int, optional): Main bore cells per block; smaller blocks make
+                               edits cheaper and take more memory (default: 32)
+        The other parameters are those of calcimp() and are fixed for the bore.
+
+    Examples:
+        >>> import calcimp
+        >>> bore = calcimp.IncrementalBore("sample.men", max_freq=2000.0)
+        >>> freq, real, imag, mag_db = bore.calcimp()
+        >>> bore.set_cell(10, df=12.1, db=12.3)
+        >>> freq, real, imag, mag_db = bore.calcimp()
+    """
+
+    def __init__(self, filename, max_freq=2000.0, step_freq=2.5, num_freq=0,
+                 temperature=24.0, rad_calc=None, dump_calc=True, sec_var_calc=False,
+                 fast_math=False, simplify=None, block=0):
+        rad_calc = _rad_calc_arg(rad_calc)
+        simplify = _simplify_arg(simplify)
+
+        self.filename = filename
+        self._handle = _calcimp_c.load_bore_tree(
+            filename, max_freq, step_freq, num_freq, temperature,
+            rad_calc, dump_calc, sec_var_calc, fast_math, simplify, block
+        )
+
+    @property
+    def cells(self):
+        """list: (df, db, r, branch) in mm per cell, main bore (branch 0) first."""
+        return _calcimp_c.bore_tree_cells(self._handle)
+
+    def set_cell(self, index, df=None, db=None, r=None):
+        """Change diameters and length of a cell in mm.
+
+        Parameters:
+            index (int): Cell index as in cells
+            df, db, r (float, optional): New values, None keeps the current one.
+                                         The open end only takes df.
+        """
+        nan = float('nan')
+        _calcimp_c.bore_tree_set_cell(self._handle, index,
+                                      nan if df is None else df,
+                                      nan if db is None else db,
+                                      nan if r is None else r)
+
+    def calcimp(self, threads=1):
+        """Calculate input impedance of the bore as edited so far.
+
+        Parameters:
+            threads (int, optional): Native threads, as for calcimp() (default: 1)
+
+        Returns:
+            tuple: (frequencies, real_part, imaginary_part, magnitude_db)
+        """
+        return _calcimp_c.bore_tree_calcimp(self._handle, threads)
+
+
+def impedance_at(filename, frequencies, temperature=24.0, rad_calc=None, dump_calc=True,
+                 sec_var_calc=False, threads=0, fast_math=False, simplify=None):
+    """Calculate input impedance at arbitrary frequencies.
+
+    Like calcimp(), the frequencies are shared among threads and go through
+    the blocked kernel. That does not help when only a handful of them are
+    needed on a very long bore (4096 main bore cells or more): then the
+    cells of the main bore are cut into one block per thread instead. The
+    chain matrices of the blocks are formed in parallel and multiplied in
+    order, so the time per frequency falls with the number of cores.
+    Results equal calcimp() within rounding either way.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        frequencies (array-like): Frequencies in Hz, those not positive give 0
+        threads (int, optional): Native threads, 0 uses all processors
+                                 (default: 0)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (frequencies, real_part, imaginary_part, magnitude_db) as calcimp()
+
+    Examples:
+        >>> import calcimp
+        >>> freq, real, imag, mag_db = calcimp.impedance_at("ct_scan.men", [233.0, 466.0])
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    freq = np.asarray(frequencies, dtype=float)
+    z = _calcimp_c.impedance_at(filename, freq, temperature, rad_calc, dump_calc,
+                                sec_var_calc, threads, fast_math, simplify)
+
+    mag = z.real ** 2 + z.imag ** 2
+    with np.errstate(divide='ignore'):
+        mag_db = np.where(mag > 0, 10 * np.log10(mag), mag)
+
+    return freq, z.real.copy(), z.imag.copy(), mag_db
+
+
+def pressure_field(filename, frequencies, p0=1.0, step=0.0, temperature=24.0, rad_calc=None,
+                   dump_calc=True, sec_var_calc=False, threads=1, fast_math=False):
+    """Complex pressure and volume velocity along the main bore.
+
+    The standing wave of every frequency is propagated from the input to
+    the open end, cell by cell, with the transfer matrices of the sweep.
+    The frequencies are shared among threads, each with one workspace for
+    its whole range, so a whole sweep of mode shapes costs about as much as
+    its impedance. Stations are the inlets of the cells of the main bore;
+    step cuts longer cells into pieces for a finer picture. The cut is
+    exact for the lossless part, while the wall losses of a taper are then
+    taken per piece, which can move Z by a fraction of a percent.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        frequencies (array-like): Frequencies in Hz, those not positive give 0
+        p0 (complex, optional): Pressure at the input in Pa (default: 1.0)
+        step (float, optional): Longest distance between stations in mm,
+                                0 keeps the cells (default: 0.0)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (position, p, u); position of each station from the input in mm,
+               p in Pa and u (volume velocity) in m^3/s as complex NumPy arrays
+               of shape (len(frequencies), len(position))
+
+    Examples:
+        >>> import calcimp
+        >>> freq, mag, q, bw = calcimp.find_resonances("sample.men")
+        >>> x, p, u = calcimp.pressure_field("sample.men", freq, step=5.0)
+        >>> plt.plot(x, np.abs(p[:3]).T)  # first three modes
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+
+    freq = np.asarray(frequencies, dtype=float).ravel()
+    return _calcimp_c.pressure_field(filename, freq, p0, temperature, rad_calc, dump_calc,
+                                     sec_var_calc, threads, fast_math, step)
+
+
+def calcimp_adaptive(filename, max_freq=2000.0, step_freq=10.0, min_step=0.01, tol_db=1.0,
+                     tol_phase=0.2, max_points=100000, temperature=24.0, rad_calc=None,
+                     dump_calc=True, sec_var_calc=False, threads=1, scalar=False,
+                     fast_math=False, simplify=None):
+    """Calculate input impedance on a frequency grid refined around peaks.
+
+    The impedance is first sampled every step_freq Hz. Then every interval
+    next to a local maximum or minimum of |Z|, or across which |Z| changes
+    by more than tol_db or its phase by more than tol_phase, is halved, and
+    so on until no interval needs it or the intervals are narrower than
+    2*min_step. Peaks are thus located within min_step with a small fraction
+    of the points of a uniform grid of that step. Each refinement round is
+    evaluated as one batch on the threads.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)
+        step_freq (float, optional): Step of the coarse grid in Hz (default: 10.0)
+        min_step (float, optional): Intervals are not halved below this width
+                                    in Hz (default: 0.01)
+        tol_db (float, optional): Largest change of the magnitude in dB between
+                                  neighbouring points (default: 1.0)
+        tol_phase (float, optional): Largest change of the phase in rad between
+                                     neighbouring points (default: 0.2)
+        max_points (int, optional): Refinement stops at this number of points,
+                                    intervals next to extrema go first
+                                    (default: 100000)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (frequencies, real_part, imaginary_part, magnitude_db) as calcimp(),
+               with ascending but not equally spaced frequencies from 0
+
+    Examples:
+        >>> import calcimp
+        >>> freq, real, imag, mag_db = calcimp.calcimp_adaptive("sample.men", min_step=0.001)
+        >>> freq[np.argmax(mag_db)]  # the strongest peak within 0.001 Hz
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    return _calcimp_c.calcimp_adaptive(
+        filename, max_freq, step_freq, min_step, tol_db, tol_phase, max_points,
+        temperature, rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math, simplify
+    )
+
+
+def find_resonances(filename, max_freq=2000.0, step_freq=10.0, tol=1e-3, temperature=24.0,
+                    rad_calc=None, dump_calc=True, sec_var_calc=False, threads=1,
+                    scalar=False, fast_math=False, simplify=None):
+    """Find the maxima of the input impedance with their Q factors.
+
+    Local maxima of |Z| on a grid of step_freq bracket the peaks. Brent's
+    method then locates each peak within tol Hz, and false position does the
+    same for the -3 dB points on both sides. One step of every search is
+    evaluated in one batch on the threads. A peak typically costs about
+    twenty evaluations on top of the grid, where a dense sweep to the same
+    accuracy would need hundreds of thousands.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)
+        step_freq (float, optional): Step of the bracketing grid in Hz; it must
+                                     be finer than the spacing of neighbouring
+                                     peaks (default: 10.0)
+        tol (float, optional): Accuracy of the peak and -3 dB frequencies in Hz
+                               (default: 1e-3)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (frequencies, magnitude, q, bandwidth), NumPy arrays with one entry
+               per peak in ascending frequency. magnitude is |Z| as impedance
+               density (not dB), bandwidth the distance of the -3 dB points in Hz
+               and q = frequency / bandwidth. When |Z| rises towards the next peak
+               on the grid before falling 3 dB, bandwidth and q are NaN.
+
+    Examples:
+        >>> import calcimp
+        >>> freq, mag, q, bw = calcimp.find_resonances("sample.men")
+        >>> 1200 * np.log2(freq[1:] / freq[0])  # intervals from the pedal note in cents
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    return _calcimp_c.find_resonances(
+        filename, max_freq, step_freq, tol, temperature, rad_calc, dump_calc,
+        sec_var_calc, threads, scalar, fast_math, simplify
+    )
+
+
+def sensitivities(filename, frequencies, temperature=24.0, rad_calc=None, dump_calc=True,
+                  threads=1, fast_math=False):
+    """Calculate input impedance and its derivatives by every cell of the bore.
+
+    The bore is evaluated once per frequency and then walked back from the
+    input (the adjoint method), which gives dZ/d(df), dZ/d(db) and dZ/d(r)
+    of all cells at about the cost of two impedance evaluations. Finite
+    differences would need a sweep per cell and parameter. The chain
+    matrices are differentiated analytically, the radiation impedance of an
+    open end by a central difference.
+
+    Section variation (sec_var_calc) is not supported. A straight cell is
+    differentiated as the cone it becomes when df and db differ; cells of
+    zero length have zero derivatives.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        frequencies (array-like): Frequencies in Hz, those not positive give 0
+        threads (int, optional): Native threads over the frequencies, 0 uses all
+                                 processors (default: 1)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (z, dz_ddf, dz_ddb, dz_dr), complex NumPy arrays. z is the input
+               impedance density per frequency, the others have one row per
+               frequency and one column per cell in the order of
+               IncrementalBore(filename).cells, in impedance density per mm.
+
+    Examples:
+        >>> import calcimp
+        >>> z, dz_ddf, dz_ddb, dz_dr = calcimp.sensitivities("sample.men", [233.0])
+        >>> np.argmax(np.abs(dz_ddf[0]))  # the cell whose entry diameter matters most
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+
+    freq = np.asarray(frequencies, dtype=float)
+    return _calcimp_c.sensitivities(filename, freq, temperature, rad_calc, dump_calc,
+                                    threads, fast_math)
+
+
+def resonance_sensitivities(filename, max_freq=2000.0, step_freq=10.0, tol=1e-3,
+                            temperature=24.0, rad_calc=None, dump_calc=True, threads=1,
+                            fast_math=False):
+    """Find the impedance peaks and the derivatives of their frequencies by every cell.
+
+    The peaks are those of find_resonances(). At a peak d|Z|/df vanishes, so
+    the shift of the peak by a parameter p is -(d2|Z|/df dp) / (d2|Z|/df2).
+    Both are central differences over f0 +- 1e-5 f0 of log|Z| and of the
+    adjoint sensitivities, so each peak costs two forward and adjoint passes
+    after the peak search, not one. That is still independent of the number
+    of cells, where finding the peaks of perturbed bores would need a search
+    per cell.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        max_freq, step_freq, tol: As for find_resonances()
+        The other parameters are those of sensitivities().
+
+    Returns:
+        tuple: (frequencies, df_ddf, df_ddb, df_dr), NumPy arrays. frequencies are
+               the peaks in Hz, the others have one row per peak and one column
+               per cell as sensitivities(), in Hz per mm.
+
+    Examples:
+        >>> import calcimp
+        >>> freq, df_ddf, df_ddb, df_dr = calcimp.resonance_sensitivities("sample.men")
+        >>> df_dr[0].sum()  # shift of the first peak per mm of every cell
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+
+    return _calcimp_c.resonance_sensitivities(filename, max_freq, step_freq, tol, temperature,
+                                              rad_calc, dump_calc, threads, fast_math)
+
+
+def xmen_variables(filename):
+    """Return the variables defined in an XMENSUR file.
+
+    Parameters:
+        filename (str): Path to the .xmen file
+
+    Returns:
+        dict: name -> value, in order of definition
+    """
+    return _calcimp_c.xmen_variables(filename)
+
+
+def optimize(filename, variables, targets, bounds=None, max_freq=None, step_freq=10.0,
+             tol=1e-4, max_iter=50, ftol=1e-10, temperature=24.0, rad_calc=None,
+             dump_calc=True, sec_var_calc=False, threads=1, fast_math=False):
+    """Fit variables of an XMENSUR file to target resonances.
+
+    A bounded Levenberg-Marquardt loop runs entirely in C: each evaluation
+    sets the variables, parses the kept text of the file again, compiles
+    the bore and finds its resonances as find_resonances() does. The
+    Jacobian comes from the adjoint sensitivities of the peaks (see
+    resonance_sensitivities()), so an iteration costs a few evaluations
+    whatever the number of variables. A variable that changes the structure
+    of the bore, such as a branch ratio, is differentiated by finite
+    differences of whole evaluations instead.
+
+    Peak frequencies are fitted in cents and magnitude ratios in dB. Each
+    target follows the peak nearest to its frequency, so the starting point
+    should be close enough for the peaks not to swap.
+
+    Parameters:
+        filename (str): Path to the .xmen file
+        variables (list or dict): Names of the free variables, starting from
+                                  their values in the file, or name -> start
+        targets (list): One entry per target:
+                        f or (f, weight) - put the peak nearest to f Hz at f
+                        (f1, f2, db) or (f1, f2, db, weight) - make |Z| of the
+                        peak nearest to f1 exceed that near f2 by db dB
+        bounds (dict, optional): name -> (lower, upper), None for no bound
+        max_freq (float, optional): Resonance search range in Hz (default:
+                                    1.25 times the highest target)
+        step_freq, tol (float, optional): As find_resonances() (default: 10.0, 1e-4)
+        max_iter (int, optional): Most iterations (default: 50)
+        ftol (float, optional): Stop when an iteration lowers the cost by less
+                                than this fraction (default: 1e-10)
+        threads (int, optional): Native threads per evaluation (default: 1)
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (values, residuals, info). values is a dict name -> fitted value,
+               residuals a NumPy array per target in cents or dB without the
+               weights, info a dict with cost, iterations, evaluations and
+               converged.
+
+    Examples:
+        >>> import calcimp
+        >>> values, res, info = calcimp.optimize(
+        ...     "trumpet.xmen", ["bore_dia", "valve_len"], [116.5, 349.2],
+        ...     bounds={"bore_dia": (10.0, 13.0)})
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+
+    if isinstance(variables, dict):
+        names = list(variables)
+        x0 = [float(variables[n]) for n in names]
+    else:
+        names = list(variables)
+        defined = _calcimp_c.xmen_variables(filename)
+        missing = [n for n in names if n not in defined]
+        if missing:
+            raise ValueError(f"Variables not defined in {filename}: {', '.join(missing)}")
+        x0 = [defined[n] for n in names]
+
+    bounds = bounds or {}
+    lower, upper = [], []
+    for n in names:
+        lo, hi = bounds.get(n, (None, None))
+        lower.append(-np.inf if lo is None else lo)
+        upper.append(np.inf if hi is None else hi)
+
+    rows = []
+    for t in targets:
+        t = tuple(t) if isinstance(t, (tuple, list)) else (t,)
+        if len(t) <= 2:
+            rows.append((0, t[0], 0, 0, t[1] if len(t) == 2 else 1.0))
+        elif len(t) <= 4:
+            rows.append((1, t[0], t[1], t[2], t[3] if len(t) == 4 else 1.0))
+        else:
+            raise ValueError(f"Bad target {t!r}")
+    rows = np.array(rows, dtype=float).reshape(-1, 5)
+
+    if max_freq is None:
+        max_freq = 1.25 * np.max(rows[:, 1:3]) if len(rows) else 2000.0
+
+    x, residuals, cost, n_iter, n_eval, converged = _calcimp_c.optimize(
+        filename, names, x0, lower, upper, rows, max_freq, step_freq, tol, max_iter, ftol,
+        temperature, rad_calc, dump_calc, sec_var_calc, threads, fast_math
+    )
+    info = {'cost': cost, 'iterations': n_iter, 'evaluations': n_eval, 'converged': converged}
+    return dict(zip(names, x.tolist())), residuals, info
+
+
+_WINDOWS = {None: 0, 'rect': 0, 'hann': 1, 'blackman': 2}
+
+
+def reflectance(filename, sample_rate=44100.0, duration=0.1, max_freq=None, window='hann',
+                temperature=24.0, rad_calc=None, dump_calc=True, sec_var_calc=False,
+                threads=1, scalar=False, fast_math=False, simplify=None):
+    """Reflectance, reflection function and impulse response of a bore.
+
+    The input impedance is swept on the frequency grid of an FFT of
+    sample_rate and duration, turned into the reflectance
+
+        R = (Z - Zc) / (Z + Zc),    Zc = rho c / S of the first cell,
+
+    and both R and Z are transformed back to sampled time responses in C.
+    The band up to max_freq is tapered by the window, which trades the
+    ringing of the cut-off for a wider smearing of the echoes; above it the
+    spectrum is zero. The static limit at 0 Hz is taken from the first bin.
+
+    Parameters:
+        filename (str): Path to the mensur file (.men or .xmen)
+        sample_rate (float, optional): Sample rate in Hz (default: 44100.0)
+        duration (float, optional): Length of the responses in seconds; the
+                                    frequency step is 1 / duration (default: 0.1)
+        max_freq (float, optional): Highest frequency evaluated (default: sample_rate / 2)
+        window (str, optional): 'hann', 'blackman' or 'rect' (None) for no taper
+                                (default: 'hann')
+        The other parameters are those of calcimp().
+
+    Returns:
+        tuple: (freq, R, time, r, h), NumPy arrays. R is complex on the bins
+               freq of 0 .. sample_rate / 2; r is the reflection function and h
+               the impulse response of the impedance density per sample at time,
+               so that an input velocity u[n] gives the pressure sum_m h[m] u[n - m].
+
+    Examples:
+        >>> import calcimp
+        >>> freq, R, t, r, h = calcimp.reflectance("sample.men", duration=0.05)
+        >>> t[np.argmin(r)]  # round trip of the first echo from the bell
+    """
+    rad_calc = _rad_calc_arg(rad_calc)
+    simplify = _simplify_arg(simplify)
+
+    if window not in _WINDOWS:
+        raise ValueError(f"Unknown window {window!r}, expected 'hann', 'blackman' or 'rect'")
+
+    return _calcimp_c.reflectance(
+        filename, sample_rate, duration, -1.0 if max_freq is None else max_freq,
+        _WINDOWS[window], temperature, rad_calc, dump_calc, sec_var_calc, threads,
+        scalar, fast_math, simplify
+    )
@@ -0,0 +1,207 @@
+"""
+Rational (pole-residue) models of an impedance curve.
+
+fit_rational() approximates sampled Z(f) by
+
+    Z(s) = d + sum_n r_n / (s - p_n),    s = 2j * pi * f
+
+with vector fitting (Gustavsen and Semlyen, relaxed form): starting from
+poles spread over the band, the poles are relocated by a linear least
+squares problem for a weighting function sigma(s) whose zeros become the
+new poles, until they settle. Complex poles come in conjugate pairs, so the
+model is real in the time domain, and unstable poles are reflected into
+the left half plane.
+
+A tube needs about two poles per resonance. The wall losses, which go with
+sqrt(f), are taken by a few real poles on top.
+"""
+
+import numpy as np
+
+
+def _basis(s, poles):
+    """Real partial fraction basis at s, one column per real pole, two per pair.
+
+    poles holds the real poles and one pole (Im > 0) of each conjugate pair.
+    A pair with residue c' + j c'' contributes c' * first + c'' * second.
+    """
+    cols = []
+    for p in poles:
+        a = 1 / (s - p)
+        if p.imag == 0:
+            cols.append(a)
+        else:
+            b = 1 / (s - np.conj(p))
+            cols.append(a + b)
+            cols.append(1j * a - 1j * b)
+    return np.array(cols).T
+
+
+def _lstsq(rows, rhs):
+    """Least squares of complex rows with real unknowns, columns scaled to unit norm."""
+    a = np.vstack([rows.real, rows.imag])
+    b = np.concatenate([rhs.real, rhs.imag])
+    return _lstsq_real(a, b)
+
+
+def _lstsq_real(a, b):
+    scale = np.linalg.norm(a, axis=0)
+    scale[scale == 0] = 1.0
+    x = np.linalg.lstsq(a / scale, b, rcond=None)[0]
+    return x / scale
+
+
+def _state_matrix(poles):
+    """Real block diagonal state matrix and input vector of the basis."""
+    n = sum(1 if p.imag == 0 else 2 for p in poles)
+    a = np.zeros((n, n))
+    b = np.zeros(n)
+    k = 0
+    for p in poles:
+        if p.imag == 0:
+            a[k, k] = p.real
+            b[k] = 1.0
+            k += 1
+        else:
+            a[k:k + 2, k:k + 2] = [[p.real, p.imag], [-p.imag, p.real]]
+            b[k] = 2.0
+            k += 2
+    return a, b
+
+
+def _relocate(s, z, w, poles):
+    """One relaxed vector fitting step, returns the new poles."""
+    phi = _basis(s, poles)
+    k, n = phi.shape
+    wz = (w * z)[:, None]
+    rows = np.hstack([w[:, None] * phi, w[:, None], -wz * phi, -wz])
+    a = np.vstack([rows.real, rows.imag])
+    b = np.zeros(2 * k)
+
+    # relaxation: the mean of sigma over the samples is 1
+    scale = np.linalg.norm(w * z) / k
+    extra = np.concatenate([np.zeros(n + 1), scale * phi.real.sum(axis=0), [scale * k]])
+    x = _lstsq_real(np.vstack([a, extra]), np.append(b, scale * k))
+    c, d = x[n + 1:2 * n + 1], x[2 * n + 1]
+
+    if abs(d) < 1e-8:
+        # sigma's constant term vanishing, fix it to 1 instead
+        rows = np.hstack([w[:, None] * phi, w[:, None], -wz * phi])
+        x = _lstsq(rows, w * z)
+        c, d = x[n + 1:], 1.0
+
+    # the zeros of sigma
+    a, b = _state_matrix(poles)
+    zeros = np.linalg.eigvals(a - np.outer(b, c) / d)
+    zeros = np.where(zeros.real > 0, -zeros.conj(), zeros)
+    real = np.abs(zeros.imag) <= 1e-12 * np.abs(zeros)
+    return np.concatenate([zeros[real].real + 0j, zeros[~real & (zeros.imag > 0)]])
+
+
+def _residues(s, z, w, poles):
+    phi = _basis(s, poles)
+    rows = np.hstack([w[:, None] * phi, w[:, None]])
+    x = _lstsq(rows, w * z)
+    return x[:-1], x[-1]
+
+
+class RationalModel:
+    """Pole-residue model of an impedance, see fit_rational().
+
+    Attributes:
+        poles (ndarray): Complex poles in rad/s, conjugate pairs both listed
+        residues (ndarray): Complex residue of each pole
+        d (float): Constant term
+        rms_error (float): RMS of |model - Z| / |Z| over the fitted points
+        max_error (float): Largest |model - Z| / |Z| over the fitted points
+    """
+
+    def __init__(self, poles, coef, d, freq, z):
+        self._poles = poles
+        self._coef = coef
+        self.d = float(d)
+
+        residues = []
+        k = 0
+        for p in poles:
+            if p.imag == 0:
+                residues.append(coef[k] + 0j)
+                k += 1
+            else:
+                r = coef[k] + 1j * coef[k + 1]
+                residues += [r, np.conj(r)]
+                k += 2
+        self.poles = np.concatenate([[p] if p.imag == 0 else [p, np.conj(p)] for p in poles])
+        self.residues = np.array(residues)
+
+        rel = np.abs(self(freq) - z) / np.abs(z)
+        self.rms_error = float(np.sqrt(np.mean(rel ** 2)))
+        self.max_error = float(np.max(rel))
+
+    def __len__(self):
+        return len(self.poles)
+
+    def __repr__(self):
+        return (f"RationalModel({len(self)} poles, rms_error={self.rms_error:.2e}, "
+                f"max_error={self.max_error:.2e})")
+
+    def at_s(self, s):
+        """Evaluate at the complex angular frequency s = sigma + j omega (rad/s)."""
+        s = np.asarray(s, dtype=complex)
+        return _basis(s.ravel(), self._poles).dot(self._coef).reshape(s.shape) + self.d
+
+    def __call__(self, freq):
+        """Evaluate at frequencies in Hz, complex ones allowed (s = 2j pi freq)."""
+        return self.at_s(2j * np.pi * np.asarray(freq, dtype=complex))
+
+
+def fit_rational(freq, z, n_poles=None, n_iter=8, weight=None):
+    """Fit a pole-residue model to an impedance curve by vector fitting.
+
+    Parameters:
+        freq (array-like): Frequencies in Hz; points at or below 0 are ignored
+        z (array-like): Complex impedance at freq
+        n_poles (int, optional): Order of the model, two per resonance and a few
+                                 for the losses are needed (default: twice the
+                                 number of maxima of |Z| plus 10)
+        n_iter (int, optional): Pole relocation steps (default: 8)
+        weight (array-like, optional): Weight of each point, 1/|Z| fits the
+                                       relative error (default: 1/|Z|)
+
+    Returns:
+        RationalModel: callable on frequencies in Hz, with rms_error and max_error
+
+    Examples:
+        >>> import calcimp
+        >>> freq, real, imag, mag_db = calcimp.calcimp("sample.men")
+        >>> model = calcimp.fit_rational(freq, real + 1j * imag)
+        >>> model.max_error
+        >>> z = model(np.linspace(0, 2000, 100001))  # no bore traversal
+    """
+    freq = np.asarray(freq, dtype=float)
+    z = np.asarray(z, dtype=complex)
+    keep = (freq > 0) & (np.abs(z) > 0)
+    if weight is None:
+        w = 1 / np.abs(z[keep])
+    else:
+        w = np.broadcast_to(np.asarray(weight, dtype=float), z.shape)[keep]
+    freq, z = freq[keep], z[keep]
+
+    if n_poles is None:
+        m = np.abs(z)
+        n_poles = 2 * int(np.sum((m[1:-1] > m[:-2]) & (m[1:-1] > m[2:]))) + 10
+    if n_poles < 1 or len(freq) < n_poles + 1:
+        raise ValueError("n_poles must be positive and below the number of points")
+
+    s = 2j * np.pi * freq
+    lo, hi = 2 * np.pi * freq.min(), 2 * np.pi * freq.max()
+    beta = np.linspace(lo, hi, n_poles // 2)
+    poles = -beta / 100 + 1j * beta
+    if n_poles % 2:
+        poles = np.append(poles, -hi + 0j)
+
+    for _ in range(n_iter):
+        poles = _relocate(s, z, w, poles)
+    coef, d = _residues(s, z, w, poles)
+
+    return RationalModel(poles, coef, d, freq, z)
@@ -0,0 +1,56 @@
+"""
+Scaling of calcimp.impedance_at() with the number of threads.
+
+Writes a sliced taper of many cells, like a CT scan of a bore, and times
+the input impedance at 4 and at nfreq frequencies for 1, 2, 4, ... threads.
+The threads are started once per call, so more frequencies must not cost
+more than in proportion.
+
+usage: python bench_parallel_chain.py [cells] [repeat] [nfreq]
+"""
+import os
+import sys
+import tempfile
+import time
+
+import numpy as np
+
+import calcimp
+
+cells = int(sys.argv[1]) if len(sys.argv) > 1 else 200000
+repeat = int(sys.argv[2]) if len(sys.argv) > 2 else 3
+nfreq = int(sys.argv[3]) if len(sys.argv) > 3 else 64
+
+# 10 - 30 mm taper of 1 m, sliced into cells
+fd, path = tempfile.mkstemp(suffix='.men')
+with os.fdopen(fd, 'w') as f:
+    f.write('% 10 - 30 taper\n')
+    dx = 1000.0 / cells
+    for i in range(cells):
+        f.write('{0},{1},{2},\n'.format(10 + 20 * i / cells, 10 + 20 * (i + 1) / cells, dx))
+    f.write('30,0,0,\n')
+
+threads = [1]
+while threads[-1] * 2 <= os.cpu_count():
+    threads.append(threads[-1] * 2)
+
+try:
+    for freqs in ([110.0, 233.0, 466.0, 932.0], np.linspace(50.0, 2000.0, nfreq)):
+        print(f"{cells} cells, {len(freqs)} frequencies, best of {repeat}")
+        print(f"{'threads':>8} {'time [s]':>10} {'speedup':>8} {'max rel diff':>13}")
+        ref = None
+        for n in threads:
+            best = None
+            for _ in range(repeat):
+                t0 = time.perf_counter()
+                _, re, im, _ = calcimp.impedance_at(path, freqs, threads=n)
+                t = time.perf_counter() - t0
+                best = t if best is None else min(best, t)
+            z = re + 1j * im
+            if ref is None:
+                ref, t1 = z, best
+            diff = np.max(np.abs(z - ref) / np.abs(ref))
+            print(f"{n:>8} {best:>10.4f} {t1 / best:>8.2f} {diff:>13.2e}")
+        print()
+finally:
+    os.unlink(path)
@@ -192,8 +192,15 @@ def get_sources():
         'src/calcimp.c',
         'src/acoustic_constants.c',
         'src/kutils.c',
+        'src/arena.c',
         'src/zmensur.c',
         'src/xmensur.c',
+        'src/bore.c',
+        'src/spectrum.c',
+        'src/sensitivity.c',
+        'src/optimize.c',
+        'src/response.c',
+        'src/cxmath.c',
         'src/tinyexpr.c',  # TinyExpr math expression parser
         'src/xydata.c',
         'src/matutil.c',
@@ -5,6 +5,7 @@
 
 #include <math.h>
 #include "acoustic_constants.h"
+#include "cxmath.h"
 
 void init_acoustic_constants(acoustic_constants* ac, double temperature) {
     /* Calculate speed of sound (m/s) */
@@ -19,14 +20,10 @@ void init_acoustic_constants(acoustic_constants* ac, double temperature) {
     /* Calculate kinematic viscosity (m^2/s) */
     double mu = (18.2 + 0.0456 * (temperature - 25)) * 1.0e-6;
     ac->nu = mu / ac->rho;
-}
-
-void init_acoustic_constants_default(acoustic_constants* ac, double temperature) {
-    /* Initialize physical constants */
-    init_acoustic_constants(ac, temperature);
 
-    /* Set default configuration flags */
+    /* Set default configuration flags, callers change what they need */
     ac->rad_calc = PIPE;
     ac->dump_calc = WALL;
     ac->sec_var_calc = FALSE;
+    ac->cx_mode = CX_EXACT;
 }
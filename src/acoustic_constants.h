@@ -36,26 +36,20 @@ typedef struct {
     int rad_calc;      /* radiation impedance calculation mode: NONE, PIPE, BUFFLE */
     int dump_calc;     /* damping calculation mode: NONE, WALL */
     int sec_var_calc;  /* section variation calculation flag: TRUE, FALSE */
+    int cx_mode;       /* complex math accuracy: CX_EXACT, CX_FAST (cxmath.h) */
 } acoustic_constants;
 
 /**
  * Initialize acoustic constants from temperature
- *
- * @param ac Pointer to acoustic_constants structure to initialize
- * @param temperature Temperature in Celsius
- */
-void init_acoustic_constants(acoustic_constants* ac, double temperature);
-
-/**
- * Create acoustic constants with default configuration
- * Same as init_acoustic_constants but also sets default flags:
+ * The configuration flags get their defaults:
  * - rad_calc = PIPE
  * - dump_calc = WALL
  * - sec_var_calc = FALSE
+ * - cx_mode = CX_EXACT
  *
  * @param ac Pointer to acoustic_constants structure to initialize
  * @param temperature Temperature in Celsius
  */
-void init_acoustic_constants_default(acoustic_constants* ac, double temperature);
+void init_acoustic_constants(acoustic_constants* ac, double temperature);
 
 #endif /* ACOUSTIC_CONSTANTS_H */
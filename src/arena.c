@@ -0,0 +1,90 @@
+/*
+ * arena.c - bump allocator for the cells of a parsed instrument
+ *
+ * Blocks double in size up to ARENA_MAX_BLOCK, so an instrument of n
+ * cells takes O(log n) calls to malloc.  Nothing is freed before the
+ * whole arena.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "kutils.h"
+#include "arena.h"
+
+#define ARENA_FIRST_BLOCK 16384
+#define ARENA_MAX_BLOCK (1 << 20)
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size, used;
+    max_align_t data[];
+} arena_block;
+
+struct arena {
+    arena_block *head;      /* the block being filled, older ones behind it */
+    size_t next_size;
+    size_t total;
+};
+
+static arena_block *new_block(size_t size)
+{
+    arena_block *blk = m_malloc(sizeof(arena_block) + size);
+
+    blk->next = NULL;
+    blk->size = size;
+    blk->used = 0;
+    return blk;
+}
+
+arena *create_arena(size_t block)
+{
+    arena *a = m_malloc(sizeof(arena));
+
+    a->head = NULL;
+    a->next_size = (block > 0) ? block : ARENA_FIRST_BLOCK;
+    a->total = 0;
+    return a;
+}
+
+void *arena_alloc(arena *a, size_t size)
+{
+    arena_block *blk = a->head;
+    void *p;
+
+    size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    if (blk == NULL || blk->size - blk->used < size) {
+        while (a->next_size < size) {
+            a->next_size *= 2;
+        }
+        blk = new_block(a->next_size);
+        blk->next = a->head;
+        a->head = blk;
+        if (a->next_size < ARENA_MAX_BLOCK) {
+            a->next_size *= 2;
+        }
+    }
+
+    p = (char *)blk->data + blk->used;
+    blk->used += size;
+    a->total += size;
+    return p;
+}
+
+size_t arena_used(const arena *a)
+{
+    return a->total;
+}
+
+void dispose_arena(arena *a)
+{
+    arena_block *blk, *next;
+
+    if (a == NULL) return;
+    for (blk = a->head; blk != NULL; blk = next) {
+        next = blk->next;
+        free(blk);
+    }
+    free(a);
+}
@@ -0,0 +1,28 @@
+/*
+ * arena.h - bump allocator for the cells of a parsed instrument
+ *
+ * An arena hands out memory from a few large blocks and gives it back
+ * all at once.  The cells of a mensur, its side branches and the copies
+ * of its groups are allocated from the arena of the parse, so that they
+ * lie next to each other and go away with one dispose_arena() call.
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+typedef struct arena arena;
+
+/* empty arena; block is the size of the first block, 0 for the default */
+arena *create_arena(size_t block);
+
+/* size bytes aligned for any type, valid until the arena is disposed */
+void *arena_alloc(arena *a, size_t size);
+
+/* bytes handed out so far */
+size_t arena_used(const arena *a);
+
+void dispose_arena(arena *a);
+
+#endif /* _ARENA_H_ */
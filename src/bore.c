@@ -0,0 +1,2128 @@
+/*
+ * bore.c - compile a resolved mensur into a flat bore and evaluate it
+ *
+ * The evaluation follows the original do_calc_imp()/input_impedance()
+ * formula by formula.  All per-frequency values (impedance and transmission
+ * matrix of each cell) go to a caller owned bore_work, the bore itself is
+ * read only.  See doc/Webster_equation.nb.pdf for the transmission matrices.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex.h>
+
+#include "kutils.h"
+#include "zmensur.h"
+#include "cxmath.h"
+#include "bore.h"
+
+/* ------------------------------ compile ------------------------------*/
+
+/*
+ * Does this cell carry a side branch that takes part in the calculation?
+ * JOIN cells only mark where a SPLIT branch comes back, and the terminal
+ * cell is never evaluated by do_calc_imp.
+ */
+static int has_side_branch(mensur *p)
+{
+    return p->side != NULL && p->next != NULL &&
+        (p->s_type == TONEHOLE || p->s_type == ADDON || p->s_type == SPLIT);
+}
+
+/*
+ * Count cells, branches and SPLIT cells reachable from head
+ * (head's own branch included)
+ */
+static void count_bore(mensur *head, int *n_cell, int *n_branch, int *n_split)
+{
+    mensur *p;
+
+    (*n_branch)++;
+    for (p = head; p != NULL; p = p->next) {
+        (*n_cell)++;
+        if (has_side_branch(p)) {
+            if (p->s_type == SPLIT) (*n_split)++;
+            count_bore(p->side, n_cell, n_branch, n_split);
+        }
+    }
+}
+
+/*
+ * Lay out the branch starting at head at *pos, then its side branches
+ * behind it.  Returns the branch index, or -1 on error.
+ */
+static int fill_branch(bore *b, mensur *head, int *pos, int *n_branch)
+{
+    mensur *p, *q;
+    int br, i, j, len = 0;
+
+    for (p = head; p != NULL; p = p->next) len++;
+
+    br = (*n_branch)++;
+    b->first[br] = *pos;
+    b->last[br] = *pos + len - 1;
+    *pos += len;
+
+    for (p = head, i = b->first[br]; p != NULL; p = p->next, i++) {
+        b->df[i] = p->df;
+        b->db[i] = p->db;
+        b->r[i] = p->r;
+        b->s_type[i] = 0;
+        b->s_ratio[i] = p->s_ratio;
+        b->side[i] = -1;
+        b->join[i] = -1;
+        b->slot[i] = -1;
+
+        if (p->next == NULL) {
+            b->kind[i] = (p->df <= 0) ? BORE_CLOSED_END : BORE_OPEN_END;
+        } else if (p->r == 0.0) {
+            b->kind[i] = BORE_NULL;
+        } else if (p->df == p->db) {
+            b->kind[i] = BORE_STRAIGHT;
+        } else {
+            b->kind[i] = BORE_TAPER;
+        }
+
+        if (has_side_branch(p)) {
+            b->s_type[i] = p->s_type;
+            b->side[i] = fill_branch(b, p->side, pos, n_branch);
+            if (b->side[i] < 0) return -1;
+        }
+    }
+
+    /*
+     * resolve joining points of SPLIT cells, same search as get_join_men.
+     * The slots of this branch are numbered after those of its side
+     * branches, so they form one range.
+     */
+    b->split_lo[br] = b->n_split;
+    for (p = head, i = b->first[br]; p != NULL; p = p->next, i++) {
+        if (b->s_type[i] != SPLIT) continue;
+
+        for (q = p, j = i; q != NULL; q = q->next, j++) {
+            if (q->side != NULL && q->s_type == JOIN &&
+                get_first_men(q->side) == p->side) {
+                break;
+            }
+        }
+        if (q == NULL) {
+            fprintf(stderr, "Cannot find joining point of \"%s\"\n", p->sidename);
+            return -1;
+        }
+        if (j == b->last[br]) {
+            fprintf(stderr, "\"%s\" joins at the end of the bore\n", p->sidename);
+            return -1;
+        }
+        b->join[i] = j;
+        if (b->s_ratio[i] > 0) {
+            /* only a SPLIT that actually divides the flow reads its span */
+            b->slot[i] = b->n_split;
+            b->split_cell[b->n_split++] = i;
+        }
+    }
+    b->split_hi[br] = b->n_split;
+
+    return br;
+}
+
+/*
+ * Compile a resolved (and rejointed) mensur into a bore.
+ * Returns NULL on error.
+ */
+bore *compile_bore(mensur *men)
+{
+    bore *b;
+    mensur *head = get_first_men(men);
+    int n_cell = 0, n_branch = 0, n_split = 0, pos = 0;
+
+    if (head == NULL) return NULL;
+
+    count_bore(head, &n_cell, &n_branch, &n_split);
+
+    b = m_calloc(1, sizeof(bore));
+    b->n_cell = n_cell;
+    b->df = m_malloc(n_cell * sizeof(double));
+    b->db = m_malloc(n_cell * sizeof(double));
+    b->r = m_malloc(n_cell * sizeof(double));
+    b->kind = m_malloc(n_cell);
+    b->s_type = m_malloc(n_cell);
+    b->s_ratio = m_malloc(n_cell * sizeof(double));
+    b->side = m_malloc(n_cell * sizeof(int));
+    b->join = m_malloc(n_cell * sizeof(int));
+    b->slot = m_malloc(n_cell * sizeof(int));
+    b->first = m_malloc(n_branch * sizeof(int));
+    b->last = m_malloc(n_branch * sizeof(int));
+    b->split_cell = m_malloc((n_split + 1) * sizeof(int));
+    b->split_lo = m_malloc(n_branch * sizeof(int));
+    b->split_hi = m_malloc(n_branch * sizeof(int));
+
+    b->n_branch = 0;
+    b->n_split = 0;
+    if (fill_branch(b, head, &pos, &b->n_branch) < 0) {
+        dispose_bore(b);
+        return NULL;
+    }
+
+    return b;
+}
+
+static void *dup_array(const void *src, size_t size)
+{
+    void *dst = m_malloc(size);
+
+    memcpy(dst, src, size);
+    return dst;
+}
+
+/* Deep copy of b, for callers that keep it beyond the original */
+bore *copy_bore(const bore *b)
+{
+    bore *c = m_calloc(1, sizeof(bore));
+    int n = b->n_cell, nb = b->n_branch;
+
+    *c = *b;
+    c->df = dup_array(b->df, n * sizeof(double));
+    c->db = dup_array(b->db, n * sizeof(double));
+    c->r = dup_array(b->r, n * sizeof(double));
+    c->kind = dup_array(b->kind, n);
+    c->s_type = dup_array(b->s_type, n);
+    c->s_ratio = dup_array(b->s_ratio, n * sizeof(double));
+    c->side = dup_array(b->side, n * sizeof(int));
+    c->join = dup_array(b->join, n * sizeof(int));
+    c->slot = dup_array(b->slot, n * sizeof(int));
+    c->first = dup_array(b->first, nb * sizeof(int));
+    c->last = dup_array(b->last, nb * sizeof(int));
+    c->split_cell = dup_array(b->split_cell, (b->n_split + 1) * sizeof(int));
+    c->split_lo = dup_array(b->split_lo, nb * sizeof(int));
+    c->split_hi = dup_array(b->split_hi, nb * sizeof(int));
+    return c;
+}
+
+void dispose_bore(bore *b)
+{
+    if (b == NULL) return;
+
+    free(b->df);
+    free(b->db);
+    free(b->r);
+    free(b->kind);
+    free(b->s_type);
+    free(b->s_ratio);
+    free(b->side);
+    free(b->join);
+    free(b->slot);
+    free(b->first);
+    free(b->last);
+    free(b->split_cell);
+    free(b->split_lo);
+    free(b->split_hi);
+    free(b);
+}
+
+/*
+ * Do a and b have the same cells and branches?  s_ratio may differ, so
+ * that one can be evaluated with the ratios of the other.
+ */
+int bore_same_layout(const bore *a, const bore *b)
+{
+    int n = a->n_cell;
+
+    return a->n_cell == b->n_cell && a->n_branch == b->n_branch && a->n_split == b->n_split &&
+        memcmp(a->df, b->df, n * sizeof(double)) == 0 &&
+        memcmp(a->db, b->db, n * sizeof(double)) == 0 &&
+        memcmp(a->r, b->r, n * sizeof(double)) == 0 &&
+        memcmp(a->kind, b->kind, n) == 0 &&
+        memcmp(a->s_type, b->s_type, n) == 0 &&
+        memcmp(a->side, b->side, n * sizeof(int)) == 0 &&
+        memcmp(a->join, b->join, n * sizeof(int)) == 0 &&
+        memcmp(a->slot, b->slot, n * sizeof(int)) == 0 &&
+        memcmp(a->first, b->first, a->n_branch * sizeof(int)) == 0 &&
+        memcmp(a->last, b->last, a->n_branch * sizeof(int)) == 0 &&
+        memcmp(a->split_cell, b->split_cell, a->n_split * sizeof(int)) == 0 &&
+        memcmp(a->split_lo, b->split_lo, a->n_branch * sizeof(int)) == 0 &&
+        memcmp(a->split_hi, b->split_hi, a->n_branch * sizeof(int)) == 0;
+}
+
+/*
+ * Allocate per-frequency scratch for evaluating b.
+ * A bore is never written during evaluation, so any number of threads
+ * can share it as long as each one owns its workspace.
+ */
+bore_work *create_bore_work(const bore *b)
+{
+    bore_work *wk = m_malloc(sizeof(bore_work));
+
+    wk->n_cell = b->n_cell;
+    wk->zi = m_calloc(b->n_cell, sizeof(double complex));
+    wk->zinf = m_calloc(b->n_cell, 1);
+    wk->m11 = m_calloc(b->n_cell, sizeof(double complex));
+    wk->m12 = m_calloc(b->n_cell, sizeof(double complex));
+    wk->m21 = m_calloc(b->n_cell, sizeof(double complex));
+    wk->m22 = m_calloc(b->n_cell, sizeof(double complex));
+    wk->n_split = b->n_split;
+    wk->s11 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->s12 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->s21 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->s22 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->j11 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->j12 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->j21 = m_calloc(b->n_split + 1, sizeof(double complex));
+    wk->j22 = m_calloc(b->n_split + 1, sizeof(double complex));
+
+    return wk;
+}
+
+void dispose_bore_work(bore_work *wk)
+{
+    if (wk == NULL) return;
+
+    free(wk->zi);
+    free(wk->zinf);
+    free(wk->m11);
+    free(wk->m12);
+    free(wk->m21);
+    free(wk->m22);
+    free(wk->s11);
+    free(wk->s12);
+    free(wk->s21);
+    free(wk->s22);
+    free(wk->j11);
+    free(wk->j12);
+    free(wk->j21);
+    free(wk->j22);
+    free(wk);
+}
+
+/* ------------------------------ evaluate ------------------------------*/
+
+static void calc_branch(const bore *b, bore_work *wk, int br, double frq, double e_ratio,
+                        const acoustic_constants *ac);
+
+/*
+ * Section variation ratio of a single cell, see sec_var_ratio1()
+ */
+static void bore_sec_var_ratio1(const bore *b, int i, double *out_t1, double *out_t2)
+{
+    double st;
+
+    *out_t1 = *out_t2 = 0;
+    if (b->r[i] > 0) {
+        st = (b->db[i] - b->df[i]) / 2 / b->r[i];
+        *out_t1 = PI * st * b->df[i];
+        *out_t2 = PI * st * b->db[i];
+    }
+}
+
+/*
+ * Section variation ratio averaged with neighbours, see sec_var_ratio()
+ */
+static void bore_sec_var_ratio(const bore *b, int i, int first, double *out_t1, double *out_t2)
+{
+    double t11, t12, t21, t22, t01, t02;
+
+    bore_sec_var_ratio1(b, i, &t01, &t02);
+
+    bore_sec_var_ratio1(b, i + 1, &t21, &t22);
+    *out_t2 = (t02 + t21) / 2;
+
+    if (i > first) {
+        bore_sec_var_ratio1(b, i - 1, &t11, &t12);
+        *out_t1 = (t01 + t12) / 2;
+    } else {
+        *out_t1 = t01;
+    }
+}
+
+/*
+ * Transmission matrix of a single cell with r > 0
+ */
+static void cell_matrix(const bore *b, bore_work *wk, int i, int first, double frq,
+                        const acoustic_constants *ac)
+{
+    double complex k, x, sinx, cosx;
+    double d, d1, d2, w, L, aa, r1, r2, s1, s2, ss, t1, t2;
+
+    w = PI2 * frq;
+    d1 = b->df[i];
+    d2 = b->db[i];
+    d = (d1 + d2) * 0.5;
+    L = b->r[i];
+
+    aa = (1 + (GMM - 1) / sqrt(Pr)) * sqrt(2 * w * ac->nu) / ac->c0 / d;
+
+    if (ac->dump_calc == WALL) {
+        k = cx_sqrt((w / ac->c0) * (w / ac->c0 - 2 * (I - 1) * aa));
+    } else {
+        k = w / ac->c0;
+    }
+    x = k * L;
+    cx_sincos(x, &sinx, &cosx, ac->cx_mode);
+
+    if (ac->sec_var_calc) {
+        s1 = PI / 4 * d1 * d1;
+        s2 = PI / 4 * d2 * d2;
+        ss = sqrt(s1 * s2);
+        bore_sec_var_ratio(b, i, first, &t1, &t2);
+
+        wk->m11[i] = (2 * k * s2 * cosx - t2 * sinx) / (2 * k * ss);
+        wk->m12[i] = (I * ac->rhoc0 * sinx) / ss;
+        wk->m21[i] = (-2 * I * k * (s2 * t1 - s1 * t2) * cosx +
+                     I * (4 * k * k * s1 * s2 + t1 * t2) * sinx) /
+            (4 * ac->rhoc0 * k * k * ss);
+        wk->m22[i] = (2 * k * s1 * cosx + t1 * sinx) / (2 * k * ss);
+    } else if (b->kind[i] == BORE_STRAIGHT) {
+        s1 = PI / 4 * d * d;
+        wk->m11[i] = wk->m22[i] = cosx;
+        wk->m12[i] = I * ac->rhoc0 * sinx / s1;
+        wk->m21[i] = I * s1 * sinx / ac->rhoc0;
+    } else {
+        r1 = d1 / 2;
+        r2 = d2 / 2;
+
+        wk->m11[i] = (r2 * x * cosx - (r2 - r1) * sinx) / (r1 * x);
+        wk->m12[i] = I * ac->rhoc0 * sinx / (PI * r1 * r2);
+        wk->m21[i] = -I * PI * ((r2 - r1) * (r2 - r1) * x * cosx -
+                               ((r2 - r1) * (r2 - r1) + x * x * r1 * r2) * sinx) /
+            (k * k * L * L * ac->rhoc0);
+        wk->m22[i] = (r1 * x * cosx + (r2 - r1) * sinx) / (r2 * x);
+    }
+}
+
+/*
+ * Transmission matrix of cell i, unity for cells of zero length
+ */
+static void cell_transfer(const bore *b, bore_work *wk, int i, int first, double frq,
+                          const acoustic_constants *ac)
+{
+    if (b->kind[i] == BORE_NULL) {
+        wk->m11[i] = wk->m22[i] = 1.0;
+        wk->m12[i] = wk->m21[i] = 0.0;
+    } else {
+        cell_matrix(b, wk, i, first, frq, ac);
+    }
+}
+
+/*
+ * z = M(i) z, one step of a product taken from the far end
+ */
+static inline void chain_push(const bore_work *wk, int i,
+                              double complex *z11, double complex *z12,
+                              double complex *z21, double complex *z22)
+{
+    double complex x11, x12, x21, x22;
+
+    x11 = wk->m11[i] * *z11 + wk->m12[i] * *z21;
+    x12 = wk->m11[i] * *z12 + wk->m12[i] * *z22;
+    x21 = wk->m21[i] * *z11 + wk->m22[i] * *z21;
+    x22 = wk->m21[i] * *z12 + wk->m22[i] * *z22;
+
+    *z11 = x11; *z12 = x12;
+    *z21 = x21; *z22 = x22;
+}
+
+/*
+ * Product of the transmission matrices of branch br without its terminal
+ * cell, multiplied from the far end like transmission_matrix().  ADDON and
+ * SPLIT need nothing else from the side, so each cell is visited once and
+ * no impedance or nested branch of the side is evaluated.
+ */
+static void branch_chain(const bore *b, bore_work *wk, int br, double frq,
+                         const acoustic_constants *ac,
+                         double complex *m11, double complex *m12,
+                         double complex *m21, double complex *m22)
+{
+    double complex z11, z12, z21, z22;
+    int i = b->last[br] - 1, first = b->first[br];
+
+    if (i < first) {
+        *m11 = *m22 = 1.0;
+        *m12 = *m21 = 0.0;
+        return;
+    }
+
+    cell_transfer(b, wk, i, first, frq, ac);
+    z11 = wk->m11[i]; z12 = wk->m12[i];
+    z21 = wk->m21[i]; z22 = wk->m22[i];
+
+    for (i--; i >= first; i--) {
+        cell_transfer(b, wk, i, first, frq, ac);
+        chain_push(wk, i, &z11, &z12, &z21, &z22);
+    }
+
+    *m11 = z11; *m12 = z12;
+    *m21 = z21; *m22 = z22;
+}
+
+/*
+ * Z -> Z z1 / (Z + z1) for a tonehole of input impedance z1 at the outlet
+ */
+static inline void tonehole_load(double complex z1, int z1inf, double complex *zo, int *oinf)
+{
+    double complex z2;
+
+    if (z1inf) {
+        /* closed hole seen through, nothing changes */
+    } else if (*oinf) {
+        *zo = z1;
+        *oinf = 0;
+    } else {
+        z2 = *zo;
+        *zo = z1 * z2 / (z1 + z2);
+    }
+}
+
+/*
+ * ADDON loop of chain matrix m taking the ratio s of the flow at the outlet
+ */
+static inline void addon_load(double complex m11, double complex m12,
+                              double complex m21, double complex m22, double s,
+                              double complex *zo, int *oinf)
+{
+    double complex z1, z2;
+
+    z1 = m12 / (m12 * m21 - (1 - m11) * (1 - m22));
+    z1 /= s;
+    if (*oinf) {
+        *zo = z1;
+        *oinf = 0;
+    } else {
+        z2 = *zo;
+        z2 /= (1 - s);
+        *zo = z1 * z2 / (z1 + z2);
+    }
+}
+
+/*
+ * Impedance at a SPLIT with side chain m and main path n, both ending at
+ * the joining point of impedance z2
+ */
+static inline double complex split_load(double complex m11, double complex m12,
+                                        double complex m21, double complex m22,
+                                        double complex n11, double complex n12,
+                                        double complex n21, double complex n22,
+                                        double s, double complex z2, int z2inf)
+{
+    m12 /= (1 - s);
+    m21 *= (1 - s);
+    n12 /= s;
+    n21 *= s;
+
+    if (z2inf) {
+        return (m12 * n11 + m11 * n12) /
+            ((m12 + n12) * (m21 + n21) - (m11 - n11) * (m22 - n22));
+    }
+    return (m12 * n12 + (m12 * n11 + m11 * n12) * z2) /
+        (m22 * n12 + m12 * n22 + ((m12 + n12) * (m21 + n21) -
+                                  (m11 - n11) * (m22 - n22)) * z2);
+}
+
+/*
+ * Impedance at the inlet of cell i from zo at its outlet, using the
+ * transmission matrix in wk
+ */
+static inline void cell_load(const bore *b, const bore_work *wk, int i,
+                             double complex zo, int oinf,
+                             double complex *zi, unsigned char *zinf)
+{
+    if (b->kind[i] == BORE_NULL) {
+        *zi = zo;
+        *zinf = oinf;
+    } else if (!oinf) {
+        *zi = (wk->m11[i] * zo + wk->m12[i]) / (wk->m21[i] * zo + wk->m22[i]);
+        *zinf = 0;
+    } else {
+        /* impedance of next cell is infinity! */
+        *zi = wk->m11[i] / wk->m21[i];
+        *zinf = 0;
+    }
+}
+
+/*
+ * Impedance of the terminal cell i, e_ratio scales its diameter, 0 closes it
+ */
+static void end_load(const bore *b, int i, double frq, double e_ratio,
+                     const acoustic_constants *ac, double complex *zi, unsigned char *zinf)
+{
+    double complex z;
+
+    if (b->kind[i] == BORE_CLOSED_END || e_ratio == 0) {
+        *zi = 0.0;
+        *zinf = 1;
+    } else {
+        rad_imp(frq, b->df[i] * e_ratio, &z, ac);
+        if (ac->rad_calc == NONE) z = 0.0;
+        *zi = z;
+        *zinf = 0;
+    }
+}
+
+/*
+ * Impedance of cell i, the counterpart of do_calc_imp()
+ */
+static void calc_cell(const bore *b, bore_work *wk, int i, int first, double frq,
+                      const acoustic_constants *ac)
+{
+    double complex zo, m11, m12, m21, m22;
+    double s = b->s_ratio[i];
+    int oinf, sb, nm, k;
+
+    /* continuity with the inlet of the next cell */
+    zo = wk->zi[i + 1];
+    oinf = wk->zinf[i + 1];
+
+    sb = b->side[i];
+    if (sb >= 0) {
+        if (b->s_type[i] == TONEHOLE) {
+            calc_branch(b, wk, sb, frq, s, ac);
+            tonehole_load(wk->zi[b->first[sb]], wk->zinf[b->first[sb]], &zo, &oinf);
+        } else if (b->s_type[i] == ADDON && s > 0) {
+            branch_chain(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+            addon_load(m11, m12, m21, m22, s, &zo, &oinf);
+        } else if (b->s_type[i] == SPLIT && s > 0) {
+            branch_chain(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+
+            /* main path i+1..nm, accumulated by calc_branch on the way here */
+            nm = b->join[i];
+            k = b->slot[i];
+            zo = split_load(m11, m12, m21, m22, wk->s11[k], wk->s12[k], wk->s21[k], wk->s22[k],
+                            s, wk->zi[nm + 1], wk->zinf[nm + 1]);
+            oinf = 0;
+        }
+    }
+
+    cell_transfer(b, wk, i, first, frq, ac);
+    cell_load(b, wk, i, zo, oinf, &wk->zi[i], &wk->zinf[i]);
+}
+
+/*
+ * Impedance of every cell of branch br, the counterpart of input_impedance()
+ * e_ratio scales the diameter of the open end, 0 closes it.
+ * On the way the product over each SPLIT span of the branch is gathered,
+ * so that the SPLIT cell finds it ready instead of walking the span again.
+ */
+static void calc_branch(const bore *b, bore_work *wk, int br, double frq, double e_ratio,
+                        const acoustic_constants *ac)
+{
+    int i, k, c, first = b->first[br];
+
+    i = b->last[br];
+    end_load(b, i, frq, e_ratio, ac, &wk->zi[i], &wk->zinf[i]);
+
+    for (i--; i >= first; i--) {
+        calc_cell(b, wk, i, first, frq, ac);
+
+        for (k = b->split_lo[br]; k < b->split_hi[br]; k++) {
+            c = b->split_cell[k];
+            if (i == b->join[c]) {
+                wk->s11[k] = wk->m11[i]; wk->s12[k] = wk->m12[i];
+                wk->s21[k] = wk->m21[i]; wk->s22[k] = wk->m22[i];
+            } else if (i > c && i < b->join[c]) {
+                chain_push(wk, i, &wk->s11[k], &wk->s12[k], &wk->s21[k], &wk->s22[k]);
+            }
+        }
+    }
+}
+
+/*
+ * Input impedance of the main bore at frequency frq, using wk as scratch.
+ * e_ratio scales the diameter of the open end like input_impedance().
+ */
+void bore_input_impedance(double frq, const bore *b, bore_work *wk, double e_ratio,
+                          double complex *out_z, const acoustic_constants *ac)
+{
+    calc_branch(b, wk, 0, frq, e_ratio, ac);
+    *out_z = wk->zi[b->first[0]];
+}
+
+/*
+ * Pressure p and volume velocity u at the inlet of every main bore cell,
+ * driven with pressure p0 at the input, the counterpart of the propagation
+ * in get_pressure_dist().  p and u hold last[0]-first[0]+1 entries; u may
+ * be NULL.
+ */
+void bore_pressure(double frq, const bore *b, bore_work *wk, double complex p0,
+                   double complex *p, double complex *u, const acoustic_constants *ac)
+{
+    double complex pi, ui, det;
+    int i, first = b->first[0], last = b->last[0];
+
+    calc_branch(b, wk, 0, frq, 1, ac);
+
+    pi = p0;
+    for (i = first; i <= last; i++) {
+        ui = wk->zinf[i] ? 0.0 : pi / wk->zi[i];
+        p[i - first] = pi;
+        if (u) u[i - first] = ui;
+        if (i == last) break;
+
+        /* calc for next segment */
+        det = wk->m11[i] * wk->m22[i] - wk->m12[i] * wk->m21[i];
+        pi = (wk->m22[i] * pi - wk->m12[i] * ui) / det;
+    }
+}
+
+/*
+ * Chain matrix of the main bore cells hi down to lo, see bore_chain().
+ * Every SPLIT span must lie inside lo .. hi or outside of it.
+ */
+static void chain_range(const bore *b, bore_work *wk, int lo, int hi, double frq,
+                        const acoustic_constants *ac, double complex *t)
+{
+    double complex t11 = 1.0, t12 = 0.0, t21 = 0.0, t22 = 1.0;
+    double complex x11, x12, x21, x22, z1, m11, m12, m21, m22, n11, n12, n21, n22;
+    double s;
+    int i, k, c, sb, first = b->first[0];
+
+    for (i = hi; i >= lo; i--) {
+        /* keep the chain behind each SPLIT span, the junction replaces the span */
+        for (k = b->split_lo[0]; k < b->split_hi[0]; k++) {
+            if (b->join[b->split_cell[k]] == i) {
+                wk->j11[k] = t11; wk->j12[k] = t12;
+                wk->j21[k] = t21; wk->j22[k] = t22;
+            }
+        }
+
+        sb = b->side[i];
+        s = b->s_ratio[i];
+        if (sb >= 0 && b->s_type[i] == TONEHOLE) {
+            calc_branch(b, wk, sb, frq, s, ac);
+            if (!wk->zinf[b->first[sb]]) {
+                /* Z -> Z z1 / (Z + z1) */
+                z1 = wk->zi[b->first[sb]];
+                t21 += t11 / z1;
+                t22 += t12 / z1;
+            }
+        } else if (sb >= 0 && b->s_type[i] == ADDON && s > 0) {
+            /* Z -> (Z/(1-s)) (z1/s) / (Z/(1-s) + z1/s) */
+            branch_chain(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+            z1 = m12 / (m12 * m21 - (1 - m11) * (1 - m22));
+            z1 /= s;
+            t21 = t11 / z1 + (1 - s) * t21;
+            t22 = t12 / z1 + (1 - s) * t22;
+        } else if (sb >= 0 && b->s_type[i] == SPLIT && s > 0) {
+            /* the formula of calc_cell() written as a bilinear map of z2 */
+            branch_chain(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+            k = b->slot[i];
+            n11 = wk->s11[k]; n12 = wk->s12[k];
+            n21 = wk->s21[k]; n22 = wk->s22[k];
+
+            m12 /= (1 - s);
+            m21 *= (1 - s);
+            n12 /= s;
+            n21 *= s;
+
+            x11 = m12 * n11 + m11 * n12;
+            x12 = m12 * n12;
+            x21 = (m12 + n12) * (m21 + n21) - (m11 - n11) * (m22 - n22);
+            x22 = m22 * n12 + m12 * n22;
+
+            t11 = x11 * wk->j11[k] + x12 * wk->j21[k];
+            t12 = x11 * wk->j12[k] + x12 * wk->j22[k];
+            t21 = x21 * wk->j11[k] + x22 * wk->j21[k];
+            t22 = x21 * wk->j12[k] + x22 * wk->j22[k];
+        }
+
+        cell_transfer(b, wk, i, first, frq, ac);
+        chain_push(wk, i, &t11, &t12, &t21, &t22);
+
+        /* running products over the SPLIT spans, as in calc_branch() */
+        for (k = b->split_lo[0]; k < b->split_hi[0]; k++) {
+            c = b->split_cell[k];
+            if (i == b->join[c]) {
+                wk->s11[k] = wk->m11[i]; wk->s12[k] = wk->m12[i];
+                wk->s21[k] = wk->m21[i]; wk->s22[k] = wk->m22[i];
+            } else if (i > c && i < b->join[c]) {
+                chain_push(wk, i, &wk->s11[k], &wk->s12[k], &wk->s21[k], &wk->s22[k]);
+            }
+        }
+    }
+
+    t[0] = t11; t[1] = t12;
+    t[2] = t21; t[3] = t22;
+}
+
+/*
+ * Chain matrix t[4] = {t11, t12, t21, t22} of the main bore at frq,
+ * everything but the terminal cell, so that
+ *   Z_in = (t11 Z_L + t12) / (t21 Z_L + t22)
+ * for any impedance Z_L at the open end (see bore_terminate()).
+ * Side branches enter as two-ports: a tonehole or ADDON as a shunt
+ * admittance at the outlet of its cell, a SPLIT as the parallel connection
+ * of both paths up to the joining point.  Their own open ends radiate
+ * according to ac->rad_calc, only the main end is left open.
+ * The result equals bore_input_impedance() within rounding.
+ */
+void bore_chain(double frq, const bore *b, bore_work *wk, double complex *t,
+                const acoustic_constants *ac)
+{
+    chain_range(b, wk, b->first[0], b->last[0] - 1, frq, ac, t);
+}
+
+/*
+ * Input impedance from a chain matrix of bore_chain() and the impedance
+ * z_l at the open end; closed ignores z_l and closes the end.
+ */
+double complex bore_terminate(const double complex *t, double complex z_l, int closed)
+{
+    if (closed) {
+        return t[0] / t[2];
+    }
+    return (t[0] * z_l + t[1]) / (t[2] * z_l + t[3]);
+}
+
+/* ------------------------------ states ------------------------------*/
+/*
+ * Input impedance of one bore for many sets of branch ratios, e.g. every
+ * fingering of a woodwind.  Nothing but the impedances depends on the
+ * ratios: the transmission matrices of all cells, the products over the
+ * SPLIT spans and the chain matrices of ADDON and SPLIT sides are taken
+ * once per frequency.  A state then walks the main bore from the first
+ * cell where it differs from an earlier state (its owner) and copies the
+ * impedances behind that cell, so a fingering chart costs about one sweep
+ * plus a few complex divisions per state and cell.
+ */
+
+/* mark the cells of branch br and its side branches with main bore cell i */
+static void mark_side(const bore *b, int br, int i, int *pos)
+{
+    int j;
+
+    for (j = b->first[br]; j <= b->last[br]; j++) {
+        pos[j] = i;
+        if (b->side[j] >= 0) mark_side(b, b->side[j], i, pos);
+    }
+}
+
+/*
+ * Allocate scratch for evaluating b with the ratios states[k * b->n_cell + j]
+ * of state k = 0 .. n_state-1 in place of b->s_ratio.  Every state must
+ * open the same SPLIT cells as b, so compile each state and group those
+ * with bore_same_layout().  Returns NULL on error.
+ */
+bore_states_work *create_bore_states_work(const bore *b, int n_state, const double *states)
+{
+    bore_states_work *sw;
+    const double *sk, *so;
+    int *pos, i, j, k, o, d;
+
+    for (k = 0; k < n_state; k++) {
+        for (i = 0; i < b->n_cell; i++) {
+            if (b->s_type[i] == SPLIT && b->slot[i] < 0 && states[k * b->n_cell + i] > 0) {
+                fprintf(stderr, "State %d opens a SPLIT that is closed in the bore\n", k);
+                return NULL;
+            }
+        }
+    }
+
+    sw = m_malloc(sizeof(bore_states_work));
+    sw->wk = create_bore_work(b);
+    sw->n_state = n_state;
+    sw->states = m_malloc(n_state * b->n_cell * sizeof(double));
+    memcpy(sw->states, states, n_state * b->n_cell * sizeof(double));
+    sw->zi = m_calloc(n_state * b->n_cell, sizeof(double complex));
+    sw->zinf = m_calloc(n_state * b->n_cell, 1);
+    sw->c11 = m_calloc(b->n_branch, sizeof(double complex));
+    sw->c12 = m_calloc(b->n_branch, sizeof(double complex));
+    sw->c21 = m_calloc(b->n_branch, sizeof(double complex));
+    sw->c22 = m_calloc(b->n_branch, sizeof(double complex));
+    sw->owner = m_malloc(n_state * sizeof(int));
+    sw->from = m_malloc(n_state * sizeof(int));
+
+    /* main bore cell at whose outlet each cell takes effect */
+    pos = m_malloc(b->n_cell * sizeof(int));
+    for (i = b->first[0]; i <= b->last[0]; i++) {
+        pos[i] = i;
+        if (b->side[i] >= 0) mark_side(b, b->side[i], i, pos);
+    }
+
+    /* share the longest part behind the first differing cell */
+    for (k = 0; k < n_state; k++) {
+        sw->owner[k] = -1;
+        sw->from[k] = b->last[0] - 1;
+        sk = &sw->states[k * b->n_cell];
+        for (o = 0; o < k && sw->from[k] >= b->first[0]; o++) {
+            so = &sw->states[o * b->n_cell];
+            d = b->first[0] - 1;
+            for (j = 0; j < b->n_cell; j++) {
+                if (sk[j] != so[j] && pos[j] > d) d = pos[j];
+            }
+            if (d < sw->from[k]) {
+                sw->owner[k] = o;
+                sw->from[k] = d;
+            }
+        }
+    }
+    free(pos);
+
+    return sw;
+}
+
+void dispose_bore_states_work(bore_states_work *sw)
+{
+    if (sw == NULL) return;
+
+    dispose_bore_work(sw->wk);
+    free(sw->states);
+    free(sw->zi);
+    free(sw->zinf);
+    free(sw->c11);
+    free(sw->c12);
+    free(sw->c21);
+    free(sw->c22);
+    free(sw->owner);
+    free(sw->from);
+    free(sw);
+}
+
+/*
+ * Everything of b at frq that does not depend on the ratios: transmission
+ * matrices of all cells, span products and chain matrices of the sides.
+ */
+static void states_matrices(const bore *b, bore_states_work *sw, double frq,
+                            const acoustic_constants *ac)
+{
+    bore_work *wk = sw->wk;
+    int br, i, k, c, sb, first;
+
+    for (br = 0; br < b->n_branch; br++) {
+        first = b->first[br];
+        for (i = b->last[br] - 1; i >= first; i--) {
+            cell_transfer(b, wk, i, first, frq, ac);
+
+            for (k = b->split_lo[br]; k < b->split_hi[br]; k++) {
+                c = b->split_cell[k];
+                if (i == b->join[c]) {
+                    wk->s11[k] = wk->m11[i]; wk->s12[k] = wk->m12[i];
+                    wk->s21[k] = wk->m21[i]; wk->s22[k] = wk->m22[i];
+                } else if (i > c && i < b->join[c]) {
+                    chain_push(wk, i, &wk->s11[k], &wk->s12[k], &wk->s21[k], &wk->s22[k]);
+                }
+            }
+        }
+    }
+
+    /* the product of branch_chain() */
+    for (i = 0; i < b->n_cell; i++) {
+        sb = b->side[i];
+        if (sb < 0 || b->s_type[i] == TONEHOLE) continue;
+
+        first = b->first[sb];
+        c = b->last[sb] - 1;
+        if (c < first) {
+            sw->c11[sb] = sw->c22[sb] = 1.0;
+            sw->c12[sb] = sw->c21[sb] = 0.0;
+            continue;
+        }
+        sw->c11[sb] = wk->m11[c]; sw->c12[sb] = wk->m12[c];
+        sw->c21[sb] = wk->m21[c]; sw->c22[sb] = wk->m22[c];
+        for (c--; c >= first; c--) {
+            chain_push(wk, c, &sw->c11[sb], &sw->c12[sb], &sw->c21[sb], &sw->c22[sb]);
+        }
+    }
+}
+
+/*
+ * Impedance of cells from .. first[br] of branch br for the ratios s,
+ * cells behind from must be set already; calc_branch() on precomputed
+ * matrices
+ */
+static void states_branch(const bore *b, bore_states_work *sw, const double *s,
+                          double complex *zi, unsigned char *zinf, int br, int from,
+                          double frq, double e_ratio, const acoustic_constants *ac)
+{
+    const bore_work *wk = sw->wk;
+    double complex zo;
+    int i, k, sb, oinf, first = b->first[br];
+
+    if (from == b->last[br] - 1) {
+        end_load(b, b->last[br], frq, e_ratio, ac, &zi[b->last[br]], &zinf[b->last[br]]);
+    }
+
+    for (i = from; i >= first; i--) {
+        zo = zi[i + 1];
+        oinf = zinf[i + 1];
+
+        sb = b->side[i];
+        if (sb >= 0) {
+            if (b->s_type[i] == TONEHOLE) {
+                states_branch(b, sw, s, zi, zinf, sb, b->last[sb] - 1, frq, s[i], ac);
+                tonehole_load(zi[b->first[sb]], zinf[b->first[sb]], &zo, &oinf);
+            } else if (b->s_type[i] == ADDON && s[i] > 0) {
+                addon_load(sw->c11[sb], sw->c12[sb], sw->c21[sb], sw->c22[sb], s[i], &zo, &oinf);
+            } else if (b->s_type[i] == SPLIT && s[i] > 0) {
+                k = b->slot[i];
+                zo = split_load(sw->c11[sb], sw->c12[sb], sw->c21[sb], sw->c22[sb],
+                                wk->s11[k], wk->s12[k], wk->s21[k], wk->s22[k],
+                                s[i], zi[b->join[i] + 1], zinf[b->join[i] + 1]);
+                oinf = 0;
+            }
+        }
+
+        cell_load(b, wk, i, zo, oinf, &zi[i], &zinf[i]);
+    }
+}
+
+/*
+ * Input impedance of the main bore at frq for every state of sw into
+ * out_z[0 .. n_state-1].  The result of each state equals
+ * bore_input_impedance() of b with its ratios.
+ */
+void bore_states_impedance(double frq, const bore *b, bore_states_work *sw, double e_ratio,
+                           double complex *out_z, const acoustic_constants *ac)
+{
+    double complex *zi;
+    unsigned char *zinf;
+    int k, o, from, n = b->n_cell, first = b->first[0], last = b->last[0];
+
+    states_matrices(b, sw, frq, ac);
+
+    for (k = 0; k < sw->n_state; k++) {
+        zi = &sw->zi[k * n];
+        zinf = &sw->zinf[k * n];
+        o = sw->owner[k];
+        from = sw->from[k];
+        if (o >= 0) {
+            memcpy(&zi[from + 1], &sw->zi[o * n + from + 1],
+                   (last - from) * sizeof(double complex));
+            memcpy(&zinf[from + 1], &sw->zinf[o * n + from + 1], last - from);
+        }
+        states_branch(b, sw, &sw->states[k * n], zi, zinf, 0, from, frq, e_ratio, ac);
+        out_z[k] = zi[first];
+    }
+}
+
+/* ------------------------------ tree ------------------------------*/
+/*
+ * A bore whose cells are edited between sweeps at fixed frequencies.  The
+ * main bore is cut into blocks of about BORE_TREE_BLOCK cells, a SPLIT
+ * span never crossing a block boundary, and per frequency the chain
+ * matrices of the blocks (see chain_range()) sit at the leaves of a binary
+ * tree whose inner nodes hold the products of their children.  An edit
+ * recomputes the blocks it touches and their path to the root, so a sweep
+ * after editing a few cells costs O(block + log(n / block)) per frequency
+ * instead of O(n).  Keeping block products only, not those of every cell,
+ * bounds the memory to 128 bytes per block and frequency.
+ */
+
+/*
+ * Cut the main bore cells first .. last-1 into blocks of at least block
+ * cells, extended so that no SPLIT span crosses a boundary.  Block k is
+ * lo[k] .. lo[k+1]-1; lo needs last-first+1 entries.  Returns the number
+ * of blocks.
+ */
+static int cut_blocks(const bore *b, int block, int *lo)
+{
+    int i, k, end, last = b->last[0];
+
+    for (i = b->first[0], k = 0; i < last; k++) {
+        lo[k] = end = i;
+        while (i < last && (i <= end || i - lo[k] < block)) {
+            if (b->s_type[i] == SPLIT && b->slot[i] >= 0) end = MAX(end, b->join[i]);
+            i++;
+        }
+    }
+    lo[k] = last;
+
+    return k;
+}
+
+/*
+ * Take b and lay out its tree for frequencies i*step, i = 0 .. n-1, with
+ * blocks of about block cells (BORE_TREE_BLOCK if block <= 0).  The tree
+ * is filled by the first bore_tree_impedance().
+ */
+bore_tree *create_bore_tree(bore *b, double step, int n, const acoustic_constants *ac,
+                            int block)
+{
+    bore_tree *bt;
+    int *pos, i, j, k, first = b->first[0], last = b->last[0];
+
+    if (block <= 0) block = BORE_TREE_BLOCK;
+
+    bt = m_calloc(1, sizeof(bore_tree));
+    bt->b = b;
+    bt->ac = *ac;
+    bt->step = step;
+    bt->n_freq = n;
+
+    bt->block_lo = m_malloc((last - first + 1) * sizeof(int));
+    bt->n_block = cut_blocks(b, block, bt->block_lo);
+    for (bt->size = 1; bt->size < bt->n_block; bt->size *= 2);
+
+    /* a cell enters the block of the main bore cell carrying its branch */
+    pos = m_malloc(b->n_cell * sizeof(int));
+    for (i = first; i <= last; i++) {
+        pos[i] = i;
+        if (b->side[i] >= 0) mark_side(b, b->side[i], i, pos);
+    }
+    bt->block_of = m_malloc(b->n_cell * sizeof(int));
+    for (k = 0; k < bt->n_block; k++) {
+        for (i = bt->block_lo[k]; i < bt->block_lo[k + 1]; i++) bt->block_of[i] = k;
+    }
+    bt->block_of[last] = -1;    /* the terminal cell only enters as the end impedance */
+    for (j = 0; j < b->n_cell; j++) {
+        if (pos[j] != j) bt->block_of[j] = bt->block_of[pos[j]];
+    }
+    free(pos);
+
+    bt->dirty = m_malloc(bt->n_block + 1);
+    memset(bt->dirty, 1, bt->n_block + 1);
+    bt->n_dirty = bt->n_block;
+    bt->z_l = m_calloc(n, sizeof(double complex));
+    bt->zinf = m_calloc(n, 1);
+    bt->end_dirty = 1;
+
+    /* unused leaves are unit matrices */
+    bt->node = m_calloc((size_t)n * 8 * bt->size, sizeof(double complex));
+    for (i = 0; i < n; i++) {
+        for (k = bt->n_block; k < bt->size; k++) {
+            bt->node[((size_t)i * 2 * bt->size + bt->size + k) * 4] = 1.0;
+            bt->node[((size_t)i * 2 * bt->size + bt->size + k) * 4 + 3] = 1.0;
+        }
+    }
+
+    return bt;
+}
+
+void dispose_bore_tree(bore_tree *bt)
+{
+    if (bt == NULL) return;
+
+    dispose_bore(bt->b);
+    free(bt->block_lo);
+    free(bt->block_of);
+    free(bt->dirty);
+    free(bt->z_l);
+    free(bt->zinf);
+    free(bt->node);
+    free(bt);
+}
+
+/* mark the block of cell j for recomputation */
+static void tree_touch(bore_tree *bt, int j)
+{
+    int k;
+
+    if (j < 0 || j >= bt->b->n_cell) return;
+    k = bt->block_of[j];
+    if (k >= 0 && !bt->dirty[k]) {
+        bt->dirty[k] = 1;
+        bt->n_dirty++;
+    }
+}
+
+/*
+ * Set diameters df, db and length r in meters of cell i, which may belong
+ * to any branch.  The topology stays, a terminal cell only takes df.
+ * Returns -1 if i is out of range, 0 otherwise.
+ */
+int bore_tree_set_cell(bore_tree *bt, int i, double df, double db, double r)
+{
+    bore *b = bt->b;
+
+    if (i < 0 || i >= b->n_cell) return -1;
+
+    b->df[i] = df;
+    if (b->kind[i] == BORE_OPEN_END || b->kind[i] == BORE_CLOSED_END) {
+        b->kind[i] = (df <= 0) ? BORE_CLOSED_END : BORE_OPEN_END;
+        if (i == b->last[0]) bt->end_dirty = 1;
+    } else {
+        b->db[i] = db;
+        b->r[i] = r;
+        if (r == 0.0) {
+            b->kind[i] = BORE_NULL;
+        } else if (df == db) {
+            b->kind[i] = BORE_STRAIGHT;
+        } else {
+            b->kind[i] = BORE_TAPER;
+        }
+    }
+
+    tree_touch(bt, i);
+    if (bt->ac.sec_var_calc) {
+        /* section variation averages with the neighbours */
+        tree_touch(bt, i - 1);
+        tree_touch(bt, i + 1);
+    }
+
+    return 0;
+}
+
+/* p = l r for 2x2 matrices {11, 12, 21, 22} */
+static inline void tree_product(double complex *p, const double complex *l,
+                                const double complex *r)
+{
+    p[0] = l[0] * r[0] + l[1] * r[2];
+    p[1] = l[0] * r[1] + l[1] * r[3];
+    p[2] = l[2] * r[0] + l[3] * r[2];
+    p[3] = l[2] * r[1] + l[3] * r[3];
+}
+
+/*
+ * Bring the tree of frequency index f up to date and return the input
+ * impedance of the main bore
+ */
+static double complex tree_impedance(bore_tree *bt, bore_work *wk, int f)
+{
+    const bore *b = bt->b;
+    double complex *nd = &bt->node[(size_t)f * 8 * bt->size];
+    double frq = f * bt->step;
+    int j, k;
+
+    for (k = 0; k < bt->n_block; k++) {
+        if (bt->dirty[k]) {
+            chain_range(b, wk, bt->block_lo[k], bt->block_lo[k + 1] - 1, frq, &bt->ac,
+                        &nd[4 * (bt->size + k)]);
+        }
+    }
+
+    if (2 * bt->n_dirty >= bt->n_block) {
+        for (j = bt->size - 1; j >= 1; j--) {
+            tree_product(&nd[4 * j], &nd[8 * j], &nd[8 * j + 4]);
+        }
+    } else {
+        for (k = 0; k < bt->n_block; k++) {
+            if (!bt->dirty[k]) continue;
+            for (j = (bt->size + k) / 2; j >= 1; j /= 2) {
+                tree_product(&nd[4 * j], &nd[8 * j], &nd[8 * j + 4]);
+            }
+        }
+    }
+
+    if (bt->end_dirty) {
+        end_load(b, b->last[0], frq, 1, &bt->ac, &bt->z_l[f], &bt->zinf[f]);
+    }
+    return bore_terminate(&nd[4], bt->z_l[f], bt->zinf[f]);
+}
+
+/* ------------------------------ blocked evaluate ------------------------------*/
+/*
+ * The same calculation for BORE_LANES frequencies at once.  Cell geometry
+ * does not depend on frequency, so every cell is visited once per block and
+ * the arithmetic runs along the frequency axis in fixed length loops that
+ * the compiler turns into SIMD code.  Complex values are kept as separate
+ * real and imaginary arrays and handled with the plain formulas below,
+ * because C99 complex multiplication and division carry inf/nan recovery
+ * that cannot be vectorized.  The results therefore agree with the scalar
+ * kernel within rounding, not bit for bit.
+ */
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && \
+    BORE_LANES > 1
+/* pick AVX-512 or AVX2 at load time, see target_clones in the GCC manual */
+#define BORE_KERNEL __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define BORE_KERNEL
+#endif
+
+typedef struct {
+    double re, im;
+} cpx;
+
+static inline cpx cx(double re, double im)
+{
+    cpx z = { re, im };
+    return z;
+}
+
+static inline cpx cx_add(cpx a, cpx b) { return cx(a.re + b.re, a.im + b.im); }
+static inline cpx cx_sub(cpx a, cpx b) { return cx(a.re - b.re, a.im - b.im); }
+static inline cpx cx_scale(cpx a, double s) { return cx(a.re * s, a.im * s); }
+static inline cpx cx_muli(cpx a) { return cx(-a.im, a.re); }   /* I*a */
+
+static inline cpx cx_mul(cpx a, cpx b)
+{
+    return cx(a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re);
+}
+
+static inline cpx cx_div(cpx a, cpx b)
+{
+    double d = b.re * b.re + b.im * b.im;
+    return cx((a.re * b.re + a.im * b.im) / d, (a.im * b.re - a.re * b.im) / d);
+}
+
+/* parallel connection z1*z2/(z1+z2) */
+static inline cpx cx_par(cpx a, cpx b)
+{
+    return cx_div(cx_mul(a, b), cx_add(a, b));
+}
+
+static inline cpx lane_get(const bore_lanes *v, int l) { return cx(v->re[l], v->im[l]); }
+
+static inline void lane_set(bore_lanes *v, int l, cpx z)
+{
+    v->re[l] = z.re;
+    v->im[l] = z.im;
+}
+
+bore_block_work *create_bore_block_work(const bore *b)
+{
+    bore_block_work *wk = m_malloc(sizeof(bore_block_work));
+
+    wk->n_cell = b->n_cell;
+    wk->zi = m_calloc(b->n_cell, sizeof(bore_lanes));
+    wk->zinf = m_calloc(b->n_cell, 1);
+    wk->m11 = m_calloc(b->n_cell, sizeof(bore_lanes));
+    wk->m12 = m_calloc(b->n_cell, sizeof(bore_lanes));
+    wk->m21 = m_calloc(b->n_cell, sizeof(bore_lanes));
+    wk->m22 = m_calloc(b->n_cell, sizeof(bore_lanes));
+    wk->n_split = b->n_split;
+    wk->s11 = m_calloc(b->n_split + 1, sizeof(bore_lanes));
+    wk->s12 = m_calloc(b->n_split + 1, sizeof(bore_lanes));
+    wk->s21 = m_calloc(b->n_split + 1, sizeof(bore_lanes));
+    wk->s22 = m_calloc(b->n_split + 1, sizeof(bore_lanes));
+
+    return wk;
+}
+
+void dispose_bore_block_work(bore_block_work *wk)
+{
+    if (wk == NULL) return;
+
+    free(wk->zi);
+    free(wk->zinf);
+    free(wk->m11);
+    free(wk->m12);
+    free(wk->m21);
+    free(wk->m22);
+    free(wk->s11);
+    free(wk->s12);
+    free(wk->s21);
+    free(wk->s22);
+    free(wk);
+}
+
+static void calc_branch_block(const bore *b, bore_block_work *wk, int br, const double *frq,
+                              double e_ratio, const acoustic_constants *ac);
+
+/*
+ * Transmission matrices of cell i for all lanes, see cell_matrix()
+ */
+BORE_KERNEL
+static void cell_matrix_block(const bore *b, bore_block_work *wk, int i, int first,
+                              const double *frq, const acoustic_constants *ac)
+{
+    double kr[BORE_LANES], ki[BORE_LANES], xr[BORE_LANES], xi[BORE_LANES];
+    double sr[BORE_LANES], si[BORE_LANES], cr[BORE_LANES], ci[BORE_LANES];
+    double d, d1, d2, L, aa0, r1, r2, s1, s2, ss, t1, t2, w, a, g;
+    cpx k, x, c, s, u, v;
+    int l;
+
+    d1 = b->df[i];
+    d2 = b->db[i];
+    d = (d1 + d2) * 0.5;
+    L = b->r[i];
+    aa0 = (1 + (GMM - 1) / sqrt(Pr)) * sqrt(2 * ac->nu) / ac->c0 / d;
+
+    /* wave number, aa = aa0*sqrt(w) */
+    for (l = 0; l < BORE_LANES; l++) {
+        w = PI2 * frq[l];
+        a = w / ac->c0;
+        if (ac->dump_calc == WALL) {
+            g = 2 * a * (aa0 * sqrt(w));
+            cx_sqrt_parts(a * a + g, -g, &k.re, &k.im);
+        } else {
+            k = cx(a, 0.0);
+        }
+        kr[l] = k.re;
+        ki[l] = k.im;
+        xr[l] = k.re * L;
+        xi[l] = k.im * L;
+    }
+
+    cx_sincos_n(BORE_LANES, xr, xi, sr, si, cr, ci, ac->cx_mode);
+
+    if (ac->sec_var_calc) {
+        s1 = PI / 4 * d1 * d1;
+        s2 = PI / 4 * d2 * d2;
+        ss = sqrt(s1 * s2);
+        bore_sec_var_ratio(b, i, first, &t1, &t2);
+
+        for (l = 0; l < BORE_LANES; l++) {
+            k = cx(kr[l], ki[l]);
+            s = cx(sr[l], si[l]);
+            c = cx(cr[l], ci[l]);
+
+            u = cx_scale(k, 2 * ss);
+            lane_set(&wk->m11[i], l, cx_div(cx_sub(cx_mul(cx_scale(k, 2 * s2), c),
+                                                   cx_scale(s, t2)), u));
+            lane_set(&wk->m12[i], l, cx_scale(cx_muli(s), ac->rhoc0 / ss));
+            v = cx_mul(k, k);
+            lane_set(&wk->m21[i], l,
+                     cx_div(cx_muli(cx_add(cx_mul(cx_scale(k, -2 * (s2 * t1 - s1 * t2)), c),
+                                           cx_mul(cx_add(cx_scale(v, 4 * s1 * s2),
+                                                         cx(t1 * t2, 0.0)), s))),
+                            cx_scale(v, 4 * ac->rhoc0 * ss)));
+            lane_set(&wk->m22[i], l, cx_div(cx_add(cx_mul(cx_scale(k, 2 * s1), c),
+                                                   cx_scale(s, t1)), u));
+        }
+    } else if (b->kind[i] == BORE_STRAIGHT) {
+        s1 = PI / 4 * d * d;
+
+        for (l = 0; l < BORE_LANES; l++) {
+            s = cx(sr[l], si[l]);
+            c = cx(cr[l], ci[l]);
+
+            lane_set(&wk->m11[i], l, c);
+            lane_set(&wk->m22[i], l, c);
+            lane_set(&wk->m12[i], l, cx_scale(cx_muli(s), ac->rhoc0 / s1));
+            lane_set(&wk->m21[i], l, cx_scale(cx_muli(s), s1 / ac->rhoc0));
+        }
+    } else {
+        r1 = d1 / 2;
+        r2 = d2 / 2;
+
+        for (l = 0; l < BORE_LANES; l++) {
+            k = cx(kr[l], ki[l]);
+            x = cx(xr[l], xi[l]);
+            s = cx(sr[l], si[l]);
+            c = cx(cr[l], ci[l]);
+
+            lane_set(&wk->m11[i], l, cx_div(cx_sub(cx_mul(cx_scale(x, r2), c),
+                                                   cx_scale(s, r2 - r1)), cx_scale(x, r1)));
+            lane_set(&wk->m12[i], l, cx_scale(cx_muli(s), ac->rhoc0 / (PI * r1 * r2)));
+            u = cx_sub(cx_mul(cx_scale(x, (r2 - r1) * (r2 - r1)), c),
+                       cx_mul(cx_add(cx((r2 - r1) * (r2 - r1), 0.0),
+                                     cx_scale(cx_mul(x, x), r1 * r2)), s));
+            v = cx_scale(cx_mul(k, k), L * L * ac->rhoc0);
+            lane_set(&wk->m21[i], l, cx_div(cx_scale(cx_muli(u), -PI), v));
+            lane_set(&wk->m22[i], l, cx_div(cx_add(cx_mul(cx_scale(x, r1), c),
+                                                   cx_scale(s, r2 - r1)), cx_scale(x, r2)));
+        }
+    }
+}
+
+/*
+ * Transmission matrices of cell i for all lanes, see cell_transfer()
+ */
+static void cell_transfer_block(const bore *b, bore_block_work *wk, int i, int first,
+                                const double *frq, const acoustic_constants *ac)
+{
+    int l;
+
+    if (b->kind[i] == BORE_NULL) {
+        for (l = 0; l < BORE_LANES; l++) {
+            lane_set(&wk->m11[i], l, cx(1.0, 0.0));
+            lane_set(&wk->m22[i], l, cx(1.0, 0.0));
+            lane_set(&wk->m12[i], l, cx(0.0, 0.0));
+            lane_set(&wk->m21[i], l, cx(0.0, 0.0));
+        }
+    } else {
+        cell_matrix_block(b, wk, i, first, frq, ac);
+    }
+}
+
+/*
+ * z = M(i) z for all lanes, see chain_push()
+ */
+BORE_KERNEL
+static void chain_push_block(const bore_block_work *wk, int i,
+                             bore_lanes *m11, bore_lanes *m12,
+                             bore_lanes *m21, bore_lanes *m22)
+{
+    cpx z11, z12, z21, z22, a11, a12, a21, a22;
+    int l;
+
+    for (l = 0; l < BORE_LANES; l++) {
+        a11 = lane_get(&wk->m11[i], l); a12 = lane_get(&wk->m12[i], l);
+        a21 = lane_get(&wk->m21[i], l); a22 = lane_get(&wk->m22[i], l);
+        z11 = lane_get(m11, l); z12 = lane_get(m12, l);
+        z21 = lane_get(m21, l); z22 = lane_get(m22, l);
+
+        lane_set(m11, l, cx_add(cx_mul(a11, z11), cx_mul(a12, z21)));
+        lane_set(m12, l, cx_add(cx_mul(a11, z12), cx_mul(a12, z22)));
+        lane_set(m21, l, cx_add(cx_mul(a21, z11), cx_mul(a22, z21)));
+        lane_set(m22, l, cx_add(cx_mul(a21, z12), cx_mul(a22, z22)));
+    }
+}
+
+/*
+ * Chain matrix of branch br without its terminal cell for all lanes,
+ * see branch_chain()
+ */
+static void branch_chain_block(const bore *b, bore_block_work *wk, int br,
+                               const double *frq, const acoustic_constants *ac,
+                               bore_lanes *m11, bore_lanes *m12,
+                               bore_lanes *m21, bore_lanes *m22)
+{
+    int i = b->last[br] - 1, first = b->first[br], l;
+
+    if (i < first) {
+        for (l = 0; l < BORE_LANES; l++) {
+            lane_set(m11, l, cx(1.0, 0.0));
+            lane_set(m22, l, cx(1.0, 0.0));
+            lane_set(m12, l, cx(0.0, 0.0));
+            lane_set(m21, l, cx(0.0, 0.0));
+        }
+        return;
+    }
+
+    cell_transfer_block(b, wk, i, first, frq, ac);
+    *m11 = wk->m11[i]; *m12 = wk->m12[i];
+    *m21 = wk->m21[i]; *m22 = wk->m22[i];
+
+    for (i--; i >= first; i--) {
+        cell_transfer_block(b, wk, i, first, frq, ac);
+        chain_push_block(wk, i, m11, m12, m21, m22);
+    }
+}
+
+/*
+ * Impedance of cell i for all lanes, see calc_cell()
+ * Whether an impedance is infinite depends on geometry only, so zinf is
+ * shared by the lanes.
+ */
+BORE_KERNEL
+static void calc_cell_block(const bore *b, bore_block_work *wk, int i, int first,
+                            const double *frq, const acoustic_constants *ac)
+{
+    bore_lanes zo, m11, m12, m21, m22;
+    cpx z, z1, z2, a11, a12, a21, a22, b11, b12, b21, b22, num, den;
+    double s = b->s_ratio[i];
+    int oinf, sb, nm, fs, k, l;
+
+    /* continuity with the inlet of the next cell */
+    zo = wk->zi[i + 1];
+    oinf = wk->zinf[i + 1];
+
+    sb = b->side[i];
+    if (sb >= 0) {
+        fs = b->first[sb];
+        if (b->s_type[i] == TONEHOLE) {
+            calc_branch_block(b, wk, sb, frq, s, ac);
+            if (wk->zinf[fs]) {
+                /* closed hole seen through, nothing changes */
+            } else if (oinf) {
+                zo = wk->zi[fs];
+                oinf = 0;
+            } else {
+                for (l = 0; l < BORE_LANES; l++) {
+                    lane_set(&zo, l, cx_par(lane_get(&wk->zi[fs], l), lane_get(&zo, l)));
+                }
+            }
+        } else if (b->s_type[i] == ADDON && s > 0) {
+            branch_chain_block(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+
+            for (l = 0; l < BORE_LANES; l++) {
+                a11 = lane_get(&m11, l); a12 = lane_get(&m12, l);
+                a21 = lane_get(&m21, l); a22 = lane_get(&m22, l);
+
+                den = cx_sub(cx_mul(a12, a21),
+                             cx_mul(cx(1 - a11.re, -a11.im), cx(1 - a22.re, -a22.im)));
+                z1 = cx_scale(cx_div(a12, den), 1 / s);
+                if (oinf) {
+                    lane_set(&zo, l, z1);
+                } else {
+                    z2 = cx_scale(lane_get(&zo, l), 1 / (1 - s));
+                    lane_set(&zo, l, cx_par(z1, z2));
+                }
+            }
+            oinf = 0;
+        } else if (b->s_type[i] == SPLIT && s > 0) {
+            branch_chain_block(b, wk, sb, frq, ac, &m11, &m12, &m21, &m22);
+
+            /* main path i+1..nm, accumulated by calc_branch_block */
+            nm = b->join[i];
+            k = b->slot[i];
+            for (l = 0; l < BORE_LANES; l++) {
+                a11 = lane_get(&m11, l);
+                a12 = cx_scale(lane_get(&m12, l), 1 / (1 - s));
+                a21 = cx_scale(lane_get(&m21, l), 1 - s);
+                a22 = lane_get(&m22, l);
+                b11 = lane_get(&wk->s11[k], l);
+                b12 = cx_scale(lane_get(&wk->s12[k], l), 1 / s);
+                b21 = cx_scale(lane_get(&wk->s21[k], l), s);
+                b22 = lane_get(&wk->s22[k], l);
+
+                den = cx_sub(cx_mul(cx_add(a12, b12), cx_add(a21, b21)),
+                             cx_mul(cx_sub(a11, b11), cx_sub(a22, b22)));
+                num = cx_add(cx_mul(a12, b11), cx_mul(a11, b12));
+                if (wk->zinf[nm + 1]) {
+                    z = cx_div(num, den);
+                } else {
+                    z2 = lane_get(&wk->zi[nm + 1], l);
+                    z = cx_div(cx_add(cx_mul(a12, b12), cx_mul(num, z2)),
+                               cx_add(cx_add(cx_mul(a22, b12), cx_mul(a12, b22)),
+                                      cx_mul(den, z2)));
+                }
+                lane_set(&zo, l, z);
+            }
+            oinf = 0;
+        }
+    }
+
+    cell_transfer_block(b, wk, i, first, frq, ac);
+
+    if (b->kind[i] == BORE_NULL) {
+        wk->zi[i] = zo;
+        wk->zinf[i] = oinf;
+        return;
+    }
+
+    for (l = 0; l < BORE_LANES; l++) {
+        a11 = lane_get(&wk->m11[i], l); a12 = lane_get(&wk->m12[i], l);
+        a21 = lane_get(&wk->m21[i], l); a22 = lane_get(&wk->m22[i], l);
+        if (!oinf) {
+            z2 = lane_get(&zo, l);
+            z = cx_div(cx_add(cx_mul(a11, z2), a12), cx_add(cx_mul(a21, z2), a22));
+        } else {
+            /* impedance of next cell is infinity! */
+            z = cx_div(a11, a21);
+        }
+        lane_set(&wk->zi[i], l, z);
+    }
+    wk->zinf[i] = 0;
+}
+
+/*
+ * Impedance of every cell of branch br for all lanes, see calc_branch()
+ */
+static void calc_branch_block(const bore *b, bore_block_work *wk, int br, const double *frq,
+                              double e_ratio, const acoustic_constants *ac)
+{
+    double complex z;
+    int i, k, c, l, first = b->first[br];
+
+    i = b->last[br];
+    if (b->kind[i] == BORE_CLOSED_END || e_ratio == 0) {
+        memset(&wk->zi[i], 0, sizeof(bore_lanes));
+        wk->zinf[i] = 1;
+    } else {
+        for (l = 0; l < BORE_LANES; l++) {
+            rad_imp(frq[l], b->df[i] * e_ratio, &z, ac);
+            if (ac->rad_calc == NONE) z = 0.0;
+            wk->zi[i].re[l] = creal(z);
+            wk->zi[i].im[l] = cimag(z);
+        }
+        wk->zinf[i] = 0;
+    }
+
+    for (i--; i >= first; i--) {
+        calc_cell_block(b, wk, i, first, frq, ac);
+
+        for (k = b->split_lo[br]; k < b->split_hi[br]; k++) {
+            c = b->split_cell[k];
+            if (i == b->join[c]) {
+                wk->s11[k] = wk->m11[i]; wk->s12[k] = wk->m12[i];
+                wk->s21[k] = wk->m21[i]; wk->s22[k] = wk->m22[i];
+            } else if (i > c && i < b->join[c]) {
+                chain_push_block(wk, i, &wk->s11[k], &wk->s12[k], &wk->s21[k], &wk->s22[k]);
+            }
+        }
+    }
+}
+
+/*
+ * Input impedance of the main bore at the BORE_LANES frequencies frq[],
+ * the blocked counterpart of bore_input_impedance().  All frequencies
+ * must be positive.
+ */
+void bore_input_impedance_block(const double *frq, const bore *b, bore_block_work *wk,
+                                double e_ratio, double complex *out_z,
+                                const acoustic_constants *ac)
+{
+    int l, first = b->first[0];
+
+    calc_branch_block(b, wk, 0, frq, e_ratio, ac);
+    for (l = 0; l < BORE_LANES; l++) {
+        out_z[l] = wk->zi[first].re[l] + I * wk->zi[first].im[l];
+    }
+}
+
+/* ------------------------------ sweep ------------------------------*/
+
+typedef struct {
+    const bore *b;
+    const acoustic_constants *ac;
+    double step, e_ratio;
+    int from, to;            /* frequency index range [from, to) */
+    int scalar;              /* use the one-frequency kernel */
+    int chain;               /* out receives bore_chain() matrices, 4 per frequency */
+    double complex *out;
+    int n_state;             /* bore_states_sweep(): out[k * n + i] of state k */
+    const double *states;
+    int n;
+    bore_tree *tree;         /* bore_tree_impedance() */
+    const double *frq;       /* bore_sweep_at(): frequency of index i instead of i*step */
+} sweep_chunk;
+
+/* frequency of index i, not positive for DC */
+static inline double sweep_frq(const sweep_chunk *c, int i)
+{
+    return c->frq ? c->frq[i] : i * c->step;
+}
+
+static void sweep_scalar(sweep_chunk *c)
+{
+    bore_work *wk;
+    int i;
+
+    wk = create_bore_work(c->b);
+    for (i = c->from; i < c->to; i++) {
+        if (sweep_frq(c, i) <= 0) {
+            c->out[i] = 0.0;    /* DC is not evaluated */
+        } else {
+            bore_input_impedance(sweep_frq(c, i), c->b, wk, c->e_ratio, &c->out[i], c->ac);
+        }
+    }
+    dispose_bore_work(wk);
+}
+
+static void sweep_block(sweep_chunk *c)
+{
+    bore_block_work *wk;
+    double frq[BORE_LANES];
+    double complex z[BORE_LANES];
+    double pad;
+    int i, l, n;
+
+    wk = create_bore_block_work(c->b);
+    for (i = c->from; i < c->to; i += BORE_LANES) {
+        n = MIN(BORE_LANES, c->to - i);
+        pad = 0;
+        for (l = 0; l < n; l++) pad = MAX(pad, sweep_frq(c, i + l));
+        if (pad <= 0) pad = c->frq ? 1.0 : c->step;
+        for (l = 0; l < BORE_LANES; l++) {
+            /* DC and the lanes past the end are computed at a dummy frequency */
+            frq[l] = (l < n && sweep_frq(c, i + l) > 0) ? sweep_frq(c, i + l) : pad;
+        }
+        bore_input_impedance_block(frq, c->b, wk, c->e_ratio, z, c->ac);
+        for (l = 0; l < n; l++) {
+            c->out[i + l] = (sweep_frq(c, i + l) <= 0) ? 0.0 : z[l];
+        }
+    }
+    dispose_bore_block_work(wk);
+}
+
+static void sweep_chain(sweep_chunk *c)
+{
+    bore_work *wk;
+    int i;
+
+    wk = create_bore_work(c->b);
+    for (i = c->from; i < c->to; i++) {
+        if (i == 0) {
+            memset(&c->out[0], 0, 4 * sizeof(double complex));
+        } else {
+            bore_chain(i * c->step, c->b, wk, &c->out[4 * i], c->ac);
+        }
+    }
+    dispose_bore_work(wk);
+}
+
+static void sweep_states(sweep_chunk *c)
+{
+    bore_states_work *sw;
+    double complex *z;
+    int i, k;
+
+    sw = create_bore_states_work(c->b, c->n_state, c->states);
+    z = m_malloc(c->n_state * sizeof(double complex));
+    for (i = c->from; i < c->to; i++) {
+        if (i == 0) {
+            for (k = 0; k < c->n_state; k++) c->out[k * c->n] = 0.0;
+        } else {
+            bore_states_impedance(i * c->step, c->b, sw, c->e_ratio, z, c->ac);
+            for (k = 0; k < c->n_state; k++) c->out[k * c->n + i] = z[k];
+        }
+    }
+    free(z);
+    dispose_bore_states_work(sw);
+}
+
+static void sweep_tree(sweep_chunk *c)
+{
+    bore_work *wk;
+    int i;
+
+    wk = create_bore_work(c->b);
+    for (i = c->from; i < c->to; i++) {
+        c->out[i] = (i == 0) ? 0.0 : tree_impedance(c->tree, wk, i);
+    }
+    dispose_bore_work(wk);
+}
+
+static gpointer sweep_worker(gpointer data)
+{
+    sweep_chunk *c = data;
+
+    if (c->tree != NULL) {
+        sweep_tree(c);
+    } else if (c->states != NULL) {
+        sweep_states(c);
+    } else if (c->chain) {
+        sweep_chain(c);
+    } else if (c->scalar || BORE_LANES == 1) {
+        sweep_scalar(c);
+    } else {
+        sweep_block(c);
+    }
+
+    return NULL;
+}
+
+/*
+ * Run the sweep described by proto over frequency indices 0 .. n-1.
+ * The range is cut into n_threads contiguous chunks, each evaluated on its
+ * own thread with its own workspace; n_threads <= 0 uses every processor.
+ * Chunks start at multiples of BORE_LANES, so every frequency sits in the
+ * same lane and the result does not depend on n_threads.
+ */
+static void sweep_run(const sweep_chunk *proto, int n, int n_threads)
+{
+    sweep_chunk *chunk;
+    GThread **th;
+    int k, per;
+
+    if (n_threads <= 0) n_threads = g_get_num_processors();
+    if (n_threads > (n + BORE_LANES - 1) / BORE_LANES) {
+        n_threads = (n + BORE_LANES - 1) / BORE_LANES;
+    }
+    if (n_threads <= 1) {
+        sweep_chunk c = *proto;
+        c.from = 0;
+        c.to = n;
+        sweep_worker(&c);
+        return;
+    }
+
+    chunk = m_calloc(n_threads, sizeof(sweep_chunk));
+    th = m_calloc(n_threads, sizeof(GThread *));
+
+    per = (n + n_threads - 1) / n_threads;
+    per = (per + BORE_LANES - 1) / BORE_LANES * BORE_LANES;
+    for (k = 0; k < n_threads; k++) {
+        chunk[k] = *proto;
+        chunk[k].from = MIN(k * per, n);
+        chunk[k].to = MIN((k + 1) * per, n);
+    }
+    /* the calling thread takes the first chunk itself */
+    for (k = 1; k < n_threads; k++) {
+        th[k] = g_thread_new("bore_sweep", sweep_worker, &chunk[k]);
+    }
+    sweep_worker(&chunk[0]);
+    for (k = 1; k < n_threads; k++) {
+        g_thread_join(th[k]);
+    }
+
+    free(th);
+    free(chunk);
+}
+
+/*
+ * Input impedance at frequencies i*step, i = 0 .. n-1, into out[i],
+ * on n_threads threads (see sweep_run()).  Frequencies go through the
+ * blocked kernel BORE_LANES at a time unless scalar is set.  Does not
+ * touch any Python state.
+ */
+void bore_sweep(const bore *b, double step, int n, double e_ratio, double complex *out,
+                const acoustic_constants *ac, int n_threads, int scalar)
+{
+    sweep_chunk c = { b, ac, step, e_ratio, 0, n, scalar, FALSE, out };
+
+    sweep_run(&c, n, n_threads);
+}
+
+/*
+ * Input impedance at the n frequencies frq[] into out[], as bore_sweep()
+ * does for a uniform grid.  Frequencies that are not positive give 0.
+ */
+void bore_sweep_at(const bore *b, const double *frq, int n, double e_ratio,
+                   double complex *out, const acoustic_constants *ac, int n_threads, int scalar)
+{
+    sweep_chunk c = { b, ac, 0, e_ratio, 0, n, scalar, FALSE, out };
+
+    c.frq = frq;
+    sweep_run(&c, n, n_threads);
+}
+
+/*
+ * Chain matrices of bore_chain() at frequencies i*step, i = 1 .. n-1, into
+ * out[4*i] .. out[4*i+3]; the entries of DC are zero.  Threads as in
+ * bore_sweep().
+ */
+void bore_chain_sweep(const bore *b, double step, int n, double complex *out,
+                      const acoustic_constants *ac, int n_threads)
+{
+    sweep_chunk c = { b, ac, step, 1, 0, n, TRUE, TRUE, out };
+
+    sweep_run(&c, n, n_threads);
+}
+
+/*
+ * Input impedance of b for n_state sets of branch ratios (see
+ * create_bore_states_work()) at frequencies i*step, i = 0 .. n-1, into
+ * out[k*n + i] for state k.  Threads as in bore_sweep().  Returns -1 if
+ * the states do not fit the layout of b, 0 otherwise.
+ */
+int bore_states_sweep(const bore *b, int n_state, const double *states, double step, int n,
+                      double e_ratio, double complex *out, const acoustic_constants *ac,
+                      int n_threads)
+{
+    sweep_chunk c = { b, ac, step, e_ratio, 0, n, TRUE, FALSE, out, n_state, states, n };
+    bore_states_work *sw;
+
+    /* check the states once before the threads start */
+    sw = create_bore_states_work(b, n_state, states);
+    if (sw == NULL) return -1;
+    dispose_bore_states_work(sw);
+
+    sweep_run(&c, n, n_threads);
+    return 0;
+}
+
+/*
+ * Input impedance of the edited bore of bt at its frequencies into out,
+ * recomputing only the blocks edited since the last call.  Threads as in
+ * bore_sweep(); frequencies are independent, so each thread updates the
+ * trees of its own chunk.
+ */
+void bore_tree_impedance(bore_tree *bt, double complex *out, int n_threads)
+{
+    sweep_chunk c = { bt->b, &bt->ac, bt->step, 1, 0, bt->n_freq, TRUE, FALSE, out,
+                      0, NULL, bt->n_freq, bt };
+
+    sweep_run(&c, bt->n_freq, n_threads);
+
+    memset(bt->dirty, 0, bt->n_block + 1);
+    bt->n_dirty = 0;
+    bt->end_dirty = 0;
+}
+
+/* ------------------------------ parallel chain ------------------------------*/
+/*
+ * For a few frequencies on a bore of very many cells the frequency axis
+ * leaves nothing to share, so the cells are shared instead: the main bore
+ * is cut into one block per thread, each thread forms the chain matrices
+ * of its block at every frequency and the calling thread multiplies them
+ * in order.  The blocks are cut and the threads started once per call, not
+ * per frequency.  Blocks never cut a SPLIT span and every side branch
+ * belongs to the block of its main bore cell, so the threads write
+ * disjoint parts of one bore_work.
+ */
+
+typedef struct {
+    const bore *b;
+    bore_work *wk;
+    const acoustic_constants *ac;
+    const double *frq;
+    int n;
+    int lo, hi;                 /* main bore cells hi down to lo */
+    double complex *t;          /* 4 per frequency */
+} chain_part;
+
+static gpointer chain_part_worker(gpointer data)
+{
+    chain_part *p = data;
+    int i;
+
+    for (i = 0; i < p->n; i++) {
+        if (p->frq[i] > 0) {
+            chain_range(p->b, p->wk, p->lo, p->hi, p->frq[i], p->ac, &p->t[4 * i]);
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Chain matrices of the main bore at the n frequencies frq[] into
+ * t[4*i] .. t[4*i+3], on n_threads threads.  Frequencies that are not
+ * positive are skipped.
+ */
+static void chain_threads(const double *frq, int n, const bore *b, bore_work *wk,
+                          double complex *t, const acoustic_constants *ac, int n_threads)
+{
+    chain_part *part;
+    GThread **th;
+    double complex x[4];
+    int *lo, i, k, m, len = b->last[0] - b->first[0];
+
+    if (n_threads <= 0) n_threads = g_get_num_processors();
+    if (n_threads <= 1 || len < 2 * n_threads) {
+        for (i = 0; i < n; i++) {
+            if (frq[i] > 0) bore_chain(frq[i], b, wk, &t[4 * i], ac);
+        }
+        return;
+    }
+
+    lo = m_malloc((len + 1) * sizeof(int));
+    m = cut_blocks(b, (len + n_threads - 1) / n_threads, lo);
+    part = m_calloc(m, sizeof(chain_part));
+    th = m_calloc(m, sizeof(GThread *));
+    for (k = 0; k < m; k++) {
+        part[k].b = b;
+        part[k].wk = wk;
+        part[k].ac = ac;
+        part[k].frq = frq;
+        part[k].n = n;
+        part[k].lo = lo[k];
+        part[k].hi = lo[k + 1] - 1;
+        /* the first block writes straight into t */
+        part[k].t = (k == 0) ? t : m_malloc(4 * (n + 1) * sizeof(double complex));
+    }
+
+    /* the calling thread takes the first block itself */
+    for (k = 1; k < m; k++) {
+        th[k] = g_thread_new("bore_chain", chain_part_worker, &part[k]);
+    }
+    chain_part_worker(&part[0]);
+    for (k = 1; k < m; k++) {
+        g_thread_join(th[k]);
+    }
+
+    for (i = 0; i < n; i++) {
+        if (frq[i] <= 0) continue;
+        for (k = 1; k < m; k++) {
+            tree_product(x, &t[4 * i], &part[k].t[4 * i]);
+            memcpy(&t[4 * i], x, sizeof(x));
+        }
+    }
+
+    for (k = 1; k < m; k++) {
+        free(part[k].t);
+    }
+    free(th);
+    free(part);
+    free(lo);
+}
+
+/*
+ * bore_chain() on n_threads threads, n_threads <= 0 uses every processor.
+ * Equals bore_chain() within rounding.
+ */
+void bore_chain_threads(double frq, const bore *b, bore_work *wk, double complex *t,
+                        const acoustic_constants *ac, int n_threads)
+{
+    chain_threads(&frq, 1, b, wk, t, ac, n_threads);
+}
+
+/*
+ * Input impedance of the main bore at the n frequencies frq[] into out[],
+ * with the cells spread over n_threads threads as in bore_chain_threads().
+ * Meant for bores too long for one core and too few frequencies for
+ * bore_sweep_at(), which shares the frequencies instead.  Frequencies that
+ * are not positive give 0.
+ */
+void bore_impedance_threads(const bore *b, const double *frq, int n, double complex *out,
+                            const acoustic_constants *ac, int n_threads)
+{
+    bore_work *wk;
+    double complex *t, z_l;
+    unsigned char closed;
+    int i;
+
+    wk = create_bore_work(b);
+    t = m_malloc(4 * (n + 1) * sizeof(double complex));
+    chain_threads(frq, n, b, wk, t, ac, n_threads);
+    for (i = 0; i < n; i++) {
+        if (frq[i] <= 0) {
+            out[i] = 0.0;
+            continue;
+        }
+        end_load(b, b->last[0], frq[i], 1, ac, &z_l, &closed);
+        out[i] = bore_terminate(&t[4 * i], z_l, closed);
+    }
+    free(t);
+    dispose_bore_work(wk);
+}
+
+/*
+ * Input impedance at the n frequencies frq[] into out[] on n_threads
+ * threads, n_threads <= 0 uses every processor.  The frequencies are
+ * shared by bore_sweep_at() with the blocked kernel unless they are too
+ * few to keep the threads busy and the main bore has at least
+ * BORE_CHAIN_CELLS cells; then bore_impedance_threads() shares the cells.
+ */
+void bore_impedance_at(const bore *b, const double *frq, int n, double complex *out,
+                       const acoustic_constants *ac, int n_threads)
+{
+    if (n_threads <= 0) n_threads = g_get_num_processors();
+
+    if (n_threads > 1 && (n + BORE_LANES - 1) / BORE_LANES < n_threads
+        && b->last[0] - b->first[0] >= BORE_CHAIN_CELLS) {
+        bore_impedance_threads(b, frq, n, out, ac, n_threads);
+    } else {
+        bore_sweep_at(b, frq, n, 1, out, ac, n_threads, FALSE);
+    }
+}
+
+/* ------------------------------ pressure field ------------------------------*/
+
+typedef struct {
+    const bore *b;
+    const acoustic_constants *ac;
+    const double *frq;
+    double complex p0;
+    int from, to;
+    double complex *p, *u;
+} pressure_chunk;
+
+static gpointer pressure_worker(gpointer data)
+{
+    pressure_chunk *c = data;
+    bore_work *wk;
+    int n = c->b->last[0] - c->b->first[0] + 1;
+    int i, j;
+    size_t row;
+
+    wk = create_bore_work(c->b);
+    for (i = c->from; i < c->to; i++) {
+        row = (size_t)i * n;
+        if (c->frq[i] <= 0) {
+            for (j = 0; j < n; j++) {
+                c->p[row + j] = 0.0;
+                if (c->u) c->u[row + j] = 0.0;
+            }
+            continue;
+        }
+        bore_pressure(c->frq[i], c->b, wk, c->p0, &c->p[row], c->u ? &c->u[row] : NULL,
+                      c->ac);
+    }
+    dispose_bore_work(wk);
+    return NULL;
+}
+
+/*
+ * bore_pressure() at the n frequencies frq[] into the rows of p and u,
+ * n x (last[0]-first[0]+1) each, on n_threads threads (<= 0 uses every
+ * processor).  Each thread keeps one bore_work for its whole range of
+ * frequencies.  u may be NULL; frequencies that are not positive give 0.
+ */
+void bore_pressure_sweep(const bore *b, const double *frq, int n, double complex p0,
+                         double complex *p, double complex *u, const acoustic_constants *ac,
+                         int n_threads)
+{
+    pressure_chunk *c;
+    GThread **th;
+    int k;
+
+    if (n_threads <= 0) n_threads = g_get_num_processors();
+    n_threads = MIN(n_threads, n);
+    if (n_threads < 1) return;
+
+    c = m_calloc(n_threads, sizeof(pressure_chunk));
+    th = m_calloc(n_threads, sizeof(GThread *));
+    for (k = 0; k < n_threads; k++) {
+        c[k].b = b;
+        c[k].ac = ac;
+        c[k].frq = frq;
+        c[k].p0 = p0;
+        c[k].from = (int)((long)n * k / n_threads);
+        c[k].to = (int)((long)n * (k + 1) / n_threads);
+        c[k].p = p;
+        c[k].u = u;
+    }
+
+    /* the calling thread takes the first chunk itself */
+    for (k = 1; k < n_threads; k++) {
+        th[k] = g_thread_new("bore_pressure", pressure_worker, &c[k]);
+    }
+    pressure_worker(&c[0]);
+    for (k = 1; k < n_threads; k++) {
+        g_thread_join(th[k]);
+    }
+
+    free(th);
+    free(c);
+}
@@ -0,0 +1,180 @@
+/*
+ * bore.h - compiled (flattened) representation of a resolved mensur
+ *
+ * A mensur is a doubly linked list of ~300 byte cells with side branches
+ * hanging off some of them.  For impedance sweeps the list is compiled once
+ * into a bore: contiguous structure-of-arrays geometry in which every
+ * branch occupies a dense index range, so that the per-frequency kernel
+ * streams through arrays instead of chasing pointers.
+ */
+
+#ifndef _BORE_H_
+#define _BORE_H_
+
+#include <complex.h>
+#include "zmensur.h"
+#include "acoustic_constants.h"
+
+/* kind of a compiled cell */
+enum {
+    BORE_STRAIGHT = 0,  /* df == db, r > 0 */
+    BORE_TAPER,         /* df != db, r > 0 */
+    BORE_NULL,          /* r == 0, passes impedance through */
+    BORE_OPEN_END,      /* terminal cell radiating with diameter df */
+    BORE_CLOSED_END     /* terminal cell with df <= 0 */
+};
+
+typedef struct {
+    /* cell geometry in meters, one entry per cell of every branch */
+    int n_cell;
+    double *df, *db, *r;
+    unsigned char *kind;   /* BORE_STRAIGHT, BORE_TAPER, ... */
+
+    /* branching at the outlet of a cell */
+    unsigned char *s_type; /* TONEHOLE, ADDON, SPLIT or 0 */
+    double *s_ratio;
+    int *side;             /* branch index of side branch, -1 if none */
+    int *join;             /* SPLIT only: cell index where the side rejoins */
+    int *slot;             /* SPLIT only: index of the span accumulator, else -1 */
+
+    /* branches; branch 0 is the main bore */
+    int n_branch;
+    int *first;            /* index of first cell of branch */
+    int *last;             /* index of terminal cell of branch */
+
+    /* SPLIT cells, those of branch br are split_lo[br] .. split_hi[br]-1 */
+    int n_split;
+    int *split_cell;
+    int *split_lo, *split_hi;
+} bore;
+
+/* per-frequency scratch for evaluating a bore, owned by the caller */
+typedef struct {
+    int n_cell;
+    double complex *zi;    /* input impedance of each cell */
+    unsigned char *zinf;   /* zi is infinite (closed end seen through) */
+    double complex *m11, *m12, *m21, *m22; /* transmission matrix */
+    int n_split;
+    double complex *s11, *s12, *s21, *s22; /* running product over each SPLIT span */
+    double complex *j11, *j12, *j21, *j22; /* bore_chain(): chain behind each span */
+} bore_work;
+
+/*
+ * Number of frequencies evaluated together by the blocked kernel.
+ * 8 doubles fill one AVX-512 register, two AVX2 registers.  Build with
+ * -DBORE_LANES=1 to sweep with the scalar kernel only.
+ */
+#ifndef BORE_LANES
+#define BORE_LANES 8
+#endif
+
+/* one complex value per lane, real and imaginary parts kept apart */
+typedef struct {
+    double re[BORE_LANES];
+    double im[BORE_LANES];
+} bore_lanes;
+
+/* bore_work for BORE_LANES frequencies at once */
+typedef struct {
+    int n_cell;
+    bore_lanes *zi;
+    unsigned char *zinf;   /* depends on geometry only, shared by lanes */
+    bore_lanes *m11, *m12, *m21, *m22;
+    int n_split;
+    bore_lanes *s11, *s12, *s21, *s22;
+} bore_block_work;
+
+/*
+ * scratch for evaluating one bore with many sets of branch ratios, see
+ * create_bore_states_work()
+ */
+typedef struct {
+    bore_work *wk;         /* matrices and span products, shared by the states */
+    int n_state;
+    double *states;        /* n_state x n_cell ratios */
+    double complex *zi;    /* n_state x n_cell input impedances */
+    unsigned char *zinf;
+    double complex *c11, *c12, *c21, *c22; /* chain matrix of each ADDON/SPLIT side */
+    int *owner;            /* earlier state sharing the cells behind from, or -1 */
+    int *from;             /* first main bore cell to evaluate */
+} bore_states_work;
+
+/* main bore cells from which bore_impedance_at() shares the cells of a few frequencies */
+#ifndef BORE_CHAIN_CELLS
+#define BORE_CHAIN_CELLS 4096
+#endif
+
+/* main bore cells per leaf of a bore_tree unless given */
+#ifndef BORE_TREE_BLOCK
+#define BORE_TREE_BLOCK 32
+#endif
+
+/*
+ * a bore edited between sweeps at fixed frequencies, see create_bore_tree()
+ */
+typedef struct {
+    bore *b;               /* owned, edited by bore_tree_set_cell() */
+    acoustic_constants ac;
+    double step;
+    int n_freq;
+    int n_block;           /* blocks of main bore cells, the leaves of the tree */
+    int size;              /* leaves rounded up to a power of two */
+    int *block_lo;         /* block k holds main bore cells block_lo[k] .. block_lo[k+1]-1 */
+    int *block_of;         /* block whose product each cell enters, -1 for the open end */
+    unsigned char *dirty;  /* block edited since the last sweep */
+    int n_dirty;
+    double complex *z_l;   /* impedance at the open end per frequency */
+    unsigned char *zinf;   /* the end is closed */
+    int end_dirty;         /* the open end was edited */
+    double complex *node;  /* per frequency 2*size matrices {11, 12, 21, 22}, root at 1 */
+} bore_tree;
+
+/* ------------------------------ prototype ------------------------------ */
+/* bore.c */
+bore *compile_bore(mensur *men);
+bore *copy_bore(const bore *b);
+void dispose_bore(bore *b);
+int bore_same_layout(const bore *a, const bore *b);
+bore_work *create_bore_work(const bore *b);
+void dispose_bore_work(bore_work *wk);
+void bore_input_impedance(double frq, const bore *b, bore_work *wk, double e_ratio,
+                          double complex *out_z, const acoustic_constants *ac);
+bore_block_work *create_bore_block_work(const bore *b);
+void dispose_bore_block_work(bore_block_work *wk);
+void bore_input_impedance_block(const double *frq, const bore *b, bore_block_work *wk,
+                                double e_ratio, double complex *out_z,
+                                const acoustic_constants *ac);
+void bore_sweep(const bore *b, double step, int n, double e_ratio, double complex *out,
+                const acoustic_constants *ac, int n_threads, int scalar);
+void bore_sweep_at(const bore *b, const double *frq, int n, double e_ratio,
+                   double complex *out, const acoustic_constants *ac, int n_threads, int scalar);
+void bore_pressure(double frq, const bore *b, bore_work *wk, double complex p0,
+                   double complex *p, double complex *u, const acoustic_constants *ac);
+void bore_pressure_sweep(const bore *b, const double *frq, int n, double complex p0,
+                         double complex *p, double complex *u, const acoustic_constants *ac,
+                         int n_threads);
+void bore_chain(double frq, const bore *b, bore_work *wk, double complex *t,
+                const acoustic_constants *ac);
+double complex bore_terminate(const double complex *t, double complex z_l, int closed);
+void bore_chain_sweep(const bore *b, double step, int n, double complex *out,
+                      const acoustic_constants *ac, int n_threads);
+bore_states_work *create_bore_states_work(const bore *b, int n_state, const double *states);
+void dispose_bore_states_work(bore_states_work *sw);
+void bore_states_impedance(double frq, const bore *b, bore_states_work *sw, double e_ratio,
+                           double complex *out_z, const acoustic_constants *ac);
+int bore_states_sweep(const bore *b, int n_state, const double *states, double step, int n,
+                      double e_ratio, double complex *out, const acoustic_constants *ac,
+                      int n_threads);
+bore_tree *create_bore_tree(bore *b, double step, int n, const acoustic_constants *ac,
+                            int block);
+void dispose_bore_tree(bore_tree *bt);
+int bore_tree_set_cell(bore_tree *bt, int i, double df, double db, double r);
+void bore_tree_impedance(bore_tree *bt, double complex *out, int n_threads);
+void bore_chain_threads(double frq, const bore *b, bore_work *wk, double complex *t,
+                        const acoustic_constants *ac, int n_threads);
+void bore_impedance_threads(const bore *b, const double *frq, int n, double complex *out,
+                            const acoustic_constants *ac, int n_threads);
+void bore_impedance_at(const bore *b, const double *frq, int n, double complex *out,
+                       const acoustic_constants *ac, int n_threads);
+
+#endif /* _BORE_H_ */
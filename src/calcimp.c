@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
 /* #include <math.h> */
 #include <getopt.h>
 #include <glib.h>
@@ -20,72 +22,283 @@
 #include "kutils.h"
 #include "zmensur.h"
 #include "xmensur.h"
+#include "bore.h"
+#include "spectrum.h"
+#include "sensitivity.h"
+#include "optimize.h"
+#include "response.h"
+#include "cxmath.h"
 #include "calcimp.h"
 #include "acoustic_constants.h"
 
 
-static PyObject* calculate_impedance(const char* filename, double max_freq, double step_freq,
-                                      unsigned long num_freq, double temperature,
-                                      int rad_calc, int dump_calc, int sec_var_calc) {
-    mensur *mensur;
-    double complex *imp;
-    int n_imp;
-    double frq, mag, S;
-    int i;
-    PyObject *freq_array, *real_array, *imag_array, *mag_array, *result_tuple;
-    npy_intp dims[1];
-    acoustic_constants ac;
-
-    /* Initialize acoustic constants based on temperature */
-    init_acoustic_constants(&ac, temperature);
-
-    /* Set configuration flags */
-    ac.rad_calc = rad_calc;
-    ac.dump_calc = dump_calc;
-    ac.sec_var_calc = sec_var_calc;
+/*
+ * Acoustic constants at temperature with the options of a Python call,
+ * dump_calc and the others as booleans
+ */
+static void set_constants(acoustic_constants* ac, double temperature, int rad_calc,
+                          int dump_calc, int sec_var_calc, int fast_math) {
+    init_acoustic_constants(ac, temperature);
+    ac->rad_calc = rad_calc;
+    ac->dump_calc = dump_calc ? WALL : NONE;
+    ac->sec_var_calc = sec_var_calc;
+    ac->cx_mode = fast_math ? CX_FAST : CX_EXACT;
+}
 
-    /* Read mensur file - detect format by extension */
+/* Read mensur file - detect format by extension */
+static mensur* read_mensur_file(const char* filename) {
     const char *ext = strrchr(filename, '.');
     if (ext != NULL && strcmp(ext, ".xmen") == 0) {
         /* XMENSUR format */
-        mensur = read_xmensur(filename);
+        return read_xmensur(filename);
+    }
+    /* ZMENSUR format (default) */
+    return read_mensur(filename);
+}
+
+/* Read mensur file without rejointing its branches */
+static mensur* read_mensur_file_nojoint(const char* filename) {
+    const char *ext = strrchr(filename, '.');
+    if (ext != NULL && strcmp(ext, ".xmen") == 0) {
+        return read_xmensur_nojoint(filename);
+    }
+    return read_mensur_nojoint(filename);
+}
+
+/*
+ * Parse len bytes of mensur text, format "xmen" or "men", rejointed or not.
+ * Returns NULL with a Python exception set on error.
+ */
+static mensur* read_mensur_text(const char* text, size_t len, const char* format, int nojoint) {
+    mensur *men;
+
+    if (strcmp(format, "xmen") == 0) {
+        men = nojoint ? read_xmensur_buffer_nojoint(text, len) : read_xmensur_buffer(text, len);
+    } else if (strcmp(format, "men") == 0) {
+        men = nojoint ? read_mensur_buffer_nojoint(text, len) : read_mensur_buffer(text, len);
     } else {
-        /* ZMENSUR format (default) */
-        mensur = read_mensur(filename);
+        PyErr_Format(PyExc_ValueError, "Unknown format '%s', expected 'xmen' or 'men'", format);
+        return NULL;
+    }
+    if (men == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to parse mensur text");
     }
+    return men;
+}
 
-    if (mensur == NULL) {
-        PyErr_SetString(PyExc_RuntimeError, "Failed to read mensur file");
+/*
+ * Optionally simplify and compile a rejointed mensur.
+ * Returns NULL with a Python exception set on error.
+ */
+static bore* finish_bore(mensur* mensur, double simplify) {
+    bore *bore;
+
+    /* Merge redundant cells, tolerance in mm */
+    if (simplify >= 0) {
+        simplify_men(mensur, simplify * 0.001);
+    }
+
+    /* Flatten the linked list once, the sweep streams through arrays */
+    bore = compile_bore(mensur);
+    if (bore == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to compile mensur");
         return NULL;
     }
 
-    /* Calculate number of points */
-    if (num_freq > 0) {
-        step_freq = max_freq / (double)num_freq;
+    return bore;
+}
+
+/* ------------------------------ file cache ------------------------------ */
+
+/*
+ * Parsed files, most recently used first.  An entry keeps the rejointed
+ * mensur and its compiled bore, both read only; callers get copies.  A
+ * file is parsed again when stat() no longer gives the same device,
+ * inode, size and modification time.  All access is under the GIL.
+ */
+typedef struct {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    long mtime_ns;
+    mensur *men;
+    bore *bore;
+} cache_entry;
+
+static GQueue file_cache = G_QUEUE_INIT;
+static int cache_max = 16;
+static long cache_hits = 0, cache_misses = 0;
+
+static long stat_mtime_ns(const struct stat *st) {
+#if defined(__APPLE__)
+    return st->st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    return 0;
+#else
+    return st->st_mtim.tv_nsec;
+#endif
+}
+
+static void dispose_cache_entry(cache_entry *e) {
+    dispose_men_tree(e->men);
+    dispose_bore(e->bore);
+    free(e->path);
+    free(e);
+}
+
+/* drop entries beyond max from the least recently used end */
+static void trim_cache(int max) {
+    while ((int)g_queue_get_length(&file_cache) > max) {
+        dispose_cache_entry(g_queue_pop_tail(&file_cache));
     }
-    n_imp = max_freq / step_freq + 1;
-    dims[0] = n_imp;
+}
 
-    /* Allocate memory for impedance calculations */
-    imp = (double complex*)calloc(n_imp, sizeof(double complex));
-    if (imp == NULL) {
-        PyErr_NoMemory();
+/*
+ * Entry for filename, parsed and compiled if missing or stale.  With the
+ * cache disabled or the file not stat()able returns NULL and sets *men
+ * to a fresh mensur owned by the caller (NULL with a Python exception on
+ * a read error).
+ */
+static cache_entry* cached_file(const char* filename, mensur** men) {
+    struct stat st;
+    cache_entry *e;
+    GList *l;
+    bore *bore;
+
+    *men = NULL;
+    if (cache_max <= 0 || stat(filename, &st) != 0) {
+        *men = read_mensur_file(filename);
+        if (*men == NULL) {
+            PyErr_SetString(PyExc_RuntimeError, "Failed to read mensur file");
+        }
         return NULL;
     }
 
-    /* Get initial cross-sectional area */
-    S = PI * pow(get_first_men(mensur)->df, 2) / 4;
+    for (l = file_cache.head; l != NULL; l = l->next) {
+        e = l->data;
+        if (strcmp(e->path, filename) != 0) continue;
+        if (e->dev == st.st_dev && e->ino == st.st_ino && e->size == st.st_size &&
+            e->mtime == st.st_mtime && e->mtime_ns == stat_mtime_ns(&st)) {
+            cache_hits++;
+            g_queue_unlink(&file_cache, l);
+            g_queue_push_head_link(&file_cache, l);
+            return e;
+        }
+        /* the file changed */
+        g_queue_delete_link(&file_cache, l);
+        dispose_cache_entry(e);
+        break;
+    }
 
-    /* Calculate impedance */
-    for (i = 0; i < n_imp; i++) {
-        frq = i * step_freq;
-        if (i == 0) {
-            imp[i] = 0.0;
-        } else {
-            input_impedance(frq, mensur, 1, &imp[i], &ac);
-            imp[i] *= S;  /* Convert to acoustic impedance density */
+    cache_misses++;
+    *men = read_mensur_file(filename);
+    if (*men == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to read mensur file");
+        return NULL;
+    }
+    bore = compile_bore(*men);
+    if (bore == NULL) {
+        /* leave the error to the caller's own compile */
+        return NULL;
+    }
+
+    e = m_calloc(1, sizeof(cache_entry));
+    e->path = m_malloc(strlen(filename) + 1);
+    strcpy(e->path, filename);
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->size = st.st_size;
+    e->mtime = st.st_mtime;
+    e->mtime_ns = stat_mtime_ns(&st);
+    e->men = *men;
+    e->bore = bore;
+    *men = NULL;
+    g_queue_push_head(&file_cache, e);
+    trim_cache(cache_max);
+    return e;
+}
+
+/*
+ * Read a mensur file, through the cache.  The result belongs to the
+ * caller, who may edit it and disposes it with dispose_men_tree().
+ * Returns NULL with a Python exception set on error.
+ */
+static mensur* load_mensur(const char* filename) {
+    cache_entry *e;
+    mensur *men;
+
+    e = cached_file(filename, &men);
+    return (e != NULL) ? copy_men(e->men) : men;
+}
+
+/*
+ * Read, optionally simplify and compile a mensur file.
+ * Returns NULL with a Python exception set on error.
+ */
+static bore* load_bore(const char* filename, double simplify) {
+    cache_entry *e;
+    mensur *mensur;
+    bore *bore;
+
+    e = cached_file(filename, &mensur);
+    if (e != NULL) {
+        if (simplify < 0) {
+            return copy_bore(e->bore);
         }
+        mensur = copy_men(e->men);
+    }
+    if (mensur == NULL) {
+        return NULL;
+    }
+
+    /* the bore keeps no pointer into the cells */
+    bore = finish_bore(mensur, simplify);
+    dispose_men_tree(mensur);
+    return bore;
+}
+
+static PyObject* py_set_cache_size(PyObject* self, PyObject* args) {
+    int size, old = cache_max;
+
+    if (!PyArg_ParseTuple(args, "i", &size)) {
+        return NULL;
     }
+    if (size < 0) {
+        PyErr_SetString(PyExc_ValueError, "cache size must not be negative");
+        return NULL;
+    }
+
+    cache_max = size;
+    trim_cache(cache_max);
+    return PyLong_FromLong(old);
+}
+
+static PyObject* py_clear_cache(PyObject* self, PyObject* args) {
+    trim_cache(0);
+    cache_hits = cache_misses = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_cache_info(PyObject* self, PyObject* args) {
+    return Py_BuildValue("{s:I,s:i,s:l,s:l}", "size", g_queue_get_length(&file_cache),
+                         "max_size", cache_max, "hits", cache_hits, "misses", cache_misses);
+}
+
+/*
+ * Build the result tuple (frequencies, real_part, imaginary_part,
+ * magnitude_db) of calcimp() from n_imp impedances at frq[i], or at
+ * i*step_freq when frq is NULL
+ */
+static PyObject* impedance_tuple(const double complex* imp, const double* frq, int n_imp,
+                                 double step_freq) {
+    double mag;
+    int i;
+    PyObject *freq_array, *real_array, *imag_array, *mag_array, *result_tuple;
+    npy_intp dims[1];
+
+    dims[0] = n_imp;
 
     /* Create numpy arrays */
     freq_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
@@ -98,7 +311,6 @@ static PyObject* calculate_impedance(const char* filename, double max_freq, doub
         Py_XDECREF(real_array);
         Py_XDECREF(imag_array);
         Py_XDECREF(mag_array);
-        free(imp);
         PyErr_NoMemory();
         return NULL;
     }
@@ -110,15 +322,13 @@ static PyObject* calculate_impedance(const char* filename, double max_freq, doub
     double *mag_data = (double*)PyArray_DATA((PyArrayObject*)mag_array);
 
     for (i = 0; i < n_imp; i++) {
-        freq_data[i] = i * step_freq;
+        freq_data[i] = frq ? frq[i] : i * step_freq;
         real_data[i] = creal(imp[i]);
         imag_data[i] = cimag(imp[i]);
         mag = real_data[i] * real_data[i] + imag_data[i] * imag_data[i];
         mag_data[i] = (mag > 0) ? 10 * log10(mag) : mag;
     }
 
-    free(imp);
-
     /* Create return tuple */
     result_tuple = PyTuple_New(4);
     if (!result_tuple) {
@@ -137,33 +347,111 @@ static PyObject* calculate_impedance(const char* filename, double max_freq, doub
     return result_tuple;
 }
 
-static PyObject* py_print_men(PyObject* self, PyObject* args) {
-    const char* filename;
+/*
+ * Sweep a compiled bore and build the result tuple of calcimp().
+ * The bore stays with the caller.
+ */
+static PyObject* calculate_impedance(bore* bore, double max_freq, double step_freq,
+                                      unsigned long num_freq, double temperature,
+                                      int rad_calc, int dump_calc, int sec_var_calc,
+                                      int threads, int scalar, int fast_math) {
+    double complex *imp;
+    int n_imp;
+    double S;
+    int i;
+    PyObject *result_tuple;
+    acoustic_constants ac;
 
-    if (!PyArg_ParseTuple(args, "s", &filename)) {
+    set_constants(&ac, temperature, rad_calc, dump_calc != NONE, sec_var_calc, fast_math);
+
+    /* Calculate number of points */
+    if (num_freq > 0) {
+        step_freq = max_freq / (double)num_freq;
+    }
+    n_imp = max_freq / step_freq + 1;
+
+    /* Allocate memory for impedance calculations */
+    imp = (double complex*)calloc(n_imp, sizeof(double complex));
+    if (imp == NULL) {
+        PyErr_NoMemory();
         return NULL;
     }
 
-    /* Read mensur file - detect format by extension */
-    mensur *mensur_data;
-    const char *ext = strrchr(filename, '.');
-    if (ext != NULL && strcmp(ext, ".xmen") == 0) {
-        /* XMENSUR format */
-        mensur_data = read_xmensur(filename);
-        if (mensur_data == NULL) {
-            PyErr_SetString(PyExc_RuntimeError, "Failed to read XMENSUR file");
-            return NULL;
-        }
-    } else {
-        /* ZMENSUR format */
-        mensur_data = read_mensur(filename);
-        if (mensur_data == NULL) {
-            PyErr_SetString(PyExc_RuntimeError, "Failed to read ZMENSUR file");
-            return NULL;
+    /* Get initial cross-sectional area */
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    /* Calculate impedance, the sweep touches no Python state */
+    Py_BEGIN_ALLOW_THREADS
+    bore_sweep(bore, step_freq, n_imp, 1, imp, &ac, threads, scalar);
+    for (i = 1; i < n_imp; i++) {
+        imp[i] *= S;  /* Convert to acoustic impedance density */
+    }
+    Py_END_ALLOW_THREADS
+
+    result_tuple = impedance_tuple(imp, NULL, n_imp, step_freq);
+    free(imp);
+
+    return result_tuple;
+}
+
+/*
+ * Find the resonances of a compiled bore and build the result tuple
+ * (frequencies, magnitude, q, bandwidth) of find_resonances().
+ * The bore stays with the caller.
+ */
+static PyObject* find_resonances(bore* bore, double max_freq, double step_freq, double tol,
+                                 double temperature, int rad_calc, int dump_calc,
+                                 int sec_var_calc, int threads, int scalar, int fast_math) {
+    resonance *res;
+    int k, n;
+    double S;
+    acoustic_constants ac;
+    PyObject *arrays[4], *result_tuple;
+    npy_intp dims[1];
+
+    if (!(step_freq > 0) || !(tol > 0) || !(max_freq >= 0)) {
+        PyErr_SetString(PyExc_ValueError, "step_freq and tol must be positive");
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc != NONE, sec_var_calc, fast_math);
+
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    Py_BEGIN_ALLOW_THREADS
+    n = bore_find_resonances(bore, max_freq, step_freq, tol, 1, &res, NULL, &ac, threads, scalar);
+    Py_END_ALLOW_THREADS
+
+    dims[0] = n;
+    for (k = 0; k < 4; k++) {
+        arrays[k] = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    }
+    result_tuple = PyTuple_New(4);
+    if (!arrays[0] || !arrays[1] || !arrays[2] || !arrays[3] || !result_tuple) {
+        for (k = 0; k < 4; k++) {
+            Py_XDECREF(arrays[k]);
         }
+        Py_XDECREF(result_tuple);
+        free(res);
+        return PyErr_NoMemory();
+    }
+
+    for (k = 0; k < n; k++) {
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[0]))[k] = res[k].frq;
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[1]))[k] = cabs(res[k].z) * S;
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[2]))[k] = res[k].q;
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[3]))[k] = res[k].bandwidth;
+    }
+    free(res);
+
+    for (k = 0; k < 4; k++) {
+        PyTuple_SET_ITEM(result_tuple, k, arrays[k]);
     }
+    return result_tuple;
+}
 
-    /* Build list of tuples (df, db, r, comment) */
+/* Build list of tuples (df, db, r, comment) of the main bore */
+static PyObject* mensur_to_list(mensur* mensur_data) {
     PyObject *result_list = PyList_New(0);
     if (result_list == NULL) {
         return NULL;
@@ -195,6 +483,78 @@ static PyObject* py_print_men(PyObject* self, PyObject* args) {
     return result_list;
 }
 
+/* List of (df, db, r, branch) in mm per cell of a compiled bore */
+static PyObject* bore_cell_list(const bore* b) {
+    PyObject *list, *item;
+    int i, br;
+
+    list = PyList_New(b->n_cell);
+    for (br = 0; list != NULL && br < b->n_branch; br++) {
+        for (i = b->first[br]; i <= b->last[br]; i++) {
+            item = Py_BuildValue("(dddi)", b->df[i] * 1000.0, b->db[i] * 1000.0,
+                                 b->r[i] * 1000.0, br);
+            if (item == NULL) {
+                Py_CLEAR(list);
+                break;
+            }
+            PyList_SET_ITEM(list, i, item);
+        }
+    }
+
+    return list;
+}
+
+static PyObject* py_print_men(PyObject* self, PyObject* args) {
+    const char* filename;
+    mensur *mensur_data;
+    PyObject *cells;
+
+    if (!PyArg_ParseTuple(args, "s", &filename)) {
+        return NULL;
+    }
+
+    mensur_data = load_mensur(filename);
+    if (mensur_data == NULL) {
+        return NULL;
+    }
+
+    cells = mensur_to_list(mensur_data);
+    dispose_men_tree(mensur_data);
+    return cells;
+}
+
+static PyObject* py_simplify_men(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double tolerance = 0.0;
+    int removed;
+    mensur *mensur_data;
+    PyObject *cells;
+    static char* kwlist[] = {"filename", "tolerance", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|d", kwlist, &filename, &tolerance)) {
+        return NULL;
+    }
+    if (tolerance < 0) {
+        PyErr_SetString(PyExc_ValueError, "tolerance must not be negative");
+        return NULL;
+    }
+
+    mensur_data = load_mensur(filename);
+    if (mensur_data == NULL) {
+        return NULL;
+    }
+
+    removed = simplify_men(mensur_data, tolerance * 0.001);
+
+    cells = mensur_to_list(mensur_data);
+    dispose_men_tree(mensur_data);
+    if (cells == NULL) {
+        return NULL;
+    }
+
+    return Py_BuildValue("(iN)", removed, cells);
+}
+
 static PyObject* py_calcimp(PyObject* self, PyObject* args, PyObject* kwargs) {
     const char* filename;
     double max_freq = 2000.0;
@@ -204,66 +564,2418 @@ static PyObject* py_calcimp(PyObject* self, PyObject* args, PyObject* kwargs) {
     int rad_calc = PIPE;
     int dump_calc_bool = 1;  /* True by default */
     int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
     int dump_calc;
+    bore *bore;
+    PyObject *result_tuple;
     static char* kwlist[] = {"filename", "max_freq", "step_freq", "num_freq", "temperature",
-                            "rad_calc", "dump_calc", "sec_var_calc", NULL};
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", "simplify", NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddkdipp", kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddkdippippd", kwlist,
                                     &filename, &max_freq, &step_freq, &num_freq, &temperature,
-                                    &rad_calc, &dump_calc_bool, &sec_var_calc)) {
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &scalar, &fast_math, &simplify)) {
         return NULL;
     }
 
     /* Convert boolean dump_calc to WALL/NONE */
     dump_calc = dump_calc_bool ? WALL : NONE;
 
-    return calculate_impedance(filename, max_freq, step_freq, num_freq, temperature,
-                               rad_calc, dump_calc, sec_var_calc);
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    result_tuple = calculate_impedance(bore, max_freq, step_freq, num_freq, temperature,
+                                       rad_calc, dump_calc, sec_var_calc, threads, scalar, fast_math);
+    dispose_bore(bore);
+    return result_tuple;
 }
 
-static PyMethodDef CalcimpMethods[] = {
-    {"calcimp", (PyCFunction)py_calcimp, METH_VARARGS | METH_KEYWORDS,
-     "Calculate input impedance of a tube.\n\n"
-     "Parameters:\n"
-     "    filename (str): Path to the mensur file\n"
-     "    max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)\n"
-     "    step_freq (float, optional): Frequency step in Hz (default: 2.5)\n"
-     "    num_freq (int, optional): Number of frequency points (overrides step_freq if > 0)\n"
-     "    temperature (float, optional): Temperature in Celsius (default: 24.0)\n"
-     "    rad_calc (int, optional): Radiation impedance mode - PIPE, BUFFLE, or NONE (default: PIPE)\n"
-     "    dump_calc (bool, optional): Enable wall damping calculation (default: True)\n"
-     "    sec_var_calc (bool, optional): Enable section variation calculation (default: False)\n\n"
-     "Returns:\n"
-     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db)"},
-    {"print_men", py_print_men, METH_VARARGS,
-     "Read and return mensur structure.\n\n"
-     "Parameters:\n"
-     "    filename (str): Path to the mensur file (.men or .xmen)\n\n"
-     "Returns:\n"
-     "    list: List of tuples (df, db, r, comment) where df, db, r are in mm"},
-    {NULL, NULL, 0, NULL}
-};
+/*
+ * One file of calcimp_many().  A worker reads, compiles and sweeps the file
+ * on its own; the parsers keep their state per thread and the file cache
+ * is bypassed, so no Python state is touched.
+ */
+typedef struct {
+    const char *path;
+    double complex *imp;    /* impedance density, NULL on error */
+    const char *error;
+} batch_job;
 
-static struct PyModuleDef calcimpmodule = {
-    PyModuleDef_HEAD_INIT,
-    "_calcimp_c",
-    "Extension module for calculating input impedance of tubes",
-    -1,
-    CalcimpMethods
-};
+typedef struct {
+    double step_freq;
+    int n_imp;
+    int scalar;
+    double simplify;
+    acoustic_constants ac;
+} batch_params;
 
-PyMODINIT_FUNC PyInit__calcimp_c(void) {
-    PyObject *m;
+static void batch_worker(gpointer data, gpointer user_data) {
+    batch_job *job = data;
+    const batch_params *bp = user_data;
+    mensur *men;
+    bore *bore;
+    double S;
+    int i;
 
-    import_array();  /* Initialize numpy */
-    m = PyModule_Create(&calcimpmodule);
-    if (m == NULL)
-        return NULL;
+    men = read_mensur_file(job->path);
+    if (men == NULL) {
+        job->error = "Failed to read mensur file";
+        return;
+    }
+    if (bp->simplify >= 0) {
+        simplify_men(men, bp->simplify * 0.001);
+    }
+    bore = compile_bore(men);
+    dispose_men_tree(men);
+    if (bore == NULL) {
+        job->error = "Failed to compile mensur";
+        return;
+    }
 
-    /* Export constants for radiation calculation modes */
-    PyModule_AddIntConstant(m, "NONE", NONE);
-    PyModule_AddIntConstant(m, "PIPE", PIPE);
-    PyModule_AddIntConstant(m, "BUFFLE", BUFFLE);
+    /* one thread per file, the pool keeps the processors busy */
+    job->imp = m_calloc(bp->n_imp, sizeof(double complex));
+    bore_sweep(bore, bp->step_freq, bp->n_imp, 1, job->imp, &bp->ac, 1, bp->scalar);
+    S = PI * pow(bore->df[0], 2) / 4;
+    for (i = 1; i < bp->n_imp; i++) {
+        job->imp[i] *= S;
+    }
+    dispose_bore(bore);
+}
+
+static PyObject* py_calcimp_many(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *paths, *seq, **names, *result = NULL, *item;
+    double max_freq = 2000.0;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 0;
+    int fast_math = FALSE;
+    batch_params bp = {2.5, 0, FALSE, -1.0};
+    batch_job *jobs;
+    GThreadPool *pool;
+    int n, k;
+    static char* kwlist[] = {"paths", "max_freq", "step_freq", "num_freq", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ddkdippippd", kwlist,
+                                    &paths, &max_freq, &bp.step_freq, &num_freq, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &bp.scalar,
+                                    &fast_math, &bp.simplify)) {
+        return NULL;
+    }
+    seq = PySequence_Fast(paths, "paths must be a sequence of file names");
+    if (seq == NULL) {
+        return NULL;
+    }
+
+    /* file names as bytes, alive until the pool is done */
+    n = PySequence_Fast_GET_SIZE(seq);
+    names = m_calloc(n + 1, sizeof(PyObject*));
+    jobs = m_calloc(n + 1, sizeof(batch_job));
+    for (k = 0; k < n; k++) {
+        if (!PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(seq, k), &names[k])) {
+            goto done;
+        }
+        jobs[k].path = PyBytes_AS_STRING(names[k]);
+    }
+
+    set_constants(&bp.ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    if (num_freq > 0) {
+        bp.step_freq = max_freq / (double)num_freq;
+    }
+    bp.n_imp = max_freq / bp.step_freq + 1;
+
+    /* While one worker parses its file the others sweep theirs */
+    Py_BEGIN_ALLOW_THREADS
+    if (threads <= 0) threads = g_get_num_processors();
+    if (threads > n) threads = n;
+    if (n > 0) {
+        pool = g_thread_pool_new(batch_worker, &bp, threads, TRUE, NULL);
+        for (k = 0; k < n; k++) {
+            g_thread_pool_push(pool, &jobs[k], NULL);
+        }
+        g_thread_pool_free(pool, FALSE, TRUE);
+    }
+    Py_END_ALLOW_THREADS
+
+    /* results in the order of paths, a RuntimeError for each failed file */
+    result = PyList_New(n);
+    for (k = 0; result != NULL && k < n; k++) {
+        if (jobs[k].imp != NULL) {
+            item = impedance_tuple(jobs[k].imp, NULL, bp.n_imp, bp.step_freq);
+        } else {
+            item = PyObject_CallFunction(PyExc_RuntimeError, "N",
+                                         PyUnicode_FromFormat("%s: %s", jobs[k].path, jobs[k].error));
+        }
+        if (item == NULL) {
+            Py_CLEAR(result);
+            break;
+        }
+        PyList_SET_ITEM(result, k, item);
+    }
+
+ done:
+    for (k = 0; k < n; k++) {
+        free(jobs[k].imp);
+        Py_XDECREF(names[k]);
+    }
+    free(jobs);
+    free(names);
+    Py_DECREF(seq);
+    return result;
+}
+
+static PyObject* py_chain_matrix(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double max_freq = 2000.0;
+    double step_freq = 2.5;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    static char* kwlist[] = {"filename", "max_freq", "step_freq", "num_freq", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "fast_math", "simplify", NULL};
+    acoustic_constants ac;
+    bore *bore;
+    double S, bell;
+    double complex *t;
+    double *freq_data;
+    int i, n, last, closed;
+    PyObject *freq_array, *chain_array;
+    npy_intp dims[3];
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddkdippipd", kwlist,
+                                    &filename, &max_freq, &step_freq, &num_freq, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &fast_math, &simplify)) {
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    if (num_freq > 0) {
+        step_freq = max_freq / (double)num_freq;
+    }
+    n = max_freq / step_freq + 1;
+    dims[0] = n;
+    dims[1] = 2;
+    dims[2] = 2;
+
+    freq_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    chain_array = PyArray_SimpleNew(3, dims, NPY_CDOUBLE);
+    if (!freq_array || !chain_array) {
+        Py_XDECREF(freq_array);
+        Py_XDECREF(chain_array);
+        dispose_bore(bore);
+        return PyErr_NoMemory();
+    }
+    freq_data = (double*)PyArray_DATA((PyArrayObject*)freq_array);
+    t = (double complex*)PyArray_DATA((PyArrayObject*)chain_array);
+
+    last = bore->last[0];
+    closed = (bore->kind[last] == BORE_CLOSED_END);
+    bell = closed ? 0.0 : bore->df[last] * 1000;
+
+    /* Scale t11 and t12 like calcimp() scales the impedance */
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    Py_BEGIN_ALLOW_THREADS
+    bore_chain_sweep(bore, step_freq, n, t, &ac, threads);
+    for (i = 0; i < n; i++) {
+        freq_data[i] = i * step_freq;
+        t[4 * i] *= S;
+        t[4 * i + 1] *= S;
+    }
+    Py_END_ALLOW_THREADS
+    dispose_bore(bore);
+
+    return Py_BuildValue("(NNdO)", freq_array, chain_array, bell, closed ? Py_True : Py_False);
+}
+
+static PyObject* py_radiation_impedance(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *freq_obj, *freq_array, *z_array;
+    double diameter;
+    int rad_calc = PIPE;
+    double temperature = 24.0;
+    static char* kwlist[] = {"freq", "diameter", "rad_calc", "temperature", NULL};
+    acoustic_constants ac;
+    double *freq_data;
+    double complex *z;
+    npy_intp i, n;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Od|id", kwlist,
+                                    &freq_obj, &diameter, &rad_calc, &temperature)) {
+        return NULL;
+    }
+    if (diameter <= 0) {
+        PyErr_SetString(PyExc_ValueError, "diameter must be positive");
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 0, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+    z_array = PyArray_SimpleNew(PyArray_NDIM((PyArrayObject*)freq_array),
+                                PyArray_DIMS((PyArrayObject*)freq_array), NPY_CDOUBLE);
+    if (z_array == NULL) {
+        Py_DECREF(freq_array);
+        return NULL;
+    }
+
+    init_acoustic_constants(&ac, temperature);
+    ac.rad_calc = rad_calc;
+
+    n = PyArray_SIZE((PyArrayObject*)freq_array);
+    freq_data = (double*)PyArray_DATA((PyArrayObject*)freq_array);
+    z = (double complex*)PyArray_DATA((PyArrayObject*)z_array);
+    for (i = 0; i < n; i++) {
+        z[i] = 0.0;
+        if (freq_data[i] > 0 && rad_calc != NONE) {
+            rad_imp(freq_data[i], diameter * 0.001, &z[i], &ac);
+        }
+    }
+
+    Py_DECREF(freq_array);
+    return z_array;
+}
+
+/*
+ * Impedance density of a compiled bore at the frequencies of freq_array,
+ * as a complex array of the same shape.  The bore stays with the caller.
+ */
+static PyObject* impedance_array(const bore* bore, PyObject* freq_array,
+                                 const acoustic_constants* ac, int threads) {
+    PyObject *z_array;
+    double complex *z;
+    double S;
+    npy_intp i, n;
+
+    z_array = PyArray_SimpleNew(PyArray_NDIM((PyArrayObject*)freq_array),
+                                PyArray_DIMS((PyArrayObject*)freq_array), NPY_CDOUBLE);
+    if (z_array == NULL) {
+        return NULL;
+    }
+
+    n = PyArray_SIZE((PyArrayObject*)freq_array);
+    z = (double complex*)PyArray_DATA((PyArrayObject*)z_array);
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    Py_BEGIN_ALLOW_THREADS
+    bore_impedance_at(bore, (double*)PyArray_DATA((PyArrayObject*)freq_array), n, z,
+                      ac, threads);
+    for (i = 0; i < n; i++) {
+        z[i] *= S;  /* Convert to acoustic impedance density */
+    }
+    Py_END_ALLOW_THREADS
+
+    return z_array;
+}
+
+static PyObject* py_impedance_at(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    PyObject *freq_obj, *freq_array, *z_array;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 0;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    bore *bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "freq", "temperature", "rad_calc", "dump_calc",
+                            "sec_var_calc", "threads", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|dippipd", kwlist,
+                                    &filename, &freq_obj, &temperature, &rad_calc, &dump_calc_bool,
+                                    &sec_var_calc, &threads, &fast_math, &simplify)) {
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 0, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        Py_DECREF(freq_array);
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    z_array = impedance_array(bore, freq_array, &ac, threads);
+    dispose_bore(bore);
+
+    Py_DECREF(freq_array);
+    return z_array;
+}
+
+/*
+ * Pressure and volume velocity along the main bore of a compiled bore,
+ * the result tuple (x, p, u) of pressure_field().  The bore stays with the
+ * caller.
+ */
+static PyObject* pressure_tuple(const bore* bore, PyObject* freq_array, double complex p0,
+                                const acoustic_constants* ac, int threads) {
+    PyObject *x_array, *p_array, *u_array, *result_tuple;
+    double *x;
+    npy_intp i, n, dims[2];
+    int n_station;
+
+    n = PyArray_SIZE((PyArrayObject*)freq_array);
+    n_station = bore->last[0] - bore->first[0] + 1;
+    dims[0] = n;
+    dims[1] = n_station;
+    x_array = PyArray_SimpleNew(1, &dims[1], NPY_DOUBLE);
+    p_array = PyArray_SimpleNew(2, dims, NPY_CDOUBLE);
+    u_array = PyArray_SimpleNew(2, dims, NPY_CDOUBLE);
+    result_tuple = PyTuple_New(3);
+    if (!x_array || !p_array || !u_array || !result_tuple) {
+        Py_XDECREF(x_array);
+        Py_XDECREF(p_array);
+        Py_XDECREF(u_array);
+        Py_XDECREF(result_tuple);
+        return PyErr_NoMemory();
+    }
+
+    /* position of the inlet of every main bore cell in mm */
+    x = (double*)PyArray_DATA((PyArrayObject*)x_array);
+    x[0] = 0.0;
+    for (i = 1; i < n_station; i++) {
+        x[i] = x[i - 1] + bore->r[bore->first[0] + i - 1] * 1000;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    bore_pressure_sweep(bore, (double*)PyArray_DATA((PyArrayObject*)freq_array), n, p0,
+                        (double complex*)PyArray_DATA((PyArrayObject*)p_array),
+                        (double complex*)PyArray_DATA((PyArrayObject*)u_array), ac, threads);
+    Py_END_ALLOW_THREADS
+
+    PyTuple_SET_ITEM(result_tuple, 0, x_array);
+    PyTuple_SET_ITEM(result_tuple, 1, p_array);
+    PyTuple_SET_ITEM(result_tuple, 2, u_array);
+    return result_tuple;
+}
+
+static PyObject* py_pressure_field(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    PyObject *freq_obj, *freq_array, *result_tuple;
+    Py_complex p0 = {1.0, 0.0};
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int fast_math = FALSE;
+    double step = 0.0;
+    mensur *mensur;
+    bore *bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "freq", "p0", "temperature", "rad_calc", "dump_calc",
+                            "sec_var_calc", "threads", "fast_math", "step", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|Ddippipd", kwlist,
+                                    &filename, &freq_obj, &p0, &temperature, &rad_calc,
+                                    &dump_calc_bool, &sec_var_calc, &threads, &fast_math,
+                                    &step)) {
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+    mensur = load_mensur(filename);
+    if (mensur == NULL) {
+        Py_DECREF(freq_array);
+        return NULL;
+    }
+    /* more stations than cells, step in mm */
+    if (step > 0) {
+        divide_men(mensur, step * 0.001);
+    }
+    bore = finish_bore(mensur, -1.0);
+    dispose_men_tree(mensur);
+    if (bore == NULL) {
+        Py_DECREF(freq_array);
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    result_tuple = pressure_tuple(bore, freq_array, p0.real + p0.imag * I, &ac, threads);
+    dispose_bore(bore);
+    Py_DECREF(freq_array);
+    return result_tuple;
+}
+
+static PyObject* py_calcimp_adaptive(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double max_freq = 2000.0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    spectrum_opt opt = { 10.0, 0.01, 1.0, 0.2, 100000 };
+    double S;
+    double *frq;
+    double complex *imp;
+    int i, n;
+    bore *bore;
+    acoustic_constants ac;
+    PyObject *result_tuple;
+    static char* kwlist[] = {"filename", "max_freq", "step_freq", "min_step", "tol_db", "tol_phase",
+                            "max_points", "temperature", "rad_calc", "dump_calc", "sec_var_calc",
+                            "threads", "scalar", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|dddddidippippd", kwlist,
+                                    &filename, &max_freq, &opt.step, &opt.min_step, &opt.tol_db,
+                                    &opt.tol_phase, &opt.max_points, &temperature, &rad_calc,
+                                    &dump_calc_bool, &sec_var_calc, &threads, &scalar, &fast_math,
+                                    &simplify)) {
+        return NULL;
+    }
+    if (!(opt.step > 0) || !(opt.min_step > 0) || !(max_freq >= 0)) {
+        PyErr_SetString(PyExc_ValueError, "step_freq and min_step must be positive");
+        return NULL;
+    }
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    Py_BEGIN_ALLOW_THREADS
+    n = bore_adaptive_sweep(bore, max_freq, &opt, 1, &frq, &imp, &ac, threads, scalar);
+    for (i = 0; i < n; i++) {
+        imp[i] *= S;  /* Convert to acoustic impedance density */
+    }
+    Py_END_ALLOW_THREADS
+    dispose_bore(bore);
+
+    result_tuple = impedance_tuple(imp, frq, n, 0);
+    free(frq);
+    free(imp);
+
+    return result_tuple;
+}
+
+static PyObject* py_find_resonances(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double max_freq = 2000.0;
+    double step_freq = 10.0;
+    double tol = 1e-3;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    bore *bore;
+    PyObject *result_tuple;
+    static char* kwlist[] = {"filename", "max_freq", "step_freq", "tol", "temperature", "rad_calc",
+                            "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddddippippd", kwlist,
+                                    &filename, &max_freq, &step_freq, &tol, &temperature, &rad_calc,
+                                    &dump_calc_bool, &sec_var_calc, &threads, &scalar, &fast_math,
+                                    &simplify)) {
+        return NULL;
+    }
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    result_tuple = find_resonances(bore, max_freq, step_freq, tol, temperature, rad_calc,
+                                   dump_calc_bool ? WALL : NONE, sec_var_calc, threads, scalar, fast_math);
+    dispose_bore(bore);
+    return result_tuple;
+}
+
+/* ------------------------------ sensitivities ------------------------------ */
+/*
+ * Derivatives by the cells of the compiled bore, in the order of
+ * bore_tree_cells(): the main bore first, then the side branches.
+ */
+
+static PyObject* py_sensitivities(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    PyObject *freq_obj, *freq_array, *z_array, *d_array[3], *result_tuple;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int threads = 1;
+    int fast_math = FALSE;
+    double S, dS;
+    double complex *z, *d[3];
+    npy_intp i, j, k, n, dims[2];
+    int n_cell, status;
+    bore *bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "freq", "temperature", "rad_calc", "dump_calc",
+                            "threads", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sO|dipip", kwlist,
+                                    &filename, &freq_obj, &temperature, &rad_calc, &dump_calc_bool,
+                                    &threads, &fast_math)) {
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+    bore = load_bore(filename, -1.0);
+    if (bore == NULL) {
+        Py_DECREF(freq_array);
+        return NULL;
+    }
+
+    n = PyArray_SIZE((PyArrayObject*)freq_array);
+    n_cell = bore->n_cell;
+    dims[0] = n;
+    dims[1] = n_cell;
+    z_array = PyArray_SimpleNew(1, dims, NPY_CDOUBLE);
+    for (k = 0; k < 3; k++) {
+        d_array[k] = PyArray_SimpleNew(2, dims, NPY_CDOUBLE);
+    }
+    if (!z_array || !d_array[0] || !d_array[1] || !d_array[2]) {
+        Py_XDECREF(z_array);
+        for (k = 0; k < 3; k++) {
+            Py_XDECREF(d_array[k]);
+        }
+        Py_DECREF(freq_array);
+        dispose_bore(bore);
+        return PyErr_NoMemory();
+    }
+
+    /* the adjoint has no section variation terms */
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, FALSE, fast_math);
+
+    z = (double complex*)PyArray_DATA((PyArrayObject*)z_array);
+    for (k = 0; k < 3; k++) {
+        d[k] = (double complex*)PyArray_DATA((PyArrayObject*)d_array[k]);
+    }
+    S = PI * pow(bore->df[0], 2) / 4;
+    dS = PI * bore->df[0] / 2;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = bore_sensitivity_sweep(bore, (double*)PyArray_DATA((PyArrayObject*)freq_array), n,
+                                    1, z, d[0], d[1], d[2], &ac, threads);
+    /* impedance density per mm, S depends on df of the first cell */
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < 3; k++) {
+            for (j = 0; j < n_cell; j++) {
+                d[k][i * n_cell + j] *= S * 0.001;
+            }
+        }
+        d[0][i * n_cell] += z[i] * dS * 0.001;
+        z[i] *= S;
+    }
+    Py_END_ALLOW_THREADS
+    dispose_bore(bore);
+    Py_DECREF(freq_array);
+
+    if (status < 0) {
+        Py_DECREF(z_array);
+        for (k = 0; k < 3; k++) {
+            Py_DECREF(d_array[k]);
+        }
+        PyErr_SetString(PyExc_RuntimeError, "Sensitivity calculation failed");
+        return NULL;
+    }
+
+    result_tuple = PyTuple_New(4);
+    if (!result_tuple) {
+        Py_DECREF(z_array);
+        for (k = 0; k < 3; k++) {
+            Py_DECREF(d_array[k]);
+        }
+        return NULL;
+    }
+    PyTuple_SET_ITEM(result_tuple, 0, z_array);
+    for (k = 0; k < 3; k++) {
+        PyTuple_SET_ITEM(result_tuple, k + 1, d_array[k]);
+    }
+    return result_tuple;
+}
+
+static PyObject* py_resonance_sensitivities(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double max_freq = 2000.0;
+    double step_freq = 10.0;
+    double tol = 1e-3;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int threads = 1;
+    int fast_math = FALSE;
+    resonance *res;
+    double *freq, *d[3];
+    PyObject *freq_array, *d_array[3], *result_tuple;
+    npy_intp i, k, n_peak, dims[2];
+    int status;
+    bore *bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "max_freq", "step_freq", "tol", "temperature",
+                            "rad_calc", "dump_calc", "threads", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddddipip", kwlist,
+                                    &filename, &max_freq, &step_freq, &tol, &temperature,
+                                    &rad_calc, &dump_calc_bool, &threads, &fast_math)) {
+        return NULL;
+    }
+    if (!(step_freq > 0) || !(tol > 0) || !(max_freq >= 0)) {
+        PyErr_SetString(PyExc_ValueError, "step_freq and tol must be positive");
+        return NULL;
+    }
+
+    bore = load_bore(filename, -1.0);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    /* the adjoint has no section variation terms */
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, FALSE, fast_math);
+
+    Py_BEGIN_ALLOW_THREADS
+    n_peak = bore_find_resonances(bore, max_freq, step_freq, tol, 1, &res, NULL, &ac, threads, FALSE);
+    Py_END_ALLOW_THREADS
+
+    dims[0] = n_peak;
+    dims[1] = bore->n_cell;
+    freq_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    for (k = 0; k < 3; k++) {
+        d_array[k] = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    }
+    if (!freq_array || !d_array[0] || !d_array[1] || !d_array[2]) {
+        Py_XDECREF(freq_array);
+        for (k = 0; k < 3; k++) {
+            Py_XDECREF(d_array[k]);
+        }
+        free(res);
+        dispose_bore(bore);
+        return PyErr_NoMemory();
+    }
+
+    freq = (double*)PyArray_DATA((PyArrayObject*)freq_array);
+    for (k = 0; k < 3; k++) {
+        d[k] = (double*)PyArray_DATA((PyArrayObject*)d_array[k]);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    status = bore_resonance_sensitivity(bore, res, n_peak, 1, d[0], d[1], d[2], &ac, threads);
+    for (i = 0; i < n_peak; i++) {
+        freq[i] = res[i].frq;
+    }
+    for (k = 0; k < 3; k++) {
+        for (i = 0; i < n_peak * bore->n_cell; i++) {
+            d[k][i] *= 0.001;   /* Hz per mm */
+        }
+    }
+    Py_END_ALLOW_THREADS
+    free(res);
+    dispose_bore(bore);
+
+    if (status < 0) {
+        Py_DECREF(freq_array);
+        for (k = 0; k < 3; k++) {
+            Py_DECREF(d_array[k]);
+        }
+        PyErr_SetString(PyExc_RuntimeError, "Sensitivity calculation failed");
+        return NULL;
+    }
+
+    result_tuple = PyTuple_New(4);
+    if (!result_tuple) {
+        Py_DECREF(freq_array);
+        for (k = 0; k < 3; k++) {
+            Py_DECREF(d_array[k]);
+        }
+        return NULL;
+    }
+    PyTuple_SET_ITEM(result_tuple, 0, freq_array);
+    for (k = 0; k < 3; k++) {
+        PyTuple_SET_ITEM(result_tuple, k + 1, d_array[k]);
+    }
+    return result_tuple;
+}
+
+/* ------------------------------ optimization ------------------------------ */
+
+static PyObject* py_xmen_variables(PyObject* self, PyObject* args) {
+    const char* filename;
+    xmen_source *src;
+    PyObject *dict, *value;
+    int i;
+
+    if (!PyArg_ParseTuple(args, "s", &filename)) {
+        return NULL;
+    }
+
+    src = load_xmen_source(filename);
+    if (src == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to read XMENSUR file");
+        return NULL;
+    }
+
+    dict = PyDict_New();
+    for (i = 0; dict != NULL && i < src->n_var; i++) {
+        value = PyFloat_FromDouble(src->values[i]);
+        if (value == NULL || PyDict_SetItemString(dict, src->names[i], value) < 0) {
+            Py_XDECREF(value);
+            Py_CLEAR(dict);
+            break;
+        }
+        Py_DECREF(value);
+    }
+    dispose_xmen_source(src);
+    return dict;
+}
+
+static PyObject* py_optimize(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    PyObject *names_obj, *x_obj, *lo_obj, *hi_obj, *targets_obj;
+    PyObject *names_seq = NULL, *x_array = NULL, *lo_array = NULL, *hi_array = NULL;
+    PyObject *targets_array = NULL, *resid_array = NULL, *result = NULL;
+    double max_freq = 2000.0;
+    double step_freq = 10.0;
+    double tol = 1e-4;
+    int max_iter = 50;
+    double ftol = 1e-10;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int fast_math = FALSE;
+    const char **names = NULL;
+    const double *row;
+    opt_target *t = NULL;
+    opt_settings settings;
+    opt_result res;
+    xmen_source *src = NULL;
+    acoustic_constants ac;
+    npy_intp i, n_var, n_target, dims[1];
+    int status;
+    static char* kwlist[] = {"filename", "names", "x0", "lower", "upper", "targets", "max_freq",
+                            "step_freq", "tol", "max_iter", "ftol", "temperature", "rad_calc",
+                            "dump_calc", "sec_var_calc", "threads", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sOOOOO|dddiddippip", kwlist,
+                                    &filename, &names_obj, &x_obj, &lo_obj, &hi_obj, &targets_obj,
+                                    &max_freq, &step_freq, &tol, &max_iter, &ftol, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &fast_math)) {
+        return NULL;
+    }
+
+    names_seq = PySequence_Fast(names_obj, "names must be a sequence of str");
+    if (names_seq == NULL) {
+        return NULL;
+    }
+    n_var = PySequence_Fast_GET_SIZE(names_seq);
+    x_array = PyArray_FROMANY(x_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_ENSURECOPY | NPY_ARRAY_IN_ARRAY);
+    lo_array = PyArray_FROMANY(lo_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    hi_array = PyArray_FROMANY(hi_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    targets_array = PyArray_FROMANY(targets_obj, NPY_DOUBLE, 2, 2, NPY_ARRAY_IN_ARRAY);
+    if (!x_array || !lo_array || !hi_array || !targets_array) {
+        goto done;
+    }
+    if (PyArray_SIZE((PyArrayObject*)x_array) != n_var ||
+        PyArray_SIZE((PyArrayObject*)lo_array) != n_var ||
+        PyArray_SIZE((PyArrayObject*)hi_array) != n_var ||
+        PyArray_DIM((PyArrayObject*)targets_array, 1) != 5) {
+        PyErr_SetString(PyExc_ValueError,
+                        "x0, lower and upper need one value per name, targets 5 columns");
+        goto done;
+    }
+
+    names = PyMem_Calloc(n_var + 1, sizeof(char*));
+    if (names == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    for (i = 0; i < n_var; i++) {
+        names[i] = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(names_seq, i));
+        if (names[i] == NULL) {
+            goto done;
+        }
+    }
+    n_target = PyArray_DIM((PyArrayObject*)targets_array, 0);
+    t = PyMem_Calloc(n_target + 1, sizeof(opt_target));
+    if (t == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    row = (const double*)PyArray_DATA((PyArrayObject*)targets_array);
+    for (i = 0; i < n_target; i++) {
+        t[i].kind = (row[5 * i] != 0) ? OPT_RATIO : OPT_FREQ;
+        t[i].frq = row[5 * i + 1];
+        t[i].frq2 = row[5 * i + 2];
+        t[i].value = row[5 * i + 3];
+        t[i].weight = row[5 * i + 4];
+    }
+
+    src = load_xmen_source(filename);
+    if (src == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to read XMENSUR file");
+        goto done;
+    }
+    for (i = 0; i < n_var; i++) {
+        if (xmen_source_var(src, names[i]) < 0) {
+            PyErr_Format(PyExc_ValueError, "Variable '%s' is not defined in %s", names[i], filename);
+            goto done;
+        }
+    }
+
+    dims[0] = n_target;
+    resid_array = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    if (resid_array == NULL) {
+        goto done;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+    settings.max_freq = max_freq;
+    settings.step = step_freq;
+    settings.tol = tol;
+    settings.max_iter = max_iter;
+    settings.ftol = ftol;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = bore_optimize(src, n_var, names, (double*)PyArray_DATA((PyArrayObject*)x_array),
+                           (const double*)PyArray_DATA((PyArrayObject*)lo_array),
+                           (const double*)PyArray_DATA((PyArrayObject*)hi_array),
+                           n_target, t, &settings,
+                           (double*)PyArray_DATA((PyArrayObject*)resid_array), &res, &ac, threads);
+    Py_END_ALLOW_THREADS
+
+    if (status < 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "Optimization failed: bad targets or settings, or no resonance at the start");
+        goto done;
+    }
+
+    result = Py_BuildValue("(OOdiiO)", x_array, resid_array, res.cost, res.n_iter, res.n_eval,
+                           res.converged ? Py_True : Py_False);
+
+done:
+    dispose_xmen_source(src);
+    PyMem_Free(names);
+    PyMem_Free(t);
+    Py_DECREF(names_seq);
+    Py_XDECREF(x_array);
+    Py_XDECREF(lo_array);
+    Py_XDECREF(hi_array);
+    Py_XDECREF(targets_array);
+    Py_XDECREF(resid_array);
+    return result;
+}
+
+/* --------------------------- time-domain responses -------------------------- */
+
+static PyObject* py_reflectance(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double rate = 44100.0;
+    double duration = 0.1;
+    double max_freq = -1.0;
+    int window = WINDOW_HANN;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    int k, n_time, n_freq, status;
+    double S, *r, *h;
+    double complex *z, *refl;
+    npy_intp dims[1];
+    PyObject *arrays[5], *result_tuple;
+    response_opt opt;
+    bore *bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "sample_rate", "duration", "max_freq", "window",
+                            "temperature", "rad_calc", "dump_calc", "sec_var_calc", "threads",
+                            "scalar", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|dddidippippd", kwlist,
+                                    &filename, &rate, &duration, &max_freq, &window,
+                                    &temperature, &rad_calc, &dump_calc_bool, &sec_var_calc,
+                                    &threads, &scalar, &fast_math, &simplify)) {
+        return NULL;
+    }
+
+    opt.rate = rate;
+    opt.duration = duration;
+    opt.max_freq = (max_freq > 0) ? max_freq : rate / 2;
+    opt.window = window;
+    if (bore_response_size(&opt, &n_time, &n_freq) < 0) {
+        PyErr_SetString(PyExc_ValueError,
+                        "sample_rate, duration and max_freq must be positive and window 0, 1 or 2");
+        return NULL;
+    }
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    z = (double complex*)calloc(n_freq, sizeof(double complex));
+    dims[0] = n_freq;
+    arrays[0] = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    arrays[1] = PyArray_SimpleNew(1, dims, NPY_CDOUBLE);
+    dims[0] = n_time;
+    for (k = 2; k < 5; k++) {
+        arrays[k] = PyArray_SimpleNew(1, dims, NPY_DOUBLE);
+    }
+    result_tuple = PyTuple_New(5);
+    if (!z || !arrays[0] || !arrays[1] || !arrays[2] || !arrays[3] || !arrays[4] || !result_tuple) {
+        for (k = 0; k < 5; k++) {
+            Py_XDECREF(arrays[k]);
+        }
+        Py_XDECREF(result_tuple);
+        free(z);
+        dispose_bore(bore);
+        return PyErr_NoMemory();
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    for (k = 0; k < n_freq; k++) {
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[0]))[k] = k * rate / n_time;
+    }
+    for (k = 0; k < n_time; k++) {
+        ((double*)PyArray_DATA((PyArrayObject*)arrays[2]))[k] = k / rate;
+    }
+    refl = (double complex*)PyArray_DATA((PyArrayObject*)arrays[1]);
+    r = (double*)PyArray_DATA((PyArrayObject*)arrays[3]);
+    h = (double*)PyArray_DATA((PyArrayObject*)arrays[4]);
+    S = PI * pow(bore->df[0], 2) / 4;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = bore_response(bore, &opt, 1, z, refl, r, h, &ac, threads, scalar);
+    for (k = 0; k < n_time; k++) {
+        h[k] *= S;  /* impulse response of the impedance density */
+    }
+    Py_END_ALLOW_THREADS
+    dispose_bore(bore);
+    free(z);
+
+    if (status < 0) {
+        for (k = 0; k < 5; k++) {
+            Py_DECREF(arrays[k]);
+        }
+        Py_DECREF(result_tuple);
+        PyErr_SetString(PyExc_RuntimeError, "Response calculation failed");
+        return NULL;
+    }
+
+    for (k = 0; k < 5; k++) {
+        PyTuple_SET_ITEM(result_tuple, k, arrays[k]);
+    }
+    return result_tuple;
+}
+
+/* ------------------------------ instrument ------------------------------ */
+/*
+ * An instrument is a mensur read without rejointing, kept in a capsule.
+ * Every evaluation copies it, applies the branch states, rejoints and
+ * compiles the copy, so the file is parsed only once.
+ */
+
+#define INSTRUMENT_CAPSULE "calcimp.instrument"
+
+static void instrument_destructor(PyObject* capsule) {
+    mensur *men = PyCapsule_GetPointer(capsule, INSTRUMENT_CAPSULE);
+    dispose_men_tree(men);
+}
+
+static PyObject* py_load_instrument(PyObject* self, PyObject* args) {
+    const char* filename;
+    mensur *men;
+
+    if (!PyArg_ParseTuple(args, "s", &filename)) {
+        return NULL;
+    }
+
+    men = read_mensur_file_nojoint(filename);
+    if (men == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to read mensur file");
+        return NULL;
+    }
+
+    return PyCapsule_New(men, INSTRUMENT_CAPSULE, instrument_destructor);
+}
+
+/* the same for a mensur text in memory, format "xmen" or "men" */
+static PyObject* py_load_instrument_text(PyObject* self, PyObject* args) {
+    const char *text, *format;
+    Py_ssize_t len;
+    mensur *men;
+
+    if (!PyArg_ParseTuple(args, "s#s", &text, &len, &format)) {
+        return NULL;
+    }
+
+    men = read_mensur_text(text, len, format, TRUE);
+    if (men == NULL) {
+        return NULL;
+    }
+
+    return PyCapsule_New(men, INSTRUMENT_CAPSULE, instrument_destructor);
+}
+
+static PyObject* py_instrument_branches(PyObject* self, PyObject* args) {
+    PyObject *capsule, *list, *item;
+    mensur *men, *p;
+    GPtrArray *points;
+    guint i;
+
+    if (!PyArg_ParseTuple(args, "O", &capsule)) {
+        return NULL;
+    }
+    men = PyCapsule_GetPointer(capsule, INSTRUMENT_CAPSULE);
+    if (men == NULL) {
+        return NULL;
+    }
+
+    points = get_men_branches(men);
+    list = PyList_New(0);
+    for (i = 0; list != NULL && i < points->len; i++) {
+        p = g_ptr_array_index(points, i);
+        item = Py_BuildValue("(sid)", p->sidename, p->s_type, p->s_ratio);
+        if (item == NULL || PyList_Append(list, item) < 0) {
+            Py_XDECREF(item);
+            Py_CLEAR(list);
+            break;
+        }
+        Py_DECREF(item);
+    }
+    g_ptr_array_free(points, TRUE);
+
+    return list;
+}
+
+/*
+ * Copy the instrument and apply states, a dict of sidename -> ratio.
+ * Returns the rejointed copy, or NULL with a Python exception set.
+ */
+static mensur* instrument_state(mensur* men, PyObject* states) {
+    PyObject *key, *value;
+    Py_ssize_t pos = 0;
+    const char *name;
+    double ratio;
+    mensur *copy;
+
+    if (states != NULL && states != Py_None && !PyDict_Check(states)) {
+        PyErr_SetString(PyExc_TypeError, "states must be a dict of branch name to ratio");
+        return NULL;
+    }
+
+    copy = copy_men(men);
+    while (states != NULL && states != Py_None && PyDict_Next(states, &pos, &key, &value)) {
+        name = PyUnicode_AsUTF8(key);
+        ratio = PyFloat_AsDouble(value);
+        if (name == NULL || (ratio == -1.0 && PyErr_Occurred())) {
+            dispose_men_tree(copy);
+            return NULL;
+        }
+        if (ratio < 0 || ratio > 1) {
+            PyErr_Format(PyExc_ValueError, "ratio of \"%s\" must be within 0 and 1", name);
+            dispose_men_tree(copy);
+            return NULL;
+        }
+        if (set_men_ratio(copy, name, ratio) == 0) {
+            PyErr_Format(PyExc_KeyError, "no branch point \"%s\"", name);
+            dispose_men_tree(copy);
+            return NULL;
+        }
+    }
+
+    /* valve分岐をs_ratioに応じて繋ぎ直す */
+    return rejoint_men(copy);
+}
+
+static PyObject* py_instrument_calcimp(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *capsule, *states = Py_None;
+    double max_freq = 2000.0;
+    double step_freq = 2.5;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    mensur *men, *copy;
+    bore *bore;
+    PyObject *result_tuple;
+    static char* kwlist[] = {"instrument", "states", "max_freq", "step_freq", "num_freq", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oddkdippippd", kwlist,
+                                    &capsule, &states, &max_freq, &step_freq, &num_freq, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &scalar, &fast_math, &simplify)) {
+        return NULL;
+    }
+    men = PyCapsule_GetPointer(capsule, INSTRUMENT_CAPSULE);
+    if (men == NULL) {
+        return NULL;
+    }
+
+    copy = instrument_state(men, states);
+    if (copy == NULL) {
+        return NULL;
+    }
+    bore = finish_bore(copy, simplify);
+    dispose_men_tree(copy);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    result_tuple = calculate_impedance(bore, max_freq, step_freq, num_freq, temperature,
+                                       rad_calc, dump_calc_bool ? WALL : NONE, sec_var_calc,
+                                       threads, scalar, fast_math);
+    dispose_bore(bore);
+    return result_tuple;
+}
+
+static PyObject* py_instrument_resonances(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *capsule, *states = Py_None;
+    double max_freq = 2000.0;
+    double step_freq = 10.0;
+    double tol = 1e-3;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    mensur *men, *copy;
+    bore *bore;
+    PyObject *result_tuple;
+    static char* kwlist[] = {"instrument", "states", "max_freq", "step_freq", "tol", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math",
+                            "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Oddddippippd", kwlist,
+                                    &capsule, &states, &max_freq, &step_freq, &tol, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &scalar,
+                                    &fast_math, &simplify)) {
+        return NULL;
+    }
+    men = PyCapsule_GetPointer(capsule, INSTRUMENT_CAPSULE);
+    if (men == NULL) {
+        return NULL;
+    }
+
+    copy = instrument_state(men, states);
+    if (copy == NULL) {
+        return NULL;
+    }
+    bore = finish_bore(copy, simplify);
+    dispose_men_tree(copy);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    result_tuple = find_resonances(bore, max_freq, step_freq, tol, temperature, rad_calc,
+                                   dump_calc_bool ? WALL : NONE, sec_var_calc, threads, scalar, fast_math);
+    dispose_bore(bore);
+    return result_tuple;
+}
+
+/*
+ * Sweep the bores of several states together.  Bores with the same layout
+ * are evaluated in one bore_states_sweep(), which shares all matrices and
+ * the part of the bore behind the first differing branch point.
+ * Writes the impedance density of bores[k] to imp[k * n_imp + i].
+ */
+static int sweep_fingerings(bore** bores, int n_state, double step_freq, int n_imp,
+                            double complex* imp, const acoustic_constants* ac, int threads) {
+    double complex *z;
+    double *states, S;
+    int *idx, k, j, m, i, n_cell, status = 0;
+    unsigned char *done;
+
+    idx = m_malloc(n_state * sizeof(int));
+    done = m_calloc(n_state, 1);
+    for (k = 0; k < n_state && status == 0; k++) {
+        if (done[k]) {
+            continue;
+        }
+        m = 0;
+        for (j = k; j < n_state; j++) {
+            if (!done[j] && bore_same_layout(bores[k], bores[j])) {
+                idx[m++] = j;
+                done[j] = 1;
+            }
+        }
+
+        n_cell = bores[k]->n_cell;
+        states = m_malloc(m * n_cell * sizeof(double));
+        for (j = 0; j < m; j++) {
+            memcpy(&states[j * n_cell], bores[idx[j]]->s_ratio, n_cell * sizeof(double));
+        }
+        z = m_calloc(m * n_imp, sizeof(double complex));
+
+        status = bore_states_sweep(bores[k], m, states, step_freq, n_imp, 1, z, ac, threads);
+
+        S = PI * pow(bores[k]->df[0], 2) / 4;
+        for (j = 0; j < m; j++) {
+            for (i = 0; i < n_imp; i++) {
+                imp[idx[j] * n_imp + i] = z[j * n_imp + i] * S;
+            }
+        }
+        free(z);
+        free(states);
+    }
+    free(done);
+    free(idx);
+
+    return status;
+}
+
+static PyObject* py_instrument_fingerings(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *capsule, *fingerings, *seq;
+    double max_freq = 2000.0;
+    double step_freq = 2.5;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    mensur *men, *copy;
+    bore **bores;
+    double complex *imp;
+    int n_state, n_imp, k, i, status;
+    double mag;
+    PyObject *freq_array, *real_array, *imag_array, *mag_array;
+    npy_intp dims[2];
+    acoustic_constants ac;
+    static char* kwlist[] = {"instrument", "fingerings", "max_freq", "step_freq", "num_freq", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "threads", "fast_math", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|ddkdippipd", kwlist,
+                                    &capsule, &fingerings, &max_freq, &step_freq, &num_freq, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &threads, &fast_math, &simplify)) {
+        return NULL;
+    }
+    men = PyCapsule_GetPointer(capsule, INSTRUMENT_CAPSULE);
+    if (men == NULL) {
+        return NULL;
+    }
+    seq = PySequence_Fast(fingerings, "fingerings must be a sequence of dicts");
+    if (seq == NULL) {
+        return NULL;
+    }
+
+    /* one compiled bore per fingering, parsing is done already */
+    n_state = PySequence_Fast_GET_SIZE(seq);
+    bores = m_calloc(n_state + 1, sizeof(bore*));
+    for (k = 0; k < n_state; k++) {
+        copy = instrument_state(men, PySequence_Fast_GET_ITEM(seq, k));
+        if (copy == NULL) {
+            break;
+        }
+        bores[k] = finish_bore(copy, simplify);
+        dispose_men_tree(copy);
+        if (bores[k] == NULL) {
+            break;
+        }
+    }
+    Py_DECREF(seq);
+    if (k < n_state) {
+        for (k = 0; k < n_state; k++) {
+            dispose_bore(bores[k]);
+        }
+        free(bores);
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    if (num_freq > 0) {
+        step_freq = max_freq / (double)num_freq;
+    }
+    n_imp = max_freq / step_freq + 1;
+
+    imp = (double complex*)calloc((size_t)n_state * n_imp + 1, sizeof(double complex));
+    if (imp == NULL) {
+        for (k = 0; k < n_state; k++) {
+            dispose_bore(bores[k]);
+        }
+        free(bores);
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    status = sweep_fingerings(bores, n_state, step_freq, n_imp, imp, &ac, threads);
+    Py_END_ALLOW_THREADS
+    for (k = 0; k < n_state; k++) {
+        dispose_bore(bores[k]);
+    }
+    free(bores);
+    if (status != 0) {
+        free(imp);
+        PyErr_SetString(PyExc_RuntimeError, "Failed to evaluate fingerings");
+        return NULL;
+    }
+
+    dims[0] = n_state;
+    dims[1] = n_imp;
+    freq_array = PyArray_SimpleNew(1, &dims[1], NPY_DOUBLE);
+    real_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    imag_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+    mag_array = PyArray_SimpleNew(2, dims, NPY_DOUBLE);
+
+    if (!freq_array || !real_array || !imag_array || !mag_array) {
+        Py_XDECREF(freq_array);
+        Py_XDECREF(real_array);
+        Py_XDECREF(imag_array);
+        Py_XDECREF(mag_array);
+        free(imp);
+        return PyErr_NoMemory();
+    }
+
+    double *freq_data = (double*)PyArray_DATA((PyArrayObject*)freq_array);
+    double *real_data = (double*)PyArray_DATA((PyArrayObject*)real_array);
+    double *imag_data = (double*)PyArray_DATA((PyArrayObject*)imag_array);
+    double *mag_data = (double*)PyArray_DATA((PyArrayObject*)mag_array);
+
+    for (i = 0; i < n_imp; i++) {
+        freq_data[i] = i * step_freq;
+    }
+    for (i = 0; i < n_state * n_imp; i++) {
+        real_data[i] = creal(imp[i]);
+        imag_data[i] = cimag(imp[i]);
+        mag = real_data[i] * real_data[i] + imag_data[i] * imag_data[i];
+        mag_data[i] = (mag > 0) ? 10 * log10(mag) : mag;
+    }
+    free(imp);
+
+    return Py_BuildValue("(NNNN)", freq_array, real_array, imag_array, mag_array);
+}
+
+/* ------------------------------ incremental bore ------------------------------ */
+/*
+ * A compiled bore with its per-frequency tree of chain matrices (see
+ * create_bore_tree()) kept in a capsule, so that optimizers can edit a few
+ * cells and sweep again without reading the file or walking every cell.
+ * The sweep runs without the GIL and edits the tree, so every access takes
+ * the lock of the handle; it is taken with the GIL released so that a sweep
+ * in progress never waits for the GIL held by a blocked caller.
+ */
+
+#define BORE_TREE_CAPSULE "calcimp.bore_tree"
+
+typedef struct {
+    bore_tree *bt;
+    GMutex lock;
+} bore_tree_handle;
+
+static void bore_tree_destructor(PyObject* capsule) {
+    bore_tree_handle *h = PyCapsule_GetPointer(capsule, BORE_TREE_CAPSULE);
+    dispose_bore_tree(h->bt);
+    g_mutex_clear(&h->lock);
+    free(h);
+}
+
+static bore_tree_handle* lock_bore_tree(PyObject* capsule) {
+    bore_tree_handle *h = PyCapsule_GetPointer(capsule, BORE_TREE_CAPSULE);
+    if (h == NULL) {
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&h->lock);
+    Py_END_ALLOW_THREADS
+    return h;
+}
+
+static PyObject* py_load_bore_tree(PyObject* self, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double max_freq = 2000.0;
+    double step_freq = 2.5;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int fast_math = FALSE;
+    double simplify = -1.0;
+    int block = 0;
+    bore *bore;
+    bore_tree_handle *h;
+    acoustic_constants ac;
+    static char* kwlist[] = {"filename", "max_freq", "step_freq", "num_freq", "temperature",
+                            "rad_calc", "dump_calc", "sec_var_calc", "fast_math", "simplify", "block", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|ddkdipppdi", kwlist,
+                                    &filename, &max_freq, &step_freq, &num_freq, &temperature,
+                                    &rad_calc, &dump_calc_bool, &sec_var_calc, &fast_math, &simplify, &block)) {
+        return NULL;
+    }
+
+    bore = load_bore(filename, simplify);
+    if (bore == NULL) {
+        return NULL;
+    }
+
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    if (num_freq > 0) {
+        step_freq = max_freq / (double)num_freq;
+    }
+
+    h = m_malloc(sizeof(bore_tree_handle));
+    h->bt = create_bore_tree(bore, step_freq, max_freq / step_freq + 1, &ac, block);
+    g_mutex_init(&h->lock);
+    return PyCapsule_New(h, BORE_TREE_CAPSULE, bore_tree_destructor);
+}
+
+static PyObject* py_bore_tree_cells(PyObject* self, PyObject* args) {
+    PyObject *capsule, *cells;
+    bore_tree_handle *h;
+
+    if (!PyArg_ParseTuple(args, "O", &capsule)) {
+        return NULL;
+    }
+    h = lock_bore_tree(capsule);
+    if (h == NULL) {
+        return NULL;
+    }
+
+    cells = bore_cell_list(h->bt->b);
+    g_mutex_unlock(&h->lock);
+    return cells;
+}
+
+static PyObject* py_bore_tree_set_cell(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *capsule;
+    bore_tree_handle *h;
+    bore_tree *bt;
+    int index;
+    double df = NAN, db = NAN, r = NAN;
+    static char* kwlist[] = {"tree", "index", "df", "db", "r", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|ddd", kwlist,
+                                    &capsule, &index, &df, &db, &r)) {
+        return NULL;
+    }
+    h = lock_bore_tree(capsule);
+    if (h == NULL) {
+        return NULL;
+    }
+    bt = h->bt;
+    if (index < 0 || index >= bt->b->n_cell) {
+        g_mutex_unlock(&h->lock);
+        PyErr_Format(PyExc_IndexError, "cell index %d out of range", index);
+        return NULL;
+    }
+
+    /* NaN keeps the current value, the bore stores meters */
+    df = isnan(df) ? bt->b->df[index] : df / 1000.0;
+    db = isnan(db) ? bt->b->db[index] : db / 1000.0;
+    r = isnan(r) ? bt->b->r[index] : r / 1000.0;
+    if (df < 0 || db < 0 || r < 0) {
+        g_mutex_unlock(&h->lock);
+        PyErr_SetString(PyExc_ValueError, "diameters and length must not be negative");
+        return NULL;
+    }
+
+    bore_tree_set_cell(bt, index, df, db, r);
+    g_mutex_unlock(&h->lock);
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_bore_tree_calcimp(PyObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *capsule, *result_tuple;
+    bore_tree_handle *h;
+    bore_tree *bt;
+    double complex *imp;
+    double S;
+    int i, threads = 1;
+    static char* kwlist[] = {"tree", "threads", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", kwlist, &capsule, &threads)) {
+        return NULL;
+    }
+    h = PyCapsule_GetPointer(capsule, BORE_TREE_CAPSULE);
+    if (h == NULL) {
+        return NULL;
+    }
+    bt = h->bt;
+
+    /* n_freq and step are fixed when the tree is made */
+    imp = (double complex*)calloc(bt->n_freq, sizeof(double complex));
+    if (imp == NULL) {
+        return PyErr_NoMemory();
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    g_mutex_lock(&h->lock);
+    S = PI * pow(bt->b->df[0], 2) / 4;
+    bore_tree_impedance(bt, imp, threads);
+    g_mutex_unlock(&h->lock);
+    for (i = 1; i < bt->n_freq; i++) {
+        imp[i] *= S;  /* Convert to acoustic impedance density */
+    }
+    Py_END_ALLOW_THREADS
+
+    result_tuple = impedance_tuple(imp, NULL, bt->n_freq, bt->step);
+    free(imp);
+
+    return result_tuple;
+}
+
+/* ------------------------------ Mensur type ------------------------------ */
+/*
+ * A parsed and compiled mensur held by Python.  Every evaluation runs on
+ * the compiled bore, which is read only and shared by the threads of a
+ * sweep; the cells are kept for pressure() with extra stations.
+ */
+
+typedef struct {
+    PyObject_HEAD
+    mensur *men;    /* rejointed cells */
+    bore *bore;     /* compiled from men */
+} MensurObject;
+
+/* Compile men, optionally simplified, into a new Mensur; takes ownership of men */
+static PyObject* new_mensur_object(PyTypeObject* type, mensur* men, double simplify) {
+    MensurObject *self;
+    bore *bore;
+
+    bore = finish_bore(men, simplify);
+    if (bore == NULL) {
+        dispose_men_tree(men);
+        return NULL;
+    }
+
+    self = (MensurObject*)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        dispose_bore(bore);
+        dispose_men_tree(men);
+        return NULL;
+    }
+    self->men = men;
+    self->bore = bore;
+    return (PyObject*)self;
+}
+
+static PyObject* Mensur_new(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    const char* filename;
+    double simplify = -1.0;
+    mensur *men;
+    static char* kwlist[] = {"filename", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|d", kwlist, &filename, &simplify)) {
+        return NULL;
+    }
+
+    men = load_mensur(filename);
+    if (men == NULL) {
+        return NULL;
+    }
+    return new_mensur_object(type, men, simplify);
+}
+
+static void Mensur_dealloc(MensurObject* self) {
+    dispose_bore(self->bore);
+    dispose_men_tree(self->men);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject* Mensur_from_text(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    const char *text, *format = "xmen";
+    Py_ssize_t len;
+    double simplify = -1.0;
+    mensur *men;
+    static char* kwlist[] = {"text", "format", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|sd", kwlist, &text, &len, &format,
+                                    &simplify)) {
+        return NULL;
+    }
+
+    men = read_mensur_text(text, len, format, FALSE);
+    if (men == NULL) {
+        return NULL;
+    }
+    return new_mensur_object(type, men, simplify);
+}
+
+/*
+ * Index of the first cell of n that is not a tube, -1 if all are: every
+ * value must be finite, the diameters of the cells before the end
+ * positive and their lengths not negative.  The end keeps r == 0 and
+ * df >= 0, df == 0 being a closed end.
+ */
+static npy_intp bad_column_cell(const double* df, const double* db, const double* r, npy_intp n) {
+    npy_intp i;
+
+    for (i = 0; i < n; i++) {
+        if (!isfinite(df[i]) || !isfinite(db[i]) || !isfinite(r[i])) {
+            return i;
+        }
+        if (i < n - 1 ? !(df[i] > 0 && db[i] > 0 && r[i] >= 0) : !(df[i] >= 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Cells from three columns df, db, r of one branch, in the current arena.
+ * The arrays are read in place when they are contiguous float64 already.
+ * The last cell must be the end (r == 0).  cells, when not NULL, receives
+ * a pointer per cell and belongs to the caller.  branch numbers the
+ * columns in error messages, -1 for the main bore.  Returns NULL with a
+ * Python exception set on error.
+ */
+static mensur* men_from_columns(PyObject* df_obj, PyObject* db_obj, PyObject* r_obj,
+                                double scale, int branch, mensur*** cells, int* n_cell) {
+    PyObject *col[3];
+    const double *df, *db, *r;
+    mensur *men = NULL;
+    npy_intp n = 0, bad;
+    int k;
+
+    col[0] = PyArray_FROMANY(df_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    col[1] = col[0] ? PyArray_FROMANY(db_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY) : NULL;
+    col[2] = col[1] ? PyArray_FROMANY(r_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY) : NULL;
+    if (col[2] != NULL) {
+        n = PyArray_SIZE((PyArrayObject*)col[0]);
+        df = (const double*)PyArray_DATA((PyArrayObject*)col[0]);
+        db = (const double*)PyArray_DATA((PyArrayObject*)col[1]);
+        r = (const double*)PyArray_DATA((PyArrayObject*)col[2]);
+        if (n < 1 || n > INT_MAX || PyArray_SIZE((PyArrayObject*)col[1]) != n ||
+            PyArray_SIZE((PyArrayObject*)col[2]) != n) {
+            PyErr_SetString(PyExc_ValueError, "df, db and r must have the same nonzero length");
+        } else if (r[n - 1] != 0) {
+            PyErr_SetString(PyExc_ValueError, "the last cell must be the end with r = 0");
+        } else if ((bad = bad_column_cell(df, db, r, n)) >= 0) {
+            /* PyErr_Format() has no %g, the index is what the caller needs */
+            if (branch < 0) {
+                PyErr_Format(PyExc_ValueError,
+                             "cell %zd: values must be finite, diameters positive and r not negative",
+                             (Py_ssize_t)bad);
+            } else {
+                PyErr_Format(PyExc_ValueError,
+                             "branch %d, cell %zd: values must be finite, diameters positive "
+                             "and r not negative", branch, (Py_ssize_t)bad);
+            }
+        } else {
+            if (cells != NULL) {
+                *cells = m_malloc(n * sizeof(mensur*));
+            }
+            men = build_men_arrays(df, db, r, (int)n, scale, cells ? *cells : NULL);
+            if (n_cell != NULL) {
+                *n_cell = (int)n;
+            }
+        }
+    }
+
+    for (k = 0; k < 3; k++) {
+        Py_XDECREF(col[k]);
+    }
+    return men;
+}
+
+/*
+ * Hang the side branches described by branches off the main bore cells;
+ * returns -1 with a Python exception set on error.  Each branch is
+ * (index, kind, ratio, df, db, r[, join]) as for Mensur.from_arrays().
+ */
+static int attach_branches(mensur** cells, int n, PyObject* branches, double scale) {
+    PyObject *seq, *bdf, *bdb, *br;
+    const char *kind;
+    double ratio;
+    int index, join, type, k;
+    mensur *side, *p;
+    char name[16];
+
+    seq = PySequence_Fast(branches, "branches must be a sequence");
+    if (seq == NULL) {
+        return -1;
+    }
+    for (k = 0; k < PySequence_Fast_GET_SIZE(seq); k++) {
+        join = -1;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, k), "isdOOO|i", &index, &kind,
+                              &ratio, &bdf, &bdb, &br, &join)) {
+            break;
+        }
+        if (strcmp(kind, "tonehole") == 0) {
+            type = TONEHOLE;
+        } else if (strcmp(kind, "addon") == 0) {
+            type = ADDON;
+        } else if (strcmp(kind, "split") == 0) {
+            type = SPLIT;
+        } else {
+            PyErr_Format(PyExc_ValueError,
+                         "Unknown branch kind '%s', expected 'tonehole', 'addon' or 'split'", kind);
+            break;
+        }
+        /* the end cell carries no branch, one branch per cell */
+        if (index < 0 || index >= n - 1 || cells[index]->side != NULL ||
+            (type == SPLIT && (join <= index || join >= n - 1 || cells[join]->side != NULL))) {
+            PyErr_Format(PyExc_ValueError, "branch %d: bad or taken cell index", k);
+            break;
+        }
+        if (!(ratio >= 0 && ratio <= 1)) {
+            PyErr_Format(PyExc_ValueError, "branch %d: ratio must be within 0 and 1", k);
+            break;
+        }
+
+        side = men_from_columns(bdf, bdb, br, scale, k, NULL, NULL);
+        if (side == NULL) {
+            break;
+        }
+        snprintf(name, sizeof(name), "B%d", k);
+        p = cells[index];
+        p->side = side;
+        p->s_type = type;
+        p->s_ratio = ratio;
+        strcpy(p->sidename, name);
+        if (type == SPLIT) {
+            /* as resolve_child(): the join points at the end of the loop */
+            p = cells[join];
+            p->side = get_last_men(side);
+            p->s_type = JOIN;
+            p->s_ratio = ratio;
+            strcpy(p->sidename, name);
+        }
+    }
+
+    Py_DECREF(seq);
+    return PyErr_Occurred() ? -1 : 0;
+}
+
+static PyObject* Mensur_from_arrays(PyTypeObject* type, PyObject* args, PyObject* kwargs) {
+    PyObject *df_obj, *db_obj, *r_obj, *branches = Py_None;
+    const char *unit = "mm";
+    double simplify = -1.0;
+    double scale;
+    mensur *men, **cells = NULL;
+    arena *pool, *prev;
+    int n, err = 0;
+    static char* kwlist[] = {"df", "db", "r", "unit", "branches", "simplify", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|sOd", kwlist, &df_obj, &db_obj,
+                                    &r_obj, &unit, &branches, &simplify)) {
+        return NULL;
+    }
+    if (strcmp(unit, "mm") == 0) {
+        scale = 0.001;
+    } else if (strcmp(unit, "m") == 0) {
+        scale = 1.0;
+    } else {
+        PyErr_Format(PyExc_ValueError, "Unknown unit '%s', expected 'mm' or 'm'", unit);
+        return NULL;
+    }
+
+    /* all cells in one arena, as a parsed file */
+    pool = create_arena(0);
+    prev = use_men_arena(pool);
+    men = men_from_columns(df_obj, db_obj, r_obj, scale, -1, &cells, &n);
+    if (men != NULL && branches != Py_None) {
+        err = attach_branches(cells, n, branches, scale);
+    }
+    use_men_arena(prev);
+    free(cells);
+
+    if (men == NULL || err < 0) {
+        dispose_arena(pool);
+        return NULL;
+    }
+
+    men = get_first_men(rejoint_men(men));
+    return new_mensur_object(type, men, simplify);
+}
+
+static PyObject* Mensur_calcimp(MensurObject* self, PyObject* args, PyObject* kwargs) {
+    double max_freq = 2000.0;
+    double step_freq = 2.5;
+    unsigned long num_freq = 0;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    static char* kwlist[] = {"max_freq", "step_freq", "num_freq", "temperature", "rad_calc",
+                            "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ddkdippipp", kwlist,
+                                    &max_freq, &step_freq, &num_freq, &temperature, &rad_calc,
+                                    &dump_calc_bool, &sec_var_calc, &threads, &scalar,
+                                    &fast_math)) {
+        return NULL;
+    }
+
+    return calculate_impedance(self->bore, max_freq, step_freq, num_freq, temperature,
+                               rad_calc, dump_calc_bool ? WALL : NONE, sec_var_calc, threads,
+                               scalar, fast_math);
+}
+
+static PyObject* Mensur_impedance(MensurObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *freq_obj, *freq_array, *z_array;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 0;
+    int fast_math = FALSE;
+    acoustic_constants ac;
+    static char* kwlist[] = {"freq", "temperature", "rad_calc", "dump_calc", "sec_var_calc",
+                            "threads", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|dippip", kwlist,
+                                    &freq_obj, &temperature, &rad_calc, &dump_calc_bool,
+                                    &sec_var_calc, &threads, &fast_math)) {
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 0, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    z_array = impedance_array(self->bore, freq_array, &ac, threads);
+    Py_DECREF(freq_array);
+    return z_array;
+}
+
+static PyObject* Mensur_resonances(MensurObject* self, PyObject* args, PyObject* kwargs) {
+    double max_freq = 2000.0;
+    double step_freq = 10.0;
+    double tol = 1e-3;
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int scalar = FALSE;
+    int fast_math = FALSE;
+    static char* kwlist[] = {"max_freq", "step_freq", "tol", "temperature", "rad_calc",
+                            "dump_calc", "sec_var_calc", "threads", "scalar", "fast_math", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ddddippipp", kwlist,
+                                    &max_freq, &step_freq, &tol, &temperature, &rad_calc,
+                                    &dump_calc_bool, &sec_var_calc, &threads, &scalar,
+                                    &fast_math)) {
+        return NULL;
+    }
+
+    return find_resonances(self->bore, max_freq, step_freq, tol, temperature, rad_calc,
+                           dump_calc_bool ? WALL : NONE, sec_var_calc, threads, scalar,
+                           fast_math);
+}
+
+static PyObject* Mensur_pressure(MensurObject* self, PyObject* args, PyObject* kwargs) {
+    PyObject *freq_obj, *freq_array, *result_tuple;
+    Py_complex p0 = {1.0, 0.0};
+    double temperature = 24.0;
+    int rad_calc = PIPE;
+    int dump_calc_bool = 1;
+    int sec_var_calc = FALSE;
+    int threads = 1;
+    int fast_math = FALSE;
+    double step = 0.0;
+    mensur *copy;
+    bore *bore = self->bore;
+    acoustic_constants ac;
+    static char* kwlist[] = {"freq", "p0", "temperature", "rad_calc", "dump_calc",
+                            "sec_var_calc", "threads", "fast_math", "step", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Ddippipd", kwlist,
+                                    &freq_obj, &p0, &temperature, &rad_calc, &dump_calc_bool,
+                                    &sec_var_calc, &threads, &fast_math, &step)) {
+        return NULL;
+    }
+
+    freq_array = PyArray_FROMANY(freq_obj, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY);
+    if (freq_array == NULL) {
+        return NULL;
+    }
+    /* extra stations need cells of their own, step in mm */
+    if (step > 0) {
+        copy = copy_men(self->men);
+        divide_men(copy, step * 0.001);
+        bore = finish_bore(copy, -1.0);
+        dispose_men_tree(copy);
+        if (bore == NULL) {
+            Py_DECREF(freq_array);
+            return NULL;
+        }
+    }
+    set_constants(&ac, temperature, rad_calc, dump_calc_bool, sec_var_calc, fast_math);
+
+    result_tuple = pressure_tuple(bore, freq_array, p0.real + p0.imag * I, &ac, threads);
+    if (bore != self->bore) {
+        dispose_bore(bore);
+    }
+    Py_DECREF(freq_array);
+    return result_tuple;
+}
+
+static PyObject* Mensur_get_cells(MensurObject* self, void* closure) {
+    return bore_cell_list(self->bore);
+}
+
+/* length of the main bore in m */
+static double main_bore_length(const bore* b) {
+    double length = 0.0;
+    int i;
+
+    for (i = b->first[0]; i < b->last[0]; i++) {
+        length += b->r[i];
+    }
+    return length;
+}
+
+static PyObject* Mensur_get_length(MensurObject* self, void* closure) {
+    return PyFloat_FromDouble(main_bore_length(self->bore) * 1000.0);
+}
+
+static Py_ssize_t Mensur_len(MensurObject* self) {
+    return self->bore->n_cell;
+}
+
+static PyObject* Mensur_repr(MensurObject* self) {
+    char length[32];
+
+    /* PyUnicode_FromFormat() has no %f */
+    snprintf(length, sizeof(length), "%.1f", main_bore_length(self->bore) * 1000.0);
+    return PyUnicode_FromFormat("<Mensur: %d cells, %d branches, %s mm>",
+                                self->bore->n_cell, self->bore->n_branch, length);
+}
+
+static PyMethodDef Mensur_methods[] = {
+    {"from_text", (PyCFunction)Mensur_from_text, METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+     "Parse a mensur held in memory, as Mensur() reads a file.\n\n"
+     "Parameters:\n"
+     "    text (str or bytes): Contents of a mensur file\n"
+     "    format (str, optional): 'xmen' or 'men' (default: 'xmen')\n"
+     "    simplify (float, optional): as for calcimp() (default: -1)"},
+    {"from_arrays", (PyCFunction)Mensur_from_arrays, METH_VARARGS | METH_KEYWORDS | METH_CLASS,
+     "Build a bore from columns of cells, without any text.\n\n"
+     "Parameters:\n"
+     "    df, db, r (array-like): Diameters and length per cell as the lines of a .men\n"
+     "        file; the last cell is the end with r = 0 (df > 0 open, 0 closed). Values must\n"
+     "        be finite, the other cells need positive diameters and r >= 0, or ValueError\n"
+     "        names the cell. Contiguous float64 arrays are read in place\n"
+     "    unit (str, optional): 'mm' or 'm' (default: 'mm')\n"
+     "    branches (sequence, optional): (index, kind, ratio, df, db, r) per side branch at\n"
+     "        the outlet of main bore cell index, kind 'tonehole' or 'addon', with the\n"
+     "        branch's own columns; a valve loop is (index, 'split', ratio, df, db, r, join)\n"
+     "        and comes back at the outlet of cell join\n"
+     "    simplify (float, optional): as for calcimp() (default: -1)"},
+    {"calcimp", (PyCFunction)Mensur_calcimp, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance on a frequency grid.\n\n"
+     "Parameters:\n"
+     "    as for calcimp(), without filename and simplify\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db)"},
+    {"impedance", (PyCFunction)Mensur_impedance, METH_VARARGS | METH_KEYWORDS,
+     "Input impedance density at given frequencies.\n\n"
+     "Parameters:\n"
+     "    freq (array-like): Frequencies in Hz, those not positive give 0\n"
+     "    threads (int, optional): Native threads, 0 uses all processors (default: 0)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    ndarray: complex impedance density in Pa s/m, shaped as freq"},
+    {"resonances", (PyCFunction)Mensur_resonances, METH_VARARGS | METH_KEYWORDS,
+     "Find the impedance maxima.\n\n"
+     "Parameters:\n"
+     "    as for find_resonances(), without filename and simplify\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, magnitude, q, bandwidth)"},
+    {"pressure", (PyCFunction)Mensur_pressure, METH_VARARGS | METH_KEYWORDS,
+     "Complex pressure and volume velocity along the main bore.\n\n"
+     "Parameters:\n"
+     "    as for pressure_field(), without filename\n\n"
+     "Returns:\n"
+     "    tuple: (x, p, u) as pressure_field()"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef Mensur_getset[] = {
+    {"cells", (getter)Mensur_get_cells, NULL,
+     "list: (df, db, r, branch) in mm per cell, main bore (branch 0) first", NULL},
+    {"length", (getter)Mensur_get_length, NULL,
+     "float: length of the main bore in mm", NULL},
+    {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PySequenceMethods Mensur_as_sequence = {
+    .sq_length = (lenfunc)Mensur_len,
+};
+
+static PyTypeObject MensurType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "calcimp.Mensur",
+    .tp_basicsize = sizeof(MensurObject),
+    .tp_dealloc = (destructor)Mensur_dealloc,
+    .tp_repr = (reprfunc)Mensur_repr,
+    .tp_as_sequence = &Mensur_as_sequence,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Mensur(filename, simplify=-1)\n\n"
+              "A mensur file parsed and compiled once, to be evaluated many times.\n"
+              "len() is the number of cells of all branches.",
+    .tp_methods = Mensur_methods,
+    .tp_getset = Mensur_getset,
+    .tp_new = Mensur_new,
+};
+
+static PyObject* py_cxmath_selftest(PyObject* self, PyObject* args) {
+    int verbose = 0;
+    int fail;
+    double ulp_exact, ulp_fast;
+
+    if (!PyArg_ParseTuple(args, "|p", &verbose)) {
+        return NULL;
+    }
+
+    fail = cx_selftest(verbose, &ulp_exact, &ulp_fast);
+
+    return Py_BuildValue("(iddi)", fail, ulp_exact, ulp_fast, CX_FAST_ULP);
+}
+
+static PyMethodDef CalcimpMethods[] = {
+    {"calcimp", (PyCFunction)py_calcimp, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance of a tube.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file\n"
+     "    max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)\n"
+     "    step_freq (float, optional): Frequency step in Hz (default: 2.5)\n"
+     "    num_freq (int, optional): Number of frequency points (overrides step_freq if > 0)\n"
+     "    temperature (float, optional): Temperature in Celsius (default: 24.0)\n"
+     "    rad_calc (int, optional): Radiation impedance mode - PIPE, BUFFLE, or NONE (default: PIPE)\n"
+     "    dump_calc (bool, optional): Enable wall damping calculation (default: True)\n"
+     "    sec_var_calc (bool, optional): Enable section variation calculation (default: False)\n"
+     "    threads (int, optional): Number of threads for the sweep, 0 uses all processors (default: 1)\n"
+     "    scalar (bool, optional): Evaluate one frequency at a time instead of in SIMD blocks (default: False)\n"
+     "    fast_math (bool, optional): Faster complex sin/cos within a few ULP instead of GSL exact (default: False)\n"
+     "    simplify (float, optional): Merge redundant cells before the sweep; 0 merges only equal cylinders\n"
+     "        exactly, > 0 also merges cones within this diameter error in mm, which changes the wall\n"
+     "        losses, < 0 disables (default: -1)\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db)"},
+    {"calcimp_many", (PyCFunction)py_calcimp_many, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance of many tubes at once on a pool of native threads.\n\n"
+     "Parameters:\n"
+     "    paths (sequence): Paths of the mensur files (.men or .xmen)\n"
+     "    threads (int, optional): Number of files evaluated at once, 0 uses all processors (default: 0)\n"
+     "    others as for calcimp()\n\n"
+     "Returns:\n"
+     "    list: For each path in order, the tuple of calcimp() or a RuntimeError if the file failed"},
+    {"print_men", py_print_men, METH_VARARGS,
+     "Read and return mensur structure.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n\n"
+     "Returns:\n"
+     "    list: List of tuples (df, db, r, comment) where df, db, r are in mm"},
+    {"simplify_men", (PyCFunction)py_simplify_men, METH_VARARGS | METH_KEYWORDS,
+     "Read a mensur file and merge redundant cells.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    tolerance (float, optional): Allowed diameter error in mm, 0 merges only equal cylinders\n"
+     "        and keeps the impedance, > 0 also merges cones and changes the wall losses (default: 0)\n\n"
+     "Returns:\n"
+     "    tuple: (cells_removed, cells) where cells is the simplified main bore as a list of\n"
+     "           (df, db, r, comment) in mm; cells_removed counts side branch cells too"},
+    {"chain_matrix", (PyCFunction)py_chain_matrix, METH_VARARGS | METH_KEYWORDS,
+     "Chain matrix of the main bore without its open end, for any termination.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file\n"
+     "    max_freq, step_freq, num_freq, temperature, dump_calc, sec_var_calc, threads,\n"
+     "    fast_math, simplify: as for calcimp()\n"
+     "    rad_calc (int, optional): Radiation mode of side branch ends (default: PIPE)\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, chain, bell_diameter, closed) where chain has shape (n, 2, 2) and\n"
+     "           Z = (t11 Z_L + t12) / (t21 Z_L + t22) is the impedance of calcimp() for an end\n"
+     "           impedance Z_L; bell_diameter is in mm, closed is True for a closed bore"},
+    {"radiation_impedance", (PyCFunction)py_radiation_impedance, METH_VARARGS | METH_KEYWORDS,
+     "Radiation impedance of an open end.\n\n"
+     "Parameters:\n"
+     "    freq (array_like): Frequencies in Hz\n"
+     "    diameter (float): Diameter of the end in mm\n"
+     "    rad_calc (int, optional): PIPE, BUFFLE or NONE (default: PIPE)\n"
+     "    temperature (float, optional): Temperature in Celsius (default: 24.0)\n\n"
+     "Returns:\n"
+     "    ndarray: complex acoustic impedance in Pa s/m^3, 0 at DC"},
+    {"impedance_at", (PyCFunction)py_impedance_at, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance at given frequencies; a few frequencies of a long bore share\n"
+     "the cells among threads.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    freq (array-like): Frequencies in Hz, those not positive give 0\n"
+     "    threads (int, optional): Native threads, 0 uses all processors (default: 0)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    ndarray: complex input impedance density, the shape of freq"},
+    {"pressure_field", (PyCFunction)py_pressure_field, METH_VARARGS | METH_KEYWORDS,
+     "Complex pressure and volume velocity along the main bore.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    freq (array-like): Frequencies in Hz, 1-D\n"
+     "    p0 (complex, optional): Pressure at the input in Pa (default: 1)\n"
+     "    step (float, optional): Cut cells longer than step mm, 0 keeps the cells (default: 0)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (position, p, u); position of the inlet of each cell in mm, p in Pa and\n"
+     "           u in m^3/s as arrays of len(freq) x len(position)"},
+    {"calcimp_adaptive", (PyCFunction)py_calcimp_adaptive, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance on a grid refined around peaks and fast changes.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)\n"
+     "    step_freq (float, optional): Coarse frequency step in Hz (default: 10.0)\n"
+     "    min_step (float, optional): Intervals are not halved below this width in Hz (default: 0.01)\n"
+     "    tol_db (float, optional): Largest change of |Z| in dB between points (default: 1.0)\n"
+     "    tol_phase (float, optional): Largest change of arg Z in rad between points (default: 0.2)\n"
+     "    max_points (int, optional): Refinement stops at this number of points (default: 100000)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db), frequencies ascending\n"
+     "           but not equally spaced"},
+    {"find_resonances", (PyCFunction)py_find_resonances, METH_VARARGS | METH_KEYWORDS,
+     "Find the maxima of the input impedance with their Q factors.\n\n"
+     "Peaks are bracketed on a coarse grid and located by Brent's method, as\n"
+     "are their -3 dB points, without a dense sweep.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    max_freq (float, optional): Maximum frequency in Hz (default: 2000.0)\n"
+     "    step_freq (float, optional): Bracketing grid in Hz, finer than the peak spacing (default: 10.0)\n"
+     "    tol (float, optional): Accuracy of the frequencies in Hz (default: 1e-3)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, magnitude, q, bandwidth), one entry per peak; magnitude is |Z|\n"
+     "           as impedance density, bandwidth the distance of the -3 dB points in Hz and\n"
+     "           NaN when one of them is not found"},
+    {"sensitivities", (PyCFunction)py_sensitivities, METH_VARARGS | METH_KEYWORDS,
+     "Input impedance and its derivatives by the geometry of every cell.\n\n"
+     "One forward and one backward (adjoint) pass per frequency; section variation\n"
+     "is not supported.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    freq (array-like): Frequencies in Hz, those not positive give 0\n"
+     "    threads (int, optional): Threads over the frequencies, 0 uses all processors (default: 1)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (z, dz_ddf, dz_ddb, dz_dr); z is the complex impedance density per frequency,\n"
+     "           the others have one row per frequency and one column per cell, in the\n"
+     "           order of IncrementalBore.cells, per mm"},
+    {"resonance_sensitivities", (PyCFunction)py_resonance_sensitivities, METH_VARARGS | METH_KEYWORDS,
+     "Resonance frequencies and their derivatives by the geometry of every cell.\n"
+     "Central differences at f0 +- 1e-5 f0, two adjoint passes per peak.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    max_freq, step_freq, tol: as for find_resonances()\n"
+     "    other parameters: as for sensitivities()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, df_ddf, df_ddb, df_dr); one row per peak and one column per\n"
+     "           cell, in Hz per mm"},
+    {"xmen_variables", py_xmen_variables, METH_VARARGS,
+     "Variables defined in an XMENSUR file.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the .xmen file\n\n"
+     "Returns:\n"
+     "    dict: name -> value, in order of definition"},
+    {"optimize", (PyCFunction)py_optimize, METH_VARARGS | METH_KEYWORDS,
+     "Fit variables of an XMENSUR file to target resonances (Levenberg-Marquardt).\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the .xmen file\n"
+     "    names (sequence of str): Free variables\n"
+     "    x0, lower, upper (array-like): Start and bounds per variable\n"
+     "    targets (array-like): One row (kind, freq, freq2, value, weight) per target;\n"
+     "                          kind 0 puts the peak nearest to freq at freq, kind 1 makes\n"
+     "                          20 log10 |Z| of the peaks nearest to freq and freq2 differ by value dB\n"
+     "    max_freq, step_freq, tol: Resonance search as find_resonances()\n"
+     "    max_iter (int, optional): Most iterations (default: 50)\n"
+     "    ftol (float, optional): Stop when the cost falls by less than this fraction (default: 1e-10)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (x, residuals, cost, iterations, evaluations, converged); residuals are\n"
+     "           in cents or dB per target without weights"},
+    {"reflectance", (PyCFunction)py_reflectance, METH_VARARGS | METH_KEYWORDS,
+     "Reflectance, reflection function and impulse response of the input impedance.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n"
+     "    sample_rate (float, optional): Sample rate in Hz (default: 44100)\n"
+     "    duration (float, optional): Length of the responses in seconds (default: 0.1)\n"
+     "    max_freq (float, optional): Band evaluated, zero above (default: sample_rate / 2)\n"
+     "    window (int, optional): Taper of the band, 0 none, 1 Hann, 2 Blackman (default: 1)\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (freq, R, time, r, h); R = (Z - Zc) / (Z + Zc) on the FFT grid, r the\n"
+     "           reflection function and h the impulse response of Z per sample"},
+    {"load_instrument", py_load_instrument, METH_VARARGS,
+     "Read a mensur file keeping its branch points switchable.\n\n"
+     "Parameters:\n"
+     "    filename (str): Path to the mensur file (.men or .xmen)\n\n"
+     "Returns:\n"
+     "    capsule: instrument handle for instrument_branches() and instrument_calcimp()"},
+    {"load_instrument_text", py_load_instrument_text, METH_VARARGS,
+     "Parse a mensur held in memory, as load_instrument() reads a file.\n\n"
+     "Parameters:\n"
+     "    text (str or bytes): Contents of a mensur file\n"
+     "    format (str): 'xmen' or 'men'\n\n"
+     "Returns:\n"
+     "    capsule: instrument handle for instrument_branches() and instrument_calcimp()"},
+    {"instrument_branches", py_instrument_branches, METH_VARARGS,
+     "List the branch points of an instrument.\n\n"
+     "Returns:\n"
+     "    list: (sidename, s_type, ratio) per branch name in the order of the bore, with the\n"
+     "          ratio given in the file; s_type is 1 tonehole, 2 addon, 3 split"},
+    {"instrument_calcimp", (PyCFunction)py_instrument_calcimp, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance of an instrument for a state of its branch points.\n\n"
+     "Parameters:\n"
+     "    instrument (capsule): Result of load_instrument()\n"
+     "    states (dict, optional): sidename -> ratio in [0, 1] overriding the file; 0 closes a\n"
+     "        tonehole or bypasses a valve loop, 1 opens it fully\n"
+     "    other parameters: as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db)"},
+    {"instrument_resonances", (PyCFunction)py_instrument_resonances, METH_VARARGS | METH_KEYWORDS,
+     "Find the impedance maxima of an instrument for a state of its branch points.\n\n"
+     "Parameters:\n"
+     "    instrument (capsule): Result of load_instrument()\n"
+     "    states (dict, optional): as for instrument_calcimp()\n"
+     "    other parameters: as for find_resonances()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, magnitude, q, bandwidth) as find_resonances()"},
+    {"instrument_fingerings", (PyCFunction)py_instrument_fingerings, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance of an instrument for a list of states at once.\n\n"
+     "Matrices are computed once per frequency for all states, and each state only\n"
+     "evaluates the bore up to where it differs from an earlier one.\n\n"
+     "Parameters:\n"
+     "    instrument (capsule): Result of load_instrument()\n"
+     "    fingerings (sequence): states as for instrument_calcimp()\n"
+     "    other parameters: as for calcimp(), without scalar\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db), the last three\n"
+     "           of shape (len(fingerings), n) with one row per state"},
+    {"load_bore_tree", (PyCFunction)py_load_bore_tree, METH_VARARGS | METH_KEYWORDS,
+     "Read a mensur file into an incremental bore for repeated sweeps.\n\n"
+     "Parameters:\n"
+     "    filename, max_freq, step_freq, num_freq, temperature, rad_calc, dump_calc,\n"
+     "    sec_var_calc, fast_math, simplify: as for calcimp(), fixed for the bore\n"
+     "    block (int, optional): main bore cells per leaf of the tree, 0 for the default\n\n"
+     "Returns:\n"
+     "    capsule: handle for bore_tree_cells(), bore_tree_set_cell() and bore_tree_calcimp()"},
+    {"bore_tree_cells", py_bore_tree_cells, METH_VARARGS,
+     "List the cells of an incremental bore.\n\n"
+     "Returns:\n"
+     "    list: (df, db, r, branch) in mm per cell; the main bore (branch 0) comes first"},
+    {"bore_tree_set_cell", (PyCFunction)py_bore_tree_set_cell, METH_VARARGS | METH_KEYWORDS,
+     "Edit a cell of an incremental bore.\n\n"
+     "Parameters:\n"
+     "    tree (capsule): Result of load_bore_tree()\n"
+     "    index (int): Cell index as in bore_tree_cells()\n"
+     "    df, db, r (float, optional): New diameters and length in mm, omitted keep theirs;\n"
+     "        the open end only takes df"},
+    {"bore_tree_calcimp", (PyCFunction)py_bore_tree_calcimp, METH_VARARGS | METH_KEYWORDS,
+     "Calculate input impedance of an incremental bore, recomputing only edited blocks.\n\n"
+     "Parameters:\n"
+     "    tree (capsule): Result of load_bore_tree()\n"
+     "    threads (int, optional): as for calcimp()\n\n"
+     "Returns:\n"
+     "    tuple: (frequencies, real_part, imaginary_part, magnitude_db)"},
+    {"set_cache_size", py_set_cache_size, METH_VARARGS,
+     "Set how many parsed mensur files are kept between calls.\n\n"
+     "Parameters:\n"
+     "    size (int): Number of files, least recently used ones are dropped; 0 disables\n"
+     "        the cache (default: 16)\n\n"
+     "Returns:\n"
+     "    int: previous size"},
+    {"clear_cache", py_clear_cache, METH_NOARGS,
+     "Drop all parsed mensur files and reset the cache counters."},
+    {"cache_info", py_cache_info, METH_NOARGS,
+     "Statistics of the parsed file cache.\n\n"
+     "Returns:\n"
+     "    dict: size, max_size, hits and misses"},
+    {"cxmath_selftest", py_cxmath_selftest, METH_VARARGS,
+     "Check the complex math layer against GSL on a table of arguments.\n\n"
+     "Parameters:\n"
+     "    verbose (bool, optional): Print failing arguments to stderr (default: False)\n\n"
+     "Returns:\n"
+     "    tuple: (failures, max_ulp_exact, max_ulp_fast, fast_ulp_bound)"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef calcimpmodule = {
+    PyModuleDef_HEAD_INIT,
+    "_calcimp_c",
+    "Extension module for calculating input impedance of tubes",
+    -1,
+    CalcimpMethods
+};
+
+PyMODINIT_FUNC PyInit__calcimp_c(void) {
+    PyObject *m;
+
+    import_array();  /* Initialize numpy */
+    m = PyModule_Create(&calcimpmodule);
+    if (m == NULL)
+        return NULL;
+
+    /* Export constants for radiation calculation modes */
+    PyModule_AddIntConstant(m, "NONE", NONE);
+    PyModule_AddIntConstant(m, "PIPE", PIPE);
+    PyModule_AddIntConstant(m, "BUFFLE", BUFFLE);
+
+    if (PyType_Ready(&MensurType) < 0) {
+        Py_DECREF(m);
+        return NULL;
+    }
+    Py_INCREF(&MensurType);
+    if (PyModule_AddObject(m, "Mensur", (PyObject*)&MensurType) < 0) {
+        Py_DECREF(&MensurType);
+        Py_DECREF(m);
+        return NULL;
+    }
 
     return m;
 }
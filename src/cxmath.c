@@ -0,0 +1,209 @@
+/*
+ * cxmath.c - complex transcendentals for the impedance kernels
+ * See cxmath.h for the accuracy modes.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     /* sincos() */
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+#include <gsl/gsl_complex.h>
+#include <gsl/gsl_complex_math.h>
+
+#include "cxmath.h"
+
+/* sin and cos of a real argument in one call where the libc has it */
+static inline void real_sincos(double x, double *s, double *c)
+{
+#if defined(__GLIBC__)
+    sincos(x, s, c);
+#elif defined(__APPLE__)
+    __sincos(x, s, c);
+#else
+    *s = sin(x);
+    *c = cos(x);
+#endif
+}
+
+/*
+ * sinh and cosh of a real argument from a single expm1()
+ * expm1 keeps sinh accurate near 0 where exp(y)-exp(-y) cancels, and
+ * working on |y| keeps expm1(y)+1 away from cancellation too.
+ */
+static inline void real_sinhcosh(double y, double *sh, double *ch)
+{
+    double em = expm1(fabs(y)), e = em + 1.0;
+
+    *sh = copysign(0.5 * (em + em / e), y);
+    *ch = 0.5 * (e + 1.0 / e);
+}
+
+/*
+ * Parts of sin(x+iy) and cos(x+iy)
+ * sin(z) = sin x cosh y + I cos x sinh y
+ * cos(z) = cos x cosh y - I sin x sinh y
+ * The y == 0 case is kept apart like gsl_complex_sin/cos so that the
+ * signs of zero imaginary parts match too.
+ */
+static inline void sincos_parts(double x, double y, double *sr, double *si,
+                                double *cr, double *ci, int mode)
+{
+    double s, c, sh, ch;
+
+    if (mode == CX_FAST) {
+        real_sincos(x, &s, &c);
+        if (y == 0.0) {
+            *sr = s; *si = 0.0;
+            *cr = c; *ci = 0.0;
+            return;
+        }
+        real_sinhcosh(y, &sh, &ch);
+    } else {
+        s = sin(x);
+        c = cos(x);
+        if (y == 0.0) {
+            *sr = s; *si = 0.0;
+            *cr = c; *ci = 0.0;
+            return;
+        }
+        sh = sinh(y);
+        ch = cosh(y);
+    }
+
+    *sr = s * ch;
+    *si = c * sh;
+    *cr = c * ch;
+    *ci = -(s * sh);
+}
+
+/*
+ * sin(z) and cos(z) together
+ */
+void cx_sincos(double complex z, double complex *s, double complex *c, int mode)
+{
+    double sr, si, cr, ci;
+
+    sincos_parts(creal(z), cimag(z), &sr, &si, &cr, &ci, mode);
+    *s = sr + I * si;
+    *c = cr + I * ci;
+}
+
+/*
+ * sin and cos of n complex numbers given as separate real and imaginary
+ * arrays, results likewise.  Same values as cx_sincos() element by element.
+ */
+void cx_sincos_n(int n, const double *xr, const double *xi,
+                 double *s_re, double *s_im, double *c_re, double *c_im, int mode)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        sincos_parts(xr[i], xi[i], &s_re[i], &s_im[i], &c_re[i], &c_im[i], mode);
+    }
+}
+
+/* ------------------------------ self test ------------------------------*/
+
+/* distance of two doubles in units in the last place */
+static double ulp_diff(double a, double b)
+{
+    int64_t ia, ib;
+
+    if (a == b) return 0;               /* also +0 == -0 */
+    if (isnan(a) || isnan(b)) return INFINITY;
+    memcpy(&ia, &a, sizeof ia);
+    memcpy(&ib, &b, sizeof ib);
+    if (ia < 0) ia = INT64_MIN - ia;    /* make the ordering monotonic */
+    if (ib < 0) ib = INT64_MIN - ib;
+
+    if ((ia < 0) != (ib < 0)) return fabs((double)ia) + fabs((double)ib);
+    return (double)(ia > ib ? ia - ib : ib - ia);
+}
+
+static double cx_ulp(double complex z, gsl_complex ref)
+{
+    double u = ulp_diff(creal(z), GSL_REAL(ref)), v = ulp_diff(cimag(z), GSL_IMAG(ref));
+
+    return u > v ? u : v;
+}
+
+/*
+ * Check cx_sincos(), cx_sincos_n() and cx_sqrt() against GSL on a table of
+ * arguments covering the range the kernels see (kL up to a few thousand,
+ * damping from none to strong).  CX_EXACT has to agree bit for bit and
+ * CX_FAST within CX_FAST_ULP.  Returns the number of failed entries and
+ * the worst errors found.
+ */
+int cx_selftest(int verbose, double *max_ulp_exact, double *max_ulp_fast)
+{
+    static const double re_tab[] = {
+        0.0, 1e-300, 1e-12, 1e-6, 0.1, 0.5, 1.0, 1.5707963267948966, 2.0,
+        3.141592653589793, 4.71238898038469, 10.0, 123.456, 1e3, 4321.0, 1e5
+    };
+    static const double im_tab[] = {
+        0.0, 1e-300, 1e-15, 1e-9, 1e-6, 1e-4, 3e-3, 0.05, 0.3, 1.0, 2.5, 7.0,
+        20.0, 100.0, 700.0
+    };
+    const int n_re = sizeof(re_tab) / sizeof(re_tab[0]);
+    const int n_im = sizeof(im_tab) / sizeof(im_tab[0]);
+    double xr[2], xi[2], sr[2], si[2], cr[2], ci[2];
+    double complex z, s, c, q;
+    gsl_complex g, gs, gc, gq;
+    double u, worst_exact = 0, worst_fast = 0;
+    int i, j, k, sr_sign, si_sign, mode, fail = 0;
+
+    for (i = 0; i < n_re; i++) {
+        for (j = 0; j < n_im; j++) {
+            for (k = 0; k < 4; k++) {
+                sr_sign = (k & 1) ? -1 : 1;
+                si_sign = (k & 2) ? -1 : 1;
+                z = sr_sign * re_tab[i] + I * (si_sign * im_tab[j]);
+                GSL_SET_COMPLEX(&g, creal(z), cimag(z));
+                gs = gsl_complex_sin(g);
+                gc = gsl_complex_cos(g);
+                gq = gsl_complex_sqrt(g);
+
+                for (mode = CX_EXACT; mode <= CX_FAST; mode++) {
+                    cx_sincos(z, &s, &c, mode);
+                    u = cx_ulp(s, gs);
+                    if (cx_ulp(c, gc) > u) u = cx_ulp(c, gc);
+
+                    /* the batched form must give the same bits */
+                    xr[0] = xr[1] = creal(z);
+                    xi[0] = xi[1] = cimag(z);
+                    cx_sincos_n(2, xr, xi, sr, si, cr, ci, mode);
+                    if (sr[1] != creal(s) || si[1] != cimag(s) ||
+                        cr[1] != creal(c) || ci[1] != cimag(c)) {
+                        u = INFINITY;
+                    }
+
+                    if (mode == CX_EXACT) {
+                        q = cx_sqrt(z);
+                        if (cx_ulp(q, gq) > u) u = cx_ulp(q, gq);
+                        if (u > worst_exact) worst_exact = u;
+                    } else if (u > worst_fast) {
+                        worst_fast = u;
+                    }
+
+                    if ((mode == CX_EXACT && u > 0) || (mode == CX_FAST && u > CX_FAST_ULP)) {
+                        fail++;
+                        if (verbose) {
+                            fprintf(stderr, "cx_selftest: %s z = %g%+gi, %g ulp\n",
+                                    mode == CX_EXACT ? "exact" : "fast",
+                                    creal(z), cimag(z), u);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    if (max_ulp_exact) *max_ulp_exact = worst_exact;
+    if (max_ulp_fast) *max_ulp_fast = worst_fast;
+
+    return fail;
+}
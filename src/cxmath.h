@@ -0,0 +1,72 @@
+/*
+ * cxmath.h - complex transcendentals for the impedance kernels
+ *
+ * Every cell needs sin(x) and cos(x) of the same complex x, and both are
+ * built from sin/cos of Re x and sinh/cosh of Im x.  cx_sincos() computes
+ * the four real functions once and returns both results, without the
+ * round trip through gsl_complex that the old csin/ccos macros made.
+ *
+ * CX_EXACT gives the same values as gsl_complex_sin/cos/sqrt bit for bit.
+ * CX_FAST uses one sincos() and one expm1() per argument; each component
+ * of the result stays within CX_FAST_ULP units in the last place of the
+ * exact one.
+ */
+
+#ifndef _CXMATH_H_
+#define _CXMATH_H_
+
+#include <math.h>
+#include <complex.h>
+
+/* accuracy mode */
+#define CX_EXACT 0
+#define CX_FAST 1
+
+/* bound on the error of CX_FAST, checked by cx_selftest() */
+#define CX_FAST_ULP 4
+
+/*
+ * Complex square root, same branch and steps as gsl_complex_sqrt()
+ * Inline so that it vectorizes inside the blocked kernel.
+ */
+static inline void cx_sqrt_parts(double re, double im, double *out_re, double *out_im)
+{
+    double x = fabs(re), y = fabs(im), t, w;
+
+    if (x == 0.0 && y == 0.0) {
+        *out_re = *out_im = 0.0;
+        return;
+    }
+    if (x >= y) {
+        t = y / x;
+        w = sqrt(x) * sqrt(0.5 * (1.0 + sqrt(1.0 + t * t)));
+    } else {
+        t = x / y;
+        w = sqrt(y) * sqrt(0.5 * (t + sqrt(1.0 + t * t)));
+    }
+    if (re >= 0.0) {
+        *out_re = w;
+        *out_im = im / (2.0 * w);
+    } else {
+        if (im < 0) w = -w;
+        *out_re = im / (2.0 * w);
+        *out_im = w;
+    }
+}
+
+static inline double complex cx_sqrt(double complex z)
+{
+    double re, im;
+
+    cx_sqrt_parts(creal(z), cimag(z), &re, &im);
+    return re + I * im;
+}
+
+/* ------------------------------ prototype ------------------------------ */
+/* cxmath.c */
+void cx_sincos(double complex z, double complex *s, double complex *c, int mode);
+void cx_sincos_n(int n, const double *xr, const double *xi,
+                 double *s_re, double *s_im, double *c_re, double *c_im, int mode);
+int cx_selftest(int verbose, double *max_ulp_exact, double *max_ulp_fast);
+
+#endif /* _CXMATH_H_ */
@@ -0,0 +1,489 @@
+/*
+ * optimize.c - fitting the variables of an XMENSUR to target resonances
+ *
+ * Residuals are in cents for peak frequencies and in dB for magnitude
+ * ratios, so that targets of both kinds weigh alike.  At a peak the
+ * derivative of |Z| by frequency vanishes, hence the change of |Z| there
+ * by a parameter is that of the impedance at the fixed frequency, which
+ * bore_sensitivity_sweep() gives directly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "kutils.h"
+#include "zmensur.h"
+#include "xmensur.h"
+#include "bore.h"
+#include "spectrum.h"
+#include "sensitivity.h"
+#include "optimize.h"
+
+#define CENTS_PER_LOG (1200 / M_LN2)
+#define DB_PER_LOG (20 / M_LN10)
+
+/* relative step of the variables for differences */
+#define GEOMETRY_STEP 1e-4
+#define EVAL_STEP 1e-2
+
+/* an evaluated design */
+typedef struct {
+    bore *b;
+    resonance *res;
+    int n_res;
+    int *peak;          /* per target the peak nearest to frq, then to frq2 */
+} opt_point;
+
+static void clear_point(opt_point *p)
+{
+    if (p->b) dispose_bore(p->b);
+    free(p->res);
+    free(p->peak);
+    memset(p, 0, sizeof(opt_point));
+}
+
+/* parse and compile src with the variables at x, NULL on error */
+static bore *build_bore(const xmen_source *src, int n_var, const char **names, const double *x)
+{
+    mensur *men;
+    bore *b;
+
+    men = eval_xmen_source(src, names, x, n_var);
+    if (men == NULL) return NULL;
+    b = compile_bore(men);
+    dispose_men_tree(men);
+    return b;
+}
+
+static int nearest_peak(const resonance *res, int n_res, double frq)
+{
+    double d, best = HUGE_VAL;
+    int k, found = 0;
+
+    for (k = 0; k < n_res; k++) {
+        d = fabs(log(res[k].frq / frq));
+        if (d < best) {
+            best = d;
+            found = k;
+        }
+    }
+    return found;
+}
+
+/*
+ * Evaluate the design x into p and its unweighted residuals into r.
+ * Returns -1 when the bore cannot be built or has no peak.
+ */
+static int evaluate(const xmen_source *src, int n_var, const char **names, const double *x,
+                    int n_target, const opt_target *t, const opt_settings *s,
+                    const acoustic_constants *ac, int n_threads, opt_point *p, double *r)
+{
+    const resonance *a, *b;
+    int i;
+
+    memset(p, 0, sizeof(opt_point));
+    p->b = build_bore(src, n_var, names, x);
+    if (p->b == NULL) return -1;
+    p->n_res = bore_find_resonances(p->b, s->max_freq, s->step, s->tol, 1, &p->res, NULL,
+                                    ac, n_threads, FALSE);
+    if (p->n_res <= 0) {
+        clear_point(p);
+        return -1;
+    }
+
+    p->peak = m_malloc(2 * n_target * sizeof(int));
+    for (i = 0; i < n_target; i++) {
+        p->peak[2 * i] = nearest_peak(p->res, p->n_res, t[i].frq);
+        a = &p->res[p->peak[2 * i]];
+        if (t[i].kind == OPT_RATIO) {
+            p->peak[2 * i + 1] = nearest_peak(p->res, p->n_res, t[i].frq2);
+            b = &p->res[p->peak[2 * i + 1]];
+            r[i] = DB_PER_LOG * log(cabs(a->z) / cabs(b->z)) - t[i].value;
+        } else {
+            p->peak[2 * i + 1] = -1;
+            r[i] = CENTS_PER_LOG * log(a->frq / t[i].frq);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Do a and b differ only in the values of their geometry?  A cell turning
+ * from straight to taper is the same cell, the sensitivities cover both.
+ */
+static int same_structure(const bore *a, const bore *b)
+{
+    int i, ka, kb;
+
+    if (a->n_cell != b->n_cell || a->n_branch != b->n_branch || a->n_split != b->n_split) {
+        return FALSE;
+    }
+    for (i = 0; i < a->n_cell; i++) {
+        ka = (a->kind[i] == BORE_TAPER) ? BORE_STRAIGHT : a->kind[i];
+        kb = (b->kind[i] == BORE_TAPER) ? BORE_STRAIGHT : b->kind[i];
+        if (ka != kb || a->s_type[i] != b->s_type[i] || a->s_ratio[i] != b->s_ratio[i] ||
+            a->side[i] != b->side[i] || a->join[i] != b->join[i]) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Derivatives of the unweighted residuals at p by the geometry of every
+ * cell, n_target x n_cell per parameter.  Returns -1 when the adjoint does
+ * not apply (section variation).
+ */
+static int residual_geometry(const opt_point *p, int n_target, const opt_target *t,
+                             double *g_df, double *g_db, double *g_r,
+                             const acoustic_constants *ac, int n_threads)
+{
+    resonance *peaks;
+    double *f_df, *f_db, *f_r, *frq;
+    double complex *z, *z_df, *z_db, *z_r;
+    size_t n = p->b->n_cell, ia, ib, k;
+    int i, status;
+
+    peaks = m_malloc((n_target + 1) * sizeof(resonance));
+    frq = m_malloc((2 * n_target + 1) * sizeof(double));
+    for (i = 0; i < n_target; i++) {
+        peaks[i] = p->res[p->peak[2 * i]];
+        /* impedances are only swept for ratios, 0 gives zeros */
+        frq[2 * i] = frq[2 * i + 1] = 0;
+        if (t[i].kind == OPT_RATIO) {
+            frq[2 * i] = peaks[i].frq;
+            frq[2 * i + 1] = p->res[p->peak[2 * i + 1]].frq;
+        }
+    }
+    f_df = m_malloc((n_target * n + 1) * sizeof(double));
+    f_db = m_malloc((n_target * n + 1) * sizeof(double));
+    f_r = m_malloc((n_target * n + 1) * sizeof(double));
+    z = m_malloc((2 * n_target + 1) * sizeof(double complex));
+    z_df = m_malloc((2 * n_target * n + 1) * sizeof(double complex));
+    z_db = m_malloc((2 * n_target * n + 1) * sizeof(double complex));
+    z_r = m_malloc((2 * n_target * n + 1) * sizeof(double complex));
+
+    status = bore_resonance_sensitivity(p->b, peaks, n_target, 1, f_df, f_db, f_r, ac, n_threads);
+    if (status == 0) {
+        for (i = 0; i < n_target; i++) {
+            if (t[i].kind == OPT_RATIO) break;
+        }
+        if (i < n_target) {
+            status = bore_sensitivity_sweep(p->b, frq, 2 * n_target, 1, z, z_df, z_db, z_r,
+                                            ac, n_threads);
+        }
+    }
+
+    for (i = 0; status == 0 && i < n_target; i++) {
+        for (k = 0; k < n; k++) {
+            if (t[i].kind == OPT_RATIO) {
+                ia = 2 * i * n + k;
+                ib = (2 * i + 1) * n + k;
+                g_df[i * n + k] = DB_PER_LOG * creal(z_df[ia] / z[2 * i] - z_df[ib] / z[2 * i + 1]);
+                g_db[i * n + k] = DB_PER_LOG * creal(z_db[ia] / z[2 * i] - z_db[ib] / z[2 * i + 1]);
+                g_r[i * n + k] = DB_PER_LOG * creal(z_r[ia] / z[2 * i] - z_r[ib] / z[2 * i + 1]);
+            } else {
+                g_df[i * n + k] = CENTS_PER_LOG * f_df[i * n + k] / peaks[i].frq;
+                g_db[i * n + k] = CENTS_PER_LOG * f_db[i * n + k] / peaks[i].frq;
+                g_r[i * n + k] = CENTS_PER_LOG * f_r[i * n + k] / peaks[i].frq;
+            }
+        }
+    }
+
+    free(peaks);
+    free(frq);
+    free(f_df);
+    free(f_db);
+    free(f_r);
+    free(z);
+    free(z_df);
+    free(z_db);
+    free(z_r);
+    return status;
+}
+
+/*
+ * Jacobian of the unweighted residuals by the variables at x, n_target x
+ * n_var into jac.  Returns the number of evaluations it took.
+ */
+static int jacobian(const xmen_source *src, int n_var, const char **names, const double *x,
+                    int n_target, const opt_target *t, const opt_settings *s,
+                    const acoustic_constants *ac, int n_threads, const opt_point *p,
+                    double *jac)
+{
+    double *xh, *g_df = NULL, *g_db = NULL, *g_r = NULL, *rp, *rm, h, d_df, d_db, d_r;
+    bore *bp, *bm;
+    opt_point q;
+    size_t n = p->b->n_cell, k;
+    int i, j, geometry, adjoint = -1, n_eval = 0, ok_p, ok_m;
+
+    xh = m_malloc((n_var + 1) * sizeof(double));
+    rp = m_malloc((n_target + 1) * sizeof(double));
+    rm = m_malloc((n_target + 1) * sizeof(double));
+
+    for (j = 0; j < n_var; j++) {
+        memcpy(xh, x, n_var * sizeof(double));
+        h = GEOMETRY_STEP * fmax(fabs(x[j]), 1.0);
+
+        /* the geometry as a function of the variable, by itself cheap */
+        xh[j] = x[j] + h;
+        bp = build_bore(src, n_var, names, xh);
+        xh[j] = x[j] - h;
+        bm = build_bore(src, n_var, names, xh);
+        geometry = bp && bm && same_structure(p->b, bp) && same_structure(p->b, bm);
+        if (geometry && adjoint < 0) {
+            g_df = m_malloc((n_target * n + 1) * sizeof(double));
+            g_db = m_malloc((n_target * n + 1) * sizeof(double));
+            g_r = m_malloc((n_target * n + 1) * sizeof(double));
+            adjoint = (residual_geometry(p, n_target, t, g_df, g_db, g_r, ac, n_threads) == 0);
+        }
+        if (geometry && adjoint > 0) {
+            for (i = 0; i < n_target; i++) {
+                jac[i * n_var + j] = 0;
+            }
+            for (k = 0; k < n; k++) {
+                d_df = (bp->df[k] - bm->df[k]) / (2 * h);
+                d_db = (bp->db[k] - bm->db[k]) / (2 * h);
+                d_r = (bp->r[k] - bm->r[k]) / (2 * h);
+                if (d_df == 0 && d_db == 0 && d_r == 0) continue;
+                for (i = 0; i < n_target; i++) {
+                    jac[i * n_var + j] += g_df[i * n + k] * d_df + g_db[i * n + k] * d_db +
+                        g_r[i * n + k] * d_r;
+                }
+            }
+        } else {
+            /* whole evaluations, one-sided at a failure */
+            h = EVAL_STEP * fmax(fabs(x[j]), 1.0);
+            xh[j] = x[j] + h;
+            ok_p = (evaluate(src, n_var, names, xh, n_target, t, s, ac, n_threads, &q, rp) == 0);
+            if (ok_p) clear_point(&q);
+            xh[j] = x[j] - h;
+            ok_m = (evaluate(src, n_var, names, xh, n_target, t, s, ac, n_threads, &q, rm) == 0);
+            if (ok_m) clear_point(&q);
+            n_eval += 2;
+            for (i = 0; i < n_target; i++) {
+                if (ok_p && ok_m) {
+                    jac[i * n_var + j] = (rp[i] - rm[i]) / (2 * h);
+                } else {
+                    jac[i * n_var + j] = 0;
+                }
+            }
+        }
+        if (bp) dispose_bore(bp);
+        if (bm) dispose_bore(bm);
+    }
+
+    free(xh);
+    free(rp);
+    free(rm);
+    free(g_df);
+    free(g_db);
+    free(g_r);
+    return n_eval;
+}
+
+/* solve a x = b in place for symmetric positive definite a, -1 if it is not */
+static int solve_spd(int n, double *a, double *b)
+{
+    double sum;
+    int i, j, k;
+
+    for (j = 0; j < n; j++) {
+        sum = a[j * n + j];
+        for (k = 0; k < j; k++) {
+            sum -= a[j * n + k] * a[j * n + k];
+        }
+        if (!(sum > 0)) return -1;
+        a[j * n + j] = sqrt(sum);
+        for (i = j + 1; i < n; i++) {
+            sum = a[i * n + j];
+            for (k = 0; k < j; k++) {
+                sum -= a[i * n + k] * a[j * n + k];
+            }
+            a[i * n + j] = sum / a[j * n + j];
+        }
+    }
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < i; k++) {
+            b[i] -= a[i * n + k] * b[k];
+        }
+        b[i] /= a[i * n + i];
+    }
+    for (i = n - 1; i >= 0; i--) {
+        for (k = i + 1; k < n; k++) {
+            b[i] -= a[k * n + i] * b[k];
+        }
+        b[i] /= a[i * n + i];
+    }
+    return 0;
+}
+
+static double weighted_cost(int n_target, const opt_target *t, const double *r)
+{
+    double cost = 0;
+    int i;
+
+    for (i = 0; i < n_target; i++) {
+        cost += 0.5 * t[i].weight * t[i].weight * r[i] * r[i];
+    }
+    return cost;
+}
+
+int bore_optimize(const xmen_source *src, int n_var, const char **names, double *x,
+                  const double *lo, const double *hi, int n_target, const opt_target *t,
+                  const opt_settings *s, double *resid, opt_result *res,
+                  const acoustic_constants *ac, int n_threads)
+{
+    opt_point p, q;
+    double *jac, *g, *a, *m, *step, *xn, *rn;
+    double lambda = 1e-3, cost, cost_n, w2, move;
+    int *free_var, i, j, k, l, n_free, iter, accepted;
+
+    memset(res, 0, sizeof(opt_result));
+    if (n_var < 1 || n_target < 1 || !(s->max_freq > 0) || !(s->step > 0) || !(s->tol > 0)) {
+        fprintf(stderr, "bore_optimize: no variable, no target or bad settings.\n");
+        return -1;
+    }
+    for (j = 0; j < n_var; j++) {
+        if (xmen_source_var(src, names[j]) < 0) {
+            fprintf(stderr, "bore_optimize: variable \"%s\" is not defined.\n", names[j]);
+            return -1;
+        }
+        if (!(lo[j] <= hi[j])) {
+            fprintf(stderr, "bore_optimize: bounds of \"%s\" are empty.\n", names[j]);
+            return -1;
+        }
+        x[j] = fmin(fmax(x[j], lo[j]), hi[j]);
+    }
+    for (i = 0; i < n_target; i++) {
+        if (!(t[i].frq > 0) || (t[i].kind == OPT_RATIO && !(t[i].frq2 > 0))) {
+            fprintf(stderr, "bore_optimize: target frequencies must be positive.\n");
+            return -1;
+        }
+    }
+
+    if (evaluate(src, n_var, names, x, n_target, t, s, ac, n_threads, &p, resid) < 0) {
+        fprintf(stderr, "bore_optimize: the starting point cannot be evaluated.\n");
+        return -1;
+    }
+    res->n_eval = 1;
+    cost = weighted_cost(n_target, t, resid);
+
+    jac = m_malloc((n_target * n_var + 1) * sizeof(double));
+    g = m_malloc((n_var + 1) * sizeof(double));
+    a = m_malloc((n_var * n_var + 1) * sizeof(double));
+    m = m_malloc((n_var * n_var + 1) * sizeof(double));
+    step = m_malloc((n_var + 1) * sizeof(double));
+    xn = m_malloc((n_var + 1) * sizeof(double));
+    rn = m_malloc((n_target + 1) * sizeof(double));
+    free_var = m_malloc((n_var + 1) * sizeof(int));
+
+    for (iter = 0; iter < s->max_iter && cost > 0; iter++) {
+        res->n_eval += jacobian(src, n_var, names, x, n_target, t, s, ac, n_threads, &p, jac);
+
+        /* normal equations of the weighted residuals */
+        for (j = 0; j < n_var; j++) {
+            g[j] = 0;
+            for (k = 0; k < n_var; k++) {
+                a[j * n_var + k] = 0;
+            }
+        }
+        for (i = 0; i < n_target; i++) {
+            w2 = t[i].weight * t[i].weight;
+            for (j = 0; j < n_var; j++) {
+                g[j] += w2 * jac[i * n_var + j] * resid[i];
+                for (k = 0; k < n_var; k++) {
+                    a[j * n_var + k] += w2 * jac[i * n_var + j] * jac[i * n_var + k];
+                }
+            }
+        }
+
+        /* variables on a bound the descent would cross stay there */
+        n_free = 0;
+        for (j = 0; j < n_var; j++) {
+            free_var[j] = !((x[j] <= lo[j] && g[j] > 0) || (x[j] >= hi[j] && g[j] < 0) ||
+                            a[j * n_var + j] == 0);
+            if (free_var[j]) n_free++;
+        }
+        if (n_free == 0) {
+            res->converged = TRUE;
+            break;
+        }
+
+        accepted = FALSE;
+        while (!accepted && lambda < 1e10) {
+            for (j = 0, l = 0; j < n_var; j++) {
+                if (!free_var[j]) continue;
+                for (k = 0, i = 0; k < n_var; k++) {
+                    if (!free_var[k]) continue;
+                    m[l * n_free + i] = a[j * n_var + k];
+                    i++;
+                }
+                m[l * n_free + l] *= 1 + lambda;
+                step[l] = -g[j];
+                l++;
+            }
+            if (solve_spd(n_free, m, step) < 0) {
+                lambda *= 4;
+                continue;
+            }
+
+            move = 0;
+            for (j = 0, l = 0; j < n_var; j++) {
+                xn[j] = x[j];
+                if (!free_var[j]) continue;
+                xn[j] = fmin(fmax(x[j] + step[l++], lo[j]), hi[j]);
+                move = fmax(move, fabs(xn[j] - x[j]) / fmax(fabs(x[j]), 1.0));
+            }
+            if (move < 1e-12) {
+                /* the step vanished, x is stationary within the bounds */
+                res->converged = TRUE;
+                break;
+            }
+
+            if (evaluate(src, n_var, names, xn, n_target, t, s, ac, n_threads, &q, rn) == 0) {
+                res->n_eval++;
+                cost_n = weighted_cost(n_target, t, rn);
+                if (cost_n < cost) {
+                    accepted = TRUE;
+                    clear_point(&p);
+                    p = q;
+                    memcpy(x, xn, n_var * sizeof(double));
+                    memcpy(resid, rn, n_target * sizeof(double));
+                    lambda = fmax(lambda / 3, 1e-9);
+                    break;
+                }
+                clear_point(&q);
+            }
+            lambda *= 4;
+        }
+
+        if (!accepted) {
+            /* converged if the step vanished, stuck if lambda ran out */
+            break;
+        }
+        res->n_iter = iter + 1;
+        if (cost - cost_n <= s->ftol * cost) {
+            cost = cost_n;
+            res->converged = TRUE;
+            break;
+        }
+        cost = cost_n;
+    }
+    if (cost == 0) res->converged = TRUE;
+    res->cost = cost;
+
+    clear_point(&p);
+    free(jac);
+    free(g);
+    free(a);
+    free(m);
+    free(step);
+    free(xn);
+    free(rn);
+    free(free_var);
+    return 0;
+}
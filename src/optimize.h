@@ -0,0 +1,60 @@
+/*
+ * optimize.h - fitting the variables of an XMENSUR to target resonances
+ *
+ * bore_optimize() runs a bounded Levenberg-Marquardt loop entirely in C.
+ * Every evaluation parses the kept text of the file again with new values
+ * of the free variables, compiles the bore and finds its resonances.  The
+ * Jacobian chains the adjoint sensitivities of the peaks by cell geometry
+ * with the change of the geometry by each variable, so one iteration costs
+ * a few evaluations whatever the number of variables.  Variables that
+ * change the structure of the bore (branch ratios, cells appearing) are
+ * differentiated by finite differences of whole evaluations instead.
+ */
+
+#ifndef _OPTIMIZE_H_
+#define _OPTIMIZE_H_
+
+#include "acoustic_constants.h"
+#include "xmensur.h"
+
+/* kind of a target */
+enum {
+    OPT_FREQ = 0,       /* the peak nearest to frq should be at frq */
+    OPT_RATIO           /* |Z| of the peaks nearest to frq and frq2 */
+};
+
+typedef struct {
+    int kind;
+    double frq;         /* Hz */
+    double frq2;        /* OPT_RATIO: peak of the denominator, Hz */
+    double value;       /* OPT_RATIO: target of 20 log10 |Z1 / Z2|, dB */
+    double weight;      /* residuals in cents and dB are multiplied by this */
+} opt_target;
+
+typedef struct {
+    double max_freq;    /* resonances are searched up to this frequency, Hz */
+    double step, tol;   /* grid and accuracy as bore_find_resonances() */
+    int max_iter;
+    double ftol;        /* stop when an iteration lowers the cost by less than this fraction */
+} opt_settings;
+
+typedef struct {
+    double cost;        /* half the sum of the squared weighted residuals */
+    int n_iter;         /* iterations done */
+    int n_eval;         /* bores evaluated */
+    int converged;      /* stopped by ftol, a vanishing step or zero cost */
+} opt_result;
+
+/*
+ * Fit variables names[0..n_var-1] of src, starting from and returning in
+ * x, within lo and hi (+-HUGE_VAL for none).  resid receives the residual
+ * of each target without its weight, in cents for OPT_FREQ and dB for
+ * OPT_RATIO.  Returns 0, or -1 when an argument is bad or the starting
+ * point cannot be evaluated.
+ */
+int bore_optimize(const xmen_source *src, int n_var, const char **names, double *x,
+                  const double *lo, const double *hi, int n_target, const opt_target *t,
+                  const opt_settings *s, double *resid, opt_result *res,
+                  const acoustic_constants *ac, int n_threads);
+
+#endif /* _OPTIMIZE_H_ */
@@ -0,0 +1,112 @@
+/*
+ * response.c - time-domain responses of a compiled bore
+ *
+ * The spectra are packed in GSL's halfcomplex order, real and imaginary
+ * parts of bins 1 .. n/2 after DC, and transformed by the mixed radix
+ * inverse, which takes any even length and divides by n.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex.h>
+#include <gsl/gsl_fft_real.h>
+#include <gsl/gsl_fft_halfcomplex.h>
+
+#include "kutils.h"
+#include "bore.h"
+#include "response.h"
+
+int bore_response_size(const response_opt *opt, int *n_time, int *n_freq)
+{
+    double n = ceil(opt->rate * opt->duration - 1e-9);
+
+    if (!(opt->rate > 0) || !(n >= 2) || n > 1 << 30 || !(opt->max_freq > 0) ||
+        opt->window < WINDOW_RECT || opt->window > WINDOW_BLACKMAN) {
+        fprintf(stderr, "bore_response: bad sample rate, duration, band or window.\n");
+        return -1;
+    }
+    *n_time = (int)n + ((int)n & 1);
+    *n_freq = *n_time / 2 + 1;
+    return 0;
+}
+
+/* weight of the frequency x * max_freq, 0 <= x <= 1 */
+static double window_weight(int window, double x)
+{
+    switch (window) {
+    case WINDOW_HANN:
+        return 0.5 + 0.5 * cos(M_PI * x);
+    case WINDOW_BLACKMAN:
+        return 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+    default:
+        return 1.0;
+    }
+}
+
+/* inverse transform of n_freq bins of spec weighted by w into n real samples */
+static void inverse_fft(const double complex *spec, const double *w, int n_band, int n,
+                        double *out, gsl_fft_halfcomplex_wavetable *wt,
+                        gsl_fft_real_workspace *ws)
+{
+    int k;
+
+    for (k = 0; k < n; k++) {
+        out[k] = 0;
+    }
+    out[0] = creal(spec[0]) * w[0];
+    for (k = 1; k < n_band && 2 * k < n; k++) {
+        out[2 * k - 1] = creal(spec[k]) * w[k];
+        out[2 * k] = cimag(spec[k]) * w[k];
+    }
+    if (n_band > n / 2) {
+        /* the Nyquist bin of a real signal is real */
+        out[n - 1] = creal(spec[n / 2]) * w[n / 2];
+    }
+    gsl_fft_halfcomplex_inverse(out, 1, n, wt, ws);
+}
+
+int bore_response(const bore *b, const response_opt *opt, double e_ratio, double complex *z,
+                  double complex *refl, double *r, double *h, const acoustic_constants *ac,
+                  int n_threads, int scalar)
+{
+    gsl_fft_halfcomplex_wavetable *wt;
+    gsl_fft_real_workspace *ws;
+    double step, zc, *w;
+    int k, n, n_freq, n_band;
+
+    if (bore_response_size(opt, &n, &n_freq) < 0) return -1;
+    step = opt->rate / n;
+    n_band = (int)fmin(floor(opt->max_freq / step + 1e-9), n_freq - 1) + 1;
+
+    for (k = 0; k < n_freq; k++) {
+        z[k] = refl[k] = 0;
+    }
+    bore_sweep(b, step, n_band, e_ratio, z, ac, n_threads, scalar);
+
+    zc = ac->rhoc0 / (M_PI * b->df[0] * b->df[0] / 4);
+    for (k = 1; k < n_band; k++) {
+        refl[k] = (z[k] - zc) / (z[k] + zc);
+    }
+    if (n_band > 1) {
+        z[0] = creal(z[1]);
+        refl[0] = creal(refl[1]);
+    } else {
+        refl[0] = -1;
+    }
+
+    w = m_malloc(n_freq * sizeof(double));
+    for (k = 0; k < n_freq; k++) {
+        w[k] = (k < n_band) ? window_weight(opt->window, k * step / opt->max_freq) : 0;
+    }
+
+    wt = gsl_fft_halfcomplex_wavetable_alloc(n);
+    ws = gsl_fft_real_workspace_alloc(n);
+    inverse_fft(refl, w, n_band, n, r, wt, ws);
+    inverse_fft(z, w, n_band, n, h, wt, ws);
+    gsl_fft_halfcomplex_wavetable_free(wt);
+    gsl_fft_real_workspace_free(ws);
+
+    free(w);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * response.h - time-domain responses of a compiled bore
+ *
+ * bore_response() sweeps the input impedance on the frequency grid of an
+ * FFT of the requested sample rate and duration, forms the reflectance
+ * R = (Z - Zc) / (Z + Zc) with the characteristic impedance Zc of the
+ * input, tapers the band with a window and transforms R and Z back with
+ * GSL's real FFT, so that no intermediate spectrum leaves C.
+ */
+
+#ifndef _RESPONSE_H_
+#define _RESPONSE_H_
+
+#include <complex.h>
+#include "acoustic_constants.h"
+#include "bore.h"
+
+/* taper of the band 0 .. max_freq before the inverse transform */
+enum {
+    WINDOW_RECT = 0,    /* none, the band is cut off */
+    WINDOW_HANN,        /* half Hann, 1 at DC to 0 at max_freq */
+    WINDOW_BLACKMAN     /* half Blackman */
+};
+
+typedef struct {
+    double rate;        /* sample rate, Hz */
+    double duration;    /* length of the responses, s */
+    double max_freq;    /* band evaluated, above it the spectrum is zero, Hz */
+    int window;
+} response_opt;
+
+/*
+ * Length of the responses (ceil(rate * duration), rounded up to even) and
+ * number of frequency bins 0 .. rate/2, step rate / n_time.  Returns -1 on
+ * bad options.
+ */
+int bore_response_size(const response_opt *opt, int *n_time, int *n_freq);
+
+/*
+ * Input impedance z and reflectance refl per bin (zero above max_freq),
+ * and the sampled reflection function r and impulse response h of Z per
+ * time step, so that a response is y[n] = sum_m r[m] x[n - m].  DC, where
+ * the sweep gives no value, is the real part of the first bin.  Returns -1
+ * on bad options.
+ */
+int bore_response(const bore *b, const response_opt *opt, double e_ratio, double complex *z,
+                  double complex *refl, double *r, double *h, const acoustic_constants *ac,
+                  int n_threads, int scalar);
+
+#endif /* _RESPONSE_H_ */
@@ -0,0 +1,551 @@
+/*
+ * sensitivity.c - derivatives of the input impedance by cell geometry
+ *
+ * The forward pass is bore_input_impedance(), which leaves the impedance
+ * and the transmission matrix of every evaluated cell in a bore_work.  The
+ * backward pass visits the branches from their inlet, carrying
+ * adj[i] = dZ/dzi[i], and collects dZ/dM of every cell; the derivatives of
+ * each matrix by its own geometry then give the result.  Everything is
+ * holomorphic in the complex quantities, so no conjugates appear.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "kutils.h"
+#include "zmensur.h"
+#include "cxmath.h"
+#include "bore.h"
+#include "sensitivity.h"
+
+bore_sens_work *create_bore_sens_work(const bore *b)
+{
+    bore_sens_work *sw;
+    int n = b->n_cell;
+
+    sw = m_calloc(1, sizeof(bore_sens_work));
+    sw->wk = create_bore_work(b);
+    sw->adj = m_calloc(n, sizeof(double complex));
+    sw->g11 = m_calloc(n, sizeof(double complex));
+    sw->g12 = m_calloc(n, sizeof(double complex));
+    sw->g21 = m_calloc(n, sizeof(double complex));
+    sw->g22 = m_calloc(n, sizeof(double complex));
+    sw->r11 = m_calloc(n, sizeof(double complex));
+    sw->r12 = m_calloc(n, sizeof(double complex));
+    sw->r21 = m_calloc(n, sizeof(double complex));
+    sw->r22 = m_calloc(n, sizeof(double complex));
+    return sw;
+}
+
+void dispose_bore_sens_work(bore_sens_work *sw)
+{
+    if (sw == NULL) return;
+    dispose_bore_work(sw->wk);
+    free(sw->adj);
+    free(sw->g11);
+    free(sw->g12);
+    free(sw->g21);
+    free(sw->g22);
+    free(sw->r11);
+    free(sw->r12);
+    free(sw->r21);
+    free(sw->r22);
+    free(sw);
+}
+
+/* ------------------------------ cell derivatives ------------------------------*/
+
+/*
+ * g(x) = (x cos x - sin x) / x^2 and its derivative, by series near 0
+ * where the closed forms cancel
+ */
+static void cone_g(double complex x, double complex s, double complex c,
+                   double complex *g, double complex *gp)
+{
+    double complex x2 = x * x;
+
+    if (cabs(x) < 0.05) {
+        *g = x * (-1.0 / 3 + x2 * (1.0 / 30 - x2 / 840));
+        *gp = -1.0 / 3 + x2 * (1.0 / 10 - x2 / 168);
+    } else {
+        *g = (x * c - s) / x2;
+        *gp = (2 * s - 2 * x * c - x2 * s) / (x2 * x);
+    }
+}
+
+/*
+ * Derivatives of the transmission matrix of cell i (r > 0, no section
+ * variation) by df, db and r, each as {11, 12, 21, 22}.  The matrix of
+ * cell_matrix() is written as a function of r1 = df/2, r2 = db/2 and
+ * x = k r, the straight cell being the cone with r1 == r2:
+ *   m11 = (r2/r1) cos x - (r2-r1)/r1 sin x/x
+ *   m12 = I rhoc0 sin x / (PI r1 r2)
+ *   m21 = -I PI / rhoc0 ((r2-r1)^2 g(x) - r1 r2 sin x)
+ *   m22 = (r1/r2) cos x + (r2-r1)/r2 sin x/x
+ * and k depends on the mean diameter through the wall loss.
+ */
+static void cell_dmatrix(const bore *b, int i, double frq, const acoustic_constants *ac,
+                         double complex *d_df, double complex *d_db, double complex *d_r)
+{
+    double complex k, dk, x, s, c, g, gp, f;
+    double complex p[4][3];     /* dM/dr1, dM/dr2, dM/dx */
+    double d1, d2, d, L, w, aa, r1, r2, dl;
+    int m;
+
+    w = PI2 * frq;
+    d1 = b->df[i];
+    d2 = b->db[i];
+    d = (d1 + d2) * 0.5;
+    L = b->r[i];
+
+    aa = (1 + (GMM - 1) / sqrt(Pr)) * sqrt(2 * w * ac->nu) / ac->c0 / d;
+
+    if (ac->dump_calc == WALL) {
+        k = cx_sqrt((w / ac->c0) * (w / ac->c0 - 2 * (I - 1) * aa));
+        /* aa is proportional to 1/d */
+        dk = (w / ac->c0) * (I - 1) * aa / (k * d);
+    } else {
+        k = w / ac->c0;
+        dk = 0;
+    }
+    x = k * L;
+    cx_sincos(x, &s, &c, ac->cx_mode);
+    cone_g(x, s, c, &g, &gp);
+
+    r1 = d1 / 2;
+    r2 = d2 / 2;
+    dl = r2 - r1;
+    f = -I * PI / ac->rhoc0;
+
+    /* c - s/x = x g */
+    p[0][0] = -(r2 / (r1 * r1)) * x * g;
+    p[0][1] = x * g / r1;
+    p[0][2] = -(r2 / r1) * s - (dl / r1) * g;
+
+    p[1][0] = -I * ac->rhoc0 * s / (PI * r1 * r1 * r2);
+    p[1][1] = -I * ac->rhoc0 * s / (PI * r1 * r2 * r2);
+    p[1][2] = I * ac->rhoc0 * c / (PI * r1 * r2);
+
+    p[2][0] = f * (-2 * dl * g - r2 * s);
+    p[2][1] = f * (2 * dl * g - r1 * s);
+    p[2][2] = f * (dl * dl * gp - r1 * r2 * c);
+
+    p[3][0] = x * g / r2;
+    p[3][1] = -(r1 / (r2 * r2)) * x * g;
+    p[3][2] = -(r1 / r2) * s + (dl / r2) * g;
+
+    /* dx/d(df) = dx/d(db) = L dk/dd / 2 */
+    for (m = 0; m < 4; m++) {
+        d_df[m] = p[m][0] / 2 + p[m][2] * L * dk / 2;
+        d_db[m] = p[m][1] / 2 + p[m][2] * L * dk / 2;
+        d_r[m] = p[m][2] * k;
+    }
+}
+
+/* d(radiation impedance)/d(diameter) by central difference */
+static double complex rad_dimp(double frq, double d, const acoustic_constants *ac)
+{
+    double complex zp, zm;
+    double h = d * 1e-6;
+
+    rad_imp(frq, d + h, &zp, ac);
+    rad_imp(frq, d - h, &zm, ac);
+    return (zp - zm) / (2 * h);
+}
+
+/* ------------------------------ backward pass ------------------------------*/
+
+/*
+ * P = M(lo) M(lo+1) ... M(hi) with dZ/dP = G: add dZ/dM(j) = L^T G R^T of
+ * every factor, L and R the products in front of and behind it
+ */
+static void product_adjoint(bore_sens_work *sw, int lo, int hi, const double complex *G)
+{
+    const bore_work *wk = sw->wk;
+    double complex l11 = 1.0, l12 = 0.0, l21 = 0.0, l22 = 1.0;
+    double complex x11, x12, x21, x22, t11, t12, t21, t22;
+    int j;
+
+    if (hi < lo) return;
+
+    sw->r11[hi] = 1.0; sw->r12[hi] = 0.0;
+    sw->r21[hi] = 0.0; sw->r22[hi] = 1.0;
+    for (j = hi - 1; j >= lo; j--) {
+        sw->r11[j] = wk->m11[j + 1] * sw->r11[j + 1] + wk->m12[j + 1] * sw->r21[j + 1];
+        sw->r12[j] = wk->m11[j + 1] * sw->r12[j + 1] + wk->m12[j + 1] * sw->r22[j + 1];
+        sw->r21[j] = wk->m21[j + 1] * sw->r11[j + 1] + wk->m22[j + 1] * sw->r21[j + 1];
+        sw->r22[j] = wk->m21[j + 1] * sw->r12[j + 1] + wk->m22[j + 1] * sw->r22[j + 1];
+    }
+
+    for (j = lo; j <= hi; j++) {
+        /* X = L^T G */
+        x11 = l11 * G[0] + l21 * G[2];
+        x12 = l11 * G[1] + l21 * G[3];
+        x21 = l12 * G[0] + l22 * G[2];
+        x22 = l12 * G[1] + l22 * G[3];
+
+        /* X R^T */
+        sw->g11[j] += x11 * sw->r11[j] + x12 * sw->r12[j];
+        sw->g12[j] += x11 * sw->r21[j] + x12 * sw->r22[j];
+        sw->g21[j] += x21 * sw->r11[j] + x22 * sw->r12[j];
+        sw->g22[j] += x21 * sw->r21[j] + x22 * sw->r22[j];
+
+        /* L = L M(j) */
+        t11 = l11 * wk->m11[j] + l12 * wk->m21[j];
+        t12 = l11 * wk->m12[j] + l12 * wk->m22[j];
+        t21 = l21 * wk->m11[j] + l22 * wk->m21[j];
+        t22 = l21 * wk->m12[j] + l22 * wk->m22[j];
+        l11 = t11; l12 = t12;
+        l21 = t21; l22 = t22;
+    }
+}
+
+/* chain matrix of branch br without its terminal cell, as branch_chain() */
+static void side_chain(const bore *b, const bore_work *wk, int br, double complex *P)
+{
+    double complex x11, x12, x21, x22;
+    int i;
+
+    P[0] = 1.0; P[1] = 0.0;
+    P[2] = 0.0; P[3] = 1.0;
+    for (i = b->last[br] - 1; i >= b->first[br]; i--) {
+        x11 = wk->m11[i] * P[0] + wk->m12[i] * P[2];
+        x12 = wk->m11[i] * P[1] + wk->m12[i] * P[3];
+        x21 = wk->m21[i] * P[0] + wk->m22[i] * P[2];
+        x22 = wk->m21[i] * P[1] + wk->m22[i] * P[3];
+        P[0] = x11; P[1] = x12;
+        P[2] = x21; P[3] = x22;
+    }
+}
+
+/*
+ * Impedance at a SPLIT as split_load() in bore.c, with its derivatives by
+ * the side chain m, the main path n and z2
+ */
+static double complex split_adjoint(const double complex *m, const double complex *n, double s,
+                                    double complex z2, int z2inf,
+                                    double complex *dm, double complex *dn, double complex *dz2)
+{
+    double complex m11 = m[0], m12 = m[1] / (1 - s), m21 = m[2] * (1 - s), m22 = m[3];
+    double complex n11 = n[0], n12 = n[1] / s, n21 = n[2] * s, n22 = n[3];
+    double complex c0 = z2inf ? 0.0 : 1.0, zz = z2inf ? 1.0 : z2;
+    double complex q, num, den, zo;
+
+    /* zo = num / den, with z2 -> infinity dropping c0 */
+    q = (m12 + n12) * (m21 + n21) - (m11 - n11) * (m22 - n22);
+    num = c0 * m12 * n12 + (m12 * n11 + m11 * n12) * zz;
+    den = c0 * (m22 * n12 + m12 * n22) + q * zz;
+    zo = num / den;
+
+    /* d zo = (d num - zo d den) / den */
+    dm[0] = (n12 * zz + zo * (m22 - n22) * zz) / den;
+    dm[1] = (c0 * n12 + n11 * zz - zo * (c0 * n22 + (m21 + n21) * zz)) / den / (1 - s);
+    dm[2] = (-zo * (m12 + n12) * zz) / den * (1 - s);
+    dm[3] = (-zo * (c0 * n12 - (m11 - n11) * zz)) / den;
+    dn[0] = (m12 * zz - zo * (m22 - n22) * zz) / den;
+    dn[1] = (c0 * m12 + m11 * zz - zo * (c0 * m22 + (m21 + n21) * zz)) / den / s;
+    dn[2] = (-zo * (m12 + n12) * zz) / den * s;
+    dn[3] = (-zo * (c0 * m12 + (m11 - n11) * zz)) / den;
+    *dz2 = z2inf ? 0.0 : (m12 * n11 + m11 * n12 - zo * q) / den;
+
+    return zo;
+}
+
+/*
+ * Propagate adj[first] of branch br, already final, through the branch
+ * and its side branches.  e_ratio is that of its open end.
+ */
+static void adjoint_branch(const bore *b, bore_sens_work *sw, int br, double frq, double e_ratio,
+                           const acoustic_constants *ac, double complex *d_df)
+{
+    bore_work *wk = sw->wk;
+    double complex a, a_zo, zo, z1, z2, dz1, dz2, D, P[4], N[4], dP[4], dN[4], G[4];
+    double s;
+    int i, j, k, sb, nm, oinf, z2inf, first = b->first[br], last = b->last[br];
+
+    for (i = first; i < last; i++) {
+        a = sw->adj[i];
+        if (a == 0) continue;
+
+        /* outlet of cell i as calc_cell() saw it */
+        z2 = wk->zi[i + 1];
+        z2inf = wk->zinf[i + 1];
+        zo = z2;
+        oinf = z2inf;
+        dz1 = 0.0;
+        dz2 = 1.0;
+        sb = b->side[i];
+        s = b->s_ratio[i];
+        nm = -1;
+        if (sb >= 0 && b->s_type[i] == TONEHOLE) {
+            z1 = wk->zi[b->first[sb]];
+            if (wk->zinf[b->first[sb]]) {
+                /* closed hole seen through */
+            } else if (z2inf) {
+                zo = z1;
+                oinf = 0;
+                dz1 = 1.0;
+                dz2 = 0.0;
+            } else {
+                zo = z1 * z2 / (z1 + z2);
+                dz1 = z2 * z2 / ((z1 + z2) * (z1 + z2));
+                dz2 = z1 * z1 / ((z1 + z2) * (z1 + z2));
+            }
+        } else if (sb >= 0 && b->s_type[i] == ADDON && s > 0) {
+            side_chain(b, wk, sb, P);
+            D = P[1] * P[2] - (1 - P[0]) * (1 - P[3]);
+            z1 = P[1] / D / s;
+            dP[0] = -P[1] * (1 - P[3]) / (s * D * D);
+            dP[1] = -(1 - P[0]) * (1 - P[3]) / (s * D * D);
+            dP[2] = -P[1] * P[1] / (s * D * D);
+            dP[3] = -P[1] * (1 - P[0]) / (s * D * D);
+            if (z2inf) {
+                zo = z1;
+                dz1 = 1.0;
+                dz2 = 0.0;
+            } else {
+                z2 /= (1 - s);
+                zo = z1 * z2 / (z1 + z2);
+                dz1 = z2 * z2 / ((z1 + z2) * (z1 + z2));
+                dz2 = z1 * z1 / ((z1 + z2) * (z1 + z2)) / (1 - s);
+            }
+            oinf = 0;
+        } else if (sb >= 0 && b->s_type[i] == SPLIT && s > 0) {
+            side_chain(b, wk, sb, P);
+            nm = b->join[i];
+            k = b->slot[i];
+            N[0] = wk->s11[k]; N[1] = wk->s12[k];
+            N[2] = wk->s21[k]; N[3] = wk->s22[k];
+            zo = split_adjoint(P, N, s, wk->zi[nm + 1], wk->zinf[nm + 1], dP, dN, &dz2);
+            oinf = 0;
+        }
+
+        /* zi = (m11 zo + m12) / (m21 zo + m22) */
+        if (b->kind[i] == BORE_NULL) {
+            a_zo = a;
+        } else if (!oinf) {
+            D = wk->m21[i] * zo + wk->m22[i];
+            sw->g11[i] += a * zo / D;
+            sw->g12[i] += a / D;
+            sw->g21[i] -= a * wk->zi[i] * zo / D;
+            sw->g22[i] -= a * wk->zi[i] / D;
+            a_zo = a * (wk->m11[i] - wk->zi[i] * wk->m21[i]) / D;
+        } else {
+            sw->g11[i] += a / wk->m21[i];
+            sw->g21[i] -= a * wk->zi[i] / wk->m21[i];
+            a_zo = 0.0;
+        }
+        if (a_zo == 0) continue;
+
+        /* into the loads behind */
+        if (nm >= 0) {
+            for (j = 0; j < 4; j++) G[j] = a_zo * dP[j];
+            product_adjoint(sw, b->first[sb], b->last[sb] - 1, G);
+            for (j = 0; j < 4; j++) G[j] = a_zo * dN[j];
+            product_adjoint(sw, i + 1, nm, G);
+            sw->adj[nm + 1] += a_zo * dz2;
+        } else if (sb >= 0 && b->s_type[i] == ADDON && s > 0) {
+            for (j = 0; j < 4; j++) G[j] = a_zo * dz1 * dP[j];
+            product_adjoint(sw, b->first[sb], b->last[sb] - 1, G);
+            sw->adj[i + 1] += a_zo * dz2;
+        } else {
+            sw->adj[i + 1] += a_zo * dz2;
+            if (dz1 != 0) {
+                sw->adj[b->first[sb]] += a_zo * dz1;
+                adjoint_branch(b, sw, sb, frq, s, ac, d_df);
+            }
+        }
+    }
+
+    /* radiation of the open end */
+    a = sw->adj[last];
+    if (a != 0 && b->kind[last] != BORE_CLOSED_END && e_ratio != 0 && ac->rad_calc != NONE) {
+        d_df[last] += a * e_ratio * rad_dimp(frq, b->df[last] * e_ratio, ac);
+    }
+}
+
+int bore_sensitivity(double frq, const bore *b, bore_sens_work *sw, double e_ratio,
+                     double complex *z, double complex *d_df, double complex *d_db,
+                     double complex *d_r, const acoustic_constants *ac)
+{
+    double complex m_df[4], m_db[4], m_r[4];
+    int i, n = b->n_cell;
+
+    if (ac->sec_var_calc) {
+        fprintf(stderr, "bore_sensitivity: section variation is not supported.\n");
+        return -1;
+    }
+
+    memset(d_df, 0, n * sizeof(double complex));
+    memset(d_db, 0, n * sizeof(double complex));
+    memset(d_r, 0, n * sizeof(double complex));
+    if (frq <= 0) {
+        *z = 0.0;
+        return 0;
+    }
+
+    bore_input_impedance(frq, b, sw->wk, e_ratio, z, ac);
+
+    memset(sw->adj, 0, n * sizeof(double complex));
+    memset(sw->g11, 0, n * sizeof(double complex));
+    memset(sw->g12, 0, n * sizeof(double complex));
+    memset(sw->g21, 0, n * sizeof(double complex));
+    memset(sw->g22, 0, n * sizeof(double complex));
+    sw->adj[b->first[0]] = 1.0;
+    adjoint_branch(b, sw, 0, frq, e_ratio, ac, d_df);
+
+    for (i = 0; i < n; i++) {
+        if (b->kind[i] != BORE_STRAIGHT && b->kind[i] != BORE_TAPER) continue;
+        if (sw->g11[i] == 0 && sw->g12[i] == 0 && sw->g21[i] == 0 && sw->g22[i] == 0) continue;
+        cell_dmatrix(b, i, frq, ac, m_df, m_db, m_r);
+        d_df[i] += sw->g11[i] * m_df[0] + sw->g12[i] * m_df[1] +
+            sw->g21[i] * m_df[2] + sw->g22[i] * m_df[3];
+        d_db[i] += sw->g11[i] * m_db[0] + sw->g12[i] * m_db[1] +
+            sw->g21[i] * m_db[2] + sw->g22[i] * m_db[3];
+        d_r[i] += sw->g11[i] * m_r[0] + sw->g12[i] * m_r[1] +
+            sw->g21[i] * m_r[2] + sw->g22[i] * m_r[3];
+    }
+    return 0;
+}
+
+/* ------------------------------ sweeps ------------------------------*/
+
+typedef struct {
+    const bore *b;
+    const acoustic_constants *ac;
+    const double *frq;
+    double e_ratio;
+    int from, to;
+    double complex *z, *d_df, *d_db, *d_r;
+} sens_chunk;
+
+static gpointer sens_worker(gpointer data)
+{
+    sens_chunk *c = data;
+    bore_sens_work *sw;
+    int i, n = c->b->n_cell;
+
+    sw = create_bore_sens_work(c->b);
+    for (i = c->from; i < c->to; i++) {
+        bore_sensitivity(c->frq[i], c->b, sw, c->e_ratio, &c->z[i],
+                         &c->d_df[(size_t)i * n], &c->d_db[(size_t)i * n], &c->d_r[(size_t)i * n],
+                         c->ac);
+    }
+    dispose_bore_sens_work(sw);
+    return NULL;
+}
+
+int bore_sensitivity_sweep(const bore *b, const double *frq, int n, double e_ratio,
+                           double complex *z, double complex *d_df, double complex *d_db,
+                           double complex *d_r, const acoustic_constants *ac, int n_threads)
+{
+    sens_chunk *c;
+    GThread **th;
+    int k;
+
+    if (ac->sec_var_calc) {
+        fprintf(stderr, "bore_sensitivity_sweep: section variation is not supported.\n");
+        return -1;
+    }
+
+    if (n_threads <= 0) n_threads = g_get_num_processors();
+    n_threads = MIN(n_threads, n);
+    if (n_threads < 1) return 0;
+
+    c = m_calloc(n_threads, sizeof(sens_chunk));
+    th = m_calloc(n_threads, sizeof(GThread *));
+    for (k = 0; k < n_threads; k++) {
+        c[k].b = b;
+        c[k].ac = ac;
+        c[k].frq = frq;
+        c[k].e_ratio = e_ratio;
+        c[k].from = (int)((long)n * k / n_threads);
+        c[k].to = (int)((long)n * (k + 1) / n_threads);
+        c[k].z = z;
+        c[k].d_df = d_df;
+        c[k].d_db = d_db;
+        c[k].d_r = d_r;
+    }
+
+    /* the calling thread takes the first chunk itself */
+    for (k = 1; k < n_threads; k++) {
+        th[k] = g_thread_new("bore_sensitivity", sens_worker, &c[k]);
+    }
+    sens_worker(&c[0]);
+    for (k = 1; k < n_threads; k++) {
+        g_thread_join(th[k]);
+    }
+
+    free(th);
+    free(c);
+    return 0;
+}
+
+/*
+ * A peak f0 of |Z| is a zero of h = d/df Re log Z, so for any parameter p
+ *   df0/dp = -(dh/dp) / (dh/df)
+ * dh/dp = Re d/df (Z_p / Z) and dh/df are central differences over
+ * f0 +- delta, the adjoint passes at those two frequencies giving Z_p.
+ * That is two passes per peak on top of the peak search instead of one;
+ * d/df of the chain by the same adjoint would save one of them.
+ */
+int bore_resonance_sensitivity(const bore *b, const resonance *res, int n_peak, double e_ratio,
+                               double *d_df, double *d_db, double *d_r,
+                               const acoustic_constants *ac, int n_threads)
+{
+    double *frq, delta, curv;
+    double complex *z, *z0, *g_df, *g_db, *g_r;
+    size_t lo, hi;
+    int k, i, n = b->n_cell;
+
+    frq = m_malloc((2 * n_peak + 1) * sizeof(double));
+    z = m_malloc((2 * n_peak + 1) * sizeof(double complex));
+    z0 = m_malloc((n_peak + 1) * sizeof(double complex));
+    g_df = m_malloc(((size_t)2 * n_peak * n + 1) * sizeof(double complex));
+    g_db = m_malloc(((size_t)2 * n_peak * n + 1) * sizeof(double complex));
+    g_r = m_malloc(((size_t)2 * n_peak * n + 1) * sizeof(double complex));
+
+    for (k = 0; k < n_peak; k++) {
+        delta = res[k].frq * 1e-5;
+        frq[2 * k] = res[k].frq - delta;
+        frq[2 * k + 1] = res[k].frq + delta;
+        z0[k] = res[k].z;
+    }
+    if (bore_sensitivity_sweep(b, frq, 2 * n_peak, e_ratio, z, g_df, g_db, g_r, ac,
+                               n_threads) < 0) {
+        free(frq);
+        free(z);
+        free(z0);
+        free(g_df);
+        free(g_db);
+        free(g_r);
+        return -1;
+    }
+
+    for (k = 0; k < n_peak; k++) {
+        delta = res[k].frq * 1e-5;
+        curv = (log(cabs(z[2 * k + 1])) - 2 * log(cabs(z0[k])) + log(cabs(z[2 * k]))) /
+            (delta * delta);
+        lo = (size_t)2 * k * n;
+        hi = lo + n;
+        for (i = 0; i < n; i++) {
+            d_df[(size_t)k * n + i] = -creal(g_df[hi + i] / z[2 * k + 1] -
+                                             g_df[lo + i] / z[2 * k]) / (2 * delta) / curv;
+            d_db[(size_t)k * n + i] = -creal(g_db[hi + i] / z[2 * k + 1] -
+                                             g_db[lo + i] / z[2 * k]) / (2 * delta) / curv;
+            d_r[(size_t)k * n + i] = -creal(g_r[hi + i] / z[2 * k + 1] -
+                                            g_r[lo + i] / z[2 * k]) / (2 * delta) / curv;
+        }
+    }
+
+    free(frq);
+    free(z);
+    free(z0);
+    free(g_df);
+    free(g_db);
+    free(g_r);
+    return 0;
+}
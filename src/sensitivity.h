@@ -0,0 +1,61 @@
+/*
+ * sensitivity.h - derivatives of the input impedance by cell geometry
+ *
+ * bore_sensitivity() evaluates the bore once and then walks it back from
+ * the input (the adjoint of calc_branch()), so that dZ/d(df), dZ/d(db) and
+ * dZ/d(r) of every cell come out of one forward and one backward pass
+ * instead of one sweep per parameter.  The transmission matrices are
+ * differentiated analytically; only the radiation impedance of an open end
+ * is differentiated by a central difference.
+ *
+ * Section variation (sec_var_calc) couples neighbouring cells and is not
+ * supported.  Cells of zero length have zero sensitivities.
+ */
+
+#ifndef _SENSITIVITY_H_
+#define _SENSITIVITY_H_
+
+#include <complex.h>
+#include "acoustic_constants.h"
+#include "bore.h"
+#include "spectrum.h"
+
+/* per-frequency scratch of bore_sensitivity(), owned by the caller */
+typedef struct {
+    bore_work *wk;         /* forward pass */
+    double complex *adj;   /* dZ/dzi of each cell */
+    double complex *g11, *g12, *g21, *g22; /* dZ/dM of each cell */
+    double complex *r11, *r12, *r21, *r22; /* products behind each cell of a chain */
+} bore_sens_work;
+
+bore_sens_work *create_bore_sens_work(const bore *b);
+void dispose_bore_sens_work(bore_sens_work *sw);
+
+/*
+ * Input impedance z at frq and its derivatives by the geometry of every
+ * cell, in ohm per meter, into d_df, d_db and d_r of n_cell entries each.
+ * Returns -1 with sec_var_calc, else 0.
+ */
+int bore_sensitivity(double frq, const bore *b, bore_sens_work *sw, double e_ratio,
+                     double complex *z, double complex *d_df, double complex *d_db,
+                     double complex *d_r, const acoustic_constants *ac);
+
+/*
+ * bore_sensitivity() at n frequencies on n_threads threads (<= 0 uses every
+ * processor).  Row i of the n x n_cell arrays belongs to frq[i]; frequencies
+ * that are not positive give zeros.
+ */
+int bore_sensitivity_sweep(const bore *b, const double *frq, int n, double e_ratio,
+                           double complex *z, double complex *d_df, double complex *d_db,
+                           double complex *d_r, const acoustic_constants *ac, int n_threads);
+
+/*
+ * Derivatives of the frequencies of the n_peak resonances found by
+ * bore_find_resonances() by the geometry of every cell, in Hz per meter,
+ * into n_peak x n_cell arrays.  Each peak takes two adjoint passes.
+ */
+int bore_resonance_sensitivity(const bore *b, const resonance *res, int n_peak, double e_ratio,
+                               double *d_df, double *d_db, double *d_r,
+                               const acoustic_constants *ac, int n_threads);
+
+#endif /* _SENSITIVITY_H_ */
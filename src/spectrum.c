@@ -0,0 +1,423 @@
+/*
+ * spectrum.c - frequency analysis of a compiled bore
+ *
+ * The impedance itself comes from bore_sweep_at(), so every batch of
+ * frequencies is shared among threads and SIMD lanes like a uniform sweep.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <complex.h>
+
+#include "kutils.h"
+#include "bore.h"
+#include "spectrum.h"
+
+/* ------------------------------ adaptive sweep ------------------------------*/
+
+/* interval priorities */
+enum { KEEP = 0, COARSE, PEAK };
+
+static double level_db(double complex z)
+{
+    double m = creal(z) * creal(z) + cimag(z) * cimag(z);
+
+    return (m > 0) ? 10 * log10(m) : -HUGE_VAL;
+}
+
+/* may the interval frq[k]..frq[k+1] be halved */
+static int splittable(const double *frq, int k, const spectrum_opt *opt)
+{
+    return frq[k] > 0 && (frq[k + 1] - frq[k]) / 2 >= opt->min_step;
+}
+
+/*
+ * Decide which of the n-1 intervals of frq[] to halve.  Both intervals
+ * around a local maximum or minimum of |Z| are PEAK, intervals whose level
+ * or phase changes more than the tolerances are COARSE.  The interval
+ * from DC is never halved.  Returns the number of marked intervals.
+ */
+static int mark_intervals(int n, const double *frq, const double complex *z, const double *db,
+                          const spectrum_opt *opt, char *mark)
+{
+    int k, count = 0;
+
+    for (k = 0; k < n - 1; k++) {
+        mark[k] = KEEP;
+        if (!splittable(frq, k, opt)) continue;
+        if (fabs(db[k + 1] - db[k]) > opt->tol_db ||
+            fabs(carg(z[k + 1] * conj(z[k]))) > opt->tol_phase) {
+            mark[k] = COARSE;
+        }
+    }
+    for (k = 1; k < n - 1; k++) {
+        if (frq[k - 1] <= 0 || (db[k] - db[k - 1]) * (db[k + 1] - db[k]) > 0) continue;
+        if (splittable(frq, k - 1, opt)) mark[k - 1] = PEAK;
+        if (splittable(frq, k, opt)) mark[k] = PEAK;
+    }
+    for (k = 0; k < n - 1; k++) {
+        if (mark[k] != KEEP) count++;
+    }
+    return count;
+}
+
+/* keep only the first budget marks, PEAK ones before COARSE ones */
+static void limit_marks(int n, char *mark, int budget)
+{
+    int k, level;
+
+    for (level = PEAK; level >= COARSE; level--) {
+        for (k = 0; k < n - 1; k++) {
+            if (mark[k] != level) continue;
+            if (budget > 0) {
+                budget--;
+            } else {
+                mark[k] = KEEP;
+            }
+        }
+    }
+}
+
+int bore_adaptive_sweep(const bore *b, double max_freq, const spectrum_opt *opt,
+                        double e_ratio, double **frq, double complex **z,
+                        const acoustic_constants *ac, int n_threads, int scalar)
+{
+    double *f, *nf, *mid, *db;
+    double complex *zz, *nz, *zm;
+    char *mark;
+    int i, k, n, n_mid;
+
+    if (!(opt->step > 0) || !(opt->min_step > 0) || !(max_freq >= 0)) {
+        fprintf(stderr, "bore_adaptive_sweep: step and min_step must be positive.\n");
+        return -1;
+    }
+
+    /* coarse grid, the same points as bore_sweep() */
+    n = max_freq / opt->step + 1;
+    f = m_malloc(n * sizeof(double));
+    zz = m_malloc(n * sizeof(double complex));
+    for (i = 0; i < n; i++) f[i] = i * opt->step;
+    bore_sweep_at(b, f, n, e_ratio, zz, ac, n_threads, scalar);
+
+    /* every round halves the marked intervals, all midpoints in one batch */
+    for (;;) {
+        db = m_malloc(n * sizeof(double));
+        mark = m_malloc(n);
+        for (i = 0; i < n; i++) db[i] = level_db(zz[i]);
+        n_mid = mark_intervals(n, f, zz, db, opt, mark);
+        if (n + n_mid > opt->max_points) {
+            n_mid = MAX(opt->max_points - n, 0);
+            limit_marks(n, mark, n_mid);
+        }
+        free(db);
+        if (n_mid == 0) {
+            free(mark);
+            break;
+        }
+
+        mid = m_malloc(n_mid * sizeof(double));
+        zm = m_malloc(n_mid * sizeof(double complex));
+        for (k = 0, i = 0; k < n - 1; k++) {
+            if (mark[k] != KEEP) mid[i++] = (f[k] + f[k + 1]) / 2;
+        }
+        bore_sweep_at(b, mid, n_mid, e_ratio, zm, ac, n_threads, scalar);
+
+        /* merge, the midpoints keep the order */
+        nf = m_malloc((n + n_mid) * sizeof(double));
+        nz = m_malloc((n + n_mid) * sizeof(double complex));
+        for (k = 0, i = 0; k < n; k++) {
+            nf[k + i] = f[k];
+            nz[k + i] = zz[k];
+            if (k < n - 1 && mark[k] != KEEP) {
+                i++;
+                nf[k + i] = mid[i - 1];
+                nz[k + i] = zm[i - 1];
+            }
+        }
+        free(f);
+        free(zz);
+        free(mid);
+        free(zm);
+        free(mark);
+        f = nf;
+        zz = nz;
+        n += n_mid;
+    }
+
+    *frq = f;
+    *z = zz;
+    return n;
+}
+
+/* ------------------------------ resonances ------------------------------*/
+/*
+ * Every peak is searched on its own, but one step of all searches is taken
+ * at a time so that the new frequencies of all peaks go to bore_sweep_at()
+ * in one batch.  The searches are therefore written as state machines:
+ * *_next() proposes the next frequency, *_update() takes its value.
+ */
+
+#define GOLDEN 0.3819660112501051
+#define MAX_ITER 100
+
+/* half power relative to the peak */
+#define HALF_POWER_DB 3.0102999566398120
+
+/* Brent's minimization of f on a < x < b, as in Numerical Recipes */
+typedef struct {
+    double a, b;            /* bracket */
+    double x, w, v;         /* best, second best and previous point */
+    double fx, fw, fv;
+    double d, e;            /* last and second last step */
+    double u;               /* pending point */
+    double complex zx;      /* impedance at x */
+    int iter;
+} brent_state;
+
+/* Illinois false position for f(x) = 0 with f(lo) < 0 < f(hi) */
+typedef struct {
+    double lo, hi;          /* lo may be above hi */
+    double flo, fhi;
+    double u;               /* pending point */
+    int side;               /* end replaced last, -1 lo, 1 hi */
+    int iter;
+} root_state;
+
+static void brent_init(brent_state *s, double a, double x, double b, double fx, double complex zx)
+{
+    s->a = a;
+    s->b = b;
+    s->x = s->w = s->v = x;
+    s->fx = s->fw = s->fv = fx;
+    s->d = s->e = 0;
+    s->zx = zx;
+    s->iter = 0;
+}
+
+/* next point into s->u, FALSE when x is within tol */
+static int brent_next(brent_state *s, double tol)
+{
+    double xm = (s->a + s->b) / 2, tol2 = 2 * tol;
+    double p, q, r, e;
+
+    if (fabs(s->x - xm) <= tol2 - (s->b - s->a) / 2 || s->iter >= MAX_ITER) return FALSE;
+    if (fabs(s->e) > tol) {
+        /* parabola through x, w, v */
+        r = (s->x - s->w) * (s->fx - s->fv);
+        q = (s->x - s->v) * (s->fx - s->fw);
+        p = (s->x - s->v) * q - (s->x - s->w) * r;
+        q = 2 * (q - r);
+        if (q > 0) p = -p;
+        q = fabs(q);
+        e = s->e;
+        s->e = s->d;
+        if (fabs(p) >= fabs(q * e / 2) || p <= q * (s->a - s->x) || p >= q * (s->b - s->x)) {
+            s->e = (s->x >= xm) ? s->a - s->x : s->b - s->x;
+            s->d = GOLDEN * s->e;
+        } else {
+            s->d = p / q;
+            if (s->x + s->d - s->a < tol2 || s->b - s->x - s->d < tol2) {
+                s->d = copysign(tol, xm - s->x);
+            }
+        }
+    } else {
+        s->e = (s->x >= xm) ? s->a - s->x : s->b - s->x;
+        s->d = GOLDEN * s->e;
+    }
+    s->u = (fabs(s->d) >= tol) ? s->x + s->d : s->x + copysign(tol, s->d);
+    s->iter++;
+    return TRUE;
+}
+
+static void brent_update(brent_state *s, double fu, double complex zu)
+{
+    double u = s->u;
+
+    if (fu <= s->fx) {
+        if (u >= s->x) s->a = s->x; else s->b = s->x;
+        s->v = s->w; s->fv = s->fw;
+        s->w = s->x; s->fw = s->fx;
+        s->x = u; s->fx = fu;
+        s->zx = zu;
+    } else {
+        if (u < s->x) s->a = u; else s->b = u;
+        if (fu <= s->fw || s->w == s->x) {
+            s->v = s->w; s->fv = s->fw;
+            s->w = u; s->fw = fu;
+        } else if (fu <= s->fv || s->v == s->x || s->v == s->w) {
+            s->v = u; s->fv = fu;
+        }
+    }
+}
+
+/* next point into s->u, FALSE when the bracket is within tol */
+static int root_next(root_state *s, double tol)
+{
+    if (fabs(s->hi - s->lo) <= 2 * tol || s->iter >= MAX_ITER) return FALSE;
+    s->u = (s->lo * s->fhi - s->hi * s->flo) / (s->fhi - s->flo);
+    /* keep clear of the ends, false position may stall at one of them */
+    if (fabs(s->u - s->lo) < tol || fabs(s->u - s->hi) < tol) s->u = (s->lo + s->hi) / 2;
+    s->iter++;
+    return TRUE;
+}
+
+static void root_update(root_state *s, double fu)
+{
+    if (fu == 0) {
+        s->lo = s->hi = s->u;
+    } else if (fu < 0) {
+        s->lo = s->u;
+        s->flo = fu;
+        if (s->side == -1) s->fhi /= 2;
+        s->side = -1;
+    } else {
+        s->hi = s->u;
+        s->fhi = fu;
+        if (s->side == 1) s->flo /= 2;
+        s->side = 1;
+    }
+}
+
+/* best estimate of the root */
+static double root_value(const root_state *s)
+{
+    if (s->lo == s->hi) return s->lo;
+    return (s->lo * s->fhi - s->hi * s->flo) / (s->fhi - s->flo);
+}
+
+/*
+ * Bracket the -3 dB point on the side dir of the peak at f0, next to grid
+ * point k.  FALSE when |Z| rises again or DC is reached first.
+ */
+static int edge_bracket(int n, const double *f, const double *db, int k, int dir,
+                        double f0, double target, root_state *s)
+{
+    int i;
+
+    for (i = k + dir; i > 0 && i < n; i += dir) {
+        if (db[i] < target) {
+            s->lo = f[i];
+            s->flo = db[i] - target;
+            s->hi = (i - dir == k) ? f0 : f[i - dir];
+            s->fhi = (i - dir == k) ? HALF_POWER_DB : db[i - dir] - target;
+            s->side = 0;
+            s->iter = 0;
+            return TRUE;
+        }
+        if (db[i] > db[i - dir]) break;
+    }
+    return FALSE;
+}
+
+int bore_find_resonances(const bore *b, double max_freq, double step, double tol,
+                         double e_ratio, resonance **out, int *n_eval,
+                         const acoustic_constants *ac, int n_threads, int scalar)
+{
+    double *f, *db, *u;
+    double complex *z, *zu;
+    brent_state *peak;
+    root_state *edge;
+    char *active, *found;
+    resonance *res;
+    int *grid;
+    int i, k, n, m, n_peak, count;
+
+    if (!(step > 0) || !(tol > 0) || !(max_freq >= 0)) {
+        fprintf(stderr, "bore_find_resonances: step and tol must be positive.\n");
+        return -1;
+    }
+
+    /* coarse grid */
+    n = max_freq / step + 1;
+    f = m_malloc(n * sizeof(double));
+    z = m_malloc(n * sizeof(double complex));
+    db = m_malloc(n * sizeof(double));
+    for (i = 0; i < n; i++) f[i] = i * step;
+    bore_sweep_at(b, f, n, e_ratio, z, ac, n_threads, scalar);
+    for (i = 0; i < n; i++) db[i] = level_db(z[i]);
+    count = n;
+
+    /* grid maxima, not next to DC */
+    n_peak = 0;
+    peak = m_malloc((n + 1) * sizeof(brent_state));
+    grid = m_malloc((n + 1) * sizeof(int));
+    for (i = 2; i < n - 1; i++) {
+        if (db[i] > db[i - 1] && db[i] >= db[i + 1]) {
+            grid[n_peak] = i;
+            brent_init(&peak[n_peak++], f[i - 1], f[i], f[i + 1], -db[i], z[i]);
+        }
+    }
+
+    /* both -3 dB points per peak use the same buffers */
+    u = m_malloc((2 * n_peak + 1) * sizeof(double));
+    zu = m_malloc((2 * n_peak + 1) * sizeof(double complex));
+    active = m_malloc(2 * n_peak + 1);
+    found = m_malloc(2 * n_peak + 1);
+
+    /* peaks, Brent on -dB */
+    for (;;) {
+        for (k = 0, m = 0; k < n_peak; k++) {
+            active[k] = brent_next(&peak[k], tol);
+            if (active[k]) u[m++] = peak[k].u;
+        }
+        if (m == 0) break;
+        bore_sweep_at(b, u, m, e_ratio, zu, ac, n_threads, scalar);
+        count += m;
+        for (k = 0, m = 0; k < n_peak; k++) {
+            if (active[k]) {
+                brent_update(&peak[k], -level_db(zu[m]), zu[m]);
+                m++;
+            }
+        }
+    }
+
+    /* -3 dB points, edge 2k below and 2k+1 above peak k */
+    edge = m_malloc((2 * n_peak + 1) * sizeof(root_state));
+    for (k = 0; k < n_peak; k++) {
+        double target = -peak[k].fx - HALF_POWER_DB;
+
+        found[2 * k] = edge_bracket(n, f, db, grid[k], -1, peak[k].x, target, &edge[2 * k]);
+        found[2 * k + 1] = edge_bracket(n, f, db, grid[k], 1, peak[k].x, target, &edge[2 * k + 1]);
+    }
+    for (;;) {
+        for (k = 0, m = 0; k < 2 * n_peak; k++) {
+            active[k] = found[k] && root_next(&edge[k], tol);
+            if (active[k]) u[m++] = edge[k].u;
+        }
+        if (m == 0) break;
+        bore_sweep_at(b, u, m, e_ratio, zu, ac, n_threads, scalar);
+        count += m;
+        for (k = 0, m = 0; k < 2 * n_peak; k++) {
+            if (active[k]) {
+                root_update(&edge[k], level_db(zu[m]) + peak[k / 2].fx + HALF_POWER_DB);
+                m++;
+            }
+        }
+    }
+
+    res = m_malloc((n_peak + 1) * sizeof(resonance));
+    for (k = 0; k < n_peak; k++) {
+        res[k].frq = peak[k].x;
+        res[k].z = peak[k].zx;
+        res[k].lower = found[2 * k] ? root_value(&edge[2 * k]) : NAN;
+        res[k].upper = found[2 * k + 1] ? root_value(&edge[2 * k + 1]) : NAN;
+        res[k].bandwidth = res[k].upper - res[k].lower;
+        res[k].q = res[k].frq / res[k].bandwidth;
+    }
+
+    free(f);
+    free(z);
+    free(db);
+    free(peak);
+    free(grid);
+    free(edge);
+    free(u);
+    free(zu);
+    free(active);
+    free(found);
+
+    *out = res;
+    if (n_eval != NULL) *n_eval = count;
+    return n_peak;
+}
@@ -0,0 +1,59 @@
+/*
+ * spectrum.h - frequency analysis of a compiled bore
+ *
+ * bore_adaptive_sweep() samples the input impedance on a coarse uniform
+ * grid and then halves only the intervals where the curve has an extremum
+ * or changes faster than the tolerances, so that sharp resonances are
+ * resolved without a dense grid over the whole band.
+ *
+ * bore_find_resonances() goes straight to the maxima of |Z|: a coarse grid
+ * brackets them, Brent's method converges on each peak and its -3 dB
+ * points, typically in a few tens of evaluations per peak.
+ */
+
+#ifndef _SPECTRUM_H_
+#define _SPECTRUM_H_
+
+#include <complex.h>
+#include "acoustic_constants.h"
+#include "bore.h"
+
+/* refinement of bore_adaptive_sweep() */
+typedef struct {
+    double step;        /* coarse grid, Hz */
+    double min_step;    /* intervals are not halved below this width, Hz */
+    double tol_db;      /* largest change of |Z| in dB across an interval */
+    double tol_phase;   /* largest change of arg Z in rad across an interval */
+    int max_points;     /* no refinement beyond this number of points */
+} spectrum_opt;
+
+/*
+ * Sample the input impedance from 0 to max_freq.  Returns the number of
+ * points and sets *frq (ascending, from 0) and *z to m_malloc'ed arrays,
+ * or returns -1 on bad options.  DC gives 0 as in bore_sweep().
+ */
+int bore_adaptive_sweep(const bore *b, double max_freq, const spectrum_opt *opt,
+                        double e_ratio, double **frq, double complex **z,
+                        const acoustic_constants *ac, int n_threads, int scalar);
+
+/* an impedance maximum */
+typedef struct {
+    double frq;             /* Hz */
+    double complex z;       /* input impedance at frq */
+    double lower, upper;    /* -3 dB points of |Z|, NaN when not found */
+    double bandwidth;       /* upper - lower, Hz */
+    double q;               /* frq / bandwidth */
+} resonance;
+
+/*
+ * Find the maxima of |Z| up to max_freq.  Peaks are bracketed on the grid
+ * of step, which must be finer than the spacing of the peaks, then located
+ * within tol Hz.  Returns the number of peaks and sets *out to an m_malloc'ed
+ * array in ascending frequency, or returns -1 on bad arguments.  n_eval, if
+ * not NULL, receives the number of impedance evaluations.
+ */
+int bore_find_resonances(const bore *b, double max_freq, double step, double tol,
+                         double e_ratio, resonance **out, int *n_eval,
+                         const acoustic_constants *ac, int n_threads, int scalar);
+
+#endif /* _SPECTRUM_H_ */
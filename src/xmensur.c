@@ -29,11 +29,13 @@ typedef struct {
     mensur *men;
 } xmen_group;
 
-static xmen_var variables[MAX_VARS];
-static int var_count = 0;
-
-static xmen_group groups[MAX_GROUPS];
-static int group_count = 0;
+/* Variables and groups of one parse, so that threads can parse at once */
+typedef struct {
+    xmen_var variables[MAX_VARS];
+    int var_count;
+    xmen_group groups[MAX_GROUPS];
+    int group_count;
+} xmen_state;
 
 /*
  * Utility: case-insensitive string comparison
@@ -103,7 +105,7 @@ static char* trim_line(char *line) {
 /*
  * Evaluate arithmetic expression with variables using TinyExpr
  */
-static double evaluate_expression(char *expr) {
+static double evaluate_expression(xmen_state *xs, char *expr) {
     /* Skip leading whitespace/commas */
     while (*expr && (isspace((unsigned char)*expr) || *expr == ',')) expr++;
     if (*expr == '\0') return 0.0;  /* Empty expression */
@@ -120,17 +122,17 @@ static double evaluate_expression(char *expr) {
     }
 
     /* Build array of te_variable for TinyExpr */
-    te_variable *te_vars = malloc(var_count * sizeof(te_variable));
-    for (int i = 0; i < var_count; i++) {
-        te_vars[i].name = variables[i].name;
-        te_vars[i].address = &variables[i].value;
+    te_variable *te_vars = malloc(xs->var_count * sizeof(te_variable));
+    for (int i = 0; i < xs->var_count; i++) {
+        te_vars[i].name = xs->variables[i].name;
+        te_vars[i].address = &xs->variables[i].value;
         te_vars[i].type = TE_VARIABLE;
         te_vars[i].context = NULL;
     }
 
     /* Compile and evaluate expression */
     int err;
-    te_expr *compiled = te_compile(expr_copy, te_vars, var_count, &err);
+    te_expr *compiled = te_compile(expr_copy, te_vars, xs->var_count, &err);
     double result = 0.0;
 
     if (compiled) {
@@ -146,53 +148,29 @@ static double evaluate_expression(char *expr) {
 }
 
 /*
- * Step 1: Read all contents of XMENSUR file and return as list of line text
+ * Step 1: Split an XMENSUR text into lines, the text is modified
  * Ignore blank lines and comments, remove whitespaces
  */
-static char** read_xmensur_text(const char* path) {
-    FILE *infile;
-    struct stat fstatus;
-    char *readbuffer;
+static char** split_xmensur_text(char* readbuffer) {
     char **lines;
     int line_count = 0;
     int line_capacity = 1000;  /* Initial capacity */
 
-    /* Read entire file */
-    if (stat(path, &fstatus) != 0) {
-        fprintf(stderr, "Failed to open XMENSUR file: %s\n", path);
-        return NULL;
-    }
-
-    readbuffer = malloc(fstatus.st_size + 1);
-    if (!readbuffer) {
-        fprintf(stderr, "Cannot allocate memory\n");
-        return NULL;
-    }
-
-    infile = fopen(path, "r");
-    if (!infile) {
-        fprintf(stderr, "Cannot open file: %s\n", path);
-        free(readbuffer);
-        return NULL;
-    }
-
-    fread(readbuffer, 1, fstatus.st_size, infile);
-    readbuffer[fstatus.st_size] = '\0';
-    fclose(infile);
-
     eol_to_lf(readbuffer);
 
     /* Allocate initial lines array */
     lines = (char**)malloc(line_capacity * sizeof(char*));
     if (!lines) {
         fprintf(stderr, "Cannot allocate memory for lines\n");
-        free(readbuffer);
         return NULL;
     }
 
-    /* Split into lines, trim, and skip blank/comment lines */
-    char *line = strtok(readbuffer, "\n");
+    /* Split into lines, trim, and skip blank/comment lines.
+     * Not strtok(), which keeps its position in a static. */
+    char *line = readbuffer;
     while (line != NULL) {
+        char *eol = strchr(line, '\n');
+        if (eol) *eol = '\0';
         char *trimmed = trim_line(strdup(line));
         if (strlen(trimmed) > 0) {
             /* Expand array if needed */
@@ -203,7 +181,6 @@ static char** read_xmensur_text(const char* path) {
                     fprintf(stderr, "Cannot reallocate memory for lines\n");
                     for (int i = 0; i < line_count; i++) free(lines[i]);
                     free(lines);
-                    free(readbuffer);
                     return NULL;
                 }
                 lines = new_lines;
@@ -212,10 +189,66 @@ static char** read_xmensur_text(const char* path) {
         } else {
             free(trimmed);
         }
-        line = strtok(NULL, "\n");
+        line = eol ? eol + 1 : NULL;
     }
     lines[line_count] = NULL;  /* NULL terminator */
 
+    return lines;
+}
+
+/*
+ * Read all contents of XMENSUR file and return as list of line text
+ */
+static char** read_xmensur_text(const char* path) {
+    FILE *infile;
+    struct stat fstatus;
+    char *readbuffer;
+    char **lines;
+
+    /* Read entire file */
+    if (stat(path, &fstatus) != 0) {
+        fprintf(stderr, "Failed to open XMENSUR file: %s\n", path);
+        return NULL;
+    }
+
+    readbuffer = malloc(fstatus.st_size + 1);
+    if (!readbuffer) {
+        fprintf(stderr, "Cannot allocate memory\n");
+        return NULL;
+    }
+
+    infile = fopen(path, "r");
+    if (!infile) {
+        fprintf(stderr, "Cannot open file: %s\n", path);
+        free(readbuffer);
+        return NULL;
+    }
+
+    fread(readbuffer, 1, fstatus.st_size, infile);
+    readbuffer[fstatus.st_size] = '\0';
+    fclose(infile);
+
+    lines = split_xmensur_text(readbuffer);
+    free(readbuffer);
+    return lines;
+}
+
+/*
+ * The same for XMENSUR text in memory, len bytes that need no terminator
+ */
+static char** copy_xmensur_text(const char* text, size_t len) {
+    char *readbuffer;
+    char **lines;
+
+    readbuffer = malloc(len + 1);
+    if (!readbuffer) {
+        fprintf(stderr, "Cannot allocate memory\n");
+        return NULL;
+    }
+    memcpy(readbuffer, text, len);
+    readbuffer[len] = '\0';
+
+    lines = split_xmensur_text(readbuffer);
     free(readbuffer);
     return lines;
 }
@@ -264,9 +297,9 @@ static char** split_var_defs(char** lines) {
 /*
  * Check if a variable name already exists
  */
-static int variable_exists(const char* name) {
-    for (int i = 0; i < var_count; i++) {
-        if (strcmp(variables[i].name, name) == 0) {
+static int variable_exists(xmen_state *xs, const char* name) {
+    for (int i = 0; i < xs->var_count; i++) {
+        if (strcmp(xs->variables[i].name, name) == 0) {
             return 1;
         }
     }
@@ -276,10 +309,13 @@ static int variable_exists(const char* name) {
 /*
  * Step 3: Read variable definitions
  * Note: No whitespace handling needed - already trimmed by read_xmensur_text
+ * Variables named in names[0..n_override-1] take values[] instead of their
+ * definition; those defined from them follow.
  * Returns NULL if variable count exceeds MAX_VARS or if duplicate variables are found
  */
-static xmen_var* read_xmen_variables(char** vardefs) {
-    var_count = 0;
+static xmen_var* read_xmen_variables(xmen_state *xs, char** vardefs, const char **names,
+                                     const double *values, int n_override) {
+    xs->var_count = 0;
 
     for (int i = 0; vardefs[i] != NULL; i++) {
         char *line = strdup(vardefs[i]);
@@ -299,28 +335,33 @@ static xmen_var* read_xmen_variables(char** vardefs) {
 
         if (strlen(name) > 0) {
             /* Check for duplicate variable name */
-            if (variable_exists(name)) {
+            if (variable_exists(xs, name)) {
                 fprintf(stderr, "Error: Duplicate variable definition: '%s'\n", name);
                 free(line);
                 return NULL;
             }
 
-            if (var_count >= MAX_VARS) {
+            if (xs->var_count >= MAX_VARS) {
                 fprintf(stderr, "Error: Number of variables (%d) exceeds maximum limit (%d)\n",
-                        var_count + 1, MAX_VARS);
+                        xs->var_count + 1, MAX_VARS);
                 free(line);
                 return NULL;
             }
-            strncpy(variables[var_count].name, name, 63);
-            variables[var_count].name[63] = '\0';
-            variables[var_count].value = evaluate_expression(value_str);
-            var_count++;
+            strncpy(xs->variables[xs->var_count].name, name, 63);
+            xs->variables[xs->var_count].name[63] = '\0';
+            xs->variables[xs->var_count].value = evaluate_expression(xs, value_str);
+            for (int j = 0; j < n_override; j++) {
+                if (strcmp(names[j], xs->variables[xs->var_count].name) == 0) {
+                    xs->variables[xs->var_count].value = values[j];
+                }
+            }
+            xs->var_count++;
         }
 
         free(line);
     }
 
-    return variables;
+    return xs->variables;
 }
 
 /*
@@ -365,7 +406,7 @@ static char** split_men_defs(char** lines) {
 }
 
 /* Forward declaration */
-static mensur* parse_group_recursive(char** lines, int *idx, const char *group_name, int *error);
+static mensur* parse_group_recursive(xmen_state *xs, char** lines, int *idx, const char *group_name, int *error);
 
 /*
  * Check if a line looks like an unrecognized keyword
@@ -398,7 +439,7 @@ static int is_unrecognized_keyword(const char *line) {
 /*
  * Parse df,db,r line
  */
-static int parse_xmen_cell(char *line, double *df, double *db, double *r, char *comment) {
+static int parse_xmen_cell(xmen_state *xs, char *line, double *df, double *db, double *r, char *comment) {
     char *tokens[4];
     int token_count = 0;
 
@@ -419,9 +460,9 @@ static int parse_xmen_cell(char *line, double *df, double *db, double *r, char *
 
     if (token_count < 3) return 0;
 
-    *df = evaluate_expression(tokens[0]);
-    *db = evaluate_expression(tokens[1]);
-    *r = evaluate_expression(tokens[2]);
+    *df = evaluate_expression(xs, tokens[0]);
+    *db = evaluate_expression(xs, tokens[1]);
+    *r = evaluate_expression(xs, tokens[2]);
 
     if (comment) {
         if (token_count > 3 && tokens[3]) {
@@ -440,7 +481,7 @@ static int parse_xmen_cell(char *line, double *df, double *db, double *r, char *
  * Parse GROUP/END_GROUP pairs, handle nesting
  * Returns NULL on error, sets *error to 1
  */
-static mensur* parse_group_recursive(char** lines, int *idx, const char *group_name, int *error) {
+static mensur* parse_group_recursive(xmen_state *xs, char** lines, int *idx, const char *group_name, int *error) {
     mensur *head = NULL, *cur = NULL;
     int depth = 1;  /* We're inside a group */
     int is_main = (strcasecmp_xmen(group_name, "MAIN") == 0);
@@ -539,7 +580,7 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
 
                     /* Extract ratio */
                     char *ratio_str = comma + 1;
-                    cur->s_ratio = evaluate_expression(ratio_str);
+                    cur->s_ratio = evaluate_expression(xs, ratio_str);
                     cur->s_type = SPLIT;  /* BRANCH uses SPLIT type */
                 }
             }
@@ -571,7 +612,7 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
 
                     /* Extract ratio */
                     char *ratio_str = comma + 1;
-                    cur->s_ratio = evaluate_expression(ratio_str);
+                    cur->s_ratio = evaluate_expression(xs, ratio_str);
                     cur->s_type = JOIN;  /* MERGE uses JOIN type */
                 }
             }
@@ -603,7 +644,7 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
 
                     /* Extract ratio */
                     char *ratio_str = comma + 1;
-                    cur->s_ratio = evaluate_expression(ratio_str);
+                    cur->s_ratio = evaluate_expression(xs, ratio_str);
                     cur->s_type = ADDON;  /* SPLIT uses ADDON type */
                 }
             }
@@ -626,8 +667,8 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
 
             /* Find the group */
             int found = -1;
-            for (int i = 0; i < group_count; i++) {
-                if (strcasecmp_xmen(groups[i].name, p) == 0) {
+            for (int i = 0; i < xs->group_count; i++) {
+                if (strcasecmp_xmen(xs->groups[i].name, p) == 0) {
                     found = i;
                     break;
                 }
@@ -641,7 +682,7 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
             }
 
             /* Copy all mensur cells from the referenced group */
-            mensur *src = groups[found].men;
+            mensur *src = xs->groups[found].men;
             while (src) {
                 if (!head) {
                     head = create_men(src->df, src->db, src->r, src->comment);
@@ -659,7 +700,7 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
         /* Try to parse as df,db,r line */
         double df, db, r;
         char comment[64];
-        if (parse_xmen_cell(line, &df, &db, &r, comment)) {
+        if (parse_xmen_cell(xs, line, &df, &db, &r, comment)) {
             /* Convert mm to m */
             df *= 0.001;
             db *= 0.001;
@@ -702,9 +743,9 @@ static mensur* parse_group_recursive(char** lines, int *idx, const char *group_n
 /*
  * Check if a group name already exists (case-insensitive)
  */
-static int group_exists(const char* name) {
-    for (int i = 0; i < group_count; i++) {
-        if (strcasecmp_xmen(groups[i].name, name) == 0) {
+static int group_exists(xmen_state *xs, const char* name) {
+    for (int i = 0; i < xs->group_count; i++) {
+        if (strcasecmp_xmen(xs->groups[i].name, name) == 0) {
             return 1;
         }
     }
@@ -739,8 +780,8 @@ static void skip_block(char** mendefs, int *idx, int is_main) {
  * Uses two-pass approach: first pass parses all non-MAIN groups,
  * second pass parses MAIN (which can reference the groups)
  */
-static xmen_group* read_xmen_groups(char** mendefs) {
-    group_count = 0;
+static xmen_group* read_xmen_groups(xmen_state *xs, char** mendefs) {
+    xs->group_count = 0;
     int error = 0;
 
     /* FIRST PASS: Parse all non-MAIN groups */
@@ -756,9 +797,9 @@ static xmen_group* read_xmen_groups(char** mendefs) {
 
         /* Check for GROUP or { */
         if (strncasecmp_xmen(line, "GROUP", 5) == 0 || strncmp(line, "{", 1) == 0) {
-            if (group_count >= MAX_GROUPS) {
+            if (xs->group_count >= MAX_GROUPS) {
                 fprintf(stderr, "Error: Number of groups (%d) exceeds maximum limit (%d)\n",
-                        group_count + 1, MAX_GROUPS);
+                        xs->group_count + 1, MAX_GROUPS);
                 return NULL;
             }
 
@@ -789,21 +830,21 @@ static xmen_group* read_xmen_groups(char** mendefs) {
             }
 
             /* Check for duplicate group name */
-            if (strlen(group_name) > 0 && group_exists(group_name)) {
+            if (strlen(group_name) > 0 && group_exists(xs, group_name)) {
                 fprintf(stderr, "Error: Duplicate group definition: '%s'\n", group_name);
                 return NULL;
             }
 
             idx++;
-            mensur *group_men = parse_group_recursive(mendefs, &idx, group_name, &error);
+            mensur *group_men = parse_group_recursive(xs, mendefs, &idx, group_name, &error);
             if (error) {
                 return NULL;
             }
             if (group_men && strlen(group_name) > 0) {
-                strncpy(groups[group_count].name, group_name, 255);
-                groups[group_count].name[255] = '\0';
-                groups[group_count].men = group_men;
-                group_count++;
+                strncpy(xs->groups[xs->group_count].name, group_name, 255);
+                xs->groups[xs->group_count].name[255] = '\0';
+                xs->groups[xs->group_count].men = group_men;
+                xs->group_count++;
             }
             continue;
         }
@@ -819,25 +860,25 @@ static xmen_group* read_xmen_groups(char** mendefs) {
         /* Check for MAIN or [ */
         if (strcasecmp_xmen(line, "MAIN") == 0 || strcmp(line, "[") == 0) {
             /* Check for duplicate MAIN definition */
-            if (group_exists("MAIN")) {
+            if (group_exists(xs, "MAIN")) {
                 fprintf(stderr, "Error: Duplicate MAIN block definition\n");
                 return NULL;
             }
 
-            if (group_count >= MAX_GROUPS) {
+            if (xs->group_count >= MAX_GROUPS) {
                 fprintf(stderr, "Error: Number of groups (%d) exceeds maximum limit (%d)\n",
-                        group_count + 1, MAX_GROUPS);
+                        xs->group_count + 1, MAX_GROUPS);
                 return NULL;
             }
             idx++;
-            mensur *main_men = parse_group_recursive(mendefs, &idx, "MAIN", &error);
+            mensur *main_men = parse_group_recursive(xs, mendefs, &idx, "MAIN", &error);
             if (error) {
                 return NULL;
             }
             if (main_men) {
-                strcpy(groups[group_count].name, "MAIN");
-                groups[group_count].men = main_men;
-                group_count++;
+                strcpy(xs->groups[xs->group_count].name, "MAIN");
+                xs->groups[xs->group_count].men = main_men;
+                xs->group_count++;
             }
             continue;
         }
@@ -845,14 +886,14 @@ static xmen_group* read_xmen_groups(char** mendefs) {
         idx++;
     }
 
-    return groups;
+    return xs->groups;
 }
 
 /*
  * Step 6: Get pointer to MAIN mensur (case-insensitive)
  */
-static mensur* get_main_xmen(xmen_group* mens) {
-    for (int i = 0; i < group_count; i++) {
+static mensur* get_main_xmen(xmen_state *xs, xmen_group* mens) {
+    for (int i = 0; i < xs->group_count; i++) {
         if (strcasecmp_xmen(mens[i].name, "MAIN") == 0) {
             return mens[i].men;
         }
@@ -863,10 +904,10 @@ static mensur* get_main_xmen(xmen_group* mens) {
 /*
  * Find group by name (case-insensitive)
  */
-static mensur* find_xmen(const char* name) {
-    for (int i = 0; i < group_count; i++) {
-        if (strcasecmp_xmen(groups[i].name, name) == 0) {
-            return groups[i].men;
+static mensur* find_xmen(xmen_state *xs, const char* name) {
+    for (int i = 0; i < xs->group_count; i++) {
+        if (strcasecmp_xmen(xs->groups[i].name, name) == 0) {
+            return xs->groups[i].men;
         }
     }
     return NULL;
@@ -876,17 +917,17 @@ static mensur* find_xmen(const char* name) {
 /*
  * Resolve child mensur connections
  */
-static void resolve_xmen_child(mensur *men) {
+static void resolve_xmen_child(xmen_state *xs, mensur *men) {
     mensur *m = men;
 
     while (m != NULL) {
         if (m->sidename[0] != '\0') {
-            mensur* child = find_xmen(m->sidename);
+            mensur* child = find_xmen(xs, m->sidename);
             if (child != NULL) {
                 if (m->s_type != JOIN) {
                     /* SPLIT or BRANCH */
                     m->side = child;
-                    resolve_xmen_child(child);
+                    resolve_xmen_child(xs, child);
                 } else {
                     /* JOIN */
                     m->side = get_last_men(child);
@@ -904,6 +945,7 @@ static void resolve_xmen_child(mensur *men) {
  */
 static mensur* rejoint_xmen(mensur* men) {
     mensur *p, *q, *s, *ss;
+    arena *prev = use_men_arena(men->pool);  /* new cells go to the arena of men */
 
     p = men;
 
@@ -924,6 +966,10 @@ static mensur* rejoint_xmen(mensur* men) {
                 append_men(ss, ss->db, 0, 0, "");
             } else if (p->side != NULL && p->s_type == SPLIT) {
                 s = get_join_men(p, p->side);
+                if (s == NULL) {  /* no join, leave the branch as it is */
+                    p = p->next;
+                    continue;
+                }
 
                 q = s->side;
                 q = remove_men(q);
@@ -950,6 +996,7 @@ static mensur* rejoint_xmen(mensur* men) {
 
         p = p->next;
     }
+    use_men_arena(prev);
 
     return men;
 }
@@ -958,69 +1005,187 @@ static mensur* rejoint_xmen(mensur* men) {
  * Main entry point: Read XMENSUR file
  */
 mensur* read_xmensur(const char* path) {
-    /* Step 1: Read all contents of xmensur file as list of line text */
-    char** lines = read_xmensur_text(path);
-    if (!lines) return NULL;
+    mensur* mainmen = read_xmensur_nojoint(path);
+    if (!mainmen) return NULL;
+
+    /* Step 9: Rejoint branches if s_ratio > 0.5 */
+    return rejoint_xmen(mainmen);
+}
+
+/*
+ * Steps 2 to 8 on the lines of an XMENSUR text, which are left intact
+ */
+static mensur* parse_xmensur_lines(char** lines, const char **names, const double *values,
+                                   int n_override) {
+    xmen_state *xs = m_calloc(1, sizeof(xmen_state));
 
     /* Step 2 & 3: Read variable definition lines */
     char** vardefs = split_var_defs(lines);
-    xmen_var* parsed_vars = read_xmen_variables(vardefs);
+    xmen_var* parsed_vars = read_xmen_variables(xs, vardefs, names, values, n_override);
     if (!parsed_vars) {
         fprintf(stderr, "Error: Failed to parse variables (exceeded limit)\n");
         /* Cleanup */
-        for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
-        free(lines);
         for (int i = 0; vardefs[i] != NULL; i++) free(vardefs[i]);
         free(vardefs);
+        free(xs);
         return NULL;
     }
 
-    /* Step 4 & 5: Read mensur definitions and create groups */
+    /* Step 4 & 5: Read mensur definitions and create groups, all cells in one arena */
     char** mendefs = split_men_defs(lines);
-    xmen_group* parsed_groups = read_xmen_groups(mendefs);
+    arena *pool = create_arena(0);
+    arena *prev = use_men_arena(pool);
+    xmen_group* parsed_groups = read_xmen_groups(xs, mendefs);
+    use_men_arena(prev);
     if (!parsed_groups) {
         fprintf(stderr, "Error: Failed to parse XMENSUR groups\n");
         /* Cleanup */
-        for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
-        free(lines);
+        dispose_arena(pool);
         for (int i = 0; vardefs[i] != NULL; i++) free(vardefs[i]);
         free(vardefs);
         for (int i = 0; mendefs[i] != NULL; i++) free(mendefs[i]);
         free(mendefs);
+        free(xs);
         return NULL;
     }
 
     /* Step 6: Get pointer to head mensur of MAIN */
-    mensur* mainmen = get_main_xmen(parsed_groups);
+    mensur* mainmen = get_main_xmen(xs, parsed_groups);
     if (!mainmen) {
         fprintf(stderr, "Error: No MAIN definition found in XMENSUR file\n");
         /* Cleanup */
-        for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
-        free(lines);
+        dispose_arena(pool);
         for (int i = 0; vardefs[i] != NULL; i++) free(vardefs[i]);
         free(vardefs);
         for (int i = 0; mendefs[i] != NULL; i++) free(mendefs[i]);
         free(mendefs);
+        free(xs);
         return NULL;
     }
 
     /* Step 8: Resolve child connections */
-    resolve_xmen_child(mainmen);
-
-    /* Step 9: Rejoint branches if s_ratio > 0.5 */
-    mainmen = rejoint_xmen(mainmen);
+    resolve_xmen_child(xs, mainmen);
 
     /* Cleanup */
-    for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
-    free(lines);
     for (int i = 0; vardefs[i] != NULL; i++) free(vardefs[i]);
     free(vardefs);
     for (int i = 0; mendefs[i] != NULL; i++) free(mendefs[i]);
     free(mendefs);
+    free(xs);
+
+    return mainmen;
+}
+
+/*
+ * Read XMENSUR file up to resolving child connections, without rejointing.
+ * Branch ratios can then be changed with set_men_ratio() before
+ * copy_men() and rejoint_men() build a mensur to calculate.
+ */
+mensur* read_xmensur_nojoint(const char* path) {
+    /* Step 1: Read all contents of xmensur file as list of line text */
+    char** lines = read_xmensur_text(path);
+    if (!lines) return NULL;
+
+    mensur* mainmen = parse_xmensur_lines(lines, NULL, NULL, 0);
+
+    for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
+    free(lines);
+
+    return mainmen;
+}
+
+/*
+ * Parse XMENSUR text held in memory, as read_xmensur() parses a file
+ */
+mensur* read_xmensur_buffer(const char* text, size_t len) {
+    mensur* mainmen = read_xmensur_buffer_nojoint(text, len);
+    if (!mainmen) return NULL;
+
+    return rejoint_xmen(mainmen);
+}
+
+/*
+ * Parse XMENSUR text held in memory without rejointing
+ */
+mensur* read_xmensur_buffer_nojoint(const char* text, size_t len) {
+    char** lines = copy_xmensur_text(text, len);
+    if (!lines) return NULL;
+
+    mensur* mainmen = parse_xmensur_lines(lines, NULL, NULL, 0);
+
+    for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
+    free(lines);
 
     return mainmen;
 }
 
+/*
+ * Keep the text of an XMENSUR file with its variables and their values
+ */
+xmen_source* load_xmen_source(const char* path) {
+    char** lines = read_xmensur_text(path);
+    if (!lines) return NULL;
+
+    xmen_state *xs = m_calloc(1, sizeof(xmen_state));
+    char** vardefs = split_var_defs(lines);
+    xmen_var* parsed_vars = read_xmen_variables(xs, vardefs, NULL, NULL, 0);
+    for (int i = 0; vardefs[i] != NULL; i++) free(vardefs[i]);
+    free(vardefs);
+    if (!parsed_vars) {
+        for (int i = 0; lines[i] != NULL; i++) free(lines[i]);
+        free(lines);
+        free(xs);
+        return NULL;
+    }
+
+    xmen_source *src = m_malloc(sizeof(xmen_source));
+    src->lines = lines;
+    src->n_var = xs->var_count;
+    src->names = m_malloc((xs->var_count + 1) * sizeof(char*));
+    src->values = m_malloc((xs->var_count + 1) * sizeof(double));
+    for (int i = 0; i < xs->var_count; i++) {
+        src->names[i] = strdup(xs->variables[i].name);
+        src->values[i] = xs->variables[i].value;
+    }
+    free(xs);
+
+    return src;
+}
+
+/*
+ * Index of variable name in src, -1 if it is not defined
+ */
+int xmen_source_var(const xmen_source* src, const char* name) {
+    for (int i = 0; i < src->n_var; i++) {
+        if (strcmp(src->names[i], name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Parse src again with variables names[0..n-1] set to values[], then
+ * rejoint as read_xmensur() does
+ */
+mensur* eval_xmen_source(const xmen_source* src, const char** names, const double* values, int n) {
+    mensur* mainmen = parse_xmensur_lines(src->lines, names, values, n);
+    if (!mainmen) return NULL;
+
+    return rejoint_xmen(mainmen);
+}
+
+void dispose_xmen_source(xmen_source* src) {
+    if (src == NULL) return;
+
+    for (int i = 0; src->lines[i] != NULL; i++) free(src->lines[i]);
+    free(src->lines);
+    for (int i = 0; i < src->n_var; i++) free(src->names[i]);
+    free(src->names);
+    free(src->values);
+    free(src);
+}
+
 /*
  * Test function for error handling validation
  * Returns 0 on success, non-zero on failure
@@ -19,6 +19,29 @@ enum{ XOPEN_END=0, XCLOSED_END };
 /* Main function to read XMENSUR format file */
 mensur* read_xmensur(const char *path);
 
+/* Read without rejointing, branch ratios stay changeable */
+mensur* read_xmensur_nojoint(const char *path);
+
+/* The same for XMENSUR text in memory, len bytes without terminator */
+mensur* read_xmensur_buffer(const char *text, size_t len);
+mensur* read_xmensur_buffer_nojoint(const char *text, size_t len);
+
+/*
+ * The text of an XMENSUR file kept in memory, to be parsed again with other
+ * values of its variables without reading the file (bore optimization)
+ */
+typedef struct {
+    char **lines;       /* trimmed lines, NULL terminated */
+    int n_var;
+    char **names;       /* variables in order of definition */
+    double *values;     /* their values as defined in the file */
+} xmen_source;
+
+xmen_source* load_xmen_source(const char *path);
+int xmen_source_var(const xmen_source *src, const char *name);
+mensur* eval_xmen_source(const xmen_source *src, const char **names, const double *values, int n);
+void dispose_xmen_source(xmen_source *src);
+
 /* Test function for error handling validation */
 int test_xmensur_error_handling(void);
 
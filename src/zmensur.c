@@ -12,40 +12,74 @@
 #include <ctype.h>
 #include <complex.h>
 #include <glib.h>
-#include <gsl/gsl_complex.h>
-#include <gsl/gsl_complex_math.h>
 
 #include "kutils.h"
 #include "zmensur.h"
+#include "bore.h"
 
-char filecomment[256];
-struct varlist* variable_list = NULL;
-struct menlist* mensur_list = NULL;
+/* 読み込み中のファイルコメント、変数と部分メンズールの一覧 */
+typedef struct {
+  char filecomment[256];
+  struct varlist* variable_list;
+  struct menlist* mensur_list;
+} men_lists;
 
-/* ------------------------------ complex math wrappers ------------------------------*/
-/* Use GSL complex math functions for portability */
+/* create_menが使うarena, スレッドごと */
+static GPrivate men_pool = G_PRIVATE_INIT(NULL);
+/* 読み込みの一覧もスレッドごとに持ち、別のスレッドで同時に読み込めるようにする */
+static GPrivate men_state = G_PRIVATE_INIT(free);
 
-static inline double complex gsl_to_c99_complex(gsl_complex z) {
-    return GSL_REAL(z) + I * GSL_IMAG(z);
+/* ------------------------------ subroutines ------------------------------*/
+/*
+ * このスレッドでcreate_menが要素を確保するarenaを設定し、前の設定を返す
+ * NULLならmallocに戻る。
+ */
+arena* use_men_arena( arena *pool )
+{
+  arena *prev = g_private_get( &men_pool );
+
+  g_private_set( &men_pool, pool );
+  return prev;
 }
 
-static inline gsl_complex c99_to_gsl_complex(double complex z) {
-    gsl_complex result;
-    GSL_SET_COMPLEX(&result, creal(z), cimag(z));
-    return result;
+/*
+ * このスレッドの読み込みの一覧、初めて使うときに作る
+ */
+static men_lists* get_men_lists( void )
+{
+  men_lists *ls = g_private_get( &men_state );
+
+  if( ls == NULL ){
+    ls = m_calloc( 1,sizeof(men_lists) );
+    g_private_set( &men_state, ls );
+  }
+  return ls;
 }
 
-#define csqrt(z) gsl_to_c99_complex(gsl_complex_sqrt(c99_to_gsl_complex(z)))
-#define csin(z) gsl_to_c99_complex(gsl_complex_sin(c99_to_gsl_complex(z)))
-#define ccos(z) gsl_to_c99_complex(gsl_complex_cos(c99_to_gsl_complex(z)))
+static mensur* new_men( arena *pool )
+{
+  mensur* buf;
 
-/* ------------------------------ subroutines ------------------------------*/
-mensur* create_men (double df,double db,double r,char* comm)
+  buf = ( pool != NULL ) ? arena_alloc( pool, sizeof(mensur) ) : m_malloc( sizeof(mensur) );
+  buf->pool = pool;
+  return buf;
+}
+
+/* arenaの要素はarenaごと解放されるので、ここではmallocの要素だけ */
+static void free_men( mensur *men )
+{
+  if( men->pool == NULL )
+    free( men );
+}
+
+static mensur* init_men( mensur *buf, double df,double db,double r,char* comm)
 {
-  mensur* buf = m_malloc( sizeof(mensur));
   buf->next = NULL;
   buf->prev = NULL;
   buf->side = NULL;
+  buf->s_type = 0;
+  buf->s_ratio = 0;
+  buf->hf = 0;
 
   buf->df = df;
   buf->db = db;
@@ -53,12 +87,22 @@ mensur* create_men (double df,double db,double r,char* comm)
   strncpy(buf->comment,comm,64);
   strcpy(buf->sidename,"");
 
-  /* initialize admittance as non-zero */
-  buf->y = 1.0;
-
   return buf;
 }
 
+mensur* create_men (double df,double db,double r,char* comm)
+{
+  return init_men( new_men( g_private_get(&men_pool) ), df,db,r,comm );
+}
+
+/* inmenと同じarenaに要素を作る */
+static mensur* create_men_near( mensur* inmen, double df,double db,double r,char* comm)
+{
+  if( inmen == NULL )
+    return create_men( df,db,r,comm );
+  return init_men( new_men( inmen->pool ), df,db,r,comm );
+}
+
 mensur* get_first_men( mensur* inmen )
 {
   mensur* buf = inmen;
@@ -92,7 +136,7 @@ mensur* get_join_men(mensur *inmen, mensur* bhead)
   while(1){
     if( n == NULL ){
       fprintf(stderr,"Caution! Cannot find joining point.\n");
-      exit(-1);
+      return NULL;
     }
     if(n->side != NULL && n->s_type == JOIN ){
       bh = get_first_men(n->side);
@@ -108,11 +152,11 @@ mensur* get_join_men(mensur *inmen, mensur* bhead)
 
 mensur* prepend_men( mensur* inmen,double df,double db,double r,char* comm)
 {
-  mensur* new = create_men(df,db,r,comm);
+  mensur* new = create_men_near(inmen,df,db,r,comm);
 
   if( new == NULL ){
     fprintf(stderr,"cant create new mensur item\n");
-    exit(-1);
+    return NULL;
   }
   if( inmen != NULL ){
     /* insert new to current pos if inmen has prev */
@@ -131,10 +175,10 @@ mensur* append_men( mensur* inmen ,double df,double db,double r,char* comm)
 {
   mensur* new;
   /*  mensur* last; */
-  new = create_men( df,db,r,comm );
+  new = create_men_near( inmen,df,db,r,comm );
   if( new == NULL ){
     fprintf(stderr,"cant create new mensur item\n");
-    exit(-1);
+    return NULL;
   }
 
   if (getenv("DEBUG_ZMENSUR")) {
@@ -164,7 +208,7 @@ mensur* remove_last_men( mensur *inmen )
   last = get_last_men(inmen);
 
   buf = last->prev;
-  free( last );
+  free_men( last );
   buf->next = NULL;
 
   return buf;
@@ -191,7 +235,7 @@ mensur* remove_men( mensur* inmen )
     out = next;
   }
     
-  free( buf );
+  free_men( buf );
   return out;
 }
 
@@ -200,7 +244,7 @@ void dispose_men(mensur* inmen)
   while( inmen->prev != NULL )
     inmen = remove_last_men(inmen);
 
-  free(inmen);
+  free_men(inmen);
 }
 
 /*
@@ -285,16 +329,18 @@ void divide_men( mensur* men, double step )
 
   while( p != NULL ){
     /* 分岐処理 */
-    if( p->side != NULL ){
-      /* recursive call */
+    if( p->side != NULL && p->s_type != JOIN ){
+      /* recursive call, JOINは同じ枝の末尾を指すので分割済み */
       divide_men(p->side,step);
+      /* 枝の先頭の前に分割要素が入るので付け直す */
+      p->side = get_first_men(p->side);
     }
 
     /* main process */
     prev = p->prev; /* remenber original previous cell */
 
     l = p->r;
-    if( l > step ){ /* slicing */
+    if( l > step && p->side == NULL ){ /* slicing, 分岐点の位置は動かさない */
       num = l/step;
       df = p->df;
       db = p->db;
@@ -334,6 +380,288 @@ void divide_men( mensur* men, double step )
   }
 }
 
+/*
+ * 連続するメンズール要素 a..e を一本の直線テーパで置き換えられるか調べる
+ * 各要素の両端の径が、a->dfからe->dbへの直線からtol以内にあればよい。
+ * 段差も両側の径で評価されるので、tol以上の段差は残る。
+ * cylがTRUEなら同径の円筒だけを認める。
+ */
+static int is_collinear_men( mensur *a, mensur *e, double tol, int cyl )
+{
+  mensur *p;
+  double x,len,d0,d1;
+
+  len = 0;
+  for( p = a; p != e->next; p = p->next )
+    len += p->r;
+
+  d0 = a->df;
+  d1 = e->db;
+  if( cyl && fabs( d1 - d0 ) > tol ) return FALSE;
+  x = 0;
+  for( p = a; p != e->next; p = p->next ){
+    if( len > 0 ){
+      if( fabs( p->df - (d0 + (d1-d0)*x/len) ) > tol ) return FALSE;
+      x += p->r;
+      if( fabs( p->db - (d0 + (d1-d0)*x/len) ) > tol ) return FALSE;
+    }else{
+      /* 長さ0の要素だけの場合 */
+      if( fabs( p->df - d0 ) > tol || fabs( p->db - d0 ) > tol ) return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/*
+ * ブランチ一本分の簡略化、取り除いた要素数を返す
+ * 同じ部分メンズールが複数の分岐から参照されることがあるので、
+ * 処理済みのブランチはdoneに記録して二度処理しない。
+ */
+static int simplify_branch( mensur *head, double tol, int cyl, GHashTable *done )
+{
+  mensur *a,*e,*p,*next;
+  int removed = 0;
+
+  if( head == NULL || g_hash_table_contains( done, head ) )
+    return 0;
+  g_hash_table_add( done, head );
+
+  for( a = head; a != NULL && a->next != NULL; a = a->next ){
+    /* 分岐処理 */
+    if( a->side != NULL && a->s_type != JOIN ){
+      /* JOINのsideは合流するブランチの末尾を指すので辿らない */
+      removed += simplify_branch( get_first_men(a->side), tol, cyl, done );
+    }
+    if( a->side != NULL )
+      continue; /* aの出口に分岐があるので繋げない */
+
+    /* aから後ろへ、直線とみなせる範囲を伸ばす。終端要素は残す */
+    e = a;
+    while( e->side == NULL && e->next->next != NULL
+	   && is_collinear_men( a, e->next, tol, cyl ) )
+      e = e->next;
+    if( e == a )
+      continue;
+
+    /* a..eをaにまとめる。eの出口の分岐はaが引き継ぐ */
+    if( e->side != NULL && e->s_type != JOIN )
+      removed += simplify_branch( get_first_men(e->side), tol, cyl, done );
+    a->db = e->db;
+    a->side = e->side;
+    a->s_type = e->s_type;
+    a->s_ratio = e->s_ratio;
+    a->hf = e->hf;
+    strcpy( a->sidename, e->sidename );
+
+    next = e->next;
+    p = a->next;
+    while( p != next ){
+      a->r += p->r;
+      e = p->next;
+      free_men( p );
+      removed++;
+      p = e;
+    }
+    a->next = next;
+    next->prev = a;
+  }
+
+  return removed;
+}
+
+/*
+ * メンズールを簡略化する。取り除いた要素数を返す
+ * tol == 0 : 同径の円筒の連続だけを一つにまとめる
+ *            (円筒は分割しても損失を含めて同じ計算結果になる。
+ *             テーパは要素ごとの平均径で損失を計算するので、
+ *             同一直線上でもまとめると結果が変わる)
+ * tol > 0  : 径の誤差がtol(m)以内に収まるように、テーパも含めて形状を粗くする
+ * 分岐のある要素の出口や、各ブランチの終端要素はそのまま残す。
+ */
+int simplify_men( mensur *men, double tol )
+{
+  GHashTable *done;
+  int removed,cyl;
+
+  cyl = ( tol <= 0 );
+  if( tol < THRESHOLD )
+    tol = THRESHOLD; /* 計算誤差は同じ径とみなす */
+
+  done = g_hash_table_new( g_direct_hash, g_direct_equal );
+  removed = simplify_branch( get_first_men(men), tol, cyl, done );
+  g_hash_table_destroy( done );
+
+  return removed;
+}
+
+/*
+ * menから辿れる全ての要素をseenに集める
+ * 部分メンズールは複数の分岐から共有されていることがあるので、
+ * 一度集めたブランチは辿らない。
+ */
+static void collect_men( mensur *men, GHashTable *seen )
+{
+  mensur *p,*head;
+
+  head = get_first_men(men);
+  if( head == NULL || g_hash_table_contains( seen, head ) )
+    return;
+
+  for( p = head; p != NULL; p = p->next )
+    g_hash_table_add( seen, p );
+  for( p = head; p != NULL; p = p->next ){
+    if( p->side != NULL )
+      collect_men( p->side, seen );
+  }
+}
+
+/*
+ * 分岐を含めたメンズール全体を複製する
+ * 共有されている部分メンズールは複製でも共有され、JOINのsideも
+ * 複製側の対応する要素を指す。menに対応する要素を返す。
+ * 複製は新しいarenaに作られ、dispose_men_treeでまとめて解放される。
+ */
+mensur* copy_men( mensur *men )
+{
+  GHashTable *seen,*map;
+  GHashTableIter it;
+  gpointer key,val;
+  mensur *p,*q,*out;
+  arena *pool;
+
+  seen = g_hash_table_new( g_direct_hash, g_direct_equal );
+  map = g_hash_table_new( g_direct_hash, g_direct_equal );
+  collect_men( men, seen );
+
+  pool = create_arena( 0 );
+  g_hash_table_iter_init( &it, seen );
+  while( g_hash_table_iter_next( &it, &key, NULL ) ){
+    q = new_men( pool );
+    *q = *(mensur*)key;
+    q->pool = pool;
+    g_hash_table_insert( map, key, q );
+  }
+
+  /* ポインタを複製側に付け替える */
+  g_hash_table_iter_init( &it, map );
+  while( g_hash_table_iter_next( &it, &key, &val ) ){
+    p = key;
+    q = val;
+    q->prev = g_hash_table_lookup( map, p->prev );
+    q->next = g_hash_table_lookup( map, p->next );
+    q->side = g_hash_table_lookup( map, p->side );
+  }
+
+  out = g_hash_table_lookup( map, men );
+  g_hash_table_destroy( map );
+  g_hash_table_destroy( seen );
+
+  return out;
+}
+
+/*
+ * 分岐を含めたメンズール全体を解放する (dispose_menは一本分のみ)
+ * 要素の属するarenaも、使われていないグループの要素ごと解放する。
+ */
+void dispose_men_tree( mensur *men )
+{
+  GHashTable *seen,*pools;
+  GHashTableIter it;
+  gpointer key;
+  mensur *p;
+
+  if( men == NULL )
+    return;
+
+  seen = g_hash_table_new( g_direct_hash, g_direct_equal );
+  pools = g_hash_table_new( g_direct_hash, g_direct_equal );
+  collect_men( men, seen );
+
+  g_hash_table_iter_init( &it, seen );
+  while( g_hash_table_iter_next( &it, &key, NULL ) ){
+    p = key;
+    if( p->pool != NULL )
+      g_hash_table_add( pools, p->pool );
+    else
+      free( p );
+  }
+  g_hash_table_iter_init( &it, pools );
+  while( g_hash_table_iter_next( &it, &key, NULL ) )
+    dispose_arena( key );
+  g_hash_table_destroy( pools );
+  g_hash_table_destroy( seen );
+}
+
+/*
+ * sidenameの分岐点すべての分岐比をratioにする。変更した要素数を返す
+ * rejoint_menより前のメンズールに使うこと。バルブなら0/1で経路が切り替わり、
+ * トーンホールなら開閉(中間値は半開き)になる。
+ */
+int set_men_ratio( mensur *men, const char *sidename, double ratio )
+{
+  GHashTable *seen;
+  GHashTableIter it;
+  gpointer key;
+  mensur *p;
+  int n = 0;
+
+  seen = g_hash_table_new( g_direct_hash, g_direct_equal );
+  collect_men( men, seen );
+
+  g_hash_table_iter_init( &it, seen );
+  while( g_hash_table_iter_next( &it, &key, NULL ) ){
+    p = key;
+    if( p->side != NULL && strcmp( p->sidename, sidename ) == 0 ){
+      p->s_ratio = ratio;
+      n++;
+    }
+  }
+  g_hash_table_destroy( seen );
+
+  return n;
+}
+
+/*
+ * 分岐点を先頭から順に集める。同じsidenameが複数あれば最初の
+ * 分岐点(JOIN以外)のみ。要素はmenを指すので解放しないこと。
+ */
+static void branch_points( mensur *men, GHashTable *seen, GPtrArray *out )
+{
+  mensur *p,*q,*head;
+  guint i;
+
+  head = get_first_men(men);
+  if( head == NULL || g_hash_table_contains( seen, head ) )
+    return;
+  g_hash_table_add( seen, head );
+
+  for( p = head; p != NULL; p = p->next ){
+    if( p->side == NULL || p->s_type == JOIN )
+      continue;
+    for( i = 0; i < out->len; i++ ){
+      q = g_ptr_array_index( out, i );
+      if( strcmp( q->sidename, p->sidename ) == 0 )
+	break;
+    }
+    if( i == out->len )
+      g_ptr_array_add( out, p );
+    branch_points( p->side, seen, out );
+  }
+}
+
+GPtrArray* get_men_branches( mensur *men )
+{
+  GHashTable *seen;
+  GPtrArray *out;
+
+  seen = g_hash_table_new( g_direct_hash, g_direct_equal );
+  out = g_ptr_array_new();
+  branch_points( men, seen, out );
+  g_hash_table_destroy( seen );
+
+  return out;
+}
 
 /*
  * 指定位置からlenの所までを切り取り捨てる
@@ -503,21 +831,30 @@ GPtrArray *get_men_xy(mensur* men, int show_stair )
 /*
  * mensur各位置での音圧を出力
  */
-void print_pressure(mensur* men, int show_stair )
+void print_pressure(double f, mensur* men, int show_stair, acoustic_constants *ac )
 {
   double x; /* total length */
-  double complex p;
+  double complex p,*pr;
   double mag;
-    
+  bore *b;
+  bore_work *wk;
+  int i;
+
+  b = compile_bore(men);
+  if( b == NULL ) return;
+  wk = create_bore_work(b);
+  pr = m_malloc( (b->last[0] - b->first[0] + 1)*sizeof(double complex) );
+  bore_pressure(f,b,wk,0.02,pr,NULL,ac); /* 60dB HARD CODING */
+
   mensur *pm = get_first_men(men); /* 念のため */
-    
+
   x = 0;
-  while( pm != NULL ){
-    p = pm->pi;
+  for( i = b->first[0]; i <= b->last[0] && pm != NULL; i++ ){
+    p = pr[i - b->first[0]];
     mag = 20*log10( cabs(p) );
     printf("%f,%.10e,%.10e,%f,%s\n",x*1000,creal(p),cimag(p),mag,pm->comment);
     x += pm->r;
-    
+
     /* 階段部分の値を追加する */
     if( pm->next != NULL && pm->db != pm->next->df ){
       if( show_stair ){
@@ -527,6 +864,10 @@ void print_pressure(mensur* men, int show_stair )
     }
     pm = pm->next;
   }
+
+  free(pr);
+  dispose_bore_work(wk);
+  dispose_bore(b);
 }
 
 /*
@@ -534,50 +875,40 @@ void print_pressure(mensur* men, int show_stair )
  */
 GArray *get_pressure_dist( double f, mensur* men, int show_stair, acoustic_constants *ac )
 {
-  double complex p,det,z;
+  double complex *pr;
   double mag;
   GArray* ar;
+  bore *b;
+  bore_work *wk;
+  int i;
 
-  /* calc imput impedance first */
-  input_impedance(f,men,1,&z,ac);
-
-  ar = g_array_new( FALSE, FALSE, sizeof(double) );
-
-  mensur *pm = get_first_men(men); /* 念のため */
+  b = compile_bore(men);
+  if( b == NULL ) return NULL;
+  wk = create_bore_work(b);
 
   /* calc pressure from start to end */
-  while( pm != NULL ){
-    if( pm->prev )
-      pm->pi = pm->prev->po;
-    else{
-      /* initial value */
-      pm->pi = 0.02 + 0.0*I; /* 60dB HARD CODING */
-      /* 60dB(SPL)=20*10^-6(Pa) * 10^(60/20) 2004.11.19 */
-    }
+  pr = m_malloc( (b->last[0] - b->first[0] + 1)*sizeof(double complex) );
+  bore_pressure(f,b,wk,0.02,pr,NULL,ac);
+  /* 60dB(SPL)=20*10^-6(Pa) * 10^(60/20) 2004.11.19 */
 
-    p = pm->pi;
-    mag = 20*log10( cabs(p) );
+  ar = g_array_new( FALSE, FALSE, sizeof(double) );
+
+  for( i = b->first[0]; i <= b->last[0]; i++ ){
+    mag = 20*log10( cabs(pr[i - b->first[0]]) );
     
     g_array_append_val( ar, mag );
     /* 階段部分の値を追加する */
-    if( pm->next != NULL && pm->db != pm->next->df ){
+    if( i < b->last[0] && b->db[i] != b->df[i+1] ){
       if( show_stair ){
 	g_array_append_val( ar, mag );
 	g_array_append_val( ar, mag );
       }
     }
-    
-    /* calc for next segment */
-    pm->ui = pm->pi/pm->zi; 
-    det = pm->m11*pm->m22 - pm->m12*pm->m21;
-    pm->po = pm->m22*pm->pi - pm->m12*pm->ui;
-    pm->uo = pm->m21*pm->pi + pm->m11*pm->ui;
-
-    pm->po /= det;
-    pm->uo /= det;
-
-    pm = pm->next;
   }
+
+  free(pr);
+  dispose_bore_work(wk);
+  dispose_bore(b);
   
   return ar;
 }
@@ -684,12 +1015,39 @@ mensur* build_men( char* inbuf )
   return get_first_men(men);
 }
 
+/*
+ * 配列で与えられたn個の要素(df,db,r)からメンズールを作る
+ * 値にscaleを掛けてmにする。最後の要素が終端で、r == 0でなければならない。
+ * cellsがNULLでなければ、i番目の要素へのポインタをcells[i]に入れる。
+ */
+mensur* build_men_arrays( const double *df, const double *db, const double *r, int n,
+                          double scale, mensur **cells )
+{
+  mensur *head = NULL,*last = NULL,*p;
+  int i;
+
+  /* append_menは一要素ごとに環境変数を見るので、ここで直接繋ぐ */
+  for( i = 0; i < n; i++ ){
+    p = create_men(df[i] * scale,db[i] * scale,r[i] * scale,"");
+    if( last != NULL ){
+      last->next = p;
+      p->prev = last;
+    }else
+      head = p;
+    last = p;
+    if( cells != NULL )
+      cells[i] = p;
+  }
+
+  return head;
+}
+
 /*
  * 名前のついた部分メンズールのポインタを返す
  */
 mensur* find_men(char* s)
 {
-  struct menlist* ml = mensur_list;
+  struct menlist* ml = get_men_lists()->mensur_list;
   mensur* men = NULL;
 
   while( ml != NULL ){
@@ -732,7 +1090,7 @@ double atoval(char* s )
  */
 double find_var(char* s)
 {
-  struct varlist* vl = variable_list;
+  struct varlist* vl = get_men_lists()->variable_list;
   double val = 0;
 
   while( vl != NULL ){
@@ -782,6 +1140,7 @@ void set_var(char* s )
   char* p = s;
   double x;
   struct varlist* var;
+  men_lists *ls = get_men_lists();
 
   while( *p != '=' )
     p++;
@@ -790,10 +1149,10 @@ void set_var(char* s )
   *p = '\0';
     
   var = m_malloc( sizeof(struct varlist) );
-  var->next = variable_list;
+  var->next = ls->variable_list;
   strcpy( var->name,s );
   var->val = x;
-  variable_list = var;
+  ls->variable_list = var;
 
 }
 
@@ -816,7 +1175,7 @@ void read_variables( char* inbuf )
 }
 
 /*
- * 部分メンズール定義を読み込んでグローバルなmensur_listに登録する
+ * 部分メンズール定義を読み込んでこのスレッドのmensur_listに登録する
  */
 void read_child_mensur( char* buf )
 {
@@ -824,6 +1183,7 @@ void read_child_mensur( char* buf )
   char* p = buf,*s;
   struct menlist* ml;
   mensur* men;
+  men_lists *ls = get_men_lists();
     
   while( *p != '\0' ){
     get_line(&p,str);
@@ -834,10 +1194,10 @@ void read_child_mensur( char* buf )
       men = build_men(p);
 	    
       ml = m_malloc( sizeof( struct menlist ));
-      ml->next = mensur_list; /* global data */
+      ml->next = ls->mensur_list;
       ml->men = men;
       strcpy( ml->name, wd );
-      mensur_list = ml;
+      ls->mensur_list = ml;
 
       /* 余計な最後のデータを消しておく ---> 残すように変更 */
       /* remove_last_men( men ); */
@@ -851,8 +1211,10 @@ void read_child_mensur( char* buf )
 mensur* rejoint_men( mensur* men )
 {
   mensur *p,*q,*s,*ss;
+  arena *prev;
     
   p = get_first_men(men);
+  prev = use_men_arena( p->pool ); /* 繋ぎ直しで作る要素も同じarenaに */
 
   while( p->next != NULL ){
     if( p->s_ratio > 0.5 ){
@@ -871,8 +1233,12 @@ mensur* rejoint_men( mensur* men )
 	p->s_ratio = 1 - p->s_ratio;
 	append_men(ss,ss->db,0,0,"");
       }else if( p->side != NULL && p->s_type == SPLIT ){
-	/* join先を探す */
+	/* join先を探す、なければ繋ぎ直さない */
 	s = get_join_men(p,p->side);
+	if( s == NULL ){
+	  p = p->next;
+	  continue;
+	}
 
 	q = s->side;
 	q = remove_men(q); /*最後は除く(1個前が返される)*/
@@ -904,59 +1270,164 @@ mensur* rejoint_men( mensur* men )
 
     p = p->next;
   }
+  use_men_arena( prev );
 
   return men; /* same value that used input */
 }
 
+/*
+ * 変数と部分メンズールの一覧を空にする
+ * 部分メンズールの要素は読み込んだメンズールのarenaにあるので、
+ * 読み込みごとに消しておかないと次のファイルから古い定義が見えてしまう。
+ */
+static void clear_men_lists( void )
+{
+  men_lists *ls = get_men_lists();
+  struct varlist *vl;
+  struct menlist *ml;
+
+  while( ls->variable_list != NULL ){
+    vl = ls->variable_list->next;
+    free( ls->variable_list );
+    ls->variable_list = vl;
+  }
+  while( ls->mensur_list != NULL ){
+    ml = ls->mensur_list->next;
+    free( ls->mensur_list );
+    ls->mensur_list = ml;
+  }
+}
+
 /*
  * メンズールファイルを読み込む
  * 変数定義や部分メンズール定義を処理した後、分岐や合流部分を処理して
  * 全体を適切に繋ぐ。
  */
 mensur* read_mensur( const char *path )
+{
+  mensur *men = read_mensur_nojoint(path);
+
+  if( men == NULL )
+    return NULL;
+  men = rejoint_men(men); /* valve分岐をs_ratioに応じて繋ぎ直す */
+
+#ifdef DEBUG
+  print_men( men,get_men_lists()->filecomment );
+#endif
+
+  return get_first_men(men); /* this is first segment */
+}
+
+/*
+ * 読み込んだテキストから部分メンズールを接続するところまで行う
+ * readbufferはNUL終端で、書き換えられる。メンズールがなければNULLを返す。
+ */
+static mensur* parse_mensur_text( char *readbuffer )
+{
+  mensur *men = NULL;
+  char *p;
+  arena *pool;
+
+  eol_to_lf( readbuffer );
+  /*  eat_blank( readbuffer ); */
+
+  /* 要素はすべてこの読み込みのarenaに確保する */
+  pool = use_men_arena( create_arena(0) );
+
+  clear_men_lists();
+  read_variables( readbuffer );
+  read_child_mensur( readbuffer );
+
+  p = readbuffer;
+  get_line( &p,get_men_lists()->filecomment ); /* 最初の行はファイルコメント */
+  men = build_men(p);
+
+  resolve_child(men);
+  clear_men_lists();
+
+  pool = use_men_arena( pool );
+  if( men == NULL ){
+    fprintf(stderr,"no mensur cells found\n");
+    dispose_arena( pool );
+  }
+
+  return get_first_men(men); /* this is first segment */
+}
+
+/*
+ * メンズールファイルを読み込み、部分メンズールを接続するところまで行う
+ * rejoint_menはまだ行わないので、set_men_ratioで分岐比を変えてから
+ * copy_men,rejoint_menで何度でも計算用のメンズールを作れる。
+ */
+mensur* read_mensur_nojoint( const char *path )
 {
   int err;
   FILE* infile;
-  mensur *men = NULL;
+  mensur *men;
   struct stat fstatus;
   unsigned long readbytes;
-  char *readbuffer,*p; 
+  char *readbuffer; 
 
   if( (err = stat(path,&fstatus)) != 0 ){
-    fprintf(stderr,"open err at read_mensur : %d\n",err);
-    exit(-1);
+    fprintf(stderr,"open err at read_mensur : %s\n",path);
+    return NULL;
   }
     
   readbytes = fstatus.st_size;
   readbuffer = malloc( readbytes + 1 );
   if( readbuffer == NULL ){
     fprintf(stderr,"cant assign memory for read.\n");
-    exit(-1);
+    return NULL;
   }
 
   infile = fopen(path,"r");
-  fread(readbuffer,1,readbytes,infile);
+  if( infile == NULL ){
+    fprintf(stderr,"open err at read_mensur : %s\n",path);
+    free( readbuffer );
+    return NULL;
+  }
+  readbytes = fread(readbuffer,1,readbytes,infile);
   readbuffer[readbytes] = '\0';
   fclose(infile);
 
-  eol_to_lf( readbuffer );
-  /*  eat_blank( readbuffer ); */
+  men = parse_mensur_text( readbuffer );
+  free( readbuffer );
 
-  read_variables( readbuffer );
-  read_child_mensur( readbuffer );
+  return men;
+}
 
-  p = readbuffer;
-  get_line( &p,filecomment ); /* 最初の行はファイルコメント */
-  men = build_men(p);
+/*
+ * メモリ上のメンズール(lenバイト、NUL終端は不要)を読み込む
+ * ファイルを読んだ場合と同じ結果になる。
+ */
+mensur* read_mensur_buffer( const char *text, size_t len )
+{
+  mensur *men = read_mensur_buffer_nojoint( text,len );
 
-  resolve_child(men);
-  men = rejoint_men(men); /* valve分岐をs_ratioに応じて繋ぎ直す */
+  if( men == NULL )
+    return NULL;
+  men = rejoint_men(men);
 
-#ifdef DEBUG
-  print_men( mensur,filecomment );
-#endif
+  return get_first_men(men);
+}
 
-  return get_first_men(men); /* this is first segment */
+mensur* read_mensur_buffer_nojoint( const char *text, size_t len )
+{
+  mensur *men;
+  char *readbuffer;
+
+  readbuffer = malloc( len + 1 );
+  if( readbuffer == NULL ){
+    fprintf(stderr,"cant assign memory for read.\n");
+    return NULL;
+  }
+  memcpy( readbuffer,text,len );
+  readbuffer[len] = '\0';
+
+  men = parse_mensur_text( readbuffer );
+  free( readbuffer );
+
+  return men;
 }
 
 /*
@@ -975,52 +1446,6 @@ unsigned int count_men( mensur* men )
   return i;
 }
 
-/*
- * mensurの全ブランチにわたって伝達行列の合成を計算する
- */
-void transmission_matrix( mensur *men, mensur* end,
-			  complex double* m11,complex double* m12,
-			  complex double* m21, complex double* m22,
-			  acoustic_constants *ac )
-{
-  mensur* pm;
-
-  complex double n11,n12,n21,n22;
-  complex double z11,z12,z21,z22; /* 合成行列 */
-  complex double x11,x12,x21,x22;
-    
-  if( end == NULL ){
-    pm = get_last_men(men);
-    /* 最後は終端セルだからまず手前に一つ戻す */
-    pm = pm->prev; 
-  }else
-    pm = end;
-
-  z11 = pm->m11;
-  z12 = pm->m12;
-  z21 = pm->m21;
-  z22 = pm->m22;
-
-  while( pm != men ){
-    pm = pm->prev; 
-    n11 = pm->m11;
-    n12 = pm->m12;
-    n21 = pm->m21;
-    n22 = pm->m22;
-
-    x11 = n11*z11 + n12*z21;
-    x12 = n11*z12 + n12*z22;
-    x21 = n21*z11 + n22*z21;
-    x22 = n21*z12 + n22*z22;
-
-    z11 = x11; z12 = x12;
-    z21 = x21; z22 = x22;
-  }
-
-  *m11 = z11; *m12 = z12;
-  *m21 = z21; *m22 = z22;
-}
-
 /*
  * 入口出口の断面積変化率を計算する
  */
@@ -1071,197 +1496,6 @@ void sec_var_ratio(mensur* men, double *out_t1, double *out_t2 )
   *out_t2 = t2;
 }
 
-/*
- * 各menのセグメントでインピーダンスを計算する
- */
-void do_calc_imp( double frq, mensur* men, acoustic_constants *ac )
-{
-  double complex z,z1,z2,k,x,m11,m12,m21,m22,n11,n12,n21,n22;
-  /* z : acoustic impedance z = p/u
-     p : pressure
-     u : volume velocity
-     k : wave number */
-  double d,d1,d2,w,L,aa,r1,r2,s1,s2,ss,t1,t2;
-  mensur* nm;
-
-  /* まず出口端と次のセグメントの入力端との連続条件 */
-  men->po = men->next->pi;/* should be removed in future? */
-  men->uo = men->next->ui;/* should be removed in future? */
-  men->zo = men->next->zi;/* new code for calcimp, default zo without branch. */
-  
-  if( men->side != NULL ){/* has side branch */
-    if( men->s_type == TONEHOLE ){
-      /* 音孔としての扱い */
-      input_impedance(frq,men->side,men->s_ratio,&z1,ac);
-      z2 = men->next->zi;
-      z = z1*z2/(z1+z2);
-      men->po = men->next->pi;/* should be removed in future? */
-      men->uo = men->po/z;/* should be removed in future? */
-      men->zo = z; /* new code for calimp */
-
-    }else if( men->s_type == ADDON && men->s_ratio > 0 ){
-      /* ループ管のインピーダンス */
-      input_impedance(frq,men->side,1,&z1,ac);/* z1 は未使用 */
-      transmission_matrix(men->side,NULL,&m11,&m12,&m21,&m22,ac);
-	    
-      /*↓これは間違いだった(20040928:Yoshinobu Ishizaki)*/
-      /*  z1 = m12/( m12*m21+(1-m11)*(1+m22) ); */
-      z1 = m12/(m12*m21-(1-m11)*(1-m22));
-
-      z1 /= men->s_ratio;/* 面積比の調整 */
-      z2 = men->next->zi;
-      z2 /= (1 - men->s_ratio);/* 面積比の調整 */	
-      z = z1*z2/(z1+z2);
-
-      men->po = men->next->pi; /* should be removed in future? */
-      men->uo = men->po/z; /* should be removed in future? */
-      men->zo = z; /* new code for calcimp */
-
-    }else if( men->s_type == SPLIT && men->s_ratio > 0 ){
-      /* 複合管のインピーダンス */
-      input_impedance(frq,men->side,1,&z1,ac); /* z1 は未使用 */
-      transmission_matrix(men->side,NULL,&m11,&m12,&m21,&m22,ac);
-
-      nm = get_join_men(men,men->side);
-      transmission_matrix(men->next,nm,&n11,&n12,&n21,&n22,ac);
-
-      /* 面積比を掛ける */
-      m12 /= (1 - men->s_ratio);
-      m21 *= (1 - men->s_ratio);
-      n12 /= men->s_ratio;
-      n21 *= men->s_ratio;
-
-      z2 = nm->next->zi;
-      z = (m12*n12 + (m12*n11 + m11*n12)*z2)/
-	(m22*n12 + m12*n22 + ((m12 + n12)*(m21 + n21) - 
-			      (m11 - n11)*(m22 - n22))*z2);
-
-      men->po = nm->next->pi; /* should be remove in future? */
-      men->uo = men->po/z; /* should be remove in future? */
-      men->zo = z; /* new code for calcimp */
-    }
-  }
-
-  /* 
-   * 伝達行列を計算し、それと出口側のpo,uoから入口側のpi,uiを計算する
-   * 詳細はMathematicaによるWebstar方程式.nb.pdfを参照すること
-   */
-  w = PI2*frq;
-
-  if( men->r == 0.0 ){
-    men->pi = men->po;
-    men->ui = men->uo;
-    men->m11 = men->m22 = 1.0;
-    men->m12 = men->m21 = 0.0;
-  }else{
-    d1 = men->df;
-    d2 = men->db;
-    d = (d1+d2) * 0.5;
-    L = men->r;
-
-    /* 
-       Fletcherの教科書の方法
-       (ちょっとラフなので使わないが大きくは違わなかった。)
-       v = c0 * (1 - VRATIO/d/sqrt(frq));
-       aa = ARATIO * sqrt(frq)/d;
-       k = w/v - I*aa;
-    */
-
-#if 1
-    /* より正確に計算する。詳細は"管壁摩擦再考"の文書を参照(2004.11.18) */
-    aa = (1+(GMM-1)/sqrt(Pr))*sqrt(2*w*ac->nu)/ac->c0/d;
-#else
-    /* 古典吸収による損失。小さすぎて合わない 
-       教科書にも通常壁面損失より小さいと書いてあるが…
-    */
-    aa = pow(frq,2)*(1.9191330643902223e-11 + 0.8101467155352282*
-		     (6.807568405969152e-6/
-		      (75.05860674577968 + 0.013322922491579913*
-		       pow(frq,2)) + 1.347451648197375e-6/
-		      (13.066677226339555 + 0.07653055039763432*
-		       pow(frq,2))));
-#endif
-
-    if( ac->dump_calc == WALL ){
-#if 1
-      k = csqrt( (w/ac->c0)*(w/ac->c0 - 2*(I-1)*aa) );
-#else
-      /* これも近似式だが大して結果は変わらない */
-      /*  k = (w/ac->c0 + aa) - I*aa; */
-      /* 敢えて虚部だけにaaをいれる。何故かこの方が音程面でうまくいく */
-      /* HRで全体的に音程を高く見積もってしまっている。やっぱり不採用 */
-      k = w/ac->c0 - I*aa;
-#endif
-    }else if( ac->dump_calc == NONE ){
-      k = w/ac->c0;
-    }
-    x = k*L;
-
-    if( ac->sec_var_calc ){
-      /* 断面積変化率を考慮した計算を行う */
-      /* テーパ,直管両方をまとめた式を使っている */
-      /* 計算してみたら、テーパ反転があるところで著しく実際と異なる
-	 特性となってしまって、ダメ */
-      s1 = PI/4*d1*d1;
-      s2 = PI/4*d2*d2;
-      ss = sqrt(s1*s2);
-      sec_var_ratio(men,&t1,&t2);
-
-      men->m11 = ( 2*k*s2*ccos(x) - t2*csin(x) )/(2*k*ss);
-      men->m12 = ( I * ac->rhoc0 * csin(x) )/ss;
-      men->m21 = ( -2*I*k*( s2*t1-s1*t2 )*ccos(x) +
-		   I*( 4*k*k*s1*s2 + t1*t2 )*csin(x) )/
-	(4*ac->rhoc0*k*k*ss);
-      men->m22 = (2*k*s1*ccos(x) + t1*csin(x) )/(2*k*ss);
-
-    }else{
-      /* 断面積変化率を考慮しない */
-      if( men->df == men->db ){
-	/* straight */
-	s1 = PI/4*d*d;
-	men->m11 = men->m22 = ccos(x);
-	men->m12 = I*ac->rhoc0*csin(x)/s1;
-	men->m21 = I*s1*csin(x)/ac->rhoc0;
-      }else{
-	/* taper */
-	r1 = d1/2;
-	r2 = d2/2;
-
-	men->m11 = ( r2*x*ccos(x) -(r2-r1)*csin(x))/(r1*x);
-	men->m12 = I*ac->rhoc0*csin(x)/(PI*r1*r2);
-	men->m21 = -I*PI*( (r2-r1)*(r2-r1)*x*ccos(x) -
-			   ((r2-r1)*(r2-r1) + x*x*r1*r2 )*csin(x) )/
-	  (k*k*L*L*ac->rhoc0);
-	men->m22 = ( r1*x*ccos(x) + (r2-r1)*csin(x))/(r2*x);
-		
-	/* 以下逆テーパ問題で変更する前までの式を念のため残しておく 
-	   men->m11 = ( x*d2*ccos(x)+(d1-d2)*csin(x) )/(x*d1);
-	   men->m12 = 4*I*rho*w*csin(x)/(k*PI*d1*d2);
-	   men->m21 = -I*PI*( x*(d1-d2)*(d1-d2)*ccos(x) - 
-	   ( (d1-d2)*(d1-d2) + x*x*d1*d2 )*csin(x) ) / 
-	   (4*k*L*L*rho*w);
-	   men->m22 = ( x*d1*ccos(x)-(d1-d2)*csin(x) )/(x*d2);
-	*/
-      }
-    }
-    men->pi = men->m11*men->po + men->m12*men->uo;
-    men->ui = men->m21*men->po + men->m22*men->uo;
-    
-    /* new code for calcimp */
-    if( men->next->y != 0.0 ){  
-      men->zi = (men->m11*men->zo + men->m12)/(men->m21*men->zo + men->m22 ); 
-    }else{
-      /* impedance of next men cell is infinity! */
-      men->zi = men->m11/men->m21;
-    }
-  }
-}
-
-void get_imp(mensur* men,double complex* out_z)
-{
-  *out_z = men->zi;
-}
-
 /*
  * 放射インピーダンスを計算する
  * 無限バッフル中の円盤による放射としての計算を行って
@@ -1272,7 +1506,7 @@ void get_imp(mensur* men,double complex* out_z)
  * zr : 放射インピーダンス = p/u, pは音圧,uは体積速度
  */
 #if 1
-void rad_imp( double frq,double d,double complex* zr, acoustic_constants *ac )
+void rad_imp( double frq,double d,double complex* zr, const acoustic_constants *ac )
 {
   double a,x,s;
   double re,im;
@@ -1319,7 +1553,7 @@ void rad_imp( double frq,double d,double complex* zr, acoustic_constants *ac )
 /*
  * Schwinger & Levineのフランジ無し放射特性計算の近似式を使う
  */
-void rad_imp( double frq,double d,double complex* zr, acoustic_constants *ac )
+void rad_imp( double frq,double d,double complex* zr, const acoustic_constants *ac )
 {
   double a,x,w,L,R,s,k,y;
   double complex bunbo,bunsi;
@@ -1355,63 +1589,25 @@ void rad_imp( double frq,double d,double complex* zr, acoustic_constants *ac )
 /*
  * input impedance 計算
  * e_ratioは終端断面積の調整因子(e_ratio*dを真の直径として計算する)
+ * 一回限りの計算用。掃引するときはcompile_bore()したboreを使うこと。
  */
 void input_impedance (double frq, mensur* men, double e_ratio,
 		      double complex* out_z, acoustic_constants *ac )
 {
-  double complex p,u,z;
-
-
-  mensur* pm = get_last_men(men);
-
-  p = 0.02 + 0.0*I; /* 60dB(SPL)=20*10^-6 * 10^(60/20) 2004.11.19 */
-
-
-  /* 終端 */
-  if( pm->df <= 0 || e_ratio == 0 ){/* closed end */
-    /*  pm->pi = 1.0 + 0.0*I; */
-    pm->pi = p;
-    pm->ui = 0.0 + 0.0*I;
-    /* set admittance to 0 */
-    pm->y = 0.0;
-
-  }else{/* open end */
-    rad_imp(frq,(pm->df)*e_ratio,&z,ac);
-
-    /*  u = 1.0 + 0.0 *I; */
-    /*  p = z*u; */
-    /* 開口端でのu値を適当に決めちゃっているが、それで良いのか? */
-    /* 2004.11.19
-       ->良くない?
-       開口端補正が入るために、ここでの音圧が一定と仮定し,
-       それから体積速度を求めるべきであった。
-       音圧は適当なところで60dB(SPL)とした。
-       が,この値は計算のアルゴリズム上どんな値でも結果に影響しない。
-       今までのようにuからpを求めるのではなく、pからuを求めることが重要
-       かと思ったが結果は変わらなかった。
-       むしろ、理論式と合わないと思うのだが、
-       u=p/z*sとすると音程はともかくインピーダンス曲線が良くあう。
-    */
-    if( ac->rad_calc != NONE )
-      u = p/z;
-    else{
-      u = 1.0;
-      p = 0.0;
-      z = 0.0;
-    }
+  bore *b;
+  bore_work *wk;
 
-    pm->pi = p;
-    pm->ui = u;
-    pm->zi = z;
+  b = compile_bore(men);
+  if( b == NULL ){
+    *out_z = 0.0;
+    return;
   }
+  wk = create_bore_work(b);
 
-  do{
-    pm = pm->prev;
-    do_calc_imp(frq,pm,ac);
-  }while( pm->prev != NULL );
+  bore_input_impedance(frq,b,wk,e_ratio,out_z,ac);
 
-  /* input impedance at initial mensur cell */
-  get_imp(pm,out_z);
+  dispose_bore_work(wk);
+  dispose_bore(b);
 }
 
 /* 
@@ -17,6 +17,7 @@
 
 #include "xydata.h"
 #include "acoustic_constants.h"
+#include "arena.h"
 
 struct men_s {
   double df,db,r;
@@ -25,12 +26,8 @@ struct men_s {
   int s_type; /* type of side branch */
   double hf; /* horn function at outer end */
   double s_ratio; /* ratio of side branching */
-  double complex zi, zo; /* retain impedance in mensur cell */
-  double complex y; /* in case of infinity impedance */ 
-
-  double complex ui,pi; /* will not be used by calcimp */
-  double complex uo,po; /* will not be used by calcimp */
-  double complex m11,m12,m21,m22; /* transmission matrix */
+  arena *pool; /* 要素を確保したarena, NULLならmalloc */
+  /* per-frequency values live in bore_work, see bore.h */
 };
 typedef struct men_s mensur;
 
@@ -70,6 +67,7 @@ enum { TONEHOLE = 1, ADDON,SPLIT,JOIN };
 
 /* ------------------------------ prototype ------------------------------ */
 /* zmensur.c */
+arena *use_men_arena(arena *pool);
 mensur *create_men(double df, double db, double r, char *comm);
 mensur *get_first_men(mensur *inmen);
 mensur *get_last_men(mensur *inmen);
@@ -82,17 +80,24 @@ void dispose_men(mensur *inmen);
 void scale_men(mensur *men, double a);
 void hokan_men(mensur *men, double step);
 void divide_men( mensur* men, double step );
+int simplify_men(mensur *men, double tol);
+mensur *copy_men(mensur *men);
+void dispose_men_tree(mensur *men);
+int set_men_ratio(mensur *men, const char *sidename, double ratio);
+GPtrArray *get_men_branches(mensur *men);
 mensur *cut_men(mensur *inmen, double len);
 mensur *print_men_core(mensur *inmen);
 void print_men(mensur *inmen, char *comment);
 void print_men_reverse(mensur *inmen, char *comment);
 void print_men_xy(mensur *inmen, char *comment, int show_stair);
 GPtrArray *get_men_xy(mensur* men, int show_stair );
-void print_pressure(mensur *men, int show_stair);
+void print_pressure(double f, mensur *men, int show_stair, acoustic_constants *ac);
 GArray *get_pressure(mensur* men, int show_stair );
 GArray *get_pressure_dist(double frq, mensur* men, int show_stair, acoustic_constants *ac);
 void resolve_child(mensur *men);
 mensur *build_men(char *inbuf);
+mensur *build_men_arrays(const double *df, const double *db, const double *r, int n,
+                         double scale, mensur **cells);
 mensur *find_men(char *s);
 double atoval(char *s);
 double find_var(char *s);
@@ -102,13 +107,13 @@ void read_variables(char *inbuf);
 void read_child_mensur(char *buf);
 mensur *rejoint_men(mensur *men);
 mensur *read_mensur(const char *path);
+mensur *read_mensur_nojoint(const char *path);
+mensur *read_mensur_buffer(const char *text, size_t len);
+mensur *read_mensur_buffer_nojoint(const char *text, size_t len);
 unsigned int count_men(mensur *men);
-void transmission_matrix(mensur *men, mensur *end, _Complex double *m11, _Complex double *m12, _Complex double *m21, _Complex double *m22, acoustic_constants *ac);
 void sec_var_ratio1(mensur *men, double *out_t1, double *out_t2);
 void sec_var_ratio(mensur *men, double *out_t1, double *out_t2);
-void do_calc_imp(double frq, mensur *men, acoustic_constants *ac);
-void get_imp(mensur *men, double _Complex *out_z);
-void rad_imp(double frq, double d, double _Complex *zr, acoustic_constants *ac);
+void rad_imp(double frq, double d, double _Complex *zr, const acoustic_constants *ac);
 void input_impedance(double frq, mensur *men, double e_ratio, double _Complex *out_z, acoustic_constants *ac);
 mensur *trunc_men(mensur *inmen);
 void horn_function(mensur *inmen);
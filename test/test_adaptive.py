@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""
+Test the adaptive frequency sweep.
+
+calcimp_adaptive() refines a coarse grid around the extrema of |Z| and
+where the curve changes fast. Its values must be those of the impedance at
+the returned frequencies, and its peaks those of a dense uniform sweep.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+TEST_FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur.xmen',
+]
+
+MAX_FREQ = 2000.0
+MIN_STEP = 0.01
+DENSE_STEP = 0.05
+RTOL = 1e-10
+
+
+def local_maxima(freq, mag_db):
+    k = np.where((mag_db[1:-1] > mag_db[:-2]) & (mag_db[1:-1] > mag_db[2:]))[0] + 1
+    return freq[k[freq[k - 1] > 0]]
+
+
+def check(fn):
+    freq, real, imag, mag_db = calcimp.calcimp_adaptive(fn, max_freq=MAX_FREQ, min_step=MIN_STEP)
+
+    if freq[0] != 0 or freq[-1] != MAX_FREQ or not np.all(np.diff(freq) > 0):
+        print(f"   ✗ {fn}: frequencies are not ascending from 0 to {MAX_FREQ}")
+        return False
+    if not len(freq) * 10 < MAX_FREQ / MIN_STEP:
+        print(f"   ✗ {fn}: {len(freq)} points, no saving over a uniform grid")
+        return False
+
+    ref = calcimp.impedance_at(fn, freq, threads=1)
+    za = real + 1j * imag
+    zb = ref[1] + 1j * ref[2]
+    d = np.max(np.abs(za - zb) / np.maximum(np.abs(zb), 1e-300))
+    if not d <= RTOL:
+        print(f"   ✗ {fn}: max relative difference {d:.3e} from impedance_at")
+        return False
+
+    dense = calcimp.calcimp(fn, max_freq=MAX_FREQ, step_freq=DENSE_STEP)
+    peaks = local_maxima(freq, mag_db)
+    dense_peaks = local_maxima(dense[0], dense[3])
+    if len(peaks) != len(dense_peaks):
+        print(f"   ✗ {fn}: {len(peaks)} peaks, dense sweep has {len(dense_peaks)}")
+        return False
+    err = np.max(np.abs(peaks - dense_peaks))
+    if not err <= DENSE_STEP + MIN_STEP:
+        print(f"   ✗ {fn}: peak off by {err:.3f} Hz")
+        return False
+
+    print(f"   ✓ {fn}: {len(freq)} points, {len(peaks)} peaks within {err:.3f} Hz")
+    return True
+
+
+def test_adaptive():
+    """Compare calcimp_adaptive() with the impedance and with a dense sweep."""
+
+    print("=" * 70)
+    print("Testing adaptive frequency sweep")
+    print("=" * 70)
+
+    print("\n1. Sample files...")
+    for fn in TEST_FILES:
+        if not check(fn):
+            return False
+
+    print("\n2. Point budget...")
+    freq = calcimp.calcimp_adaptive(TEST_FILES[0], max_freq=MAX_FREQ, max_points=400)[0]
+    if len(freq) != 400:
+        print(f"   ✗ max_points=400 gave {len(freq)} points")
+        return False
+    print("   ✓ max_points")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: adaptive sweep matches the impedance")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_adaptive()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+"""
+Test repeated reads of mensur files allocated from arenas.
+
+Every parse takes its cells from a fresh arena and frees them in one
+pass, and the ZMENSUR variable and child lists are emptied around each
+read. Reading the same file again, or another file in between, must give
+exactly the result of the first read.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+XMEN = '../sample/trumpet_valve.xmen'
+# child definition $V1LOOP
+MEN_CHILD = 'sample_xmensur_equiv.men'
+MEN = '../sample/test.men'
+
+REPEAT = 20
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def read_all(fn):
+    """Results of every entry point that parses fn."""
+    return (calcimp.print_men(fn),
+            calcimp.simplify_men(fn),
+            calcimp.simplify_men(fn, tolerance=0.1),
+            calcimp.Instrument(fn).calcimp(max_freq=2000.0, step_freq=10.0))
+
+
+def same_read(a, b):
+    return a[0] == b[0] and a[1] == b[1] and a[2] == b[2] and same(a[3], b[3])
+
+
+def test_arena():
+    """Compare repeated and interleaved reads with the first read."""
+
+    print("=" * 70)
+    print("Testing repeated reads of mensur files")
+    print("=" * 70)
+
+    # parse on every call instead of handing out cached copies
+    old = calcimp.set_cache_size(0)
+    try:
+        print("\n1. Repeated reads of one file...")
+        first = {}
+        for fn in [MEN_CHILD, XMEN, MEN]:
+            first[fn] = read_all(fn)
+            for k in range(REPEAT):
+                if not same_read(read_all(fn), first[fn]):
+                    print(f"   ✗ {fn}: read {k + 2} differs from the first")
+                    return False
+            print(f"   ✓ {fn}: {REPEAT + 1} identical reads")
+
+        print("\n2. Interleaved reads...")
+        for order in [(XMEN, MEN_CHILD), (MEN_CHILD, MEN), (XMEN, MEN), (XMEN, MEN_CHILD, MEN)]:
+            for k in range(REPEAT):
+                for fn in order:
+                    if not same_read(read_all(fn), first[fn]):
+                        print(f"   ✗ {fn} after {' and '.join(order)}: differs from the first read")
+                        return False
+            print(f"   ✓ {' then '.join(order)}")
+    finally:
+        calcimp.set_cache_size(old)
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: every read equals the first")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_arena()
+    sys.exit(0 if success else 1)
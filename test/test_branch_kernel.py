@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+"""
+Test the single pass evaluation of ADDON and SPLIT branches.
+
+The valve loop of trumpet_valve.xmen (SPLIT) and the side tube of
+split.xmen (ADDON) are evaluated at branch ratios 0, 0.5 and 1. The
+blocked kernel must agree with the scalar kernel to within rounding, and
+both must reproduce the reference files in ref_branch/, written by the
+sequential branch evaluation that the single pass replaced.
+"""
+
+import os
+import re
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+# file, branch name, reference file stem
+CASES = [
+    ('../sample/trumpet_valve.xmen', 'VALVE1', 'trumpet_valve_VALVE1'),
+    ('../sample/split.xmen', 'TH1', 'split_TH1'),
+]
+
+RATIOS = [0.0, 0.5, 1.0]
+
+REF_DIR = 'ref_branch'
+
+RTOL = 1e-9
+
+
+def edited_copy(filename, name, ratio):
+    """Write filename with every ratio of branch name replaced."""
+    with open(filename) as f:
+        text = f.read()
+    text = re.sub(r'(,\s*%s\s*,\s*)[0-9.]+' % re.escape(name), r'\g<1>%r' % ratio, text)
+    fd, path = tempfile.mkstemp(suffix='.xmen')
+    with os.fdopen(fd, 'w') as f:
+        f.write(text)
+    return path
+
+
+def read_imp(filename):
+    """Read an .imp file into (freq, real, imag)."""
+    data = np.loadtxt(filename, delimiter=',', skiprows=1)
+    return data[:, 0], data[:, 1], data[:, 2]
+
+
+def max_rel_diff(a, b):
+    za = a[1] + 1j * a[2]
+    zb = b[1] + 1j * b[2]
+    scale = np.maximum(np.abs(za), 1e-300)
+    return np.max(np.abs(za - zb) / scale)
+
+
+def test_branch_kernel():
+    """Compare both kernels with each other and with the references."""
+
+    print("=" * 70)
+    print("Testing ADDON and SPLIT branches against reference impedances")
+    print("=" * 70)
+
+    args = dict(max_freq=2000.0, step_freq=10.0)
+
+    for fn, name, stem in CASES:
+        for ratio in RATIOS:
+            ref = read_imp(os.path.join(REF_DIR, f"{stem}_{ratio}.imp"))
+            path = edited_copy(fn, name, ratio)
+            try:
+                sca = calcimp.calcimp(path, scalar=True, **args)
+                blk = calcimp.calcimp(path, **args)
+            finally:
+                os.unlink(path)
+            if not np.allclose(sca[0], ref[0]) or not np.array_equal(sca[0], blk[0]):
+                print(f"   ✗ {fn} {name}={ratio}: frequency axis differs")
+                return False
+            d = max_rel_diff(sca, blk)
+            if not d <= RTOL:
+                print(f"   ✗ {fn} {name}={ratio}: blocked against scalar {d:.3e}")
+                return False
+            for label, res in [('scalar', sca), ('blocked', blk)]:
+                d = max_rel_diff(ref, res)
+                if not d <= RTOL:
+                    print(f"   ✗ {fn} {name}={ratio}: {label} against reference {d:.3e}")
+                    return False
+            print(f"   ✓ {fn} {name}={ratio}")
+
+    print("\n" + "=" * 70)
+    print(f"✓ ALL TESTS PASSED: branches agree within {RTOL}")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_branch_kernel()
+    sys.exit(0 if success else 1)
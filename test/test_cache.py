@@ -0,0 +1,135 @@
+#!/usr/bin/env python
+"""
+Test the cache of parsed mensur files.
+
+calcimp() and the other file based functions keep the parsed and compiled
+file between calls and hand out copies. Results must not depend on the
+cache, a changed file must be parsed again, and the cache must keep no
+more than its size.
+"""
+
+import os
+import shutil
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+TRUMPET = '../sample/trumpet_valve.xmen'
+
+
+def write_tube(path, length):
+    """Straight tube of 10 mm by length mm, always the same file size."""
+    with open(path, 'w') as f:
+        f.write(f"cache test\n10,10,{length:04d}\n10,0,0\n")
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def test_cache():
+    """Check results, invalidation and eviction of the file cache."""
+
+    print("=" * 70)
+    print("Testing the parsed file cache")
+    print("=" * 70)
+
+    tmp = tempfile.mkdtemp()
+    try:
+        calcimp.set_cache_size(16)
+        calcimp.clear_cache()
+
+        print("\n1. Cached results...")
+        old = calcimp.set_cache_size(0)
+        ref = calcimp.calcimp(TRUMPET)
+        ref_simple = calcimp.calcimp(TRUMPET, simplify=0.1)
+        ref_men = calcimp.print_men(TRUMPET)
+        calcimp.set_cache_size(old)
+        if calcimp.cache_info()['size'] != 0:
+            print("   ✗ files cached with size 0")
+            return False
+        for _ in range(3):
+            if not (same(calcimp.calcimp(TRUMPET), ref) and
+                    same(calcimp.calcimp(TRUMPET, simplify=0.1), ref_simple) and
+                    calcimp.print_men(TRUMPET) == ref_men):
+                print("   ✗ cached results differ")
+                return False
+            # these edit their copy of the cells
+            calcimp.simplify_men(TRUMPET, tolerance=1.0)
+            calcimp.pressure_field(TRUMPET, [100.0], step=5.0)
+        info = calcimp.cache_info()
+        if info['size'] != 1 or info['misses'] != 1 or info['hits'] < 10:
+            print(f"   ✗ {info}")
+            return False
+        print(f"   ✓ identical, {info['hits']} hits and {info['misses']} miss")
+
+        print("\n2. Changed files...")
+        tube = os.path.join(tmp, 'tube.men')
+        write_tube(tube, 1000)
+        f1 = calcimp.find_resonances(tube)[0][0]
+        write_tube(tube, 500)
+        st = os.stat(tube)
+        os.utime(tube, ns=(st.st_atime_ns, st.st_mtime_ns + 1000))
+        f2 = calcimp.find_resonances(tube)[0][0]
+        if not 1.9 < f2 / f1 < 2.1:
+            print(f"   ✗ same size rewrite not seen: {f1:.1f} Hz then {f2:.1f} Hz")
+            return False
+        other = os.path.join(tmp, 'other.men')
+        write_tube(other, 1000)
+        os.replace(other, tube)
+        f3 = calcimp.find_resonances(tube)[0][0]
+        if f3 != f1:
+            print(f"   ✗ replaced file not seen: {f3:.1f} Hz")
+            return False
+        print(f"   ✓ {f1:.1f} Hz, {f2:.1f} Hz after rewriting, {f3:.1f} Hz after replacing")
+
+        print("\n3. Size...")
+        calcimp.clear_cache()
+        calcimp.set_cache_size(2)
+        names = []
+        for k in range(3):
+            names.append(os.path.join(tmp, f'tube{k}.men'))
+            write_tube(names[-1], 1000 + 100 * k)
+            calcimp.calcimp(names[-1])
+        calcimp.calcimp(names[1])
+        calcimp.calcimp(names[2])
+        hits = calcimp.cache_info()['hits']
+        calcimp.calcimp(names[0])
+        info = calcimp.cache_info()
+        if info['size'] != 2 or hits != 2 or info['hits'] != 2 or info['misses'] != 4:
+            print(f"   ✗ least recently used file kept: {info}")
+            return False
+        calcimp.clear_cache()
+        if calcimp.cache_info() != {'size': 0, 'max_size': 2, 'hits': 0, 'misses': 0}:
+            print(f"   ✗ after clear_cache(): {calcimp.cache_info()}")
+            return False
+        try:
+            calcimp.set_cache_size(-1)
+            print("   ✗ negative size accepted")
+            return False
+        except ValueError:
+            pass
+        print("   ✓ two files kept, clear_cache() empties")
+    finally:
+        calcimp.set_cache_size(16)
+        calcimp.clear_cache()
+        shutil.rmtree(tmp)
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: the cache returns the same results")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_cache()
+    sys.exit(0 if success else 1)
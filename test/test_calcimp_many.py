@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""
+Test evaluating many mensur files at once.
+
+calcimp_many() reads and sweeps the files on a pool of native threads, all
+parsers running at the same time. Every file must give exactly what
+calcimp() gives, in the order of the paths, and a file that fails must not
+stop the others.
+"""
+
+import pathlib
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/test.xmen',
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/subgroup.xmen',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur.xmen',
+    'sample_xmensur_equiv.men',
+]
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def test_calcimp_many():
+    """Compare calcimp_many() with calcimp() file by file."""
+
+    print("=" * 70)
+    print("Testing calcimp_many()")
+    print("=" * 70)
+
+    print("\n1. Same results as calcimp()...")
+    ref = [calcimp.calcimp(fn) for fn in FILES]
+    paths = FILES * 4
+    for threads in [1, 3, 0]:
+        res = calcimp.calcimp_many(paths, threads=threads)
+        if len(res) != len(paths):
+            print(f"   ✗ {len(res)} results for {len(paths)} paths")
+            return False
+        for k, r in enumerate(res):
+            if isinstance(r, Exception) or not same(r, ref[k % len(FILES)]):
+                print(f"   ✗ threads={threads}: {paths[k]} differs")
+                return False
+    print(f"   ✓ {len(paths)} files identical with 1, 3 and all threads")
+
+    print("\n2. Options...")
+    kwargs = dict(num_freq=300, max_freq=1500.0, temperature=20.0, simplify=0.5)
+    res = calcimp.calcimp_many([pathlib.Path(fn) for fn in FILES], **kwargs)
+    for fn, r in zip(FILES, res):
+        if not same(r, calcimp.calcimp(fn, **kwargs)):
+            print(f"   ✗ {fn} differs with {kwargs}")
+            return False
+    print("   ✓ num_freq, temperature, simplify and Path objects")
+
+    print("\n3. Failed files...")
+    paths = [FILES[0], 'no_such_file.men', FILES[6], 'no_such_file.xmen']
+    res = calcimp.calcimp_many(paths, threads=2)
+    for k in [1, 3]:
+        if not isinstance(res[k], RuntimeError) or paths[k] not in str(res[k]):
+            print(f"   ✗ {paths[k]} gave {res[k]!r}")
+            return False
+    if not (same(res[0], ref[0]) and same(res[2], ref[6])):
+        print("   ✗ files next to a failed one differ")
+        return False
+    if calcimp.calcimp_many([]) != []:
+        print("   ✗ empty list")
+        return False
+    try:
+        calcimp.calcimp_many(None)
+        print("   ✗ None accepted as paths")
+        return False
+    except TypeError:
+        pass
+    print(f"   ✓ {res[1]}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: calcimp_many() matches calcimp()")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_calcimp_many()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,71 @@
+#!/usr/bin/env python
+"""
+Test the complex math layer (src/cxmath.c).
+
+The C self test compares cx_sincos() and cx_sqrt() with the GSL functions
+on a table of arguments: the exact mode must agree bit for bit, the fast
+mode within its documented ULP bound. The impedance computed with
+fast_math=True must then agree with the default within rounding.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+    from calcimp import _calcimp_c
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILES = [
+    '../sample/test.men',
+    '../sample/split.xmen',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur.xmen',
+]
+
+RTOL = 1e-10
+
+
+def test_cxmath():
+    """Run the C self test and compare fast and exact impedance."""
+
+    print("=" * 70)
+    print("Testing complex math layer")
+    print("=" * 70)
+
+    fail, ulp_exact, ulp_fast, bound = _calcimp_c.cxmath_selftest(True)
+    print(f"\n1. Table against GSL: exact {ulp_exact:g} ulp, fast {ulp_fast:g} ulp "
+          f"(bound {bound})")
+    if fail != 0 or ulp_exact != 0 or ulp_fast > bound:
+        print(f"   ✗ {fail} entries out of bound")
+        return False
+    print("   ✓ Success")
+
+    print("\n2. Impedance with fast_math=True...")
+    for fn in FILES:
+        for scalar in (False, True):
+            ref = calcimp.calcimp(fn, max_freq=4000.0, step_freq=1.0, scalar=scalar)
+            fast = calcimp.calcimp(fn, max_freq=4000.0, step_freq=1.0, scalar=scalar,
+                                   fast_math=True)
+            z0 = ref[1] + 1j * ref[2]
+            z1 = fast[1] + 1j * fast[2]
+            d = np.max(np.abs(z1 - z0) / np.maximum(np.abs(z0), 1e-300))
+            if not d <= RTOL:
+                print(f"   ✗ {fn} scalar={scalar}: max relative difference {d:.3e}")
+                return False
+        print(f"   ✓ {fn}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: complex math layer within bounds")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_cxmath()
+    sys.exit(0 if success else 1)
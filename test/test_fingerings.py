@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+"""
+Test batch evaluation of fingerings.
+
+Instrument.fingerings() shares the transmission matrices of all states
+and the bore behind the first differing hole. Every row must equal a
+separate Instrument.calcimp() with the scalar kernel bit for bit.
+"""
+
+import os
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+N_HOLES = 8
+
+
+def woodwind_men():
+    """Write a conical tube with N_HOLES toneholes, all open in the file."""
+    lines = ["woodwind with %d holes" % N_HOLES, "16,15,120,"]
+    for k in range(N_HOLES):
+        lines += ["-h%d,1" % (k + 1), "15,%.1f,%d," % (15 - 0.3 * (k + 1), 25 + 3 * k)]
+    lines += ["12,12,60,", "12,0,0,"]
+    for k in range(N_HOLES):
+        d = 5 + 0.4 * k
+        lines += ["$h%d" % (k + 1), "%.1f,%.1f,%.1f," % (d, d, 4 + 0.3 * k), "%.1f,0,0," % d]
+    fd, path = tempfile.mkstemp(suffix='.men')
+    with os.fdopen(fd, 'w') as f:
+        f.write("\n".join(lines) + "\n")
+    return path
+
+
+def chart():
+    """Close holes from the top one by one, plus a half hole and a cross fingering."""
+    states = []
+    for n in range(N_HOLES + 1):
+        states.append({'h%d' % (k + 1): 0.0 if k < n else 1.0 for k in range(N_HOLES)})
+    states.append({'h1': 0.0, 'h2': 0.5})
+    states.append({'h1': 0.0, 'h2': 0.0, 'h3': 1.0, 'h4': 0.0})
+    return states
+
+
+def compare(inst, states, args):
+    freq, real, imag, mag_db = inst.fingerings(states, **args)
+    if real.shape != (len(states), len(freq)):
+        print(f"   ✗ result shape {real.shape}")
+        return False
+    for k, state in enumerate(states):
+        ref = inst.calcimp(state, scalar=True, **args)
+        if not (np.array_equal(ref[0], freq) and np.array_equal(ref[1], real[k])
+                and np.array_equal(ref[2], imag[k]) and np.array_equal(ref[3], mag_db[k])):
+            print(f"   ✗ {state}: differs from calcimp()")
+            return False
+    return True
+
+
+def test_fingerings():
+    """Compare fingerings() with one calcimp() per state."""
+
+    print("=" * 70)
+    print("Testing batch evaluation of fingerings")
+    print("=" * 70)
+
+    args = dict(max_freq=2000.0, step_freq=2.5)
+
+    print("\n1. Tonehole chart...")
+    path = woodwind_men()
+    try:
+        inst = calcimp.Instrument(path)
+        for extra in [dict(), dict(threads=3), dict(sec_var_calc=True)]:
+            if not compare(inst, chart(), dict(args, **extra)):
+                return False
+            print(f"   ✓ {len(chart())} fingerings {extra}")
+    finally:
+        os.unlink(path)
+
+    print("\n2. Valve states taking different paths...")
+    for fn, states in [('../sample/trumpet_valve.xmen',
+                        [{'VALVE1': 0.0}, {'VALVE1': 1.0}, {'VALVE1': 0.3}, {}, {'VALVE1': 0.7}]),
+                       ('../sample/split.xmen', [{'TH1': 0.0}, {'TH1': 0.3}, {}])]:
+        if not compare(calcimp.Instrument(fn), states, args):
+            return False
+        print(f"   ✓ {fn}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: fingerings match separate calcimp runs")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_fingerings()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+"""
+Test building bores from arrays.
+
+Mensur.from_arrays() takes the cells as columns, each row a line of a .men
+file, and side branches as descriptors. A bore built this way must give
+exactly the impedance of the same bore read from a file.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+# sample/trumpet_valve.xmen as columns, VALVE1 split after cell 1, joined after cell 2
+TRUMPET_DF = [10.0, 11.5, 11.5, 11.5, 11.5, 15.0, 25.0, 50.0, 120.0]
+TRUMPET_DB = [11.5, 11.5, 11.5, 11.5, 15.0, 25.0, 50.0, 120.0, 0.0]
+TRUMPET_R = [100.0, 200.0, 150.0, 100.0, 50.0, 100.0, 150.0, 200.0, 0.0]
+VALVE = ([11.5, 11.5], [11.5, 0.0], [300.0, 0.0])
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def test_from_arrays():
+    """Compare bores built from arrays with the same bores read from files."""
+
+    print("=" * 70)
+    print("Testing bores built from arrays")
+    print("=" * 70)
+
+    print("\n1. Straight tube...")
+    ref = calcimp.calcimp('../sample/test.men')
+    men = calcimp.Mensur.from_arrays([10.0, 10.0], [10.0, 0.0], [1000.0, 0.0])
+    if not same(men.calcimp(), ref) or men.cells != calcimp.Mensur('../sample/test.men').cells:
+        print("   ✗ differs from test.men")
+        return False
+    men = calcimp.Mensur.from_arrays(np.array([0.01, 0.01]), np.array([0.01, 0.0]),
+                                     np.array([1.0, 0.0]), unit='m')
+    if not same(men.calcimp(), ref):
+        print("   ✗ unit='m' differs")
+        return False
+    print("   ✓ mm and m columns equal test.men")
+
+    print("\n2. Valve loop...")
+    cols = [np.array(c) for c in (TRUMPET_DF, TRUMPET_DB, TRUMPET_R)]
+    inst = calcimp.Instrument('../sample/trumpet_valve.xmen')
+    for ratio in [1.0, 0.0]:
+        men = calcimp.Mensur.from_arrays(*cols, branches=[(1, 'split', ratio) + VALVE + (2,)])
+        if not same(men.calcimp(), inst.calcimp({'VALVE1': ratio})):
+            print(f"   ✗ valve ratio {ratio} differs from trumpet_valve.xmen")
+            return False
+    if not np.array_equal(cols[2], TRUMPET_R):
+        print("   ✗ input columns modified")
+        return False
+    print("   ✓ both valve positions equal trumpet_valve.xmen")
+
+    print("\n3. Large profile and strided columns...")
+    n = 100000
+    x = np.linspace(0.0, 1.0, n)
+    df = 10.0 + 5.0 * x ** 2
+    r = np.full(n, 1500.0 / (n - 1))
+    r[-1] = 0.0
+    db = np.append(df[1:], 0.0)
+    men = calcimp.Mensur.from_arrays(df, db, r)
+    if len(men) != n or abs(men.length - 1500.0) > 1e-6:
+        print(f"   ✗ {len(men)} cells, {men.length} mm")
+        return False
+    wide = np.zeros((n, 3))
+    wide[:, 0], wide[:, 1], wide[:, 2] = df, db, r
+    strided = calcimp.Mensur.from_arrays(wide[:, 0], wide[:, 1], wide[:, 2])
+    if not same(strided.calcimp(max_freq=200.0), men.calcimp(max_freq=200.0)):
+        print("   ✗ strided columns differ")
+        return False
+    print(f"   ✓ {len(men)} cells, {men.length:.1f} mm")
+
+    print("\n4. Bad input...")
+    bad = [
+        dict(df=[10.0, 10.0], db=[10.0, 0.0], r=[1000.0, 5.0]),
+        dict(df=[10.0, 10.0], db=[10.0], r=[1000.0, 0.0]),
+        dict(df=[10.0, np.nan, 10.0], db=[10.0, 10.0, 0.0], r=[500.0, 500.0, 0.0]),
+        dict(df=[10.0, 10.0, 10.0], db=[10.0, 10.0, 0.0], r=[500.0, np.inf, 0.0]),
+        dict(df=[10.0, 10.0, 10.0], db=[10.0, 10.0, 0.0], r=[500.0, -500.0, 0.0]),
+        dict(df=[10.0, 0.0, 10.0], db=[10.0, 10.0, 0.0], r=[500.0, 500.0, 0.0]),
+        dict(df=[10.0, 10.0, 10.0], db=[-10.0, 10.0, 0.0], r=[500.0, 500.0, 0.0]),
+        dict(df=[10.0, 10.0], db=[10.0, 0.0], r=[1000.0, np.nan]),
+        dict(df=TRUMPET_DF, db=TRUMPET_DB, r=TRUMPET_R,
+             branches=[(1, 'split', 1.0, [11.5, 11.5], [0.0, 0.0], [300.0, 0.0], 2)]),
+        dict(df=[10.0, 10.0], db=[10.0, 0.0], r=[1000.0, 0.0], unit='cm'),
+        dict(df=TRUMPET_DF, db=TRUMPET_DB, r=TRUMPET_R, branches=[(1, 'valve', 1.0) + VALVE]),
+        dict(df=TRUMPET_DF, db=TRUMPET_DB, r=TRUMPET_R, branches=[(8, 'tonehole', 1.0) + VALVE]),
+        dict(df=TRUMPET_DF, db=TRUMPET_DB, r=TRUMPET_R, branches=[(1, 'split', 1.0) + VALVE]),
+        dict(df=TRUMPET_DF, db=TRUMPET_DB, r=TRUMPET_R, branches=[(1, 'addon', 2.0) + VALVE]),
+    ]
+    for kwargs in bad:
+        try:
+            calcimp.Mensur.from_arrays(**kwargs)
+            print(f"   ✗ accepted {kwargs}")
+            return False
+        except ValueError:
+            pass
+    try:
+        calcimp.Mensur.from_arrays(*cols, branches=[(1, 'split', 1.0, [11.5, -1.0], [11.5, 0.0],
+                                                     [300.0, 0.0], 2)])
+        print("   ✗ negative branch diameter accepted")
+        return False
+    except ValueError as e:
+        if 'branch 0, cell 1' not in str(e):
+            print(f"   ✗ message does not name the cell: {e}")
+            return False
+    print(f"   ✓ {len(bad) + 1} bad inputs rejected")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: arrays and files give the same bores")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_from_arrays()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+"""
+Test runtime branch states of an Instrument.
+
+An Instrument reads the mensur file once and applies the ratios of its
+valves and toneholes per evaluation. Each state must give the same
+impedance as a copy of the file with the ratio edited in place.
+"""
+
+import os
+import re
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+# file, branch name, ratios to try
+CASES = [
+    ('../sample/trumpet_valve.xmen', 'VALVE1', [0.0, 0.3, 0.5, 1.0]),
+    ('../sample/split.xmen', 'TH1', [0.0, 0.5, 0.7]),
+]
+
+
+def edited_copy(filename, name, ratio):
+    """Write filename with every ratio of branch name replaced."""
+    with open(filename) as f:
+        text = f.read()
+    text = re.sub(r'(,\s*%s\s*,\s*)[0-9.]+' % re.escape(name), r'\g<1>%r' % ratio, text)
+    fd, path = tempfile.mkstemp(suffix='.xmen')
+    with os.fdopen(fd, 'w') as f:
+        f.write(text)
+    return path
+
+
+def test_instrument():
+    """Compare Instrument states with edited mensur files."""
+
+    print("=" * 70)
+    print("Testing runtime branch states")
+    print("=" * 70)
+
+    args = dict(max_freq=2000.0, step_freq=2.5)
+
+    print("\n1. States against edited files...")
+    for fn, name, ratios in CASES:
+        inst = calcimp.Instrument(fn)
+        if name not in inst.branches:
+            print(f"   ✗ {fn}: {name} not in {inst.branches}")
+            return False
+        default = inst.calcimp(**args)
+        ref = calcimp.calcimp(fn, **args)
+        if not np.array_equal(default[1], ref[1]) or not np.array_equal(default[2], ref[2]):
+            print(f"   ✗ {fn}: default state differs from calcimp()")
+            return False
+        for ratio in ratios:
+            path = edited_copy(fn, name, ratio)
+            try:
+                ref = calcimp.calcimp(path, **args)
+            finally:
+                os.unlink(path)
+            res = inst.calcimp({name: ratio}, **args)
+            if not np.array_equal(res[1], ref[1]) or not np.array_equal(res[2], ref[2]):
+                print(f"   ✗ {fn} {name}={ratio}: differs from the edited file")
+                return False
+            print(f"   ✓ {fn} {name}={ratio}")
+
+    print("\n2. Invalid states...")
+    inst = calcimp.Instrument(CASES[0][0])
+    for states, error in [({'NO_SUCH_VALVE': 1.0}, KeyError),
+                          ({CASES[0][1]: 1.5}, ValueError)]:
+        try:
+            inst.calcimp(states, **args)
+        except error:
+            print(f"   ✓ {states} raises {error.__name__}")
+        else:
+            print(f"   ✗ {states} did not raise {error.__name__}")
+            return False
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: runtime states match edited files")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_instrument()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+"""
+Test parsing mensur text held in memory.
+
+loads() hands the text to the same parsers the file readers use, so an
+instrument parsed from the contents of a file must give exactly the
+results of the file itself.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/test.xmen',
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/subgroup.xmen',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur.xmen',
+    'sample_xmensur_equiv.men',
+]
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def test_loads():
+    """Compare instruments parsed from text with those read from files."""
+
+    print("=" * 70)
+    print("Testing mensur text in memory")
+    print("=" * 70)
+
+    print("\n1. Same results as the files...")
+    for fn in FILES:
+        fmt = 'xmen' if fn.endswith('.xmen') else 'men'
+        with open(fn, 'rb') as f:
+            data = f.read()
+        ref = calcimp.Instrument(fn)
+        for text in [data, data.decode('utf-8'), data.replace(b'\n', b'\r\n')]:
+            inst = calcimp.loads(text, format=fmt)
+            if inst.branches != ref.branches or not same(inst.calcimp(), ref.calcimp()):
+                print(f"   ✗ {fn} from {type(text).__name__}")
+                return False
+            if ref.branches:
+                closed = {name: 0.0 for name in ref.branches}
+                if not same(inst.calcimp(closed), ref.calcimp(closed)):
+                    print(f"   ✗ {fn} with the branches closed")
+                    return False
+        print(f"   ✓ {fn}")
+    with open(FILES[2]) as f:
+        text = f.read()
+    if not same(calcimp.loads(text).calcimp(), calcimp.calcimp(FILES[2])):
+        print("   ✗ default format is not xmen")
+        return False
+
+    print("\n2. Bad input...")
+    try:
+        calcimp.loads("[\n10, 10, 1000\nOPEN_END\n]\n", format='xml')
+        print("   ✗ unknown format accepted")
+        return False
+    except ValueError:
+        pass
+    try:
+        calcimp.loads("10, 10, 1000\nOPEN_END\n", format='xmen')
+        print("   ✗ XMENSUR without MAIN accepted")
+        return False
+    except RuntimeError:
+        pass
+    print("   ✓ unknown format and missing MAIN rejected")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: text and files give the same instruments")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_loads()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+"""
+Test the Mensur type.
+
+A Mensur parses and compiles a file once and evaluates the compiled bore
+on every call. Each method must give exactly what the file based function
+gives, and the object must not change between calls.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILES = [
+    '../sample/test.men',
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur_equiv.men',
+]
+
+
+def same(a, b):
+    return all(np.array_equal(x, y) for x, y in zip(a, b))
+
+
+def test_mensur():
+    """Compare every method with the file based functions."""
+
+    print("=" * 70)
+    print("Testing the Mensur type")
+    print("=" * 70)
+
+    freq = np.linspace(50.0, 1500.0, 30)
+
+    print("\n1. Methods against the file based functions...")
+    for fn in FILES:
+        men = calcimp.Mensur(fn)
+        for _ in range(2):
+            if not same(men.calcimp(temperature=20.0, threads=2),
+                        calcimp.calcimp(fn, temperature=20.0, threads=2)):
+                print(f"   ✗ {fn}: calcimp()")
+                return False
+            z = men.impedance(freq, threads=1)
+            ref = calcimp.impedance_at(fn, freq, threads=1)
+            if not (np.array_equal(z.real, ref[1]) and np.array_equal(z.imag, ref[2])):
+                print(f"   ✗ {fn}: impedance()")
+                return False
+            if not same(men.resonances(), calcimp.find_resonances(fn)):
+                print(f"   ✗ {fn}: resonances()")
+                return False
+            for step in [0.0, 7.0]:
+                if not same(men.pressure(freq, p0=2.0, step=step),
+                            calcimp.pressure_field(fn, freq, p0=2.0, step=step)):
+                    print(f"   ✗ {fn}: pressure() with step {step}")
+                    return False
+        print(f"   ✓ {fn}: {men!r}")
+
+    print("\n2. Cells and length...")
+    men = calcimp.Mensur('../sample/test.men')
+    if len(men) != 2 or men.cells != [(10.0, 10.0, 1000.0, 0), (10.0, 0.0, 0.0, 0)]:
+        print(f"   ✗ {len(men)} cells {men.cells}")
+        return False
+    if men.length != 1000.0:
+        print(f"   ✗ length {men.length}")
+        return False
+    men = calcimp.Mensur('../sample/trumpet_valve.xmen')
+    branches = {c[3] for c in men.cells}
+    if len(men) != len(men.cells) or branches != {0, 1}:
+        print(f"   ✗ {len(men)} cells in branches {branches}")
+        return False
+    print(f"   ✓ len() {len(men)}, length {men.length:.1f} mm")
+
+    print("\n3. Text and simplify...")
+    with open('../sample/trumpet_valve.xmen') as f:
+        text = f.read()
+    if not same(calcimp.Mensur.from_text(text).calcimp(), men.calcimp()):
+        print("   ✗ from_text() differs from the file")
+        return False
+    if not same(calcimp.Mensur(FILES[4], simplify=0.5).calcimp(),
+                calcimp.calcimp(FILES[4], simplify=0.5)):
+        print("   ✗ simplify differs from calcimp()")
+        return False
+    try:
+        calcimp.Mensur.from_text(text, format='txt')
+        print("   ✗ unknown format accepted")
+        return False
+    except ValueError:
+        pass
+    print("   ✓ from_text() and simplify match the file based calls")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: Mensur matches the file based functions")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_mensur()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+"""
+Test the native bore optimizer.
+
+optimize() fits variables of an XMENSUR file to target resonances. Targets
+taken from the same file with other values of its variables must lead
+back to those values, and bounds must hold.
+"""
+
+import os
+import re
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILENAME = '../sample/trumpet_valve.xmen'
+GOAL = {'bore_dia': 11.0, 'valve_len': 320.0}
+
+
+def write_xmen(values):
+    """A copy of FILENAME with the variables set to values."""
+    with open(FILENAME) as f:
+        text = f.read()
+    for name, value in values.items():
+        text = re.sub(r'^%s\s*=.*$' % name, '%s = %r' % (name, value), text, flags=re.M)
+    fd, path = tempfile.mkstemp(suffix='.xmen')
+    with os.fdopen(fd, 'w') as f:
+        f.write(text)
+    return path
+
+
+def goal_peaks():
+    path = write_xmen(GOAL)
+    try:
+        if calcimp.xmen_variables(path) != {'bore_dia': 11.0, 'valve_len': 320.0}:
+            print("   ✗ xmen_variables() does not see the edited values")
+            return None
+        freq, mag, _, _ = calcimp.find_resonances(path, max_freq=1000.0, tol=1e-6)
+    finally:
+        os.unlink(path)
+    return freq, mag
+
+
+def test_optimize():
+    """Recover variables of a trumpet from its resonances."""
+
+    print("=" * 70)
+    print("Testing bore optimizer")
+    print("=" * 70)
+
+    print("\n1. Variables...")
+    start = calcimp.xmen_variables(FILENAME)
+    if start != {'bore_dia': 11.5, 'valve_len': 300.0}:
+        print(f"   ✗ unexpected variables {start}")
+        return False
+    peaks = goal_peaks()
+    if peaks is None:
+        return False
+    freq, mag = peaks
+    print(f"   ✓ {len(freq)} target peaks")
+
+    print("\n2. Peak frequencies...")
+    values, res, info = calcimp.optimize(FILENAME, ['bore_dia', 'valve_len'], freq[:3])
+    err = max(abs(values[k] - GOAL[k]) for k in GOAL)
+    if not (info['converged'] and err < 1e-4 and np.max(np.abs(res)) < 1e-3):
+        print(f"   ✗ {values}, residuals {res} cents, {info}")
+        return False
+    print(f"   ✓ recovered within {err:.1e} mm in {info['iterations']} iterations, "
+          f"{info['evaluations']} evaluations")
+
+    print("\n3. Magnitude ratio...")
+    db = 20 * np.log10(mag[1] / mag[3])
+    values, res, info = calcimp.optimize(FILENAME, {'bore_dia': 11.5, 'valve_len': 300.0},
+                                         [freq[0], (freq[1], freq[3], db, 2.0)])
+    err = max(abs(values[k] - GOAL[k]) for k in GOAL)
+    if not (info['converged'] and err < 1e-4 and abs(res[1]) < 1e-4):
+        print(f"   ✗ {values}, residuals {res}, {info}")
+        return False
+    print(f"   ✓ recovered within {err:.1e} mm")
+
+    print("\n4. Bounds...")
+    values, res, info = calcimp.optimize(FILENAME, ['bore_dia', 'valve_len'], freq[:3],
+                                         bounds={'bore_dia': (11.2, None)})
+    if not values['bore_dia'] == 11.2 or not np.max(np.abs(res)) > 1e-3:
+        print(f"   ✗ bore_dia {values['bore_dia']} with lower bound 11.2")
+        return False
+    print(f"   ✓ bore_dia stays at its bound, valve_len {values['valve_len']:.2f}")
+
+    print("\n5. Errors...")
+    try:
+        calcimp.optimize(FILENAME, ['no_such_variable'], [100.0])
+        print("   ✗ unknown variable accepted")
+        return False
+    except ValueError:
+        pass
+    print("   ✓ unknown variable rejected")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: optimizer recovers the variables")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_optimize()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+"""
+Test single frequency evaluation with the cells shared among threads.
+
+For a few frequencies of a long bore impedance_at() cuts the main bore
+into one block per thread and multiplies the block chain matrices;
+otherwise it shares the frequencies. For any number of threads the result
+must match calcimp() at the same frequencies within rounding.
+"""
+
+import os
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+TEST_FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/trumpet_valve.xmen',
+    '../sample/subgroup.xmen',
+    'sample_xmensur.xmen',
+]
+
+N_TAPER = 20000
+RTOL = 1e-10
+
+
+def taper_men():
+    """A 10 - 30 mm taper of N_TAPER cells."""
+    fd, path = tempfile.mkstemp(suffix='.men')
+    with os.fdopen(fd, 'w') as f:
+        f.write('% taper\n')
+        for i in range(N_TAPER):
+            f.write('%r,%r,0.05,\n' % (10 + 20 * i / N_TAPER, 10 + 20 * (i + 1) / N_TAPER))
+        f.write('30,0,0,\n')
+    return path
+
+
+def compare(fn):
+    ref = calcimp.calcimp(fn, max_freq=2000.0, step_freq=2.5)
+    pick = [0, 1, 40, 176, 451, 800]
+    for threads in [1, 2, 3, 4, 8]:
+        res = calcimp.impedance_at(fn, ref[0][pick], threads=threads)
+        za = ref[1][pick] + 1j * ref[2][pick]
+        zb = res[1] + 1j * res[2]
+        d = np.max(np.abs(za - zb) / np.maximum(np.abs(za), 1e-300))
+        if not d <= RTOL:
+            print(f"   ✗ {fn} threads={threads}: max relative difference {d:.3e}")
+            return False
+    return True
+
+
+def test_parallel_chain():
+    """Compare impedance_at() for several thread counts with calcimp()."""
+
+    print("=" * 70)
+    print("Testing single frequency evaluation on threads")
+    print("=" * 70)
+
+    print("\n1. Sample files...")
+    for fn in TEST_FILES:
+        if not compare(fn):
+            return False
+        print(f"   ✓ {fn}")
+
+    print(f"\n2. Taper of {N_TAPER} cells...")
+    path = taper_men()
+    try:
+        if not compare(path):
+            return False
+    finally:
+        os.unlink(path)
+    print("   ✓ taper")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: impedance_at matches calcimp")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_parallel_chain()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+"""
+Test the pressure and volume velocity fields along the bore.
+
+pressure_field() propagates the standing wave of each frequency from the
+input to the open end. At the input p / u must be the input impedance, in
+a lossless cylinder p must follow the plane wave solution, and the result
+must not depend on the number of threads.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILENAME = '../sample/test.men'  # straight tube, 10 mm by 1000 mm
+TEMPERATURE = 24.0
+RTOL = 1e-9
+
+
+def input_impedance(fn, freq, x, p, u, area):
+    """p / u at the input as impedance density and impedance_at() for comparison."""
+    ref = calcimp.impedance_at(fn, freq, threads=1)
+    return p[:, 0] / u[:, 0] * area, ref[1] + 1j * ref[2]
+
+
+def test_pressure_field():
+    """Check the fields against the impedance and the plane wave."""
+
+    print("=" * 70)
+    print("Testing pressure and volume velocity fields")
+    print("=" * 70)
+
+    freq = np.linspace(20.0, 2000.0, 100)
+    area = np.pi * 0.010 ** 2 / 4
+
+    print("\n1. Stations...")
+    x, p, u = calcimp.pressure_field(FILENAME, freq)
+    if not np.allclose(x, [0.0, 1000.0]) or p.shape != (100, 2) or u.shape != (100, 2):
+        print(f"   ✗ stations {x}, shapes {p.shape} {u.shape}")
+        return False
+    x, p, u = calcimp.pressure_field(FILENAME, freq, p0=2.0 - 1.0j, step=5.0)
+    if not (len(x) == 201 and np.allclose(np.diff(x), 5.0) and p.shape == (100, 201)):
+        print(f"   ✗ {len(x)} stations with step 5 mm")
+        return False
+    print(f"   ✓ {len(x)} stations every 5 mm")
+
+    print("\n2. Input...")
+    if not np.all(p[:, 0] == 2.0 - 1.0j):
+        print("   ✗ pressure at the input is not p0")
+        return False
+    za, zb = input_impedance(FILENAME, freq, x, p, u, area)
+    if not np.allclose(za, zb, rtol=RTOL, atol=0):
+        print(f"   ✗ p / u differs from impedance_at() by {np.max(np.abs(za / zb - 1)):.2e}")
+        return False
+    x, p, u = calcimp.pressure_field('../sample/trumpet_valve.xmen', freq)
+    za, zb = input_impedance('../sample/trumpet_valve.xmen', freq, x, p, u,
+                             np.pi * 0.010 ** 2 / 4)
+    if not np.allclose(za, zb, rtol=RTOL, atol=0):
+        print(f"   ✗ trumpet: p / u differs from impedance_at() by {np.max(np.abs(za / zb - 1)):.2e}")
+        return False
+    print("   ✓ p / u at the input is the input impedance")
+
+    print("\n3. Plane wave in a lossless cylinder...")
+    x, p, u = calcimp.pressure_field(FILENAME, freq, step=10.0, dump_calc=False)
+    c = 331.45 * np.sqrt(TEMPERATURE / 273.16 + 1)
+    rho = 1.2929 * (273.16 / (273.16 + TEMPERATURE))
+    kx = np.outer(2 * np.pi * freq / c, x / 1000)
+    plane = p[:, :1] * np.cos(kx) - 1j * rho * c / area * u[:, :1] * np.sin(kx)
+    if not np.allclose(p, plane, rtol=0, atol=1e-9 * np.max(np.abs(p))):
+        print(f"   ✗ off the plane wave by {np.max(np.abs(p - plane)):.2e} Pa")
+        return False
+    uplane = u[:, :1] * np.cos(kx) - 1j * area / (rho * c) * p[:, :1] * np.sin(kx)
+    if not np.allclose(u, uplane, rtol=0, atol=1e-9 * np.max(np.abs(u))):
+        print(f"   ✗ volume velocity off the plane wave by {np.max(np.abs(u - uplane)):.2e}")
+        return False
+    print("   ✓ p and u follow cos(kx) and sin(kx)")
+
+    print("\n4. Threads...")
+    ref = calcimp.pressure_field('../sample/trumpet_valve.xmen', freq, step=20.0, threads=1)
+    for threads in [2, 3, 0]:
+        res = calcimp.pressure_field('../sample/trumpet_valve.xmen', freq, step=20.0,
+                                     threads=threads)
+        if not all(np.array_equal(a, b) for a, b in zip(ref, res)):
+            print(f"   ✗ threads={threads} differs from one thread")
+            return False
+    print("   ✓ identical for 1, 2, 3 and all threads")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: fields match the impedance and the plane wave")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_pressure_field()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,95 @@
+#!/usr/bin/env python
+"""
+Test the rational (pole-residue) model.
+
+fit_rational() approximates a calcimp() sweep by vector fitting. The model
+must reproduce the fitted points within its reported error, interpolate
+between them, be stable and real in the time domain, and accept complex
+frequencies.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+# file and order, about two poles per peak below 2 kHz and some for the losses
+TEST_FILES = [
+    ('../sample/test.men', 40),
+    ('../sample/trumpet_valve.xmen', 50),
+    ('sample_xmensur.xmen', 70),
+]
+
+RTOL = 1e-4
+
+
+def check(fn, n_poles):
+    freq, real, imag, mag_db, model = calcimp.calcimp(fn, rational=n_poles)
+    z = real + 1j * imag
+
+    if len(model) > n_poles or not np.all(model.poles.real <= 0):
+        print(f"   ✗ {fn}: {len(model)} poles, or an unstable one")
+        return False
+    rel = np.abs(model(freq[1:]) - z[1:]) / np.abs(z[1:])
+    if not (np.isclose(model.max_error, rel.max()) and model.max_error <= RTOL):
+        print(f"   ✗ {fn}: max error {model.max_error:.2e}, points differ by {rel.max():.2e}")
+        return False
+
+    # between the fitted points
+    mid = freq[1:-1] + np.diff(freq)[1:] / 2
+    ref = calcimp.impedance_at(fn, mid, threads=1)
+    zm = ref[1] + 1j * ref[2]
+    err = np.max(np.abs(model(mid) - zm) / np.abs(zm))
+    if not err <= 10 * RTOL:
+        print(f"   ✗ {fn}: off by {err:.2e} between the fitted points")
+        return False
+
+    # real impulse response, and s = 2j pi f
+    if not np.allclose(model(-mid), np.conj(model(mid)), rtol=1e-12):
+        print(f"   ✗ {fn}: Z(-f) is not conj Z(f)")
+        return False
+    fc = mid[:10] - 5j
+    if not np.allclose(model(fc), model.at_s(2j * np.pi * fc), rtol=1e-12):
+        print(f"   ✗ {fn}: complex frequencies disagree with at_s")
+        return False
+
+    print(f"   ✓ {fn}: {model}, {err:.1e} between points")
+    return True
+
+
+def test_rational():
+    """Fit the sample files and evaluate the models."""
+
+    print("=" * 70)
+    print("Testing rational impedance model")
+    print("=" * 70)
+
+    print("\n1. Sample files...")
+    for fn, n_poles in TEST_FILES:
+        if not check(fn, n_poles):
+            return False
+
+    print("\n2. Default order...")
+    freq, real, imag, _ = calcimp.calcimp(TEST_FILES[0][0])
+    model = calcimp.fit_rational(freq, real + 1j * imag)
+    if not model.max_error <= 1e-2:
+        print(f"   ✗ {model}")
+        return False
+    print(f"   ✓ {model}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: rational models match the impedance")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_rational()
+    sys.exit(0 if success else 1)
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+"""
+Test the time-domain responses.
+
+reflectance() sweeps Z on the grid of an FFT and transforms the reflectance
+and the impedance back in C. The spectra must agree with impedance_at(),
+the time responses with numpy's inverse FFT of the windowed spectra, and
+the first echo of a straight tube must arrive after the round trip 2L/c.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILENAME = '../sample/test.men'  # straight tube, 10 mm by 1000 mm
+RATE = 44100.0
+DURATION = 0.05
+RTOL = 1e-8
+
+
+def half_hann(freq, max_freq):
+    return np.where(freq <= max_freq, 0.5 + 0.5 * np.cos(np.pi * freq / max_freq), 0.0)
+
+
+def test_reflectance():
+    """Compare the responses with their definitions."""
+
+    print("=" * 70)
+    print("Testing reflectance and time responses")
+    print("=" * 70)
+
+    print("\n1. Grid...")
+    freq, R, t, r, h = calcimp.reflectance(FILENAME, sample_rate=RATE, duration=DURATION)
+    n = len(t)
+    if n % 2 or n < RATE * DURATION or len(freq) != n // 2 + 1 or len(R) != len(freq):
+        print(f"   ✗ {n} samples, {len(freq)} bins")
+        return False
+    if not (np.allclose(freq, np.arange(len(freq)) * RATE / n) and
+            np.allclose(t, np.arange(n) / RATE)):
+        print("   ✗ frequency or time axis off the FFT grid")
+        return False
+    print(f"   ✓ {n} samples, {len(freq)} bins of {freq[1]:.2f} Hz")
+
+    print("\n2. Reflectance against impedance_at()...")
+    ref = calcimp.impedance_at(FILENAME, freq[1:], threads=1)
+    z = ref[1] + 1j * ref[2]
+    zc = z * (1 - R[1:]) / (1 + R[1:])
+    if not np.allclose(zc, zc[0].real, rtol=RTOL) or not 380 < zc[0].real < 440:
+        print(f"   ✗ Z (1 - R) / (1 + R) is not one real Zc: {zc[:3]}")
+        return False
+    if R[0] != R[1].real:
+        print(f"   ✗ DC {R[0]} is not Re R of the first bin {R[1]}")
+        return False
+    print(f"   ✓ R = (Z - Zc) / (Z + Zc) with Zc = {zc[0].real:.1f} Pa s/m")
+
+    print("\n3. Time responses against numpy's inverse FFT...")
+    w = half_hann(freq, RATE / 2)
+    zd = np.concatenate([[z[0].real], z])
+    if not np.allclose(r, np.fft.irfft(R * w, n), rtol=0, atol=1e-10 * np.max(np.abs(r))):
+        print(f"   ✗ reflection function off by {np.max(np.abs(r - np.fft.irfft(R * w, n))):.2e}")
+        return False
+    if not np.allclose(h, np.fft.irfft(zd * w, n), rtol=0, atol=1e-10 * np.max(np.abs(h))):
+        print(f"   ✗ impulse response off by {np.max(np.abs(h - np.fft.irfft(zd * w, n))):.2e}")
+        return False
+    if not np.isclose(np.sum(r), R[0].real, rtol=RTOL):
+        print(f"   ✗ sum of r {np.sum(r)} is not R(0) {R[0].real}")
+        return False
+    print("   ✓ r and h match, sum of r is R(0)")
+
+    print("\n4. Echo of the open end...")
+    c = 331.45 * np.sqrt(1 + 24.0 / 273.15)
+    echo = t[np.argmin(r)]
+    if not 0.95 * 2 * 1.0 / c < echo < 1.1 * 2 * 1.0 / c:
+        print(f"   ✗ echo at {echo * 1e3:.2f} ms, round trip {2e3 / c:.2f} ms")
+        return False
+    print(f"   ✓ inverted echo at {echo * 1e3:.2f} ms, round trip {2e3 / c:.2f} ms")
+
+    print("\n5. Band limit and windows...")
+    freq, R, t, r, h = calcimp.reflectance(FILENAME, sample_rate=RATE, duration=DURATION,
+                                           max_freq=5000.0, window='rect')
+    if np.any(R[freq > 5000.0] != 0) or not np.allclose(
+            r, np.fft.irfft(np.where(freq <= 5000.0, R, 0), n), rtol=0, atol=1e-10):
+        print("   ✗ rect window with max_freq")
+        return False
+    for bad in [dict(window='kaiser'), dict(duration=0.0), dict(sample_rate=-1.0)]:
+        try:
+            calcimp.reflectance(FILENAME, **bad)
+            print(f"   ✗ {bad} accepted")
+            return False
+        except ValueError:
+            pass
+    print("   ✓ zero above max_freq, bad options rejected")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: responses match their spectra")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_reflectance()
+    sys.exit(0 if success else 1)
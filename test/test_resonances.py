@@ -0,0 +1,131 @@
+#!/usr/bin/env python
+"""
+Test the direct resonance finder.
+
+find_resonances() brackets the maxima of |Z| on a coarse grid and refines
+them and their -3 dB points with Brent's method and false position. The
+peaks, magnitudes and bandwidths must be those of a dense uniform sweep.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+TEST_FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/trumpet_valve.xmen',
+    'sample_xmensur.xmen',
+]
+
+MAX_FREQ = 2000.0
+DENSE_STEP = 0.01
+TOL = 1e-3
+RTOL = 1e-10
+HALF_POWER_DB = 10 * np.log10(2)
+
+
+def dense_resonances(fn):
+    """Peaks and -3 dB bandwidths of a dense calcimp() sweep."""
+    freq, real, imag, mag_db = calcimp.calcimp(fn, max_freq=MAX_FREQ, step_freq=DENSE_STEP)
+    k = np.where((mag_db[1:-1] > mag_db[:-2]) & (mag_db[1:-1] > mag_db[2:]))[0] + 1
+    k = k[freq[k - 1] > 0]
+    bandwidth = []
+    for i in k:
+        level = mag_db[i] - HALF_POWER_DB
+        lo = i - 1
+        while lo > 1 and level <= mag_db[lo] <= mag_db[lo + 1]:
+            lo -= 1
+        hi = i + 1
+        while hi < len(freq) - 1 and level <= mag_db[hi] <= mag_db[hi - 1]:
+            hi += 1
+        found = mag_db[lo] < level and mag_db[hi] < level
+        bandwidth.append(freq[hi] - freq[lo] if found else np.nan)
+    return freq[k], np.array(bandwidth)
+
+
+def check(fn):
+    freq, mag, q, bandwidth = calcimp.find_resonances(fn, max_freq=MAX_FREQ, tol=TOL)
+
+    ref = calcimp.impedance_at(fn, freq, threads=1)
+    ref_mag = np.hypot(ref[1], ref[2])
+    d = np.max(np.abs(mag - ref_mag) / ref_mag)
+    if not d <= RTOL:
+        print(f"   ✗ {fn}: magnitude differs by {d:.3e} from impedance_at")
+        return False
+
+    # each peak is a maximum at the scale of tol
+    for side in (-3 * TOL, 3 * TOL):
+        near = calcimp.impedance_at(fn, freq + side, threads=1)
+        if not np.all(np.hypot(near[1], near[2]) < mag):
+            print(f"   ✗ {fn}: |Z| is higher {side:+g} Hz from a peak")
+            return False
+
+    dense_freq, dense_bandwidth = dense_resonances(fn)
+    if len(freq) != len(dense_freq):
+        print(f"   ✗ {fn}: {len(freq)} peaks, dense sweep has {len(dense_freq)}")
+        return False
+    err = np.max(np.abs(freq - dense_freq))
+    if not err <= DENSE_STEP:
+        print(f"   ✗ {fn}: peak off by {err:.4f} Hz")
+        return False
+    # a valley narrower than step_freq is not seen, so the grids may differ on NaN
+    both = np.isfinite(bandwidth) & np.isfinite(dense_bandwidth)
+    if not both[0]:
+        print(f"   ✗ {fn}: no bandwidth for the first peak")
+        return False
+    err_bw = np.max(np.abs(bandwidth[both] - dense_bandwidth[both]))
+    if not err_bw <= 2 * DENSE_STEP:
+        print(f"   ✗ {fn}: bandwidth off by {err_bw:.4f} Hz")
+        return False
+    if not np.allclose(q, freq / bandwidth, equal_nan=True):
+        print(f"   ✗ {fn}: q is not frequency / bandwidth")
+        return False
+
+    print(f"   ✓ {fn}: {len(freq)} peaks, Q {np.nanmin(q):.1f} - {np.nanmax(q):.1f}")
+    return True
+
+
+def test_resonances():
+    """Compare find_resonances() with a dense sweep."""
+
+    print("=" * 70)
+    print("Testing resonance finder")
+    print("=" * 70)
+
+    print("\n1. Sample files...")
+    for fn in TEST_FILES:
+        if not check(fn):
+            return False
+
+    print("\n2. Instrument states...")
+    fn = '../sample/trumpet_valve.xmen'
+    tp = calcimp.Instrument(fn)
+    a = tp.resonances()
+    b = calcimp.find_resonances(fn)
+    if not all(np.array_equal(x, y) for x, y in zip(a, b)):
+        print("   ✗ Instrument.resonances() differs from find_resonances()")
+        return False
+    bypass = tp.resonances({'VALVE1': 0})[0]
+    if not bypass[0] > a[0][0]:
+        print("   ✗ bypassing the valve loop did not raise the first peak")
+        return False
+    print("   ✓ Instrument.resonances")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: resonances match the dense sweep")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_resonances()
+    sys.exit(0 if success else 1)
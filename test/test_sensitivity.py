@@ -0,0 +1,158 @@
+#!/usr/bin/env python
+"""
+Test the adjoint sensitivities.
+
+sensitivities() differentiates the input impedance by the diameters and
+length of every cell in one backward pass. Its columns must match central
+differences of IncrementalBore sweeps with the cell edited, and the
+derivatives of resonance_sensitivities() must match the shift of the
+peaks of find_resonances() on perturbed mensur files.
+"""
+
+import math
+import os
+import sys
+import tempfile
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+N_CELLS = 60
+HOLES = (20, 40)
+H = 1e-3          # mm, step of the central differences
+RTOL = 1e-5
+
+
+def profile():
+    """Main bore cells (df, db, r) in mm, the open end last, and tonehole cells."""
+    main = []
+    for i in range(N_CELLS):
+        main.append([10 + 3 * math.sin(i / 8), 10 + 3 * math.sin((i + 1) / 8), 10.0])
+    main.append([main[-1][1], 0.0, 0.0])
+    holes = [[[6.0, 5.0, 4.0], [5.0, 0.0, 0.0]] for _ in HOLES]
+    return main, holes
+
+
+def write_men(main, holes):
+    lines = ["sensitivity test"]
+    for i, cell in enumerate(main):
+        lines.append("%r,%r,%r," % tuple(cell))
+        if i in HOLES:
+            lines.append("-h%d,1" % i)
+    for i, cells in zip(HOLES, holes):
+        lines.append("$h%d" % i)
+        lines += ["%r,%r,%r," % tuple(c) for c in cells]
+    fd, path = tempfile.mkstemp(suffix='.men')
+    with os.fdopen(fd, 'w') as f:
+        f.write("\n".join(lines) + "\n")
+    return path
+
+
+def cell_values(main, holes):
+    """The cells in the order of IncrementalBore.cells."""
+    return main + [c for cells in holes for c in cells]
+
+
+def check_impedance(path, main, holes):
+    bore = calcimp.IncrementalBore(path, max_freq=2000.0, step_freq=100.0)
+    freq, real, imag, _ = bore.calcimp()
+    z, d_df, d_db, d_r = calcimp.sensitivities(path, freq, threads=2)
+
+    if len(bore.cells) != d_df.shape[1]:
+        print(f"   ✗ {d_df.shape[1]} columns for {len(bore.cells)} cells")
+        return False
+    d = np.max(np.abs(z - (real + 1j * imag)) / np.maximum(np.abs(z), 1e-300))
+    if not d <= 1e-10:
+        print(f"   ✗ impedance differs by {d:.3e} from IncrementalBore")
+        return False
+
+    cells = cell_values(main, holes)
+    picks = [0, 1, N_CELLS // 2, N_CELLS - 1, N_CELLS, N_CELLS + 1, N_CELLS + 2]
+    for i in picks:
+        # the open ends only take df
+        names = ('df',) if cells[i][2] == 0 else ('df', 'db', 'r')
+        for k, name in enumerate(names):
+            an = (d_df, d_db, d_r)[k][:, i]
+            v = cells[i][k]
+            bore.set_cell(i, **{name: v + H})
+            zp = bore.calcimp()
+            bore.set_cell(i, **{name: v - H})
+            zm = bore.calcimp()
+            bore.set_cell(i, **{name: v})
+            fd = ((zp[1] - zm[1]) + 1j * (zp[2] - zm[2])) / (2 * H)
+            err = np.max(np.abs(fd - an))
+            if not err <= RTOL * np.max(np.abs(an)) + 1e-12 * np.max(np.abs(z)):
+                print(f"   ✗ cell {i} d{name}: off by {err:.3e}, scale {np.max(np.abs(an)):.3e}")
+                return False
+    print(f"   ✓ dZ of {len(picks)} cells matches central differences")
+    return True
+
+
+def peaks(main, holes):
+    path = write_men(main, holes)
+    try:
+        return calcimp.find_resonances(path, max_freq=1500.0, tol=1e-7)[0]
+    finally:
+        os.unlink(path)
+
+
+def check_resonances(path, main, holes):
+    freq, d_df, d_db, d_r = calcimp.resonance_sensitivities(path, max_freq=1500.0, tol=1e-7)
+    if not np.allclose(freq, calcimp.find_resonances(path, max_freq=1500.0, tol=1e-7)[0]):
+        print("   ✗ peaks differ from find_resonances()")
+        return False
+
+    h = 0.05
+    for i in (5, N_CELLS // 2, N_CELLS + 2):
+        cells = cell_values(main, holes)
+        v = cells[i][2]
+        cells[i][2] = v + h
+        fp = peaks(main, holes)
+        cells[i][2] = v - h
+        fm = peaks(main, holes)
+        cells[i][2] = v
+        fd = (fp - fm) / (2 * h)
+        err = np.max(np.abs(fd - d_r[:, i]))
+        if not err <= 1e-3 * np.max(np.abs(d_r[:, i])):
+            print(f"   ✗ cell {i}: peak shift off by {err:.3e} Hz/mm")
+            return False
+    print(f"   ✓ {len(freq)} peaks, shifts match perturbed find_resonances()")
+    return True
+
+
+def test_sensitivity():
+    """Compare the adjoint derivatives with finite differences."""
+
+    print("=" * 70)
+    print("Testing adjoint sensitivities")
+    print("=" * 70)
+
+    main, holes = profile()
+    path = write_men(main, holes)
+    try:
+        print("\n1. Impedance...")
+        if not check_impedance(path, main, holes):
+            return False
+
+        print("\n2. Resonance frequencies...")
+        if not check_resonances(path, main, holes):
+            return False
+    finally:
+        os.unlink(path)
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: sensitivities match finite differences")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_sensitivity()
+    sys.exit(0 if success else 1)
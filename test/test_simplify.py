@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+"""
+Test the mensur simplification pass (simplify_men / calcimp(simplify=...)).
+
+With tolerance 0 only cylinders of equal diameter are merged, so the
+impedance must not change, with or without wall losses. A positive
+tolerance must never remove fewer cells than tolerance 0.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/trumpet_valve.xmen',
+    '../sample/subgroup.xmen',
+    'sample_xmensur.xmen',
+]
+
+RTOL = 1e-9
+
+
+def max_rel_diff(a, b):
+    za = a[1] + 1j * a[2]
+    zb = b[1] + 1j * b[2]
+    scale = np.maximum(np.abs(za), 1e-300)
+    return np.max(np.abs(za - zb) / scale)
+
+
+def test_simplify():
+    """Compare simplified and original mensurs."""
+
+    print("=" * 70)
+    print("Testing mensur simplification")
+    print("=" * 70)
+
+    print("\n1. Cell counts...")
+    for fn in FILES:
+        before = calcimp.print_men(fn)
+        removed, cells = calcimp.simplify_men(fn)
+        if removed < 0 or len(cells) > len(before):
+            print(f"   ✗ {fn}: removed={removed}, {len(before)} -> {len(cells)} cells")
+            return False
+        removed_tol, cells_tol = calcimp.simplify_men(fn, tolerance=0.5)
+        if removed_tol < removed or len(cells_tol) > len(cells):
+            print(f"   ✗ {fn}: tolerance 0.5 removed {removed_tol} < {removed}")
+            return False
+        print(f"   ✓ {fn}: {removed} cells removed ({removed_tol} with 0.5 mm)")
+
+    try:
+        calcimp.simplify_men(FILES[0], tolerance=-1.0)
+        print("   ✗ negative tolerance accepted")
+        return False
+    except ValueError:
+        print("   ✓ negative tolerance rejected")
+
+    print("\n2. Impedance with simplify=0...")
+    for fn in FILES:
+        for dump_calc in (False, True):
+            args = dict(max_freq=3000.0, step_freq=1.0, dump_calc=dump_calc)
+            ref = calcimp.calcimp(fn, **args)
+            simp = calcimp.calcimp(fn, simplify=0.0, **args)
+            d = max_rel_diff(ref, simp)
+            if not d <= RTOL:
+                print(f"   ✗ {fn} dump_calc={dump_calc}: max relative difference {d:.3e}")
+                return False
+        print(f"   ✓ {fn}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: simplification keeps the impedance")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_simplify()
+    sys.exit(0 if success else 1)
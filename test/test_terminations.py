@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+"""
+Test input impedance from the termination independent chain matrix.
+
+calcimp_terminations() sweeps the bore once and applies every termination
+to the cached chain matrix. For each radiation mode the result must agree
+with a full calcimp() run within rounding. Files with toneholes are only
+compared for PIPE, because side branch ends keep their own radiation mode.
+"""
+
+import sys
+
+import numpy as np
+
+try:
+    import calcimp
+except ImportError:
+    print("Error: calcimp module not found. Please install it first.")
+    sys.exit(1)
+
+
+# files without open side branches: every mode must match
+PLAIN_FILES = [
+    '../sample/test.men',
+    '../sample/closed.men',
+    '../sample/test.xmen',
+]
+
+BRANCHED_FILES = [
+    '../sample/branch.xmen',
+    '../sample/split.xmen',
+    '../sample/trumpet_valve.xmen',
+    '../sample/subgroup.xmen',
+    'sample_xmensur.xmen',
+]
+
+RTOL = 1e-10
+
+
+def max_rel_diff(a, b):
+    za = a[1] + 1j * a[2]
+    zb = b[1] + 1j * b[2]
+    scale = np.maximum(np.abs(za), 1e-300)
+    return np.max(np.abs(za - zb) / scale)
+
+
+def test_terminations():
+    """Compare terminations of one chain sweep with separate calcimp runs."""
+
+    print("=" * 70)
+    print("Testing termination independent chain matrix")
+    print("=" * 70)
+
+    args = dict(max_freq=3000.0, step_freq=1.0)
+
+    print("\n1. Radiation modes against calcimp()...")
+    modes = [calcimp.PIPE, calcimp.BUFFLE, calcimp.NONE]
+    for fn in PLAIN_FILES + BRANCHED_FILES:
+        check = modes if fn in PLAIN_FILES else [calcimp.PIPE]
+        results = calcimp.calcimp_terminations(fn, terminations=check, **args)
+        for mode, res in zip(check, results):
+            ref = calcimp.calcimp(fn, rad_calc=mode, **args)
+            if not np.array_equal(ref[0], res[0]):
+                print(f"   ✗ {fn} mode {mode}: frequency axis differs")
+                return False
+            d = max_rel_diff(ref, res)
+            if not d <= RTOL:
+                print(f"   ✗ {fn} mode {mode}: max relative difference {d:.3e}")
+                return False
+        print(f"   ✓ {fn}")
+
+    print("\n2. Custom and closed terminations...")
+    for fn in PLAIN_FILES + BRANCHED_FILES:
+        chain = calcimp.chain_matrix(fn, **args)
+        freq, t, bell, closed = chain
+        pipe = calcimp.terminate(chain, calcimp.PIPE)
+        if not closed:
+            z_l = calcimp.radiation_impedance(freq, bell, calcimp.PIPE)
+            custom = calcimp.terminate(chain, z_l)
+            d = max_rel_diff(pipe, custom)
+            if not d <= RTOL:
+                print(f"   ✗ {fn}: custom Z_L differs from PIPE by {d:.3e}")
+                return False
+        shut = calcimp.terminate(chain, calcimp.CLOSED)
+        same = calcimp.terminate(chain, (calcimp.PIPE, 0.0))
+        if max_rel_diff(shut, same) != 0:
+            print(f"   ✗ {fn}: e_ratio 0 is not closed")
+            return False
+        if closed and max_rel_diff(shut, pipe) != 0:
+            print(f"   ✗ {fn}: closed bore depends on the termination")
+            return False
+        print(f"   ✓ {fn}")
+
+    print("\n" + "=" * 70)
+    print("✓ ALL TESTS PASSED: terminations agree with calcimp")
+    print("=" * 70)
+
+    return True
+
+
+if __name__ == '__main__':
+    success = test_terminations()
+    sys.exit(0 if success else 1)